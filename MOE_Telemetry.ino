@@ -19,6 +19,18 @@
 #include "power_utils.h"
 #include "button_utils.h"
 #include "ota_utils.h"
+#include "ota_pull.h"
+#include "history_store.h"
+#include "ts_store.h"
+#include "config_store.h"
+#include "task_config.h"
+#include "moe_log.h"
+#include "wake_stats.h"
+#include "door_events.h"
+#include "app_sched.h"
+#include "ap_portal.h"
+#include "wifi_store.h"
+#include "wifi_link.h"
 
 // Safety prototype: si por alguna razón el encabezado no se encuentra
 // en la copia que compilas desde el IDE de Arduino, esta declaración
@@ -26,6 +38,9 @@
 // door_state: -1 = desconocido, 0 = cerrada, 1 = abierta
 void ota_set_device_metrics(float temp_c, float humidity_pct, int battery_pct, int door_state);
 
+// Pila de loopTask desde la tabla de tareas
+SET_LOOP_TASK_STACK_SIZE(TASK_STACK_LOOP + TASK_PROFILE_HEADROOM);
+
 // Ensure RESET_BUTTON_PIN is defined (some toolchains may not include config.h early)
 #ifndef RESET_BUTTON_PIN
 #define RESET_BUTTON_PIN PRG_BUTTON_PIN
@@ -37,50 +52,193 @@ void ota_set_device_metrics(float temp_c, float humidity_pct, int battery_pct, i
 #include <esp_sleep.h>
 #include "driver/rtc_io.h"
 #include <time.h>
-#include <Preferences.h>
 
-// ---- Helpers: gestión de pulsos en botón PRG ----
-// Nota: la función anterior era bloqueante y provocaba latencias y re-lecturas no deseadas.
-// Implementamos un detector no bloqueante para doble-click y funciones de persistencia en NVS.
+// ---- Modo continuo: trabajos del bucle de eventos (app_sched) ----
+
+// Eventos de puerta ya filtrados (fuente: cola de door_events)
+static void job_door(void* ctx)
+{
+  door_event_t door_ev;
+  while (door_event_wait(&door_ev, 0))
+  {
+    // Guardar el nuevo estado en memoria RTC
+    int door_state_now = door_ev.state;
+    int previous_state = last_door_state;
+    last_door_state = door_state_now;
+
+    display_door_status = door_state_now ? "Puerta:Abierta" : "Puerta:Cerrada";
+    display_wake();
+    display_oled_message_3_line(display_temperature, display_humidity, display_door_status);
+
+    MLOGI("[CONTINUOUS] Cambio detectado: puerta %d -> %d (%u us desde el flanco)",
+          previous_state, door_state_now, (unsigned)door_ev.latency_us);
+
+    // En modo continuo: registrar interacción de puerta mediante POST
+    // Actualizar estado de batería antes de enviar
+    get_battery_status();
+
+    // Actualizar métricas OTA inmediatamente (incluye estado de puerta)
+    ota_set_device_metrics(NAN, NAN, battery_level, door_state_now);
+
+    // Garantizar conexión WiFi antes de intentar el POST. set_wifi_connection
+    // vuelve con WL_CONNECTED, que el core fija con el evento STA_GOT_IP: la
+    // dirección ya está asignada y no hace falta esperar más
+    if (WiFi.status() != WL_CONNECTED) {
+      MLOGI("[CONTINUOUS] Reconectando WiFi...");
+      set_wifi_connection();
+    }
+
+    if (WiFi.status() == WL_CONNECTED) {
+      MLOGI("[CONTINUOUS] Enviando POST: puerta=%d, batería=%dmV (%d%%)", 
+                    door_state_now, battery_voltage, battery_level);
+      send_POST_door_status_battery(door_state_now, battery_voltage, battery_level);
+    } else {
+      // Si no hay conexión, mostrar en serial
+      MLOGW("[CONTINUOUS] No hay WiFi: no se pudo enviar POST de puerta");
+    }
+  }
+}
 
-// Variables para detector no bloqueante (ver button_utils.cpp)
-// Ahora se declaran e inicializan en button_utils.cpp
+// Gestos del botón PRG (fuente: cola de button_utils)
+static void job_button(void* ctx)
+{
+  button_gesture_t gesture;
+  while (button_gesture_wait(&gesture, 0))
+  {
+    if (gesture.type == BUTTON_DOWN) display_wake();
+    // Doble click: en lugar de cambiar a modo bateria, abrir el portal de configuración
+    if (gesture.type != BUTTON_CLICKS || gesture.count < 2 || ap_portal_active()) continue;
+
+    MLOGI("[CONTINUOUS] Doble click detectado: abriendo portal de configuración...");
+    display_oled_message_3_line("Abriendo", "portal", "de configuración", 1000);
+    // Las credenciales actuales se conservan hasta guardar unas ya probadas
+    ap_portal_start();
+  }
+}
 
-// Persistencia de modo usando NVS (Preferences)
-void saveModeToNVS(uint8_t mode)
+// Temperatura, humedad y batería
+static void job_sensors(void* ctx)
 {
-  Preferences prefs;
-  prefs.begin("moe_cfg", false);
-  prefs.putUChar("mode", mode);
-  prefs.end();
+  get_temperature_humidity();
+  get_battery_status();
+  ota_set_device_metrics(temperature, humidity, battery_level, last_door_state);
+  // RSSI del enlace: si cambia de nivel se ajustan potencia y ahorro en reposo
+  wifi_link_update();
+  // Con el portal abierto la pantalla muestra su SSID/IP
+  if (ap_portal_active()) ap_portal_show();
+  else display_oled_message_3_line(display_temperature, display_humidity, display_door_status);
 }
 
-uint8_t loadModeFromNVS(uint8_t defaultMode)
+// Volcado a NVS de los cambios de configuración ya agrupados y picos de pila
+// (sólo con MOE_STACK_PROFILE)
+static void job_housekeeping(void* ctx)
 {
-  Preferences prefs;
-  prefs.begin("moe_cfg", true);
-  uint8_t m = prefs.getUChar("mode", defaultMode);
-  prefs.end();
-  return m;
+  config_store_tick();
+  task_profile_sample("continuo");
 }
 
-// Detección robusta de long-press: detecta estado opuesto al inicial sostenido durante ms
-bool isButtonLongPressed(int pin, unsigned long ms)
+// Una vez, poco después de lanzar la tarea OTA: el servidor queda activo cuando
+// la tarea termina de levantarlo
+static void job_ota_check(void* ctx)
 {
-  int initial = digitalRead(pin);
-  unsigned long start = millis();
-  // esperar hasta que el pin cambie de estado
-  while (digitalRead(pin) == initial && (millis() - start) < 2000) {
-    delay(10);
+  if (is_ota_active()) MLOGI("[SETUP] ✓ OTA iniciado correctamente"); else MLOGE("[SETUP] ✗ ERROR: OTA no se inició");
+}
+
+static void start_continuous_jobs(bool ota_started)
+{
+  app_sched_begin();
+  int door_job = app_sched_on_event("door", job_door, NULL);
+  door_events_notify(app_sched_watch_signal(door_job));
+  // Los gestos de las ventanas de arranque ya se atendieron: no repetirlos
+  button_events_begin();
+  xQueueReset(button_events_queue());
+  int button_job = app_sched_on_event("button", job_button, NULL);
+  button_events_notify(app_sched_watch_signal(button_job));
+  app_sched_every("sensors", job_sensors, NULL, CONTINUOUS_SENSOR_PERIOD_MS);
+  app_sched_every("housekeeping", job_housekeeping, NULL, CONTINUOUS_HOUSEKEEPING_MS);
+  if (ota_started) app_sched_after("ota_check", job_ota_check, NULL, CONTINUOUS_OTA_CHECK_MS);
+}
+
+// Conexión, OTA, puerta por interrupción, light sleep y bucle de trabajos
+static void continuous_mode_begin()
+{
+  // Conectar WiFi y preparar OTA sólo en modo continuo
+  MLOGI("[SETUP] Conectando WiFi (modo Continuo)...");
+  display_oled_message_3_line("Conectando","a WiFi...","", 500);
+  set_wifi_connection();
+  bool ota_started = false;
+
+  if (WiFi.status() == WL_CONNECTED)
+  {
+    IPAddress ip = WiFi.localIP();
+    char ip_str[16];
+    snprintf(ip_str, sizeof(ip_str), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    MLOGI("[SETUP] ✓ WiFi conectado!");
+    MLOGI("[SETUP] IP: %s", ip_str);
+    MLOGI("[SETUP] RSSI: %d dBm", (int)WiFi.RSSI());
+    MLOGI("[SETUP] OTA disponible en: http://%s", ip_str);
+    display_line_t version_line, ip_line;
+    version_line.format("v%s", FIRMWARE_VERSION);
+    ip_line.format("IP: %s", ip_str);
+    display_oled_message_3_line(version_line, ip_line, "OTA disponible", 3000);
+    // Hora para el historial local (en modo normal se sincroniza en cada despertar por timer)
+    get_time_NTP();
+    // Con el portal abierto :80 es suyo; el OTA arranca cuando se cierre
+    if (!ap_portal_active()) {
+      MLOGI("[SETUP] Iniciando OTA en background...");
+      Serial.flush();
+      init_ota_background();
+      // El resultado se comprueba desde el bucle de trabajos (job_ota_check)
+      ota_started = true;
+    }
   }
-  // Si no cambió en 2s, no hay pulsación sostenida
-  if (digitalRead(pin) == initial) return false;
-  // Ahora esperar que el estado opuesto se mantenga durante ms
-  unsigned long t0 = millis();
-  while (digitalRead(pin) != initial && (millis() - t0) < ms) {
-    delay(10);
+  else
+  {
+    MLOGE("[SETUP] ✗ Error: WiFi no disponible (status: %d)", (int)WiFi.status());
+    display_line_t version_line;
+    version_line.format("v%s", FIRMWARE_VERSION);
+    display_oled_message_3_line(version_line, "Modo sin", "conexión", 1500);
   }
-  return (digitalRead(pin) != initial) ? false : ((millis() - t0) >= ms);
+
+  display_oled_message_3_line(
+    "Inicio de modo",
+    "funcionamiento",
+    "continuo",
+    1000
+  );
+
+  // Lectura inicial; desde aquí la puerta llega por interrupción (door_events)
+  get_temperature_humidity();
+  get_battery_status();
+  door_events_begin();
+  // Light sleep entre eventos: la puerta y el botón PRG despiertan por GPIO
+  power_light_sleep_begin();
+  int initial_door = door_events_state();
+  last_door_state = initial_door; // Guardar estado inicial en RTC
+  ota_set_device_metrics(temperature, humidity, battery_level, initial_door);
+  display_door_status = last_door_state ? "Puerta:Abierta" : "Puerta:Cerrada";
+  if (ap_portal_active()) ap_portal_show();
+  else display_oled_message_3_line(display_temperature, display_humidity, display_door_status);
+  
+  MLOGI("[CONTINUOUS] Estado inicial de puerta: %d", initial_door);
+
+  // El panel se apaga tras un minuto sin eventos; puerta y botón lo encienden
+  // (con el portal abierto queda encendido mostrando SSID/IP)
+  display_set_idle_off(ap_portal_active() ? 0 : DISPLAY_IDLE_OFF_MS);
+
+  // Bucle continuo: trabajos del planificador, ejecutados desde loop()
+  start_continuous_jobs(ota_started);
+}
+
+// Portal de configuración en segundo plano: el equipo queda en modo continuo
+// (persistente) y sigue midiendo y enviando mientras el portal está abierto
+static void enter_config_portal()
+{
+  current_mode = MODE_CONTINUOUS;
+  config_set_mode(MODE_CONTINUOUS);
+  config_store_flush();
+  ap_portal_start();
+  continuous_mode_begin();
 }
 
 //  Esta función contiene toda la lógica de funcionamiento del modulo y los diferentes sensores utilizados
@@ -88,12 +246,30 @@ void setup()
 {
   // Inicializar Serial para debugging
   Serial.begin(115200);
-  delay(500);
-  
-  Serial.println("\n\n=================================");
-  Serial.println("MOE Telemetry v" + String(FIRMWARE_VERSION));
-  Serial.println("=================================");
-  
+
+  //  Se determina el motivo por el cual el módulo despertó del DeepSleep
+  esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
+
+  // Configuración persistente: desde el espejo RTC o, en arranque en frío, desde NVS
+  config_store_begin();
+  // Redes WiFi guardadas y su historial, también desde RTC en los despertares
+  wifi_store_begin();
+
+  // Despertar sin pantalla (modo normal, timer o puerta): no se enciende Vext
+  // ni se inicializa el panel y se omiten las ventanas de pulsaciones del
+  // botón. El botón PRG (EXT1) despierta con pantalla e interacción.
+  bool headless = (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER || wakeup_reason == ESP_SLEEP_WAKEUP_EXT0) &&
+                  current_mode == MODE_NORMAL && config_get_headless_wake();
+  wake_stats_begin(wakeup_reason, headless);
+  if (!headless) delay(500);
+
+  MLOGI("=================================");
+  MLOGI("MOE Telemetry v%s", FIRMWARE_VERSION);
+  MLOGI("=================================");
+
+  // loopTask entra al perfilado de pilas junto con las tareas de task_spawn
+  task_profile_attach(TASK_LOOP, xTaskGetCurrentTaskHandle());
+
   // Inicializar optimizaciones de energía antes de ejecutar el funcionamiento del módulo
   init_power_optimization();
 
@@ -102,51 +278,53 @@ void setup()
   pinMode(DOOR_SENSOR_PIN, INPUT_PULLUP);
 
   //  Se inicializan los sensores y periféricos
-  init_display();
-  // Detectar long-press del botón de RESET (configurable) para factory reset (5 segundos)
-  if (digitalRead(RESET_BUTTON_PIN) == LOW) {
-    unsigned long startPress = millis();
-    // Esperar mientras se mantiene presionado y comprobar duración
-    while (digitalRead(RESET_BUTTON_PIN) == LOW) {
-      if (millis() - startPress >= 5000) {
-        Serial.println("[SETUP] Long-press detectado: realizando factory reset de WiFi...");
-        display_oled_message_3_line("Factory Reset","Borrando credenciales","Reiniciando...");
-        erase_wifi_credentials();
-        delay(200);
-        ESP.restart();
-      }
-      delay(10);
+  if (headless) display_headless(); else init_display();
+  history_begin();
+  ts_store_begin();
+  // Registro binario: el anillo RTC conserva lo escrito antes de montar LittleFS
+  mlog_begin();
+  // Detectar long-press del botón de RESET (configurable) para factory reset (5 segundos).
+  // Al despertar por PRG el botón sigue presionado: no es una pulsación de RESET.
+  if (!headless && wakeup_reason != ESP_SLEEP_WAKEUP_EXT1 && digitalRead(RESET_BUTTON_PIN) == LOW) {
+    // La pulsación en curso la sigue el reconocedor de gestos: se decide con
+    // el primer gesto que no sea una nueva pulsación (larga o secuencia breve)
+    button_events_begin();
+    button_gesture_t gesture;
+    bool got = false;
+    while ((got = button_gesture_wait(&gesture, BUTTON_LONG_PRESS_MS + BUTTON_CLICK_GAP_MS)) && gesture.type == BUTTON_DOWN) {}
+    if (got && gesture.type == BUTTON_LONG) {
+      MLOGI("[SETUP] Long-press detectado: realizando factory reset de WiFi...");
+      display_oled_message_3_line("Factory Reset","Borrando credenciales","Reiniciando...", 500);
+      erase_wifi_credentials();
+      display_drain(DISPLAY_DRAIN_MAX_MS);
+      ESP.restart();
     }
     // Si se pulsó brevemente (no llegó a 5s), forzar inicio en modo CONTINUO
-    unsigned long pressDuration = millis() - startPress;
-    if (pressDuration > 0 && pressDuration < 5000) {
-      Serial.println("[SETUP] RESET breve detectado: forzando MODO_CONTINUO persistente");
-      saveModeToNVS(MODE_CONTINUOUS);
+    if (got) {
+      MLOGI("[SETUP] RESET breve detectado (%u ms): forzando MODO_CONTINUO persistente", (unsigned)gesture.press_ms);
+      config_set_mode(MODE_CONTINUOUS);
       current_mode = MODE_CONTINUOUS;
-      display_oled_message_3_line("Modo", "Forzado:", "Continuo");
-      delay(600);
+      display_oled_message_3_line("Modo", "Forzado:", "Continuo", 600);
     }
   }
   init_sensors();
-  init_button_detector(); // Inicializar detector de botones
+  // Gestos del botón PRG por interrupción (no hacen falta en un despertar sin pantalla)
+  if (!headless) button_events_begin();
 
   // Detectar 6 pulsaciones seguidas del botón PRG para entrar en modo AP/OTA
   // (reemplaza la detección de long-press que no funcionaba de forma fiable)
-  int presses_for_ap = countButtonPressesWithinWindow(6000); // 6s ventana para 6 pulsos
+  int presses_for_ap = headless ? 0 : countButtonPressesWithinWindow(6000); // 6s ventana para 6 pulsos
     if (presses_for_ap >= 6) { 
-    Serial.println("[SETUP] PRG 6x press detected: entrando en modo AP/OTA...");
+    MLOGI("[SETUP] PRG 6x press detected: entrando en modo AP/OTA...");
     display_oled_message_3_line("Entrando en", "modo AP/OTA", "Espere...");
-    // Start AP configuration portal (blocking)
-    start_config_ap();
-    // start_config_ap loops indefinitely until restart, so nothing after will run
+    // Portal en segundo plano; el equipo sigue en modo continuo
+    enter_config_portal();
+    return;
   }
 
   // Nota: la conexión WiFi e inicialización OTA se realizan más adelante
   // sólo si el dispositivo permanece en modo CONTINUOUS (ver abajo).
 
-  //  Se determina el motivo por el cual el módulo despertó del DeepSleep
-  esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
-
   // Nota: no forzar modo CONTINUO aquí para no romper el ciclo de DeepSleep.
   // Sólo en arranque en frío (wakeup_reason == ESP_SLEEP_WAKEUP_UNDEFINED)
   // se deberá forzar el modo CONTINUO si se desea reinicio físico.
@@ -155,171 +333,58 @@ void setup()
   if (wakeup_reason == ESP_SLEEP_WAKEUP_UNDEFINED) 
   {
     // Al arrancar en frio: forzar MODO_CONTINUO persistente (reinicio físico)
+    // (sólo se escribe en NVS si el modo guardado era otro)
     current_mode = MODE_CONTINUOUS;
-    saveModeToNVS(MODE_CONTINUOUS);
+    config_set_mode(MODE_CONTINUOUS);
+    config_store_flush();
 
     if (current_mode == MODE_CONTINUOUS) 
     {
-      // Conectar WiFi y preparar OTA sólo en modo continuo
-      Serial.println("[SETUP] Conectando WiFi (modo Continuo)...");
-      display_oled_message_3_line("Conectando","a WiFi...","");
-      delay(500);
-      set_wifi_connection();
-
-      if (WiFi.status() == WL_CONNECTED)
-      {
-        String ip_str = WiFi.localIP().toString();
-        Serial.println("[SETUP] ✓ WiFi conectado!");
-        Serial.println("[SETUP] IP: " + ip_str);
-        Serial.println("[SETUP] RSSI: " + String(WiFi.RSSI()) + " dBm");
-        Serial.println("[SETUP] OTA disponible en: http://" + ip_str);
-        display_oled_message_3_line("v" + String(FIRMWARE_VERSION), "IP: " + ip_str, "OTA disponible");
-        delay(3000);
-        Serial.println("[SETUP] Iniciando OTA en background...");
-        Serial.flush();
-        init_ota_background();
-        delay(500);
-        if (is_ota_active()) Serial.println("[SETUP] ✓ OTA iniciado correctamente"); else Serial.println("[SETUP] ✗ ERROR: OTA no se inició");
-      }
-      else
-      {
-        Serial.println("[SETUP] ✗ Error: WiFi no disponible (status: " + String(WiFi.status()) + ")");
-        display_oled_message_3_line("v" + String(FIRMWARE_VERSION), "Modo sin", "conexión");
-        delay(1500);
-      }
-
-      display_oled_message_3_line(
-        "Inicio de modo",
-        "funcionamiento",
-        "continuo"
-      );
-      delay(1000);
-
-      // Bucle continuo: mostrar Temp, Hum y Estado de Puerta con respuesta inmediata a cambios
-      // Variables para muestreo no bloqueante
-      unsigned long last_sensor_update = 0;
-
-      // Lectura inicial
-      get_temperature_humidity();
-      get_battery_status();
-      int initial_door = (digitalRead(DOOR_SENSOR_PIN) == true) ? 1 : 0;
-      last_door_state = initial_door; // Guardar estado inicial en RTC
-      ota_set_device_metrics(temperature, humidity, battery_level, initial_door);
-      display_door_status = last_door_state ? "Puerta:Abierta" : "Puerta:Cerrada";
-      display_oled_message_3_line(display_temperature, display_humidity, display_door_status);
-      
-      Serial.printf("[CONTINUOUS] Estado inicial de puerta: %d\n", initial_door);
-
-      while (true)
-      {
-        unsigned long now = millis();
-
-        // 1) Revisar cambios en el sensor de puerta (respuesta inmediata)
-        int door_state_now = (digitalRead(DOOR_SENSOR_PIN) == true) ? 1 : 0;
-        if (door_state_now != last_door_state)
-        {
-          // Guardar el nuevo estado en memoria RTC
-          int previous_state = last_door_state;
-          last_door_state = door_state_now;
-          
-          display_door_status = door_state_now ? "Puerta:Abierta" : "Puerta:Cerrada";
-          display_oled_message_3_line(display_temperature, display_humidity, display_door_status);
-
-          Serial.printf("[CONTINUOUS] Cambio detectado: puerta %d -> %d\n", previous_state, door_state_now);
-
-          // En modo continuo: registrar interacción de puerta mediante POST
-          // Actualizar estado de batería antes de enviar
-          get_battery_status();
-
-          // Actualizar métricas OTA inmediatamente (incluye estado de puerta)
-          ota_set_device_metrics(NAN, NAN, battery_level, door_state_now);
-
-          // Garantizar conexión WiFi antes de intentar el POST
-          if (WiFi.status() != WL_CONNECTED) {
-            Serial.println("[CONTINUOUS] Reconectando WiFi...");
-            set_wifi_connection();
-            delay(200); // breve espera a que la conexión se estabilice
-          }
-
-          if (WiFi.status() == WL_CONNECTED) {
-            Serial.printf("[CONTINUOUS] Enviando POST: puerta=%d, batería=%dmV (%d%%)\n", 
-                          door_state_now, battery_voltage, battery_level);
-            send_POST_door_status_battery(door_state_now, battery_voltage, battery_level);
-          } else {
-            // Si no hay conexión, mostrar en serial
-            Serial.println("[CONTINUOUS] No hay WiFi: no se pudo enviar POST de puerta");
-          }
-        }
-
-        // 2) Revisar doble click: en lugar de cambiar a modo bateria, entrar en AP de configuración
-        if (nonBlockingDoubleClickDetected(800))
-        {
-          Serial.println("[CONTINUOUS] Doble click detectado: borrando credenciales y entrando en AP de configuración...");
-          display_oled_message_3_line("Formateando", "y entrando", "modo AP...");
-          // Borrar credenciales para dejar el dispositivo 'formateado'
-          erase_wifi_credentials();
-          delay(200);
-          // Iniciar portal de configuración (bloqueante)
-          start_config_ap();
-        }
-
-        // 3) Actualizar temperatura y humedad cada 5s
-        if (now - last_sensor_update >= 5000)
-        {
-          get_temperature_humidity();
-          get_battery_status();
-          int door_now = (digitalRead(DOOR_SENSOR_PIN) == true) ? 1 : 0;
-          ota_set_device_metrics(temperature, humidity, battery_level, door_now);
-          last_sensor_update = now;
-          display_oled_message_3_line(display_temperature, display_humidity, display_door_status);
-        }
-
-        delay(100);
-      }
+      continuous_mode_begin();
+      return;
     }
     else 
     {
       display_oled_message_3_line(
         "Inicio de modo", 
         "funcionamiento", 
-        "normal"
+        "normal",
+        1000
       );
-      delay(1000);
 
       // Permitir al usuario entrar en modo AP con doble click (formatear)
       int initialPresses = countButtonPressesWithinWindow(3000);
       if (initialPresses >= 2)
       {
-        Serial.println("[NORMAL] Doble click detectado en modo NORMAL: borrando credenciales y entrando en AP...");
-        display_oled_message_3_line("Formateando", "y entrando", "modo AP...");
-        erase_wifi_credentials();
-        delay(200);
-        start_config_ap();
+        MLOGI("[NORMAL] Doble click detectado en modo NORMAL: abriendo portal de configuración...");
+        display_oled_message_3_line("Abriendo", "portal", "de configuración", 1000);
+        enter_config_portal();
+        return;
       }
     }
   }
-  else if (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER) 
+  else if (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER || wakeup_reason == ESP_SLEEP_WAKEUP_EXT1) 
   {
+    // PRG (EXT1) hace el mismo ciclo que el timer, siempre con pantalla
     //  Intentar conexión a la red Wi-Fi usando credenciales guardadas (no lanzar AP)
     bool wifi_ok = try_connect_wifi_no_ap();
     
     //  Se obtienen los valores de Temperatura, Humedad y Bateria.
     get_temperature_humidity();
     get_battery_status();
-    display_oled_message_2_line(
-      isnan(temperature) ? "--.-°C" : String(temperature, 1) + "°C",
-      isnan(humidity) ? "--.-%" : String(humidity, 1) + "%"
-    );
+    display_line_t temp_line, hum_line;
+    if (isnan(temperature)) temp_line = "--.-°C"; else temp_line.format("%.1f°C", temperature);
+    if (isnan(humidity)) hum_line = "--.-%"; else hum_line.format("%.1f%%", humidity);
+    display_oled_message_2_line(temp_line, hum_line);
 
     // Permitir interacción vía botón PRG: una pulsación para "despertar" y doble para entrar en AP (formatear)
-    int presses = countButtonPressesWithinWindow(3000); // 3s ventana para detectar interacción
+    int presses = headless ? 0 : countButtonPressesWithinWindow(3000); // 3s ventana para detectar interacción
     if (presses >= 2)
     {
-      Serial.println("[TIMER_WAKE] Doble click detectado: borrando credenciales y entrando en AP de configuración...");
-      display_oled_message_3_line("Formateando", "y entrando", "modo AP...");
-      erase_wifi_credentials();
-      delay(200);
-      start_config_ap();
+      MLOGI("[TIMER_WAKE] Doble click detectado: abriendo portal de configuración...");
+      display_oled_message_3_line("Abriendo", "portal", "de configuración", 1000);
+      enter_config_portal();
+      return;
     }
 
     if (wifi_ok && WiFi.status() == WL_CONNECTED)
@@ -331,6 +396,14 @@ void setup()
       //  Se envian los valores de Temperatura, Humedad y Bateria.
       ota_set_device_metrics(temperature, humidity, battery_level, -1);
       send_POST_temperature_humidity_battery(temperature, humidity, battery_voltage, battery_level);
+
+      //  Actualización por descarga: avanza la descarga pendiente dentro del presupuesto del despertar
+      if (ota_pull_on_wake(battery_level) == OTA_PULL_READY)
+      {
+        display_oled_message_3_line("Firmware", "actualizado", "Reiniciando...", 500);
+        display_drain(DISPLAY_DRAIN_MAX_MS);
+        ESP.restart();
+      }
     }
     else
     {
@@ -338,22 +411,22 @@ void setup()
       display_oled_message_3_line(
         "Sin conexión", 
         "a la red", 
-        "Wi-Fi"
+        "Wi-Fi",
+        500
       );
-      delay(500);
     }
   }
   else if (wakeup_reason == ESP_SLEEP_WAKEUP_EXT0) 
   {
     // Leer el estado actual de la puerta
     int door_state = digitalRead(DOOR_SENSOR_PIN) == true ? 1 : 0;
-    String door_state_tag = door_state == 1 ? "ABIERTA" : "CERRADA";
+    const char* door_state_tag = door_state == 1 ? "ABIERTA" : "CERRADA";
     
     // Verificar si hubo un cambio real de estado
     bool state_changed = (last_door_state != door_state);
     
-    Serial.println("[EXT0_WAKE] Despertar por cambio en sensor de puerta");
-    Serial.printf("[EXT0_WAKE] Estado anterior: %d, Estado actual: %d\n", last_door_state, door_state);
+    MLOGI("[EXT0_WAKE] Despertar por cambio en sensor de puerta");
+    MLOGI("[EXT0_WAKE] Estado anterior: %d, Estado actual: %d", last_door_state, door_state);
     
     // Enviar POST independientemente de si es apertura o cierre
     // Solo si hubo un cambio real de estado (evitar duplicados)
@@ -376,7 +449,7 @@ void setup()
         update_deep_sleep_time(wakeup_time);
         
         //  Se envian los valores de estado de puerta (0=cerrada, 1=abierta) y Bateria
-        Serial.printf("[EXT0_WAKE] Enviando POST: puerta=%d, batería=%dmV (%d%%)\n", 
+        MLOGI("[EXT0_WAKE] Enviando POST: puerta=%d, batería=%dmV (%d%%)", 
                       door_state, battery_voltage, battery_level);
         send_POST_door_status_battery(door_state, battery_voltage, battery_level);
         
@@ -386,23 +459,23 @@ void setup()
       else
       {
         // Si no hay conexión, mostrar mensaje de error
-        Serial.println("[EXT0_WAKE] Sin conexión WiFi - no se pudo enviar POST");
+        MLOGW("[EXT0_WAKE] Sin conexión WiFi - no se pudo enviar POST");
         display_oled_message_3_line(
           "Sin conexión", 
           "a la red", 
-          "Wi-Fi"
+          "Wi-Fi",
+          500
         );
-        delay(500);
       }
     }
     else
     {
-      Serial.println("[EXT0_WAKE] Sin cambio de estado real, omitiendo envío");
+      MLOGI("[EXT0_WAKE] Sin cambio de estado real, omitiendo envío");
       display_oled_message_2_line(
         "Puerta:",
-        door_state_tag
+        door_state_tag,
+        500
       );
-      delay(500);
     }
   }
   else 
@@ -410,16 +483,23 @@ void setup()
     display_oled_message_3_line(
       "Sistema activo.", 
       "Esperando", 
-      "reinicio"
+      "reinicio",
+      2000
     );
-    delay(2000);
   }
 
+  //  Historial local: el diario RTC sigue en deep sleep; se vuelca si está lleno
+  //  o envejeció, o se guardan los anillos si se cargaron en este despertar
+  history_flush();
+
+  task_profile_sample("ciclo");
+
   //  El sensor entra en modo DeepSleep
   enter_deep_sleep();
 }
 
 void loop() 
 {
-  // Este ciclo no se ejecutará
+  // Sólo el modo continuo sale de setup(): el resto termina en deep sleep
+  app_sched_poll();
 }
\ No newline at end of file
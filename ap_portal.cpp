@@ -0,0 +1,645 @@
+#include "ap_portal.h"
+#include "moe_log.h"
+#include "config.h"
+#include "display_utils.h"
+#include "wifi_utils.h"
+#include "wifi_store.h"
+#include "ota_utils.h"
+#include "req_arena.h"
+#include "task_config.h"
+#include "images.h"
+#include "esp_wifi.h"
+#include <WebServer.h>
+#include <DNSServer.h>
+
+// Portal de configuración: nombre y password del AP
+static const char* CONFIG_AP_SSID_PREFIX = "MOE_Telemetry_";
+static const char* CONFIG_AP_PASS = ""; // abierto por defecto
+
+// Redes vistas en los barridos; /scan las escribe sin armar un String
+typedef struct {
+  char ssid[CONFIG_SSID_MAX + 1];
+  int8_t rssi;
+  uint8_t channel;
+  bool open;
+  uint16_t sweep;               // Último barrido en que apareció
+} scan_entry_t;
+static scan_entry_t scan_entries[AP_PORTAL_MAX_NETWORKS];
+static uint8_t scan_count = 0;
+static uint16_t scan_sweep = 0;         // Barridos completos
+static uint8_t scan_channel = 1;        // Próximo canal a escanear
+static bool scan_running = false;
+static uint32_t scan_next_at = 0;
+
+enum { TEST_IDLE, TEST_RUNNING, TEST_OK, TEST_FAIL };
+static volatile uint8_t test_state = TEST_IDLE;
+static char test_ssid[CONFIG_SSID_MAX + 1];
+static char test_pass[CONFIG_PASS_MAX + 1];
+static const char* test_reason = "";
+static uint32_t test_started = 0;
+static IPAddress test_ip;
+static int8_t test_rssi = 0;
+static uint32_t test_ms = 0;                    // Hasta obtener IP
+static volatile uint8_t sta_disconnect_reason = 0;
+static volatile bool sta_got_ip = false;        // IP obtenida desde que empezó la prueba
+
+static TaskHandle_t portal_task_handle = NULL;
+static volatile bool portal_active = false;
+static volatile bool portal_stop_req = false;
+static WebServer* portal_server = NULL;
+static DNSServer portal_dns;
+static IPAddress portal_ip;
+static char portal_ssid[CONFIG_SSID_MAX + 1];
+static volatile bool portal_up = false;         // AP y servidor arriba
+
+// ---- Barrido incremental ----
+
+static void scan_merge(int n)
+{
+  for (int i = 0; i < n; ++i) {
+    // Registro crudo del escaneo: evita las copias String de WiFi.SSID(i)
+    const wifi_ap_record_t* ap = (const wifi_ap_record_t*)WiFi.getScanInfoByIndex(i);
+    if (!ap || ap->ssid[0] == '\0') continue;
+    char ssid[CONFIG_SSID_MAX + 1];
+    memcpy(ssid, ap->ssid, CONFIG_SSID_MAX);
+    ssid[CONFIG_SSID_MAX] = '\0';
+    scan_entry_t* e = NULL;
+    for (uint8_t k = 0; k < scan_count && !e; k++) {
+      if (strcmp(scan_entries[k].ssid, ssid) == 0) e = &scan_entries[k];
+    }
+    if (!e) {
+      if (scan_count < AP_PORTAL_MAX_NETWORKS) {
+        e = &scan_entries[scan_count++];
+      } else {
+        // Tabla llena: reemplazar la más débil si la nueva es mejor
+        e = &scan_entries[0];
+        for (uint8_t k = 1; k < scan_count; k++) if (scan_entries[k].rssi < e->rssi) e = &scan_entries[k];
+        if (e->rssi >= ap->rssi) continue;
+      }
+      memcpy(e->ssid, ssid, sizeof(ssid));
+    } else if (e->sweep == scan_sweep && e->rssi >= ap->rssi) {
+      // Mismo SSID ya visto en este barrido con mejor señal (otro BSSID)
+      continue;
+    }
+    e->rssi = ap->rssi;
+    e->channel = ap->primary;
+    e->open = ap->authmode == WIFI_AUTH_OPEN;
+    e->sweep = scan_sweep;
+  }
+}
+
+static void scan_prune()
+{
+  uint8_t kept = 0;
+  for (uint8_t k = 0; k < scan_count; k++) {
+    if ((uint16_t)(scan_sweep - scan_entries[k].sweep) >= AP_PORTAL_SCAN_KEEP) continue;
+    scan_entries[kept++] = scan_entries[k];
+  }
+  scan_count = kept;
+}
+
+static void scan_step(uint32_t now)
+{
+  if (scan_running) {
+    int16_t r = WiFi.scanComplete();
+    if (r == WIFI_SCAN_RUNNING) return;
+    if (r >= 0) scan_merge(r);
+    WiFi.scanDelete();
+    scan_running = false;
+    if (++scan_channel > AP_PORTAL_SCAN_CHANNELS) {
+      scan_channel = 1;
+      scan_sweep++;
+      scan_prune();
+      scan_next_at = now + AP_PORTAL_RESCAN_MS;
+    } else {
+      scan_next_at = now + AP_PORTAL_SCAN_GAP_MS;
+    }
+    return;
+  }
+  // Durante la prueba de credenciales la radio es de la estación
+  if (test_state == TEST_RUNNING || (int32_t)(now - scan_next_at) < 0) return;
+  if (WiFi.scanNetworks(true, false, false, AP_PORTAL_SCAN_DWELL_MS, scan_channel) == WIFI_SCAN_FAILED) {
+    scan_next_at = now + AP_PORTAL_SCAN_GAP_MS;
+    return;
+  }
+  scan_running = true;
+}
+
+// ---- Prueba de credenciales ----
+
+static void test_finish(uint8_t state, const char* reason)
+{
+  test_reason = reason;
+  if (state == TEST_OK) {
+    test_ip = WiFi.localIP();
+    test_rssi = (int8_t)WiFi.RSSI();
+    test_ms = millis() - test_started;
+    MLOGI("[PORTAL] Prueba OK: %s (%d dBm)", test_ssid, (int)test_rssi);
+  } else {
+    MLOGW("[PORTAL] Prueba fallida: %s (%s)", test_ssid, reason);
+    // Volver a la red guardada para que la telemetría siga saliendo
+    WiFi.disconnect(false);
+    wifi_begin_stored();
+  }
+  test_state = state;
+}
+
+static void test_step(uint32_t now)
+{
+  if (test_state != TEST_RUNNING) return;
+  uint8_t reason = sta_disconnect_reason;
+  // El estado puede seguir en WL_CONNECTED por la red anterior hasta que llegue su desconexión
+  if (sta_got_ip && WiFi.status() == WL_CONNECTED) {
+    test_finish(TEST_OK, "");
+  } else if (reason == WIFI_REASON_NO_AP_FOUND) {
+    test_finish(TEST_FAIL, "no_ssid");
+  } else if (reason == WIFI_REASON_AUTH_FAIL || reason == WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT ||
+             reason == WIFI_REASON_HANDSHAKE_TIMEOUT || reason == WIFI_REASON_AUTH_EXPIRE) {
+    test_finish(TEST_FAIL, "auth");
+  } else if (now - test_started >= AP_PORTAL_TEST_TIMEOUT_MS) {
+    test_finish(TEST_FAIL, "timeout");
+  }
+}
+
+static const char* test_state_name()
+{
+  switch (test_state) {
+    case TEST_RUNNING: return "testing";
+    case TEST_OK: return "ok";
+    case TEST_FAIL: return "fail";
+    default: return "idle";
+  }
+}
+
+// ---- Rutas ----
+
+static void portal_route_logo()
+{
+  const char* b64 = get_image_base64("logo");
+  if (!b64 || b64[0] == '\0') {
+    MLOGW("[PORTAL] /logo.png: no logo data");
+    portal_server->send(404, "text/plain", "no logo");
+    return;
+  }
+  resp_writer_t w;
+  resp_begin(&w, *portal_server, 200, "image/png");
+  resp_write_base64(&w, b64);
+  resp_end(&w);
+  req_arena_reset();
+}
+
+// Redes vistas hasta ahora; ?refresh=1 reinicia el barrido
+static void portal_route_scan()
+{
+  if (portal_server->arg("refresh") == "1" && !scan_running) {
+    scan_channel = 1;
+    scan_next_at = millis();
+  }
+  resp_writer_t w;
+  resp_begin(&w, *portal_server, 200, "application/json");
+  resp_printf(&w, "{\"scanning\":%s,\"sweep\":%u,\"channel\":%u,\"networks\":[",
+              scan_running || scan_channel > 1 ? "true" : "false", (unsigned)scan_sweep, (unsigned)scan_channel);
+  for (uint8_t i = 0; i < scan_count; ++i) {
+    resp_puts(&w, i ? ",{\"ssid\":" : "{\"ssid\":");
+    resp_json_string(&w, scan_entries[i].ssid);
+    resp_printf(&w, ",\"rssi\":%d,\"channel\":%u,\"open\":%d}", scan_entries[i].rssi,
+                (unsigned)scan_entries[i].channel, scan_entries[i].open ? 1 : 0);
+  }
+  resp_puts(&w, "]}");
+  resp_end(&w);
+  req_arena_reset();
+}
+
+static void portal_route_test_status()
+{
+  resp_writer_t w;
+  resp_begin(&w, *portal_server, 200, "application/json");
+  resp_printf(&w, "{\"state\":\"%s\",\"ssid\":", test_state_name());
+  resp_json_string(&w, test_ssid);
+  resp_printf(&w, ",\"reason\":\"%s\"", test_reason);
+  if (test_state == TEST_OK) {
+    resp_printf(&w, ",\"ip\":\"%u.%u.%u.%u\",\"rssi\":%d", test_ip[0], test_ip[1], test_ip[2], test_ip[3], (int)test_rssi);
+  }
+  resp_puts(&w, "}");
+  resp_end(&w);
+  req_arena_reset();
+}
+
+static void portal_route_test_start()
+{
+  String ss = portal_server->arg("ssid");
+  String pw = portal_server->arg("pass");
+  if (ss.length() == 0 || ss.length() > CONFIG_SSID_MAX || pw.length() > CONFIG_PASS_MAX) {
+    portal_server->send(400, "text/plain", "SSID o contraseña inválidos");
+    return;
+  }
+  if (test_state == TEST_RUNNING) {
+    portal_server->send(409, "text/plain", "Prueba en curso");
+    return;
+  }
+  strlcpy(test_ssid, ss.c_str(), sizeof(test_ssid));
+  strlcpy(test_pass, pw.c_str(), sizeof(test_pass));
+  // Un escaneo en curso impide asociar: se cancela y el canal se repite luego
+  if (scan_running) {
+    esp_wifi_scan_stop();
+    WiFi.scanDelete();
+    scan_running = false;
+  }
+  test_reason = "";
+  test_started = millis();
+  sta_disconnect_reason = 0;
+  sta_got_ip = false;
+  test_state = TEST_RUNNING;
+  MLOGI("[PORTAL] Probando conexión a %s", test_ssid);
+  wifi_begin_sta(test_ssid, test_pass);
+  portal_server->send(202, "application/json", "{\"state\":\"testing\"}");
+}
+
+static void portal_route_save()
+{
+  String ss = portal_server->arg("ssid");
+  String pw = portal_server->arg("pass");
+  bool tested = test_state == TEST_OK && ss == test_ssid && pw == test_pass;
+  if (ss.length() == 0) {
+    portal_server->send(400, "text/plain", "SSID vacío");
+    return;
+  }
+  if (!tested && portal_server->arg("force") != "1") {
+    portal_server->send(409, "text/plain", "Probar la conexión antes de guardar");
+    return;
+  }
+  save_wifi_credentials(ss.c_str(), pw.c_str());
+  // La prueba cuenta como primera conexión: deja latencia y pista BSSID/canal
+  if (tested) wifi_store_record(0, true, test_ms, WiFi.BSSID(), (uint8_t)WiFi.channel());
+  portal_server->send(200, "text/plain", "Guardado");
+  MLOGI("[PORTAL] Credenciales guardadas (%s), cerrando portal", tested ? "probadas" : "sin probar");
+  // Sin probar: la estación se asocia con lo guardado al cerrar
+  if (!tested) {
+    WiFi.disconnect(false);
+    wifi_begin_stored();
+  }
+  portal_stop_req = true;
+}
+
+// Redes guardadas con sus estadísticas (sin contraseñas)
+static void portal_route_networks()
+{
+  resp_writer_t w;
+  resp_begin(&w, *portal_server, 200, "application/json");
+  resp_printf(&w, "{\"max\":%u,\"networks\":[", (unsigned)WIFI_STORE_MAX);
+  wifi_net_t net;
+  for (uint8_t i = 0; wifi_store_get(i, &net); i++) {
+    const wifi_net_stats_t &st = net.stats;
+    resp_puts(&w, i ? ",{\"ssid\":" : "{\"ssid\":");
+    resp_json_string(&w, net.ssid);
+    resp_printf(&w, ",\"attempts\":%u,\"successes\":%u,\"score\":%u,\"latency_ms\":%u,\"channel\":%u}",
+                (unsigned)st.attempts, (unsigned)st.successes, (unsigned)(st.score * 100 / 255),
+                (unsigned)st.latency_ms, (unsigned)st.channel);
+  }
+  resp_puts(&w, "]}");
+  resp_end(&w);
+  req_arena_reset();
+}
+
+static void portal_route_networks_delete()
+{
+  String ss = portal_server->arg("ssid");
+  if (!wifi_store_remove(ss.c_str())) {
+    portal_server->send(404, "text/plain", "Red no guardada");
+    return;
+  }
+  portal_server->send(200, "text/plain", "Quitada");
+}
+
+static void portal_route_root()
+{
+  String page = R"rawliteral(
+<!DOCTYPE html>
+<html lang="es">
+<head>
+  <meta charset="utf-8">
+  <meta name="viewport" content="width=device-width,initial-scale=1">
+  <title>MOE Telemetry - Configuración WiFi</title>
+  <style>
+    :root{--bg:rgb(0,0,0);--card-bg:rgb(20,20,20);--accent:rgb(0,140,226);--accent-dark:#007bb5;--info-bg:rgba(0,140,226,0.04);--muted:#6c757d;--text:#ffffff;--update-green:#28a745;--reset-red:#dc3545}
+    body{font-family:-apple-system,BlinkMacSystemFont,'Segoe UI',Roboto,Helvetica,Arial;background:var(--bg);color:var(--text);min-height:100vh;display:flex;align-items:center;justify-content:center;padding:20px}
+    .container{background:var(--card-bg);border-radius:12px;max-width:640px;width:100%;box-shadow:0 20px 60px rgba(0,0,0,.7);overflow:hidden;border:1px solid rgba(255,255,255,0.03);position:relative}
+    .header{background:linear-gradient(135deg,#222222 0%,#4a4a4a 100%);color:var(--text);padding:30px;text-align:center}
+    .header h1{font-size:24px;margin:0;color:var(--accent)}
+    #logo{height:64px;display:block;margin:6px auto;background:rgba(255,255,255,0.02);padding:6px;border-radius:8px}
+    .content{padding:28px}
+    label{display:block;margin-top:12px;color:rgba(255,255,255,0.8);font-weight:600}
+    select,input{width:100%;padding:12px;margin-top:6px;border-radius:8px;border:1px solid rgba(255,255,255,0.06);background:transparent;color:var(--text)}
+    select{background:rgb(30,30,30)}
+    .row{display:flex;gap:12px}
+    .row .col{flex:1}
+    .buttons{display:flex;gap:10px;margin-top:18px}
+    button{flex:1;padding:12px;border-radius:10px;border:none;font-weight:700;cursor:pointer}
+    button:disabled{opacity:.4;cursor:default}
+    .primary{background:linear-gradient(90deg,var(--accent) 0%,var(--accent-dark) 100%);color:#fff}
+    .save{background:linear-gradient(90deg,var(--update-green) 0%,#1e7e34 100%);color:#fff}
+    .danger{background:linear-gradient(90deg,var(--muted) 0%,#5a636b 100%);color:#fff}
+    .status{margin-top:14px;padding:12px;border-radius:8px;background:rgba(0,0,0,0.06);color:var(--text);border-left:4px solid var(--accent)}
+    .hint{margin-top:6px;font-size:12px;color:rgba(255,255,255,0.5)}
+    .signature{position:absolute;left:0;right:0;bottom:6px;text-align:center;font-size:10px;color:#fff;opacity:0.04;pointer-events:none;user-select:none}
+  </style>
+</head>
+<body>
+  <div class="container">
+    <div class="header">
+      <h1>Configuración WiFi</h1>
+      <div class="version"><img id="logo" src="__LOGO__" alt="MOE" style="display:block;margin:0 auto;"></div>
+      <div class="signature">juan camilo yepes</div>
+    </div>
+    <div class="content">
+      <label for="ssidSelect">Seleccionar red disponible</label>
+      <select id="ssidSelect"><option value="">-- redes cercanas --</option></select>
+      <div id="scanHint" class="hint">Buscando redes...</div>
+
+      <label for="ssidInput">SSID (puedes escribir o seleccionar)</label>
+      <input id="ssidInput" placeholder="Nombre de la red">
+
+      <label for="passInput">Contraseña</label>
+      <input id="passInput" type="password" placeholder="Contraseña WiFi (si aplica)">
+
+      <div class="buttons">
+        <button id="testBtn" class="primary">Probar conexión</button>
+        <button id="saveBtn" class="save" disabled>Guardar</button>
+        <button id="resetBtn" class="danger">Restablecer de fábrica</button>
+      </div>
+      <div class="hint">Si la red usa otro canal, esta red de configuración cambia de canal durante la prueba y el navegador puede tardar unos segundos en reconectar.</div>
+
+      <div id="status" class="status" style="display:none">Estado...</div>
+
+      <label>Redes guardadas</label>
+      <div id="saved" class="hint">Cargando...</div>
+      <div class="hint">Se intentan en orden según éxito reciente, tiempo de conexión y señal. Guardar una red la agrega a la lista.</div>
+    </div>
+  </div>
+
+  <script>
+    const ssidSelect = document.getElementById('ssidSelect');
+    const ssidInput = document.getElementById('ssidInput');
+    const passInput = document.getElementById('passInput');
+    const testBtn = document.getElementById('testBtn');
+    const saveBtn = document.getElementById('saveBtn');
+    const resetBtn = document.getElementById('resetBtn');
+    const statusDiv = document.getElementById('status');
+    const scanHint = document.getElementById('scanHint');
+    const savedDiv = document.getElementById('saved');
+    let tested = null;
+
+    function showStatus(msg, ok=true){ statusDiv.style.display='block'; statusDiv.textContent = msg; statusDiv.style.background = ok ? 'rgba(0,140,226,0.12)' : 'rgba(220,40,40,0.12)'; statusDiv.style.color = '#ffffff'; }
+    function creds(){ const f = new FormData(); f.append('ssid', ssidInput.value.trim()); f.append('pass', passInput.value); return f; }
+    function changed(){ saveBtn.disabled = !tested || tested.ssid !== ssidInput.value.trim() || tested.pass !== passInput.value; }
+
+    // La lista crece con cada canal escaneado
+    function loadScan(){
+      fetch('/scan').then(r=>r.json()).then(s=>{
+        const keep = ssidSelect.value;
+        s.networks.sort((a,b)=>b.rssi-a.rssi);
+        ssidSelect.length = 1;
+        s.networks.forEach(n=>{
+          const opt = document.createElement('option');
+          opt.value = n.ssid;
+          opt.textContent = `${n.ssid} (${n.rssi}dBm, canal ${n.channel}${n.open ? ', abierta' : ''})`;
+          ssidSelect.appendChild(opt);
+        });
+        ssidSelect.value = keep;
+        scanHint.textContent = s.scanning ? `Buscando redes (canal ${s.channel})...` : `${s.networks.length} redes`;
+      }).catch(()=>{ /* ignore */ });
+    }
+    loadScan();
+    setInterval(loadScan, 3000);
+
+    ssidSelect.addEventListener('change', ()=>{ if (ssidSelect.value) ssidInput.value = ssidSelect.value; changed(); });
+    ssidInput.addEventListener('input', changed);
+    passInput.addEventListener('input', changed);
+
+    function pollTest(c){
+      fetch('/test').then(r=>r.json()).then(t=>{
+        if (t.state === 'testing'){ setTimeout(()=>pollTest(c), 1000); return; }
+        testBtn.disabled = false;
+        if (t.state === 'ok'){ tested = c; changed(); showStatus(`Conexión correcta: IP ${t.ip}, ${t.rssi} dBm. Ya puedes guardar.`); }
+        else { tested = null; changed(); showStatus(t.reason === 'auth' ? 'Contraseña incorrecta' : t.reason === 'no_ssid' ? 'Red no encontrada' : 'Sin respuesta de la red', false); }
+      }).catch(()=>setTimeout(()=>pollTest(c), 1000));
+    }
+
+    testBtn.addEventListener('click', ()=>{
+      const c = { ssid: ssidInput.value.trim(), pass: passInput.value };
+      if (!c.ssid){ showStatus('SSID vacío', false); return; }
+      tested = null; changed(); testBtn.disabled = true;
+      showStatus('Probando conexión...');
+      fetch('/test', { method:'POST', body: creds() }).then(r=>{
+        if (r.status !== 202) { testBtn.disabled = false; return r.text().then(t=>showStatus(t, false)); }
+        pollTest(c);
+      }).catch(()=>pollTest(c));
+    });
+
+    function loadSaved(){
+      fetch('/networks').then(r=>r.json()).then(s=>{
+        savedDiv.textContent = s.networks.length ? '' : 'Ninguna';
+        s.networks.forEach(n=>{
+          const row = document.createElement('div');
+          row.className = 'row';
+          const info = document.createElement('div');
+          info.className = 'col';
+          info.textContent = n.attempts ? `${n.ssid}: ${n.successes}/${n.attempts} conexiones, éxito reciente ${n.score}%` + (n.latency_ms ? `, ${n.latency_ms} ms` : '') : `${n.ssid}: sin intentos`;
+          const del = document.createElement('button');
+          del.className = 'danger';
+          del.style.flex = '0 0 90px';
+          del.textContent = 'Quitar';
+          del.addEventListener('click', ()=>{
+            if (!confirm(`¿Quitar ${n.ssid}?`)) return;
+            const f = new FormData(); f.append('ssid', n.ssid);
+            fetch('/networks/delete', { method:'POST', body: f }).then(loadSaved);
+          });
+          row.appendChild(info); row.appendChild(del);
+          savedDiv.appendChild(row);
+        });
+        if (s.networks.length >= s.max) savedDiv.appendChild(Object.assign(document.createElement('div'), { textContent: `Lista llena (${s.max}): guardar otra reemplaza a la de peor historial.` }));
+      }).catch(()=>{ /* ignore */ });
+    }
+    loadSaved();
+
+    saveBtn.addEventListener('click', ()=>{
+      showStatus('Guardando credenciales...');
+      fetch('/save', { method:'POST', body: creds() }).then(r=>r.text().then(t=>{
+        if (!r.ok) { showStatus(t, false); return; }
+        showStatus('Guardado. El portal se cierra y el equipo sigue conectado a ' + ssidInput.value.trim() + '.');
+        loadSaved();
+      })).catch(e=>{ showStatus('Error al guardar', false); });
+    });
+
+    resetBtn.addEventListener('click', ()=>{
+      if (!confirm('¿Borrar credenciales y reiniciar el dispositivo?')) return;
+      fetch('/factory_reset', { method:'POST' }).then(r=>r.text()).then(t=>{ showStatus('Restableciendo...'); setTimeout(()=>location.reload(),3000); }).catch(()=>{ showStatus('Error al resetear', false); });
+    });
+  </script>
+</body>
+</html>
+)rawliteral";
+
+  // Embed the logo as a data: URI so it renders even when the client is connected to the AP
+  page.replace("__LOGO__", String("data:image/png;base64,") + String(get_image_base64("logo")));
+  // Inyectar la IP del AP en la página para que también se muestre en el navegador
+  page.replace("MOE Telemetry", String("MOE Telemetry - ") + portal_ip.toString());
+  portal_server->send(200, "text/html", page);
+}
+
+// ---- Servicio ----
+
+static bool portal_open()
+{
+  // Stop OTA server if running to avoid port conflicts so AP portal on :80 is reachable
+  if (is_ota_active()) {
+    MLOGI("[PORTAL] Deteniendo servidor OTA (mismo puerto que el portal)");
+    stop_ota_background();
+  }
+  // El AP no admite modem sleep
+  wifi_power_save(false);
+  WiFi.mode(WIFI_AP_STA);
+  // Build AP SSID: prefix + last 4 hex digits of MAC
+  String mac = WiFi.macAddress();
+  mac.replace(":", "");
+  String last4 = mac;
+  if (last4.length() >= 4) last4 = last4.substring(last4.length() - 4);
+  String apSSID = String(CONFIG_AP_SSID_PREFIX) + last4;
+  if (!WiFi.softAP(apSSID.c_str(), CONFIG_AP_PASS)) {
+    MLOGE("[PORTAL] ERROR: no se pudo iniciar AP");
+    return false;
+  }
+  portal_ip = WiFi.softAPIP();
+  MLOGI("[PORTAL] AP iniciado. SSID: %s, IP: %u.%u.%u.%u", apSSID.c_str(), portal_ip[0], portal_ip[1], portal_ip[2], portal_ip[3]);
+  strlcpy(portal_ssid, apSSID.c_str(), sizeof(portal_ssid));
+
+  // Iniciar servidor DNS para captive portal: responder a cualquier dominio con la IP del AP
+  portal_dns.start(53, "*", portal_ip);
+
+  portal_server = new WebServer(80);
+  portal_server->on("/logo.png", HTTP_GET, portal_route_logo);
+  portal_server->on("/scan", HTTP_GET, portal_route_scan);
+  portal_server->on("/test", HTTP_GET, portal_route_test_status);
+  portal_server->on("/test", HTTP_POST, portal_route_test_start);
+  portal_server->on("/save", HTTP_POST, portal_route_save);
+  portal_server->on("/networks", HTTP_GET, portal_route_networks);
+  portal_server->on("/networks/delete", HTTP_POST, portal_route_networks_delete);
+  portal_server->on("/", HTTP_GET, portal_route_root);
+  // Factory reset handler
+  portal_server->on("/factory_reset", HTTP_POST, []() {
+    erase_wifi_credentials();
+    portal_server->send(200, "text/plain", "Borrado");
+    delay(200);
+    ESP.restart();
+  });
+  // Captive portal behavior: servir una página simple para cualquier request
+  // Esto ayuda a clientes que no siguen 302/Location o usan HTTPS para comprobaciones.
+  portal_server->onNotFound([]() {
+    String fallback = "<html><head><meta http-equiv=\"refresh\" content=\"0;url=http://" + portal_ip.toString() + "\"></head><body>Red de configuracion MOE - <a href=\"http://" + portal_ip.toString() + "\">Abrir configuracion</a></body></html>";
+    portal_server->send(200, "text/html", fallback);
+  });
+  portal_server->begin();
+
+  scan_count = 0;
+  scan_channel = 1;
+  scan_running = false;
+  scan_next_at = millis();
+  test_state = TEST_IDLE;
+  test_ssid[0] = '\0';
+  portal_up = true;
+  // El portal muestra SSID/IP: el panel queda encendido mientras dure
+  display_set_idle_off(0);
+  ap_portal_show();
+  MLOGI("[PORTAL] Portal de configuración activo en %u.%u.%u.%u", portal_ip[0], portal_ip[1], portal_ip[2], portal_ip[3]);
+  return true;
+}
+
+static void portal_close()
+{
+  portal_up = false;
+  if (scan_running) {
+    esp_wifi_scan_stop();
+    WiFi.scanDelete();
+    scan_running = false;
+  }
+  if (portal_server) {
+    portal_server->stop();
+    delete portal_server;
+    portal_server = NULL;
+  }
+  portal_dns.stop();
+  // Sin AP la radio vuelve a STA (con modem sleep) y el servidor OTA a :80
+  WiFi.softAPdisconnect(true);
+  wifi_power_save(true);
+  display_set_idle_off(current_mode == MODE_CONTINUOUS ? DISPLAY_IDLE_OFF_MS : 0);
+  if (WiFi.status() == WL_CONNECTED && current_mode == MODE_CONTINUOUS) init_ota_background();
+  MLOGI("[PORTAL] Portal cerrado");
+}
+
+static void portal_task(void* arg)
+{
+  if (portal_open()) {
+    while (!portal_stop_req) {
+      portal_dns.processNextRequest();
+      portal_server->handleClient();
+      uint32_t now = millis();
+      test_step(now);
+      scan_step(now);
+      task_profile_sample("portal");
+      vTaskDelay(pdMS_TO_TICKS(AP_PORTAL_POLL_MS));
+    }
+    // La respuesta de /save sale antes de cortar el AP
+    vTaskDelay(pdMS_TO_TICKS(200));
+    portal_close();
+  }
+  portal_active = false;
+  portal_task_handle = NULL;
+  task_profile_detach(TASK_PORTAL);
+  vTaskDelete(NULL);
+}
+
+bool ap_portal_start()
+{
+  if (portal_active) return true;
+  static bool events_ready = false;
+  if (!events_ready) {
+    WiFi.onEvent([](WiFiEvent_t event, WiFiEventInfo_t info) {
+      // El abandono voluntario de la red anterior no es un fallo de la prueba
+      uint8_t reason = info.wifi_sta_disconnected.reason;
+      if (reason != WIFI_REASON_ASSOC_LEAVE) sta_disconnect_reason = reason;
+    }, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    WiFi.onEvent([](WiFiEvent_t event, WiFiEventInfo_t info) {
+      sta_got_ip = true;
+    }, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    events_ready = true;
+  }
+  portal_stop_req = false;
+  portal_active = true;
+  if (task_spawn(TASK_PORTAL, portal_task, NULL, &portal_task_handle) != pdPASS) {
+    MLOGE("[PORTAL] No se pudo crear la tarea del portal");
+    portal_active = false;
+    return false;
+  }
+  return true;
+}
+
+void ap_portal_stop()
+{
+  portal_stop_req = true;
+}
+
+bool ap_portal_active()
+{
+  return portal_active;
+}
+
+void ap_portal_show()
+{
+  if (!portal_up) return;
+  display_oled_ap_info(portal_ssid, portal_ip.toString().c_str(), WiFi.macAddress().c_str());
+}
+
+bool ap_portal_owns_sta()
+{
+  return portal_active && test_state == TEST_RUNNING;
+}
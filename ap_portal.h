@@ -0,0 +1,48 @@
+#ifndef AP_PORTAL_H
+#define AP_PORTAL_H
+
+#include <Arduino.h>
+
+// Portal de configuración WiFi como servicio en segundo plano. La radio pasa
+// a AP+STA: el AP (MOE_Telemetry_XXXX, DNS cautivo y página en :80) convive
+// con la estación, así el sensado, la puerta y los POST siguen funcionando
+// mientras el portal está abierto. La tarea AP_Portal atiende DNS y HTTP y
+// además:
+//  - Barre las redes de a un canal por vez con escaneos asíncronos, volviendo
+//    al canal del AP entre uno y otro para no cortar a los clientes. La lista
+//    se actualiza en cada canal; una red que no aparece en
+//    AP_PORTAL_SCAN_KEEP barridos se quita.
+//  - Prueba las credenciales enviadas (POST /test) conectando la estación
+//    mientras el AP sigue arriba; GET /test informa el resultado. /save sólo
+//    guarda lo que se probó con éxito (o con force=1) y cierra el portal sin
+//    reiniciar: la estación queda conectada y vuelve el servidor OTA.
+// El servidor OTA usa el mismo puerto: se detiene mientras el portal está
+// abierto. Al conectar la estación a una red en otro canal el AP cambia de
+// canal y los clientes del portal se reconectan.
+
+#define AP_PORTAL_POLL_MS           10      // Vuelta de DNS + HTTP
+#define AP_PORTAL_MAX_NETWORKS      20
+#define AP_PORTAL_SCAN_CHANNELS     13
+#define AP_PORTAL_SCAN_DWELL_MS     120     // Escucha activa por canal
+#define AP_PORTAL_SCAN_GAP_MS       300     // En el canal del AP entre canales
+#define AP_PORTAL_RESCAN_MS         30000   // Entre barridos completos
+#define AP_PORTAL_SCAN_KEEP         2       // Barridos sin ver una red antes de quitarla
+#define AP_PORTAL_TEST_TIMEOUT_MS   15000
+
+// Abre el portal y retorna en el acto. Se puede llamar con el portal abierto.
+bool ap_portal_start();
+
+// Pide el cierre; la tarea lo completa en su próxima vuelta
+void ap_portal_stop();
+
+bool ap_portal_active();
+
+// Vuelve a dibujar SSID/IP/MAC del AP (otros mensajes lo tapan). Sin efecto
+// si el AP todavía no está arriba.
+void ap_portal_show();
+
+// Prueba de credenciales en curso: la estación es del portal y no se debe
+// reconectar con las credenciales guardadas
+bool ap_portal_owns_sta();
+
+#endif
@@ -0,0 +1,96 @@
+#include "app_sched.h"
+#include "moe_log.h"
+#include "esp_timer.h"
+
+typedef struct {
+  int job;
+  QueueSetMemberHandle_t member;        // Semáforo binario de la fuente
+} app_source_t;
+
+static sched_t app_sched;
+static QueueSetHandle_t app_set = NULL;
+static app_source_t app_sources[APP_SCHED_MAX_SOURCES];
+static uint8_t app_source_count = 0;
+
+static uint64_t app_sched_clock(void* ctx)
+{
+  return (uint64_t)esp_timer_get_time();
+}
+
+static app_source_t* app_sched_add_source(int job, QueueSetMemberHandle_t member)
+{
+  if (!app_set || !sched_job(&app_sched, job) || app_source_count >= APP_SCHED_MAX_SOURCES ||
+      xQueueAddToSet(member, app_set) != pdPASS) {
+    MLOGE("[SCHED] No se pudo registrar la fuente del trabajo %d", job);
+    return NULL;
+  }
+  app_source_t* s = &app_sources[app_source_count++];
+  s->job = job;
+  s->member = member;
+  return s;
+}
+
+void app_sched_begin()
+{
+  if (app_set) return;
+  sched_init(&app_sched, app_sched_clock, NULL);
+  app_set = xQueueCreateSet(APP_SCHED_SET_LEN);
+  if (!app_set) MLOGE("[SCHED] No se pudo crear el conjunto de colas");
+}
+
+int app_sched_every(const char* name, sched_job_fn fn, void* ctx, uint32_t period_ms)
+{
+  return sched_add(&app_sched, name, fn, ctx, period_ms, period_ms);
+}
+
+int app_sched_after(const char* name, sched_job_fn fn, void* ctx, uint32_t delay_ms)
+{
+  return sched_add(&app_sched, name, fn, ctx, delay_ms, 0);
+}
+
+int app_sched_on_event(const char* name, sched_job_fn fn, void* ctx)
+{
+  return sched_add(&app_sched, name, fn, ctx, SCHED_NEVER, 0);
+}
+
+SemaphoreHandle_t app_sched_watch_signal(int job)
+{
+  SemaphoreHandle_t sem = xSemaphoreCreateBinary();
+  if (!sem) {
+    MLOGE("[SCHED] Sin memoria para el semáforo de la fuente");
+    return NULL;
+  }
+  if (!app_sched_add_source(job, sem)) {
+    vSemaphoreDelete(sem);
+    return NULL;
+  }
+  xSemaphoreGive(sem);
+  return sem;
+}
+
+void app_sched_poll()
+{
+  uint32_t wait_ms = sched_run(&app_sched);
+
+  TickType_t wait = wait_ms == SCHED_NEVER ? portMAX_DELAY : pdMS_TO_TICKS(wait_ms);
+  if (wait_ms && !wait) wait = 1;
+  if (!app_set) {
+    vTaskDelay(wait);
+    return;
+  }
+  QueueSetMemberHandle_t ready = xQueueSelectFromSet(app_set, wait);
+  if (!ready) return;
+  for (uint8_t i = 0; i < app_source_count; i++) {
+    app_source_t* s = &app_sources[i];
+    if (s->member != ready) continue;
+    // Un aviso del conjunto por cada toma: el semáforo se toma siempre
+    xSemaphoreTake((SemaphoreHandle_t)ready, 0);
+    sched_start(&app_sched, s->job, 0);
+    return;
+  }
+}
+
+const sched_job_t* app_sched_job(int id)
+{
+  return sched_job(&app_sched, id);
+}
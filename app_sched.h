@@ -0,0 +1,42 @@
+#ifndef APP_SCHED_H
+#define APP_SCHED_H
+
+#include <Arduino.h>
+#include "sched.h"
+
+// Bucle de eventos del modo continuo sobre el planificador de sched.h. Cada
+// vuelta de app_sched_poll() ejecuta los trabajos vencidos y bloquea la tarea
+// (loopTask) hasta el próximo plazo o hasta que una fuente de eventos se
+// active, de modo que el idle puede entrar en light sleep entre medio.
+//
+// Fuente de eventos: semáforo binario que el productor da después de encolar
+// en su propia cola (door_events, button_utils); el trabajo vacía la cola.
+// Los semáforos despiertan al mismo xQueueSelectFromSet. Las colas no entran
+// al conjunto: éste exige recibir un elemento por cada aviso y un trabajo que
+// vacía la cola de una vez dejaría avisos viejos hasta desbordarlo.
+// Los trabajos de eventos se crean con app_sched_on_event (sin plazo ni
+// periodo). Todas las funciones salvo app_sched_job se llaman desde la tarea
+// que ejecuta app_sched_poll.
+
+#define APP_SCHED_MAX_SOURCES       8
+#define APP_SCHED_SET_LEN           APP_SCHED_MAX_SOURCES   // Un semáforo binario por fuente
+
+void app_sched_begin();
+
+// Trabajo periódico (primera ejecución tras un periodo), de una vez, o sin plazo
+int app_sched_every(const char* name, sched_job_fn fn, void* ctx, uint32_t period_ms);
+int app_sched_after(const char* name, sched_job_fn fn, void* ctx, uint32_t delay_ms);
+int app_sched_on_event(const char* name, sched_job_fn fn, void* ctx);
+
+// Semáforo que arranca el trabajo (NULL si no se pudo registrar). El trabajo
+// corre una vez al registrarlo, por si la cola ya tenía elementos.
+SemaphoreHandle_t app_sched_watch_signal(int job);
+
+// Ejecuta lo vencido y duerme hasta el próximo plazo o evento
+void app_sched_poll();
+
+// Nombre y estadísticas para /metrics (NULL si el id está libre). Se lee
+// desde otra tarea sin bloqueo: un valor puede quedar a medio actualizar.
+const sched_job_t* app_sched_job(int id);
+
+#endif
@@ -0,0 +1,88 @@
+#include "button_fsm.h"
+#include <string.h>
+
+enum { BTN_IDLE, BTN_PRESSED, BTN_RELEASED, BTN_LONG_HELD };
+
+static void button_fsm_emit(button_fsm_t* f, uint8_t type, uint32_t press_ms)
+{
+  button_gesture_t g;
+  g.type = type;
+  g.count = f->count;
+  g.t_ms = f->seq_start;
+  g.press_ms = press_ms;
+  if (f->emit) f->emit(&g, f->ctx);
+}
+
+// Cambio de nivel aceptado en t
+static void button_fsm_accept(button_fsm_t* f, bool pressed, uint32_t t)
+{
+  f->level = pressed;
+  f->lockout = true;
+  f->lockout_until = t + BUTTON_DEBOUNCE_MS;
+  if (pressed) {
+    if (f->state == BTN_IDLE) {
+      f->count = 0;
+      f->seq_start = t;
+    }
+    if (f->count < UINT8_MAX) f->count++;
+    f->press_start = t;
+    f->state = BTN_PRESSED;
+    button_fsm_emit(f, BUTTON_DOWN, 0);
+  } else if (f->state == BTN_PRESSED) {
+    f->release_at = t;
+    f->state = BTN_RELEASED;
+  } else {
+    // Se suelta tras BUTTON_LONG: la secuencia ya se entregó
+    f->state = BTN_IDLE;
+  }
+}
+
+void button_fsm_init(button_fsm_t* f, bool pressed, uint32_t now_ms, button_emit_fn emit, void* ctx)
+{
+  memset(f, 0, sizeof(*f));
+  f->emit = emit;
+  f->ctx = ctx;
+  f->level = f->raw = pressed;
+  if (pressed) {
+    f->state = BTN_PRESSED;
+    f->count = 1;
+    f->seq_start = f->press_start = now_ms;
+  }
+}
+
+void button_fsm_edge(button_fsm_t* f, bool pressed, uint32_t t_ms)
+{
+  // Primero lo que venció antes de este flanco
+  button_fsm_poll(f, t_ms);
+  f->raw = pressed;
+  if (f->lockout) {
+    f->bounces++;
+    return;
+  }
+  // Mismo nivel que el aceptado: el flanco intermedio fue un rebote ya filtrado
+  if (pressed != f->level) button_fsm_accept(f, pressed, t_ms);
+}
+
+uint32_t button_fsm_poll(button_fsm_t* f, uint32_t now_ms)
+{
+  // Fin del bloqueo: el nivel que quedó decide
+  while (f->lockout && (int32_t)(now_ms - f->lockout_until) >= 0) {
+    f->lockout = false;
+    if (f->raw != f->level) button_fsm_accept(f, f->raw, f->lockout_until);
+  }
+
+  if (f->state == BTN_PRESSED && now_ms - f->press_start >= BUTTON_LONG_PRESS_MS) {
+    f->state = BTN_LONG_HELD;
+    button_fsm_emit(f, BUTTON_LONG, BUTTON_LONG_PRESS_MS);
+  } else if (f->state == BTN_RELEASED && now_ms - f->release_at >= BUTTON_CLICK_GAP_MS) {
+    f->state = BTN_IDLE;
+    button_fsm_emit(f, BUTTON_CLICKS, f->release_at - f->press_start);
+  }
+
+  uint32_t next = BUTTON_FSM_IDLE;
+  if (f->lockout) next = f->lockout_until - now_ms;
+  uint32_t due = BUTTON_FSM_IDLE;
+  if (f->state == BTN_PRESSED) due = f->press_start + BUTTON_LONG_PRESS_MS - now_ms;
+  else if (f->state == BTN_RELEASED) due = f->release_at + BUTTON_CLICK_GAP_MS - now_ms;
+  return due < next ? due : next;
+}
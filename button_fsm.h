@@ -0,0 +1,66 @@
+#ifndef BUTTON_FSM_H
+#define BUTTON_FSM_H
+
+// Reconocedor de gestos de un botón a partir de flancos con marca de tiempo.
+// Antirrebote por bloqueo: el primer flanco se acepta en el acto (su marca es
+// la del flanco real) y durante BUTTON_DEBOUNCE_MS se ignoran los siguientes;
+// si al terminar el bloqueo el nivel quedó distinto, el cambio se acepta en
+// ese instante. Gestos:
+//  - BUTTON_DOWN: cada pulsación aceptada (para reaccionar sin esperar).
+//  - BUTTON_CLICKS: la secuencia terminó tras BUTTON_CLICK_GAP_MS sin volver a
+//    pulsar; count = 1 (simple), 2 (doble), 3 (triple)... N.
+//  - BUTTON_LONG: la pulsación lleva BUTTON_LONG_PRESS_MS; se entrega sin
+//    esperar a soltar y cierra la secuencia (count incluye la larga).
+// Los plazos se atienden con button_fsm_poll(), que indica cuándo volver a
+// llamarlo. No depende de Arduino: los flancos y el tiempo (ms) se inyectan.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BUTTON_DEBOUNCE_MS      25
+#define BUTTON_CLICK_GAP_MS     400     // Silencio tras soltar que cierra la secuencia
+#define BUTTON_LONG_PRESS_MS    5000    // Pulsación larga (factory reset al arrancar)
+#define BUTTON_FSM_IDLE         0xFFFFFFFFUL
+
+typedef enum {
+  BUTTON_DOWN,
+  BUTTON_CLICKS,
+  BUTTON_LONG
+} button_gesture_type_t;
+
+typedef struct {
+  uint8_t type;                 // button_gesture_type_t
+  uint8_t count;                // Pulsaciones de la secuencia hasta ahora
+  uint32_t t_ms;                // Inicio de la secuencia (primera pulsación)
+  uint32_t press_ms;            // Duración de la última pulsación (DOWN: 0)
+} button_gesture_t;
+
+typedef void (*button_emit_fn)(const button_gesture_t* g, void* ctx);
+
+typedef struct {
+  uint8_t state;
+  bool level;                   // Nivel aceptado (true = presionado)
+  bool raw;                     // Último nivel visto, aceptado o no
+  bool lockout;
+  uint32_t lockout_until;
+  uint8_t count;
+  uint32_t seq_start;
+  uint32_t press_start;
+  uint32_t release_at;
+  uint32_t bounces;             // Flancos ignorados durante el bloqueo
+  button_emit_fn emit;
+  void* ctx;
+} button_fsm_t;
+
+// Con pressed (botón ya presionado al empezar, p. ej. al arrancar) la
+// pulsación en curso cuenta desde now_ms sin emitir BUTTON_DOWN
+void button_fsm_init(button_fsm_t* f, bool pressed, uint32_t now_ms, button_emit_fn emit, void* ctx);
+
+// Flanco observado con su marca de tiempo (en orden creciente)
+void button_fsm_edge(button_fsm_t* f, bool pressed, uint32_t t_ms);
+
+// Atiende los plazos vencidos hasta now_ms. Retorna los ms hasta el próximo
+// plazo o BUTTON_FSM_IDLE si sólo queda esperar flancos.
+uint32_t button_fsm_poll(button_fsm_t* f, uint32_t now_ms);
+
+#endif
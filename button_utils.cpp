@@ -1,137 +1,152 @@
 #include "button_utils.h"
 #include "config.h"
+#include "moe_log.h"
+#include "task_config.h"
+#include "esp_timer.h"
+#include "hal/gpio_ll.h"
+#include "driver/gpio.h"
+#include "esp_sleep.h"
+#include <atomic>
+
+// Flanco capturado en la ISR
+typedef struct {
+  uint32_t t_ms;
+  bool pressed;
+} button_edge_t;
+
+// Anillo SPSC: la ISR sólo escribe button_head y la tarea sólo button_tail
+static button_edge_t button_ring[BUTTON_RING_SIZE];
+static std::atomic<uint32_t> button_head(0);
+static std::atomic<uint32_t> button_tail(0);
+static std::atomic<uint32_t> button_ring_dropped(0);
+
+static TaskHandle_t button_task_handle = NULL;
+static QueueHandle_t button_q = NULL;
+static SemaphoreHandle_t button_notify = NULL;
+static button_fsm_t button_fsm;
+static button_stats_t button_stats;
+
+static uint32_t button_now_ms()
+{
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
 
-// Variables globales para detector no bloqueante
-unsigned long btn_last_press_time = 0;
-int btn_press_count = 0;
-bool btn_was_pressed = false;
-
-void init_button_detector()
+// Nivel con polaridad alternada: cada disparo es un flanco (ver door_events)
+static void IRAM_ATTR button_isr(void* arg)
 {
-  btn_last_press_time = 0;
-  btn_press_count = 0;
-  btn_was_pressed = false;
+  uint32_t t = (uint32_t)(esp_timer_get_time() / 1000);
+  uint8_t level = gpio_ll_get_level(&GPIO, (gpio_num_t)PRG_BUTTON_PIN);
+  gpio_ll_set_intr_type(&GPIO, (gpio_num_t)PRG_BUTTON_PIN, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+  uint32_t head = button_head.load(std::memory_order_relaxed);
+  if (head - button_tail.load(std::memory_order_acquire) >= BUTTON_RING_SIZE) {
+    button_ring_dropped.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    button_ring[head & (BUTTON_RING_SIZE - 1)] = { t, level == 0 };
+    button_head.store(head + 1, std::memory_order_release);
+  }
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(button_task_handle, &woken);
+  if (woken) portYIELD_FROM_ISR();
 }
 
-// Detector no bloqueante de doble click. Debe llamarse con frecuencia (cada <100ms idealmente).
-bool nonBlockingDoubleClickDetected(unsigned long windowMs)
+static void button_emit(const button_gesture_t* g, void* ctx)
 {
-  unsigned long now = millis();
-  bool pressed = (digitalRead(PRG_BUTTON_PIN) == LOW);
+  if (g->type == BUTTON_DOWN) button_stats.downs++;
+  else if (g->type == BUTTON_CLICKS) button_stats.clicks++;
+  else button_stats.longs++;
+  if (xQueueSend(button_q, g, 0) != pdTRUE) button_stats.dropped++;
+  else if (button_notify) xSemaphoreGive(button_notify);
+}
 
-  // detectar flanco de bajada (press)
-  if (pressed && !btn_was_pressed)
-  {
-    // Si la última pulsación fue hace más tiempo que la ventana, resetear conteo
-    if (now - btn_last_press_time > windowMs)
-    {
-      btn_press_count = 0;
+static void button_task(void* arg)
+{
+  uint32_t wait_ms = BUTTON_FSM_IDLE;
+  for (;;) {
+    TickType_t wait = wait_ms == BUTTON_FSM_IDLE ? portMAX_DELAY : pdMS_TO_TICKS(wait_ms);
+    if (wait_ms && !wait) wait = 1;
+    ulTaskNotifyTake(pdTRUE, wait);
+
+    uint32_t tail = button_tail.load(std::memory_order_relaxed);
+    uint32_t head = button_head.load(std::memory_order_acquire);
+    while (tail != head) {
+      button_edge_t e = button_ring[tail & (BUTTON_RING_SIZE - 1)];
+      button_tail.store(++tail, std::memory_order_release);
+      button_stats.edges++;
+      button_fsm_edge(&button_fsm, e.pressed, e.t_ms);
     }
-
-    btn_press_count++;
-    btn_last_press_time = now;
-    btn_was_pressed = true;
-  }
-
-  // detectar flanco de subida (release)
-  if (!pressed && btn_was_pressed)
-  {
-    btn_was_pressed = false;
+    wait_ms = button_fsm_poll(&button_fsm, button_now_ms());
   }
+}
 
-  // si se acumularon 2 pulsaciones dentro de la ventana -> doble click
-  if (btn_press_count >= 2 && (now - btn_last_press_time) <= windowMs)
-  {
-    btn_press_count = 0; // reset
-    return true;
+void button_events_begin()
+{
+  if (button_task_handle) return;
+  bool pressed = digitalRead(PRG_BUTTON_PIN) == LOW;
+  button_fsm_init(&button_fsm, pressed, button_now_ms(), button_emit, NULL);
+  button_q = xQueueCreate(BUTTON_GESTURE_QUEUE_LEN, sizeof(button_gesture_t));
+  if (!button_q) {
+    MLOGE("[BUTTON] No se pudo crear la cola de gestos");
+    return;
   }
-
-  // reset si se excede la ventana
-  if ((now - btn_last_press_time) > windowMs)
-  {
-    btn_press_count = 0;
+  task_spawn(TASK_BUTTON, button_task, NULL, &button_task_handle);
+  if (!button_task_handle) {
+    MLOGE("[BUTTON] No se pudo crear la tarea de gestos");
+    return;
   }
-
-  return false;
+  gpio_num_t pin = (gpio_num_t)PRG_BUTTON_PIN;
+  gpio_install_isr_service(0);          // ESP_ERR_INVALID_STATE si ya estaba
+  gpio_isr_handler_add(pin, button_isr, NULL);
+  gpio_wakeup_enable(pin, pressed ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  gpio_intr_enable(pin);
 }
 
-// Detector no bloqueante de triple click (3 pulsaciones en ventana)
-bool nonBlockingTripleClickDetected(unsigned long windowMs)
+void button_events_stop()
 {
-  unsigned long now = millis();
-  bool pressed = (digitalRead(PRG_BUTTON_PIN) == LOW);
-
-  // detectar flanco de bajada (press)
-  if (pressed && !btn_was_pressed)
-  {
-    // Si la última pulsación fue hace más tiempo que la ventana, resetear conteo
-    if (now - btn_last_press_time > windowMs)
-    {
-      btn_press_count = 0;
-    }
-
-    btn_press_count++;
-    btn_last_press_time = now;
-    btn_was_pressed = true;
-  }
+  if (!button_task_handle) return;
+  gpio_num_t pin = (gpio_num_t)PRG_BUTTON_PIN;
+  gpio_intr_disable(pin);
+  gpio_wakeup_disable(pin);
+  gpio_isr_handler_remove(pin);
+}
 
-  // detectar flanco de subida (release)
-  if (!pressed && btn_was_pressed)
-  {
-    btn_was_pressed = false;
+bool button_gesture_wait(button_gesture_t* g, uint32_t timeout_ms)
+{
+  if (!button_q) {
+    delay(timeout_ms);
+    return false;
   }
+  return xQueueReceive(button_q, g, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
 
-  // si se acumularon 3 pulsaciones dentro de la ventana -> triple click
-  if (btn_press_count >= 3 && (now - btn_last_press_time) <= windowMs)
-  {
-    btn_press_count = 0; // reset
-    return true;
-  }
+QueueHandle_t button_events_queue()
+{
+  return button_q;
+}
 
-  // reset si se excede la ventana
-  if ((now - btn_last_press_time) > windowMs)
-  {
-    btn_press_count = 0;
-  }
+void button_events_notify(SemaphoreHandle_t sem)
+{
+  button_notify = sem;
+}
 
-  return false;
+void button_events_get_stats(button_stats_t* out)
+{
+  *out = button_stats;
+  out->bounces = button_fsm.bounces;
+  out->ring_dropped = button_ring_dropped.load(std::memory_order_relaxed);
 }
 
-// Detector bloqueante: cuenta cuántas pulsaciones (press->release) se detectan dentro de una ventana de tiempo (ms)
 int countButtonPressesWithinWindow(unsigned long windowMs)
 {
+  button_events_begin();
   unsigned long start = millis();
   int count = 0;
-  bool pressed = false;
-
-  // Si el botón está presionado al inicio, esperar a que suelte para evitar contar pulsación sostenida
-  if (digitalRead(PRG_BUTTON_PIN) == LOW)
-  {
-    while (digitalRead(PRG_BUTTON_PIN) == LOW && (millis() - start) < windowMs)
-    {
-      delay(10);
-    }
-  }
-
-  while ((millis() - start) < windowMs)
-  {
-    bool now = digitalRead(PRG_BUTTON_PIN) == LOW;
-    if (now && !pressed)
-    {
-      // debounce
-      delay(50);
-      if (digitalRead(PRG_BUTTON_PIN) == LOW)
-      {
-        count++;
-        pressed = true;
-      }
-    }
-    else if (!now && pressed)
-    {
-      pressed = false;
-    }
-    delay(10);
+  button_gesture_t g;
+  for (;;) {
+    unsigned long elapsed = millis() - start;
+    if (elapsed >= windowMs) break;
+    if (!button_gesture_wait(&g, windowMs - elapsed)) break;
+    if (g.type == BUTTON_DOWN) count++;
   }
-
   return count;
 }
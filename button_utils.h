@@ -2,17 +2,50 @@
 #define BUTTON_UTILS_H
 
 #include <Arduino.h>
+#include "button_fsm.h"
 
-// Inicializa variables globales del detector de botones
-void init_button_detector();
+// Gestos del botón PRG por interrupción. La ISR (por nivel con polaridad
+// alternada, como la de la puerta, para que también despierte del light
+// sleep) guarda cada flanco con su marca de tiempo en un anillo SPSC y
+// despierta a la tarea Button, que alimenta el reconocedor de button_fsm
+// (antirrebote, simple/doble/triple/N pulsaciones y pulsación larga) y
+// atiende sus plazos. Los gestos se consumen de una cola, sin muestrear el
+// pin: button_gesture_wait() o como fuente del bucle de app_sched.
 
-// Detector no bloqueante de doble click (2 pulsaciones en ventana)
-bool nonBlockingDoubleClickDetected(unsigned long windowMs);
+#define BUTTON_RING_SIZE            16      // Potencia de 2
+#define BUTTON_GESTURE_QUEUE_LEN    8
 
-// Detector no bloqueante de triple click (3 pulsaciones en ventana)
-bool nonBlockingTripleClickDetected(unsigned long windowMs);
+typedef struct {
+  uint32_t edges;               // Flancos procesados
+  uint32_t ring_dropped;        // Flancos descartados por anillo lleno
+  uint32_t bounces;             // Flancos ignorados por el antirrebote
+  uint32_t downs;
+  uint32_t clicks;              // Secuencias de pulsaciones cortas
+  uint32_t longs;
+  uint32_t dropped;             // Gestos descartados por cola llena
+} button_stats_t;
 
-// Detector bloqueante (legacy): cuenta pulsaciones dentro de una ventana de tiempo
+// Lee el nivel actual (presionado = pulsación en curso), crea la tarea y la
+// cola e instala la ISR. Se puede llamar más de una vez.
+void button_events_begin();
+
+// Quita la ISR y el despertar por GPIO (antes del deep sleep: el botón pasa a EXT1)
+void button_events_stop();
+
+// Espera el próximo gesto hasta timeout_ms. Retorna false si no hubo.
+bool button_gesture_wait(button_gesture_t* g, uint32_t timeout_ms);
+
+// Cola de gestos; NULL antes de button_events_begin
+QueueHandle_t button_events_queue();
+
+// Semáforo que se da después de encolar cada gesto (fuente del bucle de
+// app_sched; NULL = ninguno)
+void button_events_notify(SemaphoreHandle_t sem);
+
+void button_events_get_stats(button_stats_t* out);
+
+// Cuenta las pulsaciones que empiezan dentro de la ventana, esperando en la
+// cola de gestos (sin muestrear). Una pulsación ya en curso no cuenta.
 int countButtonPressesWithinWindow(unsigned long windowMs);
 
 #endif
@@ -25,6 +25,7 @@ const char* ntpServer = "172.30.19.65";
 const String base_url = "https://172.30.19.123:8000/webhook";                            //  URL base del servidor
 const String endpoint_telemetry = base_url + "/moe_telemetry/temperature_humidity";     //  Endpoint del servidor para registro de temperatura y humedad
 const String endpoint_door_sensor = base_url + "/moe_telemetry/door_status";            //  Endpoint del servidor para registro de apertura de puertas
+const String ota_manifest_url = "http://172.30.19.123:8080/firmware/manifest.json";     //  Manifiesto de firmware (servidor estático con soporte de Range)
 
 // Variables globales de sensores
 float temperature = 0.0;                                                                //  Inicialización de la variable que contiene la temperatura actual
@@ -33,11 +34,11 @@ int battery_voltage = 0;
 int battery_level = 0;                                                                  //  Inicialización de la variable que contiene el porcentaje de la bateria
 
 // Variables de display
-String display_temperature = "Temp: --°C";
-String display_humidity = "Hum: --%";
-String display_battery_voltage = "Bat: --mV";
-String display_battery_level = "Bat: --%";
-String display_door_status = "Puerta: --";
+display_line_t display_temperature("Temp: --°C");
+display_line_t display_humidity("Hum: --%");
+display_line_t display_battery_voltage("Bat: --mV");
+display_line_t display_battery_level("Bat: --%");
+display_line_t display_door_status("Puerta: --");
 
 // Modos de funcionamiento
 #define MODE_NORMAL 0
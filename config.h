@@ -2,6 +2,7 @@
 #define CONFIG_H
 
 #include <Arduino.h>
+#include "fixed_string.h"
 
 // Definicion de pines utilizados
 #define PRG_BUTTON_PIN      GPIO_NUM_0                      //  Pin digital asignado al botón P de la tarjeta
@@ -47,6 +48,7 @@ extern const char* ntpServer;                               //  Dirección IP de
 extern const String base_url;                               // URL base del servidor
 extern const String endpoint_telemetry;                     // Endpoint del servidor para registro de temperatura y humedad
 extern const String endpoint_door_sensor;                   // Endpoint del servidor para registro de apertura de puertas
+extern const String ota_manifest_url;                       // Manifiesto de firmware para actualización por descarga (pull)
 
 // Variables globales de sensores
 extern float temperature;                                   // Variable que contiene la temperatura actual
@@ -55,18 +57,27 @@ extern int battery_voltage;                                 // Variable que cont
 extern int battery_level;                                   // Variable que contiene el porcentaje de la bateria
 
 // Variables de display
-extern String display_temperature;
-extern String display_humidity;
-extern String display_battery_voltage;
-extern String display_battery_level;
+// Líneas de pantalla de capacidad fija: se reescriben cada 5 s sin usar heap
+#define DISPLAY_LINE_MAX    24                              //  Bytes por línea (UTF-8, sin el '\0')
+typedef FixedString<DISPLAY_LINE_MAX> display_line_t;
+
+extern display_line_t display_temperature;
+extern display_line_t display_humidity;
+extern display_line_t display_battery_voltage;
+extern display_line_t display_battery_level;
 
 // Variables de display
-extern String display_door_status;
+extern display_line_t display_door_status;
 
 // Modos de funcionamiento
 #define MODE_NORMAL 0
 #define MODE_CONTINUOUS 1
 
+// Periodos de los trabajos del modo continuo (ms)
+#define CONTINUOUS_SENSOR_PERIOD_MS     5000                //  Temperatura, humedad y batería
+#define CONTINUOUS_HOUSEKEEPING_MS      500                 //  Volcado de configuración y picos de pila
+#define CONTINUOUS_OTA_CHECK_MS         500                 //  Verificación (una vez) del arranque del servidor OTA
+
 // RTC memory variables
 extern RTC_DATA_ATTR time_t deep_sleep_start_time;
 extern RTC_DATA_ATTR uint8_t current_mode; // Persistente: MODE_NORMAL o MODE_CONTINUOUS
@@ -0,0 +1,341 @@
+#include "config_store.h"
+#include "moe_log.h"
+#include "config.h"
+#include <Preferences.h>
+#include "esp_rom_crc.h"
+#include "freertos/semphr.h"
+
+#define CONFIG_RTC_MAGIC        0x3147434DUL    // "MCG1"
+
+// Claves sucias pendientes de escribir en NVS
+#define CFG_DIRTY_MODE          0x01
+#define CFG_DIRTY_INTERVAL      0x02
+#define CFG_DIRTY_CONTINUOUS    0x04
+#define CFG_DIRTY_FORCE_AP      0x08
+#define CFG_DIRTY_WIFI          0x10
+#define CFG_DIRTY_PULL          0x20
+#define CFG_DIRTY_URLS          0x40
+#define CFG_DIRTY_POWER         0x80    // headless y listen
+
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t dirty;                  // Fuera del CRC: cambios aún no volcados a NVS
+  config_values_t v;
+  uint32_t crc;                   // CRC32 de v
+} config_rtc_t;
+
+// Espejo persistente en deep sleep (en arranque en frío queda con magic = 0)
+RTC_DATA_ATTR static config_rtc_t cfg_rtc;
+
+static portMUX_TYPE cfg_mux = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t cfg_flush_mutex = NULL;
+static unsigned long cfg_last_change = 0;
+static uint32_t cfg_nvs_writes = 0;
+static bool cfg_ready = false;
+
+static uint32_t config_crc(const config_values_t* v)
+{
+  return esp_rom_crc32_le(0, (const uint8_t*)v, sizeof(*v));
+}
+
+static bool config_rtc_valid()
+{
+  return cfg_rtc.magic == CONFIG_RTC_MAGIC && cfg_rtc.version == CONFIG_STORE_VERSION &&
+         cfg_rtc.crc == config_crc(&cfg_rtc.v);
+}
+
+static void config_load_nvs()
+{
+  config_values_t v;
+  memset(&v, 0, sizeof(v));
+  Preferences prefs;
+  prefs.begin("moe_cfg", true);
+  v.mode = prefs.getUChar("mode", MODE_CONTINUOUS);
+  v.interval_minutes = prefs.getUChar("interval_minutes", 10);
+  v.pull_min_battery = prefs.getUChar("pull_batt", CONFIG_DEFAULT_PULL_MIN_BATTERY);
+  if (!prefs.getString("url_tel", v.telemetry_url, sizeof(v.telemetry_url))) {
+    strlcpy(v.telemetry_url, endpoint_telemetry.c_str(), sizeof(v.telemetry_url));
+  }
+  if (!prefs.getString("url_door", v.door_url, sizeof(v.door_url))) {
+    strlcpy(v.door_url, endpoint_door_sensor.c_str(), sizeof(v.door_url));
+  }
+  v.headless_wake = prefs.getBool("headless", true);
+  v.listen_interval = prefs.getUChar("listen", CONFIG_DEFAULT_LISTEN_INTERVAL);
+  if (v.listen_interval < 1 || v.listen_interval > CONFIG_LISTEN_INTERVAL_MAX) v.listen_interval = CONFIG_DEFAULT_LISTEN_INTERVAL;
+  prefs.end();
+
+  prefs.begin("moe", true);
+  v.continuous = prefs.getBool("continuous", false);
+  prefs.end();
+
+  prefs.begin("moe_wifi", true);
+  prefs.getString("ssid", v.wifi_ssid, sizeof(v.wifi_ssid));
+  prefs.getString("pass", v.wifi_pass, sizeof(v.wifi_pass));
+  v.force_ap = prefs.getBool("force_ap", false);
+  prefs.end();
+
+  cfg_rtc.v = v;
+  cfg_rtc.dirty = 0;
+  cfg_rtc.version = CONFIG_STORE_VERSION;
+  cfg_rtc.crc = config_crc(&cfg_rtc.v);
+  cfg_rtc.magic = CONFIG_RTC_MAGIC;
+}
+
+void config_store_begin()
+{
+  if (cfg_ready) return;
+  cfg_flush_mutex = xSemaphoreCreateMutex();
+  bool cached = config_rtc_valid();
+  if (!cached) config_load_nvs();
+  cfg_ready = true;
+  MLOGI("[CONFIG] %s (modo=%u, intervalo=%u min, pendientes=0x%02X)",
+                cached ? "Espejo RTC válido" : "Cargado desde NVS",
+                cfg_rtc.v.mode, cfg_rtc.v.interval_minutes, cfg_rtc.dirty);
+}
+
+// Todas las rutas de acceso pasan por aquí: nunca se lee el espejo sin validar
+static inline void config_ensure_ready()
+{
+  if (!cfg_ready) config_store_begin();
+}
+
+void config_store_get(config_values_t* out)
+{
+  config_ensure_ready();
+  taskENTER_CRITICAL(&cfg_mux);
+  *out = cfg_rtc.v;
+  taskEXIT_CRITICAL(&cfg_mux);
+}
+
+uint8_t config_get_mode()
+{
+  config_ensure_ready();
+  return cfg_rtc.v.mode;
+}
+
+uint8_t config_get_interval_minutes()
+{
+  config_ensure_ready();
+  return cfg_rtc.v.interval_minutes;
+}
+
+bool config_get_continuous()
+{
+  config_ensure_ready();
+  return cfg_rtc.v.continuous;
+}
+
+bool config_get_force_ap()
+{
+  config_ensure_ready();
+  return cfg_rtc.v.force_ap;
+}
+
+uint8_t config_get_pull_min_battery()
+{
+  config_ensure_ready();
+  return cfg_rtc.v.pull_min_battery;
+}
+
+bool config_get_headless_wake()
+{
+  config_ensure_ready();
+  return cfg_rtc.v.headless_wake;
+}
+
+uint8_t config_get_listen_interval()
+{
+  config_ensure_ready();
+  return cfg_rtc.v.listen_interval;
+}
+
+// Aplica un cambio ya validado. Se llama dentro de la sección crítica.
+static void config_mark_dirty(uint8_t bit)
+{
+  cfg_rtc.dirty |= bit;
+  cfg_rtc.crc = config_crc(&cfg_rtc.v);
+  cfg_last_change = millis();
+}
+
+void config_set_mode(uint8_t mode)
+{
+  config_ensure_ready();
+  taskENTER_CRITICAL(&cfg_mux);
+  if (cfg_rtc.v.mode != mode) {
+    cfg_rtc.v.mode = mode;
+    config_mark_dirty(CFG_DIRTY_MODE);
+  }
+  taskEXIT_CRITICAL(&cfg_mux);
+}
+
+void config_set_interval_minutes(uint8_t minutes)
+{
+  config_ensure_ready();
+  taskENTER_CRITICAL(&cfg_mux);
+  if (cfg_rtc.v.interval_minutes != minutes) {
+    cfg_rtc.v.interval_minutes = minutes;
+    config_mark_dirty(CFG_DIRTY_INTERVAL);
+  }
+  taskEXIT_CRITICAL(&cfg_mux);
+}
+
+void config_set_continuous(bool enabled)
+{
+  config_ensure_ready();
+  taskENTER_CRITICAL(&cfg_mux);
+  if (cfg_rtc.v.continuous != enabled) {
+    cfg_rtc.v.continuous = enabled;
+    config_mark_dirty(CFG_DIRTY_CONTINUOUS);
+  }
+  taskEXIT_CRITICAL(&cfg_mux);
+}
+
+void config_set_force_ap(bool enabled)
+{
+  config_ensure_ready();
+  taskENTER_CRITICAL(&cfg_mux);
+  if (cfg_rtc.v.force_ap != enabled) {
+    cfg_rtc.v.force_ap = enabled;
+    config_mark_dirty(CFG_DIRTY_FORCE_AP);
+  }
+  taskEXIT_CRITICAL(&cfg_mux);
+}
+
+void config_set_headless_wake(bool enabled)
+{
+  config_ensure_ready();
+  taskENTER_CRITICAL(&cfg_mux);
+  if (cfg_rtc.v.headless_wake != enabled) {
+    cfg_rtc.v.headless_wake = enabled;
+    config_mark_dirty(CFG_DIRTY_POWER);
+  }
+  taskEXIT_CRITICAL(&cfg_mux);
+}
+
+void config_set_wifi(const char* ssid, const char* pass)
+{
+  char s[CONFIG_SSID_MAX + 1] = { 0 };
+  char p[CONFIG_PASS_MAX + 1] = { 0 };
+  if (ssid) strlcpy(s, ssid, sizeof(s));
+  if (ssid && ssid[0] && pass) strlcpy(p, pass, sizeof(p));
+
+  config_ensure_ready();
+  taskENTER_CRITICAL(&cfg_mux);
+  if (strcmp(cfg_rtc.v.wifi_ssid, s) != 0 || strcmp(cfg_rtc.v.wifi_pass, p) != 0) {
+    memcpy(cfg_rtc.v.wifi_ssid, s, sizeof(s));
+    memcpy(cfg_rtc.v.wifi_pass, p, sizeof(p));
+    config_mark_dirty(CFG_DIRTY_WIFI);
+  }
+  taskEXIT_CRITICAL(&cfg_mux);
+}
+
+void config_store_set(const config_values_t* v)
+{
+  config_ensure_ready();
+  taskENTER_CRITICAL(&cfg_mux);
+  const config_values_t &c = cfg_rtc.v;
+  uint8_t dirty = 0;
+  if (c.mode != v->mode) dirty |= CFG_DIRTY_MODE;
+  if (c.interval_minutes != v->interval_minutes) dirty |= CFG_DIRTY_INTERVAL;
+  if (c.continuous != v->continuous) dirty |= CFG_DIRTY_CONTINUOUS;
+  if (c.force_ap != v->force_ap) dirty |= CFG_DIRTY_FORCE_AP;
+  if (strcmp(c.wifi_ssid, v->wifi_ssid) != 0 || strcmp(c.wifi_pass, v->wifi_pass) != 0) dirty |= CFG_DIRTY_WIFI;
+  if (c.pull_min_battery != v->pull_min_battery) dirty |= CFG_DIRTY_PULL;
+  if (strcmp(c.telemetry_url, v->telemetry_url) != 0 || strcmp(c.door_url, v->door_url) != 0) dirty |= CFG_DIRTY_URLS;
+  if (c.headless_wake != v->headless_wake || c.listen_interval != v->listen_interval) dirty |= CFG_DIRTY_POWER;
+  if (dirty) {
+    cfg_rtc.v = *v;
+    config_mark_dirty(dirty);
+  }
+  taskEXIT_CRITICAL(&cfg_mux);
+}
+
+// Escribe las claves indicadas en dirty con los valores de v
+static bool config_write_nvs(uint8_t dirty, const config_values_t* v)
+{
+  Preferences prefs;
+  bool ok = true;
+  if (dirty & (CFG_DIRTY_MODE | CFG_DIRTY_INTERVAL | CFG_DIRTY_PULL | CFG_DIRTY_URLS | CFG_DIRTY_POWER)) {
+    ok = prefs.begin("moe_cfg", false) && ok;
+    if (dirty & CFG_DIRTY_MODE) { ok = prefs.putUChar("mode", v->mode) > 0 && ok; cfg_nvs_writes++; }
+    if (dirty & CFG_DIRTY_INTERVAL) { ok = prefs.putUChar("interval_minutes", v->interval_minutes) > 0 && ok; cfg_nvs_writes++; }
+    if (dirty & CFG_DIRTY_PULL) { ok = prefs.putUChar("pull_batt", v->pull_min_battery) > 0 && ok; cfg_nvs_writes++; }
+    if (dirty & CFG_DIRTY_URLS) {
+      ok = prefs.putString("url_tel", v->telemetry_url) > 0 && ok;
+      ok = prefs.putString("url_door", v->door_url) > 0 && ok;
+      cfg_nvs_writes += 2;
+    }
+    if (dirty & CFG_DIRTY_POWER) {
+      ok = prefs.putBool("headless", v->headless_wake) > 0 && ok;
+      ok = prefs.putUChar("listen", v->listen_interval) > 0 && ok;
+      cfg_nvs_writes += 2;
+    }
+    prefs.end();
+  }
+  if (dirty & CFG_DIRTY_CONTINUOUS) {
+    ok = prefs.begin("moe", false) && ok;
+    ok = prefs.putBool("continuous", v->continuous) > 0 && ok;
+    cfg_nvs_writes++;
+    prefs.end();
+  }
+  if (dirty & (CFG_DIRTY_WIFI | CFG_DIRTY_FORCE_AP)) {
+    ok = prefs.begin("moe_wifi", false) && ok;
+    if (dirty & CFG_DIRTY_WIFI) {
+      if (v->wifi_ssid[0]) {
+        ok = prefs.putString("ssid", v->wifi_ssid) > 0 && ok;
+        prefs.putString("pass", v->wifi_pass);
+      } else {
+        prefs.remove("ssid");
+        prefs.remove("pass");
+      }
+      cfg_nvs_writes += 2;
+    }
+    if (dirty & CFG_DIRTY_FORCE_AP) {
+      // La bandera sólo existe en NVS mientras está activa (compatibilidad con versiones previas)
+      if (v->force_ap) ok = prefs.putBool("force_ap", true) > 0 && ok;
+      else prefs.remove("force_ap");
+      cfg_nvs_writes++;
+    }
+    prefs.end();
+  }
+  return ok;
+}
+
+bool config_store_flush()
+{
+  config_ensure_ready();
+  if (cfg_rtc.dirty == 0) return true;
+
+  // Un volcado a la vez: así uno viejo no pisa en NVS a otro más reciente
+  xSemaphoreTake(cfg_flush_mutex, portMAX_DELAY);
+  config_values_t v;
+  taskENTER_CRITICAL(&cfg_mux);
+  uint8_t dirty = cfg_rtc.dirty;
+  v = cfg_rtc.v;
+  cfg_rtc.dirty = 0;
+  taskEXIT_CRITICAL(&cfg_mux);
+
+  bool ok = dirty == 0 || config_write_nvs(dirty, &v);
+  if (!ok) {
+    // Reintentar en el próximo volcado
+    taskENTER_CRITICAL(&cfg_mux);
+    cfg_rtc.dirty |= dirty;
+    taskEXIT_CRITICAL(&cfg_mux);
+    MLOGE("[CONFIG] ERROR escribiendo NVS");
+  }
+  xSemaphoreGive(cfg_flush_mutex);
+  return ok;
+}
+
+void config_store_tick()
+{
+  if (cfg_ready && cfg_rtc.dirty && millis() - cfg_last_change >= CONFIG_FLUSH_DELAY_MS) {
+    config_store_flush();
+  }
+}
+
+uint32_t config_store_nvs_writes()
+{
+  return cfg_nvs_writes;
+}
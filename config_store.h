@@ -0,0 +1,72 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+
+// Configuración persistente del dispositivo en un único objeto tipado.
+// Se lee de NVS una sola vez (arranque en frío) y se refleja en memoria RTC
+// con versión y CRC, así los despertares del deep sleep no abren NVS. Los
+// setters sólo marcan como sucias las claves cuyo valor cambió; las escrituras
+// se agrupan y se vuelcan con config_store_flush() (explícito, antes de dormir
+// o de reiniciar) o con config_store_tick() tras CONFIG_FLUSH_DELAY_MS sin
+// cambios. Se conservan los namespaces y claves históricos de NVS.
+
+#define CONFIG_STORE_VERSION    4
+#define CONFIG_FLUSH_DELAY_MS   2000UL          // Ventana para agrupar cambios seguidos
+#define CONFIG_SSID_MAX         32
+#define CONFIG_PASS_MAX         64
+#define CONFIG_URL_MAX          112
+#define CONFIG_DEFAULT_PULL_MIN_BATTERY  30     // % mínimo para descargar firmware (pull)
+#define CONFIG_DEFAULT_LISTEN_INTERVAL   3      // Beacons entre escuchas con modem sleep
+#define CONFIG_LISTEN_INTERVAL_MAX       10
+
+typedef struct {
+  uint8_t mode;                                 // moe_cfg/mode (MODE_NORMAL o MODE_CONTINUOUS)
+  uint8_t interval_minutes;                     // moe_cfg/interval_minutes
+  bool continuous;                              // moe/continuous (bandera de la interfaz OTA)
+  bool force_ap;                                // moe_wifi/force_ap (entrar en AP en el próximo arranque)
+  char wifi_ssid[CONFIG_SSID_MAX + 1];          // moe_wifi/ssid ("" = sin credenciales)
+  char wifi_pass[CONFIG_PASS_MAX + 1];          // moe_wifi/pass
+  uint8_t pull_min_battery;                     // moe_cfg/pull_batt
+  char telemetry_url[CONFIG_URL_MAX + 1];       // moe_cfg/url_tel (por defecto endpoint_telemetry)
+  char door_url[CONFIG_URL_MAX + 1];            // moe_cfg/url_door (por defecto endpoint_door_sensor)
+  bool headless_wake;                           // moe_cfg/headless (modo normal: timer y puerta sin pantalla)
+  uint8_t listen_interval;                      // moe_cfg/listen (1..CONFIG_LISTEN_INTERVAL_MAX)
+} config_values_t;
+
+// Valida el espejo RTC o, si no es válido, carga desde NVS
+void config_store_begin();
+
+// Copia consistente de todos los valores
+void config_store_get(config_values_t* out);
+
+uint8_t config_get_mode();
+uint8_t config_get_interval_minutes();
+bool config_get_continuous();
+bool config_get_force_ap();
+uint8_t config_get_pull_min_battery();
+bool config_get_headless_wake();
+uint8_t config_get_listen_interval();
+
+void config_set_mode(uint8_t mode);
+void config_set_interval_minutes(uint8_t minutes);
+void config_set_continuous(bool enabled);
+void config_set_force_ap(bool enabled);
+void config_set_headless_wake(bool enabled);
+// ssid vacío o NULL borra las credenciales
+void config_set_wifi(const char* ssid, const char* pass);
+
+// Reemplaza todos los valores de una vez (validados por quien llama); sólo se
+// marcan las claves que difieren
+void config_store_set(const config_values_t* v);
+
+// Escribe en NVS sólo las claves modificadas. Retorna false si alguna escritura falló.
+bool config_store_flush();
+
+// Llamar periódicamente: vuelca los cambios pendientes tras CONFIG_FLUSH_DELAY_MS
+void config_store_tick();
+
+// Escrituras a NVS realizadas desde el arranque (desgaste de flash)
+uint32_t config_store_nvs_writes();
+
+#endif
@@ -0,0 +1,239 @@
+#include "delta_patch.h"
+#include <string.h>
+
+enum {
+  DELTA_S_HEADER = 0,
+  DELTA_S_CTRL,
+  DELTA_S_ZERO_RUN,
+  DELTA_S_LIT_LEN,
+  DELTA_S_LIT,
+  DELTA_S_EXTRA,
+  DELTA_S_DONE,
+  DELTA_S_ERROR
+};
+
+static uint32_t delta_read_u32(const uint8_t* b)
+{
+  return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static bool delta_fail(delta_patch_t* p, const char* msg)
+{
+  p->error = msg;
+  p->state = DELTA_S_ERROR;
+  return false;
+}
+
+static bool delta_flush(delta_patch_t* p)
+{
+  if (p->out_len == 0) return true;
+  if (!p->write_new(p->ctx, p->out, p->out_len)) return delta_fail(p, "error escribiendo imagen nueva");
+  p->out_len = 0;
+  return true;
+}
+
+static bool delta_emit(delta_patch_t* p, uint8_t b)
+{
+  if (p->new_pos >= p->header.new_size) return delta_fail(p, "parche excede new_size");
+  p->out[p->out_len++] = b;
+  p->new_pos++;
+  if (p->out_len == DELTA_IO_CHUNK) return delta_flush(p);
+  return true;
+}
+
+// Byte de la imagen base en old_pos (con ventana de lectura)
+static bool delta_old_byte(delta_patch_t* p, uint8_t* out)
+{
+  if (p->old_pos >= p->header.old_size) return delta_fail(p, "lectura fuera de la imagen base");
+  if (p->old_pos < p->cache_off || p->old_pos >= p->cache_off + p->cache_len) {
+    uint32_t n = p->header.old_size - p->old_pos;
+    if (n > DELTA_IO_CHUNK) n = DELTA_IO_CHUNK;
+    if (!p->read_old(p->ctx, p->old_pos, p->cache, n)) return delta_fail(p, "error leyendo imagen base");
+    p->cache_off = p->old_pos;
+    p->cache_len = n;
+  }
+  *out = p->cache[p->old_pos - p->cache_off];
+  p->old_pos++;
+  return true;
+}
+
+// Acumula un varint LEB128; retorna true cuando el valor está completo.
+// A lo sumo 5 bytes y el quinto sólo aporta los 4 bits altos (sin continuación).
+static bool delta_varint(delta_patch_t* p, uint8_t b, bool* complete)
+{
+  if (p->varint_shift > 28 || (p->varint_shift == 28 && (b & 0xF0))) return delta_fail(p, "varint invalido");
+  p->varint |= (uint32_t)(b & 0x7F) << p->varint_shift;
+  p->varint_shift += 7;
+  *complete = (b & 0x80) == 0;
+  return true;
+}
+
+static void delta_varint_reset(delta_patch_t* p)
+{
+  p->varint = 0;
+  p->varint_shift = 0;
+}
+
+// Fin de un registro: aplicar seek y decidir si sigue otro registro
+static bool delta_end_record(delta_patch_t* p)
+{
+  int64_t pos = (int64_t)p->old_pos + p->seek;
+  if (pos < 0 || pos > (int64_t)p->header.old_size) return delta_fail(p, "seek fuera de la imagen base");
+  p->old_pos = (uint32_t)pos;
+  if (p->new_pos == p->header.new_size) {
+    if (!delta_flush(p)) return false;
+    p->state = DELTA_S_DONE;
+  } else {
+    p->state = DELTA_S_CTRL;
+    p->field = 0;
+    delta_varint_reset(p);
+  }
+  return true;
+}
+
+static bool delta_after_diff(delta_patch_t* p)
+{
+  if (p->diff_left > 0) {
+    p->state = DELTA_S_ZERO_RUN;
+    delta_varint_reset(p);
+    return true;
+  }
+  if (p->extra_left > 0) {
+    p->state = DELTA_S_EXTRA;
+    return true;
+  }
+  return delta_end_record(p);
+}
+
+static bool delta_parse_header(delta_patch_t* p)
+{
+  const uint8_t* h = p->hdr_buf;
+  if (!delta_is_patch(h, DELTA_HEADER_SIZE)) return delta_fail(p, "magic invalido");
+  if (h[4] != DELTA_VERSION) return delta_fail(p, "version de parche no soportada");
+  p->header.old_size = delta_read_u32(h + 8);
+  p->header.new_size = delta_read_u32(h + 12);
+  memcpy(p->header.old_sha256, h + 16, 32);
+  memcpy(p->header.new_sha256, h + 48, 32);
+  if (p->header.new_size == 0) return delta_fail(p, "new_size invalido");
+  if (p->on_header && !p->on_header(p->ctx, &p->header)) return delta_fail(p, "imagen base rechazada");
+  p->state = DELTA_S_CTRL;
+  p->field = 0;
+  delta_varint_reset(p);
+  return true;
+}
+
+bool delta_is_patch(const uint8_t* data, size_t len)
+{
+  return len >= 4 && data[0] == DELTA_MAGIC_0 && data[1] == DELTA_MAGIC_1 &&
+         data[2] == DELTA_MAGIC_2 && data[3] == DELTA_MAGIC_3;
+}
+
+void delta_patch_init(delta_patch_t* p, delta_read_fn read_old, delta_write_fn write_new,
+                      delta_header_fn on_header, void* ctx)
+{
+  memset(p, 0, sizeof(*p));
+  p->read_old = read_old;
+  p->write_new = write_new;
+  p->on_header = on_header;
+  p->ctx = ctx;
+  p->state = DELTA_S_HEADER;
+}
+
+bool delta_patch_feed(delta_patch_t* p, const uint8_t* data, size_t len)
+{
+  size_t i = 0;
+  while (i < len)
+  {
+    switch (p->state)
+    {
+      case DELTA_S_HEADER: {
+        size_t n = DELTA_HEADER_SIZE - p->hdr_len;
+        if (n > len - i) n = len - i;
+        memcpy(p->hdr_buf + p->hdr_len, data + i, n);
+        p->hdr_len += n;
+        i += n;
+        if (p->hdr_len == DELTA_HEADER_SIZE && !delta_parse_header(p)) return false;
+        break;
+      }
+
+      case DELTA_S_CTRL: {
+        bool complete = false;
+        if (!delta_varint(p, data[i++], &complete)) return false;
+        if (!complete) break;
+        if (p->field == 0) {
+          p->diff_left = p->varint;
+        } else if (p->field == 1) {
+          p->extra_left = p->varint;
+        } else {
+          // zigzag: 0,-1,1,-2,... -> 0,1,2,3,...
+          p->seek = (int32_t)(p->varint >> 1) ^ -(int32_t)(p->varint & 1);
+          if ((uint64_t)p->new_pos + p->diff_left + p->extra_left > p->header.new_size) {
+            return delta_fail(p, "registro excede new_size");
+          }
+          if (!delta_after_diff(p)) return false;
+          break;
+        }
+        p->field++;
+        delta_varint_reset(p);
+        break;
+      }
+
+      case DELTA_S_ZERO_RUN: {
+        bool complete = false;
+        if (!delta_varint(p, data[i++], &complete)) return false;
+        if (!complete) break;
+        uint32_t run = p->varint;
+        if (run > p->diff_left) return delta_fail(p, "zero_run excede diff");
+        // Bytes idénticos a la base: copiar directamente
+        for (uint32_t k = 0; k < run; k++) {
+          uint8_t b;
+          if (!delta_old_byte(p, &b) || !delta_emit(p, b)) return false;
+        }
+        p->diff_left -= run;
+        p->state = DELTA_S_LIT_LEN;
+        delta_varint_reset(p);
+        break;
+      }
+
+      case DELTA_S_LIT_LEN: {
+        bool complete = false;
+        if (!delta_varint(p, data[i++], &complete)) return false;
+        if (!complete) break;
+        if (p->varint > p->diff_left) return delta_fail(p, "lit_len excede diff");
+        p->lit_left = p->varint;
+        p->diff_left -= p->lit_left;
+        if (p->lit_left > 0) {
+          p->state = DELTA_S_LIT;
+        } else if (!delta_after_diff(p)) {
+          return false;
+        }
+        break;
+      }
+
+      case DELTA_S_LIT: {
+        uint8_t b;
+        if (!delta_old_byte(p, &b) || !delta_emit(p, (uint8_t)(b + data[i++]))) return false;
+        if (--p->lit_left == 0 && !delta_after_diff(p)) return false;
+        break;
+      }
+
+      case DELTA_S_EXTRA: {
+        if (!delta_emit(p, data[i++])) return false;
+        if (--p->extra_left == 0 && !delta_end_record(p)) return false;
+        break;
+      }
+
+      case DELTA_S_DONE:
+        return delta_fail(p, "datos despues del final del parche");
+
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+bool delta_patch_done(const delta_patch_t* p)
+{
+  return p->state == DELTA_S_DONE;
+}
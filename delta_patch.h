@@ -0,0 +1,86 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+// Motor de aplicación de parches binarios (delta OTA).
+// No depende de Arduino ni de ESP-IDF: la lectura de la imagen base y la escritura
+// de la imagen nueva se hacen mediante callbacks, de modo que el mismo código
+// puede ejecutarse en Linux contra imágenes de partición respaldadas en archivos.
+//
+// Formato del parche (generado por tools/moe_delta.py), enteros little-endian:
+//   "MOED" | version(1) | reservado(3) | old_size(4) | new_size(4) | old_sha256(32) | new_sha256(32)
+//   registros hasta completar new_size:
+//     diff_len(varint) extra_len(varint) seek(varint zigzag)
+//     diff: pares zero_run(varint) lit_len(varint) lit[lit_len] que suman diff_len;
+//           cada byte nuevo = byte_base + byte_diff (los ceros copian la base)
+//     extra[extra_len]: bytes nuevos sin referencia a la base
+//     al final del registro el puntero de la base avanza seek bytes
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DELTA_MAGIC_0       'M'
+#define DELTA_MAGIC_1       'O'
+#define DELTA_MAGIC_2       'E'
+#define DELTA_MAGIC_3       'D'
+#define DELTA_VERSION       1
+#define DELTA_HEADER_SIZE   80
+#define DELTA_IO_CHUNK      256
+
+typedef struct {
+  uint32_t old_size;
+  uint32_t new_size;
+  uint8_t old_sha256[32];
+  uint8_t new_sha256[32];
+} delta_header_t;
+
+// Lee len bytes de la imagen base en offset. Retorna false ante error de lectura.
+typedef bool (*delta_read_fn)(void* ctx, uint32_t offset, uint8_t* buf, size_t len);
+// Escribe bytes consecutivos de la imagen nueva. Retorna false ante error.
+typedef bool (*delta_write_fn)(void* ctx, const uint8_t* buf, size_t len);
+// Se invoca una vez con el encabezado ya parseado, antes de producir salida.
+// Permite validar la imagen base y preparar el destino; false aborta el parche.
+typedef bool (*delta_header_fn)(void* ctx, const delta_header_t* header);
+
+typedef struct {
+  delta_read_fn read_old;
+  delta_write_fn write_new;
+  delta_header_fn on_header;
+  void* ctx;
+
+  delta_header_t header;
+  uint8_t state;
+  uint8_t field;                    // Campo del registro de control en curso
+  uint32_t varint;                  // Acumulador de varint
+  uint8_t varint_shift;
+  uint32_t hdr_len;
+
+  uint32_t diff_left;               // Bytes de diff pendientes en el registro
+  uint32_t lit_left;                // Literales pendientes en el par actual
+  uint32_t extra_left;              // Bytes extra pendientes
+  int32_t seek;
+  uint32_t old_pos;
+  uint32_t new_pos;
+
+  uint8_t hdr_buf[DELTA_HEADER_SIZE];
+  uint8_t cache[DELTA_IO_CHUNK];    // Ventana de lectura de la imagen base
+  uint32_t cache_off;
+  uint32_t cache_len;
+  uint8_t out[DELTA_IO_CHUNK];      // Salida pendiente de escribir
+  uint32_t out_len;
+
+  const char* error;
+} delta_patch_t;
+
+// true si los primeros bytes corresponden a un parche delta
+bool delta_is_patch(const uint8_t* data, size_t len);
+
+void delta_patch_init(delta_patch_t* p, delta_read_fn read_old, delta_write_fn write_new,
+                      delta_header_fn on_header, void* ctx);
+
+// Consume un bloque del parche. Retorna false ante un error (ver p->error).
+bool delta_patch_feed(delta_patch_t* p, const uint8_t* data, size_t len);
+
+// true cuando se produjo la imagen completa (new_size bytes escritos)
+bool delta_patch_done(const delta_patch_t* p);
+
+#endif
@@ -1,8 +1,81 @@
 #include "display_utils.h"
+#include "moe_log.h"
 #include "config.h"
+#include "oled_diff.h"
+#include "task_config.h"
+#include "wake_stats.h"
+#include <Wire.h>
+#include <atomic>
+
+#define OLED_I2C_ADDRESS    0x3c
+#define OLED_I2C_CHUNK      64          // Bytes de datos por transacción (buffer de Wire: 128)
 
 // Definición del objeto display
-SSD1306Wire oled_display(0x3c, 500000, SDA_OLED, SCL_OLED, GEOMETRY_128_64, RST_OLED);
+SSD1306Wire oled_display(OLED_I2C_ADDRESS, 500000, SDA_OLED, SCL_OLED, GEOMETRY_128_64, RST_OLED);
+
+// Copia de lo que tiene la RAM del panel; inválida tras init o corte de Vext
+static uint8_t oled_sent[OLED_FB_SIZE];
+static bool oled_sent_valid = false;
+static display_stats_t oled_stats;
+
+// Servicio de pantalla: sólo la tarea Display toca oled_display y el bus I2C.
+// Los avisos (hold_ms > 0) van en orden por una cola; las actualizaciones sin
+// hold_ms van a un buzón de una sola entrada, así la última reemplaza a las
+// anteriores sin ocupar la cola. El número de secuencia ordena ambos.
+typedef enum {
+  DISPLAY_KIND_3_LINE,
+  DISPLAY_KIND_2_LINE,
+  DISPLAY_KIND_WRAP,            // 3 líneas ya cortadas por palabras (las vacías se omiten)
+  DISPLAY_KIND_AP_INFO,
+} display_kind_t;
+
+typedef struct {
+  uint32_t seq;
+  uint8_t kind;
+  uint16_t hold_ms;
+  display_line_t line[3];
+} display_msg_t;
+
+static QueueHandle_t display_q = NULL;
+static TaskHandle_t display_task_handle = NULL;
+static portMUX_TYPE display_mux = portMUX_INITIALIZER_UNLOCKED;
+static display_msg_t display_latest;            // Buzón de actualizaciones (protegido por display_mux)
+static bool display_latest_valid = false;
+static bool display_wake_req = false;
+static uint32_t display_seq = 0;
+static std::atomic<uint32_t> display_pending(0);  // Avisos + buzón + encendido + mensaje en curso
+
+// Estado de la tarea Display
+static display_msg_t display_current;           // Último contenido (se redibuja al encender)
+static bool display_has_content = false;
+static bool display_panel_on = false;
+static uint32_t display_last_wake = 0;
+static std::atomic<uint32_t> display_idle_off_ms(0);
+
+// Ventana de columnas [x0, x1] de una página y sus datos, directo por I2C
+static void oled_send_span(uint8_t page, uint8_t x0, uint8_t x1, const uint8_t* data, void* ctx)
+{
+  uint32_t* bytes = (uint32_t*)ctx;
+  Wire.beginTransmission(OLED_I2C_ADDRESS);
+  Wire.write(0x00);                                     // Co=0, D/C#=0: comandos
+  Wire.write(0x21); Wire.write(x0); Wire.write(x1);     // COLUMNADDR
+  Wire.write(0x22); Wire.write(page); Wire.write(page); // PAGEADDR
+  Wire.endTransmission();
+  *bytes += 7;
+
+  size_t n = x1 - x0 + 1;
+  for (size_t off = 0; off < n; off += OLED_I2C_CHUNK) {
+    size_t len = n - off < OLED_I2C_CHUNK ? n - off : OLED_I2C_CHUNK;
+    Wire.beginTransmission(OLED_I2C_ADDRESS);
+    Wire.write(0x40);                                   // Co=0, D/C#=1: datos
+    Wire.write(data + off, len);
+    Wire.endTransmission();
+    *bytes += len + 1;
+  }
+}
+
+// Estado de Vext; desconocido (se asume encendido) hasta el primer VextON/VextOFF
+static bool vext_on = true;
 
 // Enciende pantalla OLED
 void VextON() 
@@ -10,6 +83,8 @@ void VextON()
   pinMode(Vext, OUTPUT);
   digitalWrite(Vext, LOW);
   delay(20);
+  vext_on = true;
+  wake_stats_oled(true);
 }
 
 // Apaga pantalla OLED para ahorro energético
@@ -17,97 +92,291 @@ void VextOFF()
 {
   pinMode(Vext, OUTPUT);
   digitalWrite(Vext, HIGH);  // Apaga la pantalla OLED
-  delay(20);
+  if (vext_on) delay(20);
+  vext_on = false;
+  oled_sent_valid = false;
+  wake_stats_oled(false);
 }
 
-// Inicializa la pantalla OLED
-void init_display()
+static void display_power_on()
 {
   VextON();
   oled_display.init();
+  oled_sent_valid = false;
+  display_panel_on = true;
 }
 
-//  Función que me permite imprimir mensajes a 3 lineas en la pantalla OLED integrada
-void display_oled_message_3_line(String line_1, String line_2, String line_3) 
+void display_flush()
 {
-  oled_display.clear();
-  oled_display.setFont(ArialMT_Plain_16);
-  oled_display.setTextAlignment(TEXT_ALIGN_CENTER);
-  oled_display.drawString(64, 5,  line_1);
-  oled_display.drawString(64, 25, line_2);
-  oled_display.drawString(64, 45, line_3);
-  oled_display.display();
+  uint32_t bytes = 0;
+  size_t columns = oled_diff(oled_sent, oled_display.buffer, !oled_sent_valid, oled_send_span, &bytes);
+  oled_sent_valid = true;
+  oled_stats.frames++;
+  if (columns == 0) oled_stats.skipped++;
+  oled_stats.last_bytes = bytes;
+  oled_stats.bytes_total += bytes;
+  MLOGD("[OLED] frame: %u columnas, %u bytes I2C", (unsigned)columns, (unsigned)bytes);
 }
 
-// Mostrar información de AP: SSID, IP y MAC con fuente más pequeña y alineado a la izquierda
-void display_oled_ap_info(const String &ssid, const String &ip, const String &mac)
+void display_get_stats(display_stats_t* out)
+{
+  *out = oled_stats;
+}
+
+static void display_render(const display_msg_t* m)
 {
   oled_display.clear();
-  oled_display.setFont(ArialMT_Plain_10);
-  oled_display.setTextAlignment(TEXT_ALIGN_LEFT);
+  switch (m->kind) {
+    case DISPLAY_KIND_3_LINE:
+      oled_display.setFont(ArialMT_Plain_16);
+      oled_display.setTextAlignment(TEXT_ALIGN_CENTER);
+      oled_display.drawString(64, 5,  m->line[0].c_str());
+      oled_display.drawString(64, 25, m->line[1].c_str());
+      oled_display.drawString(64, 45, m->line[2].c_str());
+      break;
+    case DISPLAY_KIND_2_LINE: {
+      oled_display.setFont(ArialMT_Plain_24);
+      oled_display.setTextAlignment(TEXT_ALIGN_CENTER);
+      // Calcular coordenadas Y para centrar 2 líneas (cada una de 24px)
+      int total_text_height = 2 * 24;
+      int top_margin = (64 - total_text_height) / 2;
+      oled_display.drawString(64, top_margin, m->line[0].c_str());
+      oled_display.drawString(64, top_margin + 24, m->line[1].c_str());
+      break;
+    }
+    case DISPLAY_KIND_WRAP:
+      oled_display.setFont(ArialMT_Plain_16);
+      oled_display.setTextAlignment(TEXT_ALIGN_CENTER);
+      for (int i = 0; i < 3; i++) {
+        if (m->line[i].length() > 0) oled_display.drawString(64, 6 + 20 * i, m->line[i].c_str());
+      }
+      break;
+    case DISPLAY_KIND_AP_INFO:
+      // Fuente más pequeña y alineado a la izquierda
+      oled_display.setFont(ArialMT_Plain_10);
+      oled_display.setTextAlignment(TEXT_ALIGN_LEFT);
+      oled_display.drawString(2, 6,  m->line[0].c_str());
+      oled_display.drawString(2, 26, m->line[1].c_str());
+      oled_display.drawString(2, 46, m->line[2].c_str());
+      break;
+  }
+}
 
-  // Truncar si es necesario para que encaje en 128px de ancho
-  String s1 = ssid;
-  if (s1.length() > 20) s1 = s1.substring(0, 20) + "...";
-  String s2 = "IP: " + ip;
-  String s3 = "MAC: " + mac;
+// Enciende el panel (si estaba apagado) y reinicia el temporizador de inactividad
+static void display_wake_panel()
+{
+  display_last_wake = millis();
+  if (display_panel_on) return;
+  display_power_on();
+  if (display_has_content) {
+    display_render(&display_current);
+    display_flush();
+  }
+}
 
-  oled_display.drawString(2, 6, s1);
-  oled_display.drawString(2, 26, s2);
-  oled_display.drawString(2, 46, s3);
-  oled_display.display();
+// Próximo mensaje a mostrar: el aviso más antiguo, o el buzón si no hay
+// avisos. Un buzón anterior al aviso ya quedó viejo y se descarta.
+static bool display_next(display_msg_t* m)
+{
+  display_msg_t notice;
+  bool have_notice = xQueuePeek(display_q, &notice, 0) == pdTRUE;
+  bool have = false;
+  portENTER_CRITICAL(&display_mux);
+  if (display_latest_valid && (!have_notice || display_latest.seq < notice.seq)) {
+    display_latest_valid = false;
+    if (have_notice) {
+      oled_stats.coalesced++;
+      display_pending--;
+    } else {
+      *m = display_latest;
+      have = true;
+    }
+  }
+  portEXIT_CRITICAL(&display_mux);
+  if (have) return true;
+  return xQueueReceive(display_q, m, 0) == pdTRUE;
 }
 
-//  Función que me permite imprimir mensajes a 2 líneas en la pantalla OLED integrada
-void display_oled_message_2_line(String line_1, String line_2) 
+static void display_task(void* arg)
 {
-  oled_display.clear();
-  oled_display.setFont(ArialMT_Plain_24);
-  oled_display.setTextAlignment(TEXT_ALIGN_CENTER);
+  display_msg_t m;
+  for (;;) {
+    TickType_t wait = portMAX_DELAY;
+    uint32_t idle_off = display_idle_off_ms;
+    if (display_panel_on && idle_off) {
+      uint32_t elapsed = millis() - display_last_wake;
+      wait = elapsed >= idle_off ? 0 : pdMS_TO_TICKS(idle_off - elapsed);
+    }
+    ulTaskNotifyTake(pdTRUE, wait);
 
-  // Calcular coordenadas Y para centrar 2 líneas (cada una de 24px)
-  int total_text_height = 2 * 24;
-  int top_margin = (64 - total_text_height) / 2;
+    portENTER_CRITICAL(&display_mux);
+    bool wake = display_wake_req;
+    display_wake_req = false;
+    portEXIT_CRITICAL(&display_mux);
+    if (wake) {
+      display_wake_panel();
+      display_pending--;
+    }
 
-  oled_display.drawString(64, top_margin, line_1);
-  oled_display.drawString(64, top_margin + 24, line_2);
+    while (display_next(&m)) {
+      display_current = m;
+      display_has_content = true;
+      // Los avisos encienden el panel; las actualizaciones periódicas no
+      if (m.hold_ms > 0) display_wake_panel();
+      if (display_panel_on) {
+        display_render(&m);
+        display_flush();
+      }
+      if (m.hold_ms > 0) vTaskDelay(pdMS_TO_TICKS(m.hold_ms));
+      display_pending--;
+    }
 
-  oled_display.display();
+    idle_off = display_idle_off_ms;
+    if (display_panel_on && idle_off && millis() - display_last_wake >= idle_off) {
+      // Inactividad: apagar el panel; el contenido se conserva para el próximo encendido
+      MLOGD("[OLED] Inactividad: panel apagado");
+      VextOFF();
+      display_panel_on = false;
+    }
+  }
+}
+
+// Encola sin bloquear. Con la cola de avisos llena se descarta el más antiguo.
+static void display_post(display_msg_t* m)
+{
+  if (!display_task_handle) return;
+  portENTER_CRITICAL(&display_mux);
+  m->seq = ++display_seq;
+  if (m->hold_ms == 0) {
+    if (display_latest_valid) oled_stats.coalesced++;
+    else display_pending++;
+    display_latest = *m;
+    display_latest_valid = true;
+  } else {
+    display_pending++;
+  }
+  portEXIT_CRITICAL(&display_mux);
+
+  if (m->hold_ms > 0 && xQueueSend(display_q, m, 0) != pdTRUE) {
+    display_msg_t old;
+    if (xQueueReceive(display_q, &old, 0) == pdTRUE) {
+      portENTER_CRITICAL(&display_mux);
+      oled_stats.coalesced++;
+      portEXIT_CRITICAL(&display_mux);
+      display_pending--;
+    }
+    if (xQueueSend(display_q, m, 0) != pdTRUE) display_pending--;
+  }
+  xTaskNotifyGive(display_task_handle);
+}
+
+// Inicializa la pantalla OLED y el servicio que la atiende
+void init_display()
+{
+  display_power_on();
+  display_last_wake = millis();
+  if (display_q) return;
+  display_q = xQueueCreate(DISPLAY_QUEUE_LEN, sizeof(display_msg_t));
+  task_spawn(TASK_DISPLAY, display_task, NULL, &display_task_handle);
+}
+
+// Despertar sin pantalla: Vext queda cortado y no se crea la tarea Display
+void display_headless()
+{
+  pinMode(Vext, OUTPUT);
+  digitalWrite(Vext, HIGH);
+  vext_on = false;
+  display_panel_on = false;
+}
+
+void display_wake()
+{
+  if (!display_task_handle) return;
+  portENTER_CRITICAL(&display_mux);
+  if (!display_wake_req) display_pending++;
+  display_wake_req = true;
+  portEXIT_CRITICAL(&display_mux);
+  xTaskNotifyGive(display_task_handle);
+}
+
+void display_set_idle_off(uint32_t ms)
+{
+  display_idle_off_ms = ms;
+  display_wake();
+}
+
+bool display_drain(uint32_t timeout_ms)
+{
+  uint32_t start = millis();
+  while (display_pending.load() > 0) {
+    if (millis() - start >= timeout_ms) return false;
+    delay(10);
+  }
+  return true;
+}
+
+
+//  Función que me permite imprimir mensajes a 3 lineas en la pantalla OLED integrada
+void display_oled_message_3_line(const char* line_1, const char* line_2, const char* line_3, uint16_t hold_ms)
+{
+  display_msg_t m;
+  m.kind = DISPLAY_KIND_3_LINE;
+  m.hold_ms = hold_ms;
+  m.line[0] = line_1;
+  m.line[1] = line_2;
+  m.line[2] = line_3;
+  display_post(&m);
+}
+
+// Mostrar información de AP: SSID, IP y MAC con fuente más pequeña y alineado a la izquierda
+void display_oled_ap_info(const char* ssid, const char* ip, const char* mac)
+{
+  display_msg_t m;
+  m.kind = DISPLAY_KIND_AP_INFO;
+  m.hold_ms = 0;
+  // Truncar si es necesario para que encaje en 128px de ancho
+  if (strlen(ssid) > 20) m.line[0].format("%.20s...", ssid);
+  else m.line[0] = ssid;
+  m.line[1].format("IP: %s", ip);
+  m.line[2].format("MAC: %s", mac);
+  display_post(&m);
+}
+
+//  Función que me permite imprimir mensajes a 2 líneas en la pantalla OLED integrada
+void display_oled_message_2_line(const char* line_1, const char* line_2, uint16_t hold_ms)
+{
+  display_msg_t m;
+  m.kind = DISPLAY_KIND_2_LINE;
+  m.hold_ms = hold_ms;
+  m.line[0] = line_1;
+  m.line[1] = line_2;
+  display_post(&m);
 }
 
 // Mostrar un mensaje largo dividiendo por palabras en hasta 3 líneas y adaptando fuente
-void display_oled_wrap_message(const String &msg)
+void display_oled_wrap_message(const char* msg, uint16_t hold_ms)
 {
-  String s = msg;
-  String lines[3];
+  display_msg_t m;
+  m.kind = DISPLAY_KIND_WRAP;
+  m.hold_ms = hold_ms;
   int lineIdx = 0;
+  const char* s = msg;
 
-  while (s.length() > 0 && lineIdx < 3) {
-    int sp = s.indexOf(' ');
-    String word;
-    if (sp < 0) { word = s; s = ""; }
-    else { word = s.substring(0, sp); s = s.substring(sp + 1); }
+  while (*s && lineIdx < 3) {
+    while (*s == ' ') s++;
+    if (!*s) break;
+    size_t word_len = strcspn(s, " ");
 
-    if (lines[lineIdx].length() == 0) {
-      lines[lineIdx] = word;
-    } else {
+    if (m.line[lineIdx].length() == 0) {
+      m.line[lineIdx].appendf("%.*s", (int)word_len, s);
+    } else if (m.line[lineIdx].length() + 1 + word_len <= 18) {
       // Try to append to current line if reasonable (max ~18 chars)
-      if (lines[lineIdx].length() + 1 + word.length() <= 18) {
-        lines[lineIdx] += " ";
-        lines[lineIdx] += word;
-      } else {
-        lineIdx++;
-        if (lineIdx < 3) lines[lineIdx] = word;
-      }
+      m.line[lineIdx].appendf(" %.*s", (int)word_len, s);
+    } else {
+      lineIdx++;
+      if (lineIdx < 3) m.line[lineIdx].appendf("%.*s", (int)word_len, s);
     }
+    s += word_len;
   }
-
-  oled_display.clear();
-  oled_display.setFont(ArialMT_Plain_16);
-  oled_display.setTextAlignment(TEXT_ALIGN_CENTER);
-  int y0 = 6;
-  if (lines[0].length() > 0) oled_display.drawString(64, y0, lines[0]);
-  if (lines[1].length() > 0) oled_display.drawString(64, y0 + 20, lines[1]);
-  if (lines[2].length() > 0) oled_display.drawString(64, y0 + 40, lines[2]);
-  oled_display.display();
-}
\ No newline at end of file
+  display_post(&m);
+}
@@ -7,16 +7,56 @@
 // Declaración del objeto display
 extern SSD1306Wire oled_display;
 
+// Las funciones display_oled_* no dibujan: encolan el mensaje para la tarea
+// Display y retornan sin esperar al bus I2C. hold_ms es el tiempo mínimo en
+// pantalla (antes se lograba con delay() en quien llamaba); los mensajes
+// siguientes esperan su turno. Un mensaje sin hold_ms que ya fue reemplazado
+// por otro en la cola se descarta sin dibujarse. Los avisos (hold_ms > 0) y
+// display_wake() encienden el panel si estaba apagado por inactividad; las
+// actualizaciones periódicas sólo cambian el contenido.
+#define DISPLAY_QUEUE_LEN       6
+#define DISPLAY_IDLE_OFF_MS     60000   // Modo continuo: apagar el panel tras 1 min sin eventos
+#define DISPLAY_DRAIN_MAX_MS    5000    // Espera máxima antes de dormir o reiniciar
+
 // Funciones de inicialización
 void VextON();
 void VextOFF();
+// Enciende el panel y crea la tarea Display
 void init_display();
+// Alternativa a init_display() para despertares sin pantalla: corta Vext sin
+// esperas ni inicializar el panel. Sin la tarea Display, todas las funciones
+// display_* (mensajes, wake, drain) retornan de inmediato sin hacer nada.
+void display_headless();
+
+// Envía al panel sólo las páginas/columnas que cambiaron desde el último envío
+// (nada si el frame es idéntico). Sólo desde la tarea Display.
+void display_flush();
+
+// Evento de usuario (botón, puerta): enciende el panel y reinicia la inactividad
+void display_wake();
+
+// Apagado por inactividad (0 = nunca)
+void display_set_idle_off(uint32_t ms);
+
+// Espera a que se muestren los mensajes pendientes (antes de dormir o reiniciar).
+// Retorna false si venció timeout_ms.
+bool display_drain(uint32_t timeout_ms);
+
+typedef struct {
+  uint32_t frames;
+  uint32_t skipped;             // Frames sin cambios (no se transmitió nada)
+  uint32_t last_bytes;          // Bytes I2C del último frame (comandos + datos)
+  uint32_t bytes_total;
+  uint32_t coalesced;           // Mensajes reemplazados antes de mostrarse
+} display_stats_t;
+
+void display_get_stats(display_stats_t* out);
 
-// Funciones de visualización
-void display_oled_message_3_line(String line_1, String line_2, String line_3);
-void display_oled_message_2_line(String line_1, String line_2);
-void display_oled_ap_info(const String &ssid, const String &ip, const String &mac);
+// Funciones de visualización (texto en buffers fijos: ver display_line_t en config.h)
+void display_oled_message_3_line(const char* line_1, const char* line_2, const char* line_3, uint16_t hold_ms = 0);
+void display_oled_message_2_line(const char* line_1, const char* line_2, uint16_t hold_ms = 0);
+void display_oled_ap_info(const char* ssid, const char* ip, const char* mac);
 // Mostrar un mensaje largo dividiendo por palabras en hasta 3 líneas y adaptando fuente
-void display_oled_wrap_message(const String &msg);
+void display_oled_wrap_message(const char* msg, uint16_t hold_ms = 0);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "door_events.h"
+#include "moe_log.h"
+#include "config.h"
+#include "task_config.h"
+#include "esp_timer.h"
+#include "hal/gpio_ll.h"
+#include "driver/gpio.h"
+#include "esp_sleep.h"
+#include <atomic>
+
+// Flanco capturado en la ISR
+typedef struct {
+  uint32_t t_us;
+  uint8_t level;
+} door_edge_t;
+
+// Anillo SPSC: la ISR sólo escribe door_head y la tarea sólo door_tail.
+// Los índices crecen libremente; la posición es índice & (DOOR_RING_SIZE - 1).
+static door_edge_t door_ring[DOOR_RING_SIZE];
+static std::atomic<uint32_t> door_head(0);
+static std::atomic<uint32_t> door_tail(0);
+static std::atomic<uint32_t> door_ring_dropped(0);
+
+static TaskHandle_t door_task_handle = NULL;
+static QueueHandle_t door_q = NULL;
+static SemaphoreHandle_t door_notify = NULL;
+static door_stats_t door_stats;
+static volatile int door_state = -1;
+
+// Interrupción por nivel con polaridad alternada: se arma para el nivel
+// opuesto al actual, así cada disparo es un flanco y, a diferencia de una
+// interrupción por flanco, también despierta del light sleep (GPIO wakeup).
+static void IRAM_ATTR door_isr(void* arg)
+{
+  uint32_t t = (uint32_t)esp_timer_get_time();
+  uint8_t level = gpio_ll_get_level(&GPIO, (gpio_num_t)DOOR_SENSOR_PIN);
+  gpio_ll_set_intr_type(&GPIO, (gpio_num_t)DOOR_SENSOR_PIN, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+  uint32_t head = door_head.load(std::memory_order_relaxed);
+  if (head - door_tail.load(std::memory_order_acquire) >= DOOR_RING_SIZE) {
+    door_ring_dropped.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    door_ring[head & (DOOR_RING_SIZE - 1)] = { t, level };
+    door_head.store(head + 1, std::memory_order_release);
+  }
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(door_task_handle, &woken);
+  if (woken) portYIELD_FROM_ISR();
+}
+
+static void door_publish(uint8_t state, uint32_t t_us)
+{
+  door_event_t ev;
+  ev.state = state;
+  ev.t_us = t_us;
+  ev.latency_us = (uint32_t)esp_timer_get_time() - t_us;
+  door_stats.last_latency_us = ev.latency_us;
+  if (xQueueSend(door_q, &ev, 0) == pdTRUE) {
+    door_stats.events++;
+    if (door_notify) xSemaphoreGive(door_notify);
+  } else {
+    door_stats.events_dropped++;
+  }
+}
+
+// Ráfaga de flancos en curso. El nivel estable publicado es door_state.
+typedef struct {
+  bool active;
+  uint32_t start_us;            // Primer flanco
+  uint32_t last_us;             // Último flanco
+  uint8_t level;                // Nivel del último flanco
+  uint32_t opposite_since;      // Inicio del tramo actual con el nivel opuesto al estable
+  uint32_t opposite_max_us;     // Tramo opuesto más largo de la ráfaga
+} door_burst_t;
+
+static void door_add_edge(door_burst_t* b, const door_edge_t* e, uint8_t stable)
+{
+  door_stats.edges++;
+  if (!b->active) {
+    *b = { true, e->t_us, e->t_us, stable, 0, 0 };
+  } else if (e->level == b->level) {
+    // Dos flancos seguidos con el mismo nivel: falta el intermedio
+    door_stats.edges_missed++;
+  }
+  if (e->level != b->level) {
+    if (e->level != stable) {
+      b->opposite_since = e->t_us;
+    } else if (e->t_us - b->opposite_since > b->opposite_max_us) {
+      b->opposite_max_us = e->t_us - b->opposite_since;
+    }
+  }
+  b->level = e->level;
+  b->last_us = e->t_us;
+}
+
+// La ráfaga terminó: el pin decide el estado; sin cambio, un tramo opuesto
+// suficientemente largo fue un pulso real y no un rebote
+static void door_settle(door_burst_t* b)
+{
+  uint8_t stable = (uint8_t)door_state;
+  uint8_t level = digitalRead(DOOR_SENSOR_PIN) == HIGH ? 1 : 0;
+  b->active = false;
+  if (level != stable) {
+    door_state = level;
+    door_publish(level, b->start_us);
+  } else if (b->opposite_max_us >= DOOR_PULSE_MIN_MS * 1000UL) {
+    door_stats.pulses++;
+    door_publish(!stable, b->start_us);
+    door_publish(stable, b->last_us);
+  } else {
+    door_stats.bounces++;
+  }
+}
+
+static void door_task(void* arg)
+{
+  door_burst_t burst = {};
+  for (;;) {
+    TickType_t wait = portMAX_DELAY;
+    if (burst.active) {
+      uint32_t now = (uint32_t)esp_timer_get_time();
+      uint32_t quiet = (now - burst.last_us) / 1000;
+      uint32_t total = (now - burst.start_us) / 1000;
+      uint32_t left = quiet >= DOOR_DEBOUNCE_MS ? 0 : DOOR_DEBOUNCE_MS - quiet;
+      if (total >= DOOR_BURST_MAX_MS) left = 0;
+      wait = pdMS_TO_TICKS(left);
+      if (left && !wait) wait = 1;
+    }
+    ulTaskNotifyTake(pdTRUE, wait);
+
+    uint32_t tail = door_tail.load(std::memory_order_relaxed);
+    uint32_t head = door_head.load(std::memory_order_acquire);
+    while (tail != head) {
+      door_edge_t e = door_ring[tail & (DOOR_RING_SIZE - 1)];
+      door_tail.store(++tail, std::memory_order_release);
+      door_add_edge(&burst, &e, (uint8_t)door_state);
+    }
+
+    if (burst.active) {
+      uint32_t now = (uint32_t)esp_timer_get_time();
+      if ((now - burst.last_us) / 1000 >= DOOR_DEBOUNCE_MS || (now - burst.start_us) / 1000 >= DOOR_BURST_MAX_MS) {
+        door_settle(&burst);
+      }
+    }
+  }
+}
+
+void door_events_begin()
+{
+  if (door_task_handle) return;
+  door_state = digitalRead(DOOR_SENSOR_PIN) == HIGH ? 1 : 0;
+  door_q = xQueueCreate(DOOR_EVENT_QUEUE_LEN, sizeof(door_event_t));
+  task_spawn(TASK_DOOR, door_task, NULL, &door_task_handle);
+  if (!door_q || !door_task_handle) {
+    MLOGE("[DOOR] No se pudo crear la tarea o la cola de eventos");
+    return;
+  }
+  gpio_num_t pin = (gpio_num_t)DOOR_SENSOR_PIN;
+  gpio_install_isr_service(0);          // ESP_ERR_INVALID_STATE si ya estaba (attachInterrupt)
+  gpio_isr_handler_add(pin, door_isr, NULL);
+  gpio_wakeup_enable(pin, door_state ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  gpio_intr_enable(pin);
+  MLOGI("[DOOR] Interrupción de puerta activa (estado inicial %d)", (int)door_state);
+}
+
+void door_events_stop()
+{
+  if (!door_task_handle) return;
+  gpio_num_t pin = (gpio_num_t)DOOR_SENSOR_PIN;
+  gpio_intr_disable(pin);
+  gpio_wakeup_disable(pin);
+  gpio_isr_handler_remove(pin);
+}
+
+bool door_event_wait(door_event_t* ev, uint32_t timeout_ms)
+{
+  if (!door_q) {
+    delay(timeout_ms);
+    return false;
+  }
+  return xQueueReceive(door_q, ev, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
+
+void door_events_notify(SemaphoreHandle_t sem)
+{
+  door_notify = sem;
+}
+
+int door_events_state()
+{
+  return door_state;
+}
+
+void door_events_get_stats(door_stats_t* out)
+{
+  *out = door_stats;
+  out->ring_dropped = door_ring_dropped.load(std::memory_order_relaxed);
+}
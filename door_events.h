@@ -0,0 +1,61 @@
+#ifndef DOOR_EVENTS_H
+#define DOOR_EVENTS_H
+
+#include <Arduino.h>
+
+// Detección de la puerta por interrupción (modo continuo). La ISR (por nivel,
+// con la polaridad alternada en cada disparo para que también despierte del
+// light sleep) captura cada flanco (nivel + esp_timer_get_time) en un anillo
+// SPSC sin bloqueo y despierta a la tarea Door, que agrupa los rebotes: el
+// estado se da por estable tras DOOR_DEBOUNCE_MS sin flancos (o
+// DOOR_BURST_MAX_MS de vibración continua) y se toma del pin. Un pulso corto que vuelve al estado
+// anterior, pero que se mantuvo al menos DOOR_PULSE_MIN_MS, genera los dos
+// eventos (apertura y cierre) en lugar de perderse. Los eventos limpios se
+// consumen con door_event_wait() (pantalla, métricas OTA y POST).
+//
+// Pérdidas: anillo lleno (flancos descartados en la ISR), flancos
+// consecutivos con el mismo nivel (se perdió uno intermedio) y cola de
+// eventos llena.
+
+#define DOOR_RING_SIZE          32      // Potencia de 2
+#define DOOR_EVENT_QUEUE_LEN    8
+#define DOOR_DEBOUNCE_MS        30
+#define DOOR_BURST_MAX_MS       500
+#define DOOR_PULSE_MIN_MS       10
+
+typedef struct {
+  uint8_t state;                // 1 = abierta, 0 = cerrada
+  uint32_t t_us;                // esp_timer del primer flanco (32 bits bajos)
+  uint32_t latency_us;          // Del flanco a la publicación del evento
+} door_event_t;
+
+typedef struct {
+  uint32_t edges;               // Flancos procesados
+  uint32_t ring_dropped;        // Flancos descartados por anillo lleno
+  uint32_t edges_missed;        // Flancos repetidos (uno intermedio se perdió)
+  uint32_t bounces;             // Ráfagas descartadas sin cambio de estado
+  uint32_t pulses;              // Pulsos cortos entregados como apertura + cierre
+  uint32_t events;
+  uint32_t events_dropped;      // Cola de eventos llena
+  uint32_t last_latency_us;
+} door_stats_t;
+
+// Lee el estado inicial, crea la tarea y la cola e instala la ISR en ambos flancos
+void door_events_begin();
+
+// Quita la ISR y el despertar por GPIO (antes del deep sleep: la puerta pasa a EXT0)
+void door_events_stop();
+
+// Espera el próximo evento limpio hasta timeout_ms. Retorna false si no hubo.
+bool door_event_wait(door_event_t* ev, uint32_t timeout_ms);
+
+// Semáforo que se da después de publicar cada evento (fuente del bucle de
+// app_sched; NULL = ninguno)
+void door_events_notify(SemaphoreHandle_t sem);
+
+// Último estado estable (el de los eventos ya publicados)
+int door_events_state();
+
+void door_events_get_stats(door_stats_t* out);
+
+#endif
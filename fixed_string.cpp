@@ -0,0 +1,34 @@
+#include "fixed_string.h"
+#include <stdint.h>
+#include <stdio.h>
+
+size_t fixed_utf8_trim(const char* buf, size_t start, size_t end)
+{
+  if (end <= start) return end;
+  // Inicio del último carácter
+  size_t k = end - 1;
+  while (k > start && ((uint8_t)buf[k] & 0xC0) == 0x80) k--;
+  uint8_t lead = (uint8_t)buf[k];
+  size_t need = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+  return end - k < need ? k : end;
+}
+
+bool fixed_vappendf(char* buf, size_t cap, size_t* len, const char* fmt, va_list args)
+{
+  size_t used = *len;
+  if (used >= cap) return false;
+  int n = vsnprintf(buf + used, cap - used, fmt, args);
+  if (n < 0) {
+    buf[used] = '\0';
+    return false;
+  }
+  if ((size_t)n >= cap - used) {
+    // Truncado: no dejar un carácter UTF-8 a medias al final
+    size_t end = fixed_utf8_trim(buf, used, cap - 1);
+    buf[end] = '\0';
+    *len = end;
+    return false;
+  }
+  *len = used + (size_t)n;
+  return true;
+}
@@ -0,0 +1,91 @@
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+// Cadena de capacidad fija para el estado de sensores, pantalla y logs.
+// El buffer vive dentro del objeto (global, estático o en pila): asignar o
+// formatear nunca reserva heap, así las actualizaciones periódicas no
+// fragmentan la memoria. Si el texto no cabe se trunca (siempre termina en
+// '\0') y truncated() lo indica. No depende de Arduino.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+
+// Formatea en buf[cap] a partir de *len (append) y actualiza *len.
+// Retorna false si el resultado se truncó.
+bool fixed_vappendf(char* buf, size_t cap, size_t* len, const char* fmt, va_list args);
+
+// Fin ajustado de buf[start, end) para no cortar un carácter UTF-8 multibyte
+size_t fixed_utf8_trim(const char* buf, size_t start, size_t end);
+
+template <size_t N>
+class FixedString {
+public:
+  FixedString() { clear(); }
+  FixedString(const char* s) { set(s); }
+
+  FixedString &operator=(const char* s) { set(s); return *this; }
+
+  void clear()
+  {
+    buf_[0] = '\0';
+    len_ = 0;
+    truncated_ = false;
+  }
+
+  void set(const char* s)
+  {
+    clear();
+    append(s);
+  }
+
+  void append(const char* s)
+  {
+    if (!s) return;
+    size_t n = strlen(s);
+    size_t end = len_ + n;
+    if (n > N - len_) {
+      memcpy(buf_ + len_, s, N - len_);
+      end = fixed_utf8_trim(buf_, len_, N);
+      truncated_ = true;
+    } else {
+      memcpy(buf_ + len_, s, n);
+    }
+    len_ = end;
+    buf_[len_] = '\0';
+  }
+
+  // Reemplaza el contenido con el texto formateado (semántica de snprintf)
+  void format(const char* fmt, ...) __attribute__((format(printf, 2, 3)))
+  {
+    clear();
+    va_list args;
+    va_start(args, fmt);
+    truncated_ = !fixed_vappendf(buf_, N + 1, &len_, fmt, args);
+    va_end(args);
+  }
+
+  void appendf(const char* fmt, ...) __attribute__((format(printf, 2, 3)))
+  {
+    va_list args;
+    va_start(args, fmt);
+    if (!fixed_vappendf(buf_, N + 1, &len_, fmt, args)) truncated_ = true;
+    va_end(args);
+  }
+
+  const char* c_str() const { return buf_; }
+  operator const char*() const { return buf_; }
+  size_t length() const { return len_; }
+  static constexpr size_t capacity() { return N; }
+  bool truncated() const { return truncated_; }
+
+  bool operator==(const char* s) const { return s && strcmp(buf_, s) == 0; }
+  bool operator!=(const char* s) const { return !(*this == s); }
+
+private:
+  char buf_[N + 1];
+  size_t len_;
+  bool truncated_;
+};
+
+#endif
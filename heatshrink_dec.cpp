@@ -0,0 +1,142 @@
+#include "heatshrink_dec.h"
+#include <string.h>
+
+enum {
+  HS_S_TAG = 0,
+  HS_S_LITERAL,
+  HS_S_INDEX,
+  HS_S_COUNT,
+  HS_S_DONE,
+  HS_S_ERROR
+};
+
+static bool hs_fail(hs_decoder_t* d, const char* msg)
+{
+  d->error = msg;
+  d->state = HS_S_ERROR;
+  return false;
+}
+
+static bool hs_flush(hs_decoder_t* d)
+{
+  if (d->out_len == 0) return true;
+  if (!d->write(d->ctx, d->out, d->out_len)) return hs_fail(d, "error escribiendo salida");
+  d->out_len = 0;
+  return true;
+}
+
+static bool hs_emit(hs_decoder_t* d, uint8_t b)
+{
+  if (d->remaining == 0) return hs_fail(d, "datos exceden el tamano original");
+  uint16_t mask = (uint16_t)((1u << d->window_bits) - 1);
+  d->window[d->head] = b;
+  d->head = (uint16_t)((d->head + 1) & mask);
+  d->out[d->out_len++] = b;
+  d->remaining--;
+  d->produced++;
+  if (d->out_len == HS_OUT_CHUNK && !hs_flush(d)) return false;
+  if (d->remaining == 0) {
+    if (!hs_flush(d)) return false;
+    d->state = HS_S_DONE;
+  }
+  return true;
+}
+
+static void hs_expect(hs_decoder_t* d, uint8_t state, uint8_t bits)
+{
+  d->state = state;
+  d->need = bits;
+  d->have = 0;
+  d->acc = 0;
+}
+
+bool hs_decoder_init(hs_decoder_t* d, uint8_t window_bits, uint8_t lookahead_bits,
+                     uint8_t* window, uint32_t out_size, hs_write_fn write, void* ctx)
+{
+  memset(d, 0, sizeof(*d));
+  if (window_bits < HS_MIN_WINDOW_BITS || window_bits > HS_MAX_WINDOW_BITS) return hs_fail(d, "window_bits fuera de rango");
+  if (lookahead_bits < 3 || lookahead_bits >= window_bits) return hs_fail(d, "lookahead_bits fuera de rango");
+  d->window_bits = window_bits;
+  d->lookahead_bits = lookahead_bits;
+  d->window = window;
+  d->remaining = out_size;
+  d->write = write;
+  d->ctx = ctx;
+  memset(window, 0, (size_t)1 << window_bits);
+  if (out_size == 0) {
+    d->state = HS_S_DONE;
+  } else {
+    hs_expect(d, HS_S_TAG, 1);
+  }
+  return true;
+}
+
+// Procesa un campo completo (acc contiene d->need bits)
+static bool hs_field(hs_decoder_t* d)
+{
+  switch (d->state)
+  {
+    case HS_S_TAG:
+      if (d->acc) hs_expect(d, HS_S_LITERAL, 8);
+      else hs_expect(d, HS_S_INDEX, d->window_bits);
+      return true;
+
+    case HS_S_LITERAL:
+      if (!hs_emit(d, (uint8_t)d->acc)) return false;
+      if (d->state != HS_S_DONE) hs_expect(d, HS_S_TAG, 1);
+      return true;
+
+    case HS_S_INDEX:
+      d->index = d->acc;
+      hs_expect(d, HS_S_COUNT, d->lookahead_bits);
+      return true;
+
+    case HS_S_COUNT: {
+      uint16_t mask = (uint16_t)((1u << d->window_bits) - 1);
+      uint16_t dist = (uint16_t)(d->index + 1);
+      uint16_t count = (uint16_t)(d->acc + 1);
+      // El codificador nunca referencia antes del inicio: es un flujo corrupto
+      if (dist > d->produced) return hs_fail(d, "referencia antes del inicio");
+      for (uint16_t k = 0; k < count; k++) {
+        uint8_t b = d->window[(uint16_t)(d->head - dist) & mask];
+        if (!hs_emit(d, b)) return false;
+        if (d->state == HS_S_DONE) {
+          if (k + 1 != count) return hs_fail(d, "referencia excede el tamano original");
+          return true;
+        }
+      }
+      hs_expect(d, HS_S_TAG, 1);
+      return true;
+    }
+
+    default:
+      return false;
+  }
+}
+
+bool hs_decoder_feed(hs_decoder_t* d, const uint8_t* data, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    if (d->state == HS_S_DONE) {
+      // Sólo se admite el relleno del último byte; bytes adicionales son un error
+      return hs_fail(d, "datos despues del final");
+    }
+    if (d->state == HS_S_ERROR) return false;
+
+    uint8_t byte = data[i];
+    for (int bit = 7; bit >= 0; bit--)
+    {
+      d->acc = (uint16_t)((d->acc << 1) | ((byte >> bit) & 1));
+      if (++d->have < d->need) continue;
+      if (!hs_field(d)) return false;
+      if (d->state == HS_S_DONE) break;
+    }
+  }
+  return true;
+}
+
+bool hs_decoder_done(const hs_decoder_t* d)
+{
+  return d->state == HS_S_DONE;
+}
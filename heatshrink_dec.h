@@ -0,0 +1,48 @@
+#ifndef HEATSHRINK_DEC_H
+#define HEATSHRINK_DEC_H
+
+// Decodificador heatshrink (LZSS) en streaming, compatible con el formato de
+// heatshrink_encoder (bits MSB primero; 1 = literal de 8 bits, 0 = referencia
+// index(W bits) + count(L bits), distancia index+1 y longitud count+1).
+// No depende de Arduino: la salida se entrega por callback y la ventana de
+// 2^window_bits bytes la provee el llamador, así la RAM queda acotada.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HS_MIN_WINDOW_BITS  4
+#define HS_MAX_WINDOW_BITS  12
+#define HS_OUT_CHUNK        128
+
+typedef bool (*hs_write_fn)(void* ctx, const uint8_t* buf, size_t len);
+
+typedef struct {
+  uint8_t window_bits;
+  uint8_t lookahead_bits;
+  uint8_t* window;              // 2^window_bits bytes, provisto por el llamador
+  uint16_t head;                // Próxima posición de escritura en la ventana
+  uint8_t state;
+  uint8_t need;                 // Bits requeridos por el campo en curso
+  uint8_t have;                 // Bits acumulados del campo en curso
+  uint16_t acc;                 // Acumulador de bits
+  uint16_t index;
+  uint32_t remaining;           // Bytes de salida pendientes (tamaño original)
+  uint32_t produced;            // Bytes ya entregados: ninguna referencia llega más atrás
+  hs_write_fn write;
+  void* ctx;
+  uint8_t out[HS_OUT_CHUNK];
+  uint16_t out_len;
+  const char* error;
+} hs_decoder_t;
+
+// Retorna false si los parámetros están fuera de rango
+bool hs_decoder_init(hs_decoder_t* d, uint8_t window_bits, uint8_t lookahead_bits,
+                     uint8_t* window, uint32_t out_size, hs_write_fn write, void* ctx);
+
+// Consume datos comprimidos. Retorna false ante un error (ver d->error).
+bool hs_decoder_feed(hs_decoder_t* d, const uint8_t* data, size_t len);
+
+// true cuando se produjeron out_size bytes
+bool hs_decoder_done(const hs_decoder_t* d);
+
+#endif
@@ -0,0 +1,336 @@
+#include "history_store.h"
+#include "moe_log.h"
+#include <LittleFS.h>
+#include "freertos/semphr.h"
+
+#define HISTORY_FILE          "/history.bin"
+#define HISTORY_TMP_FILE      "/history.tmp"
+#define HISTORY_MAGIC         0x31484F4DUL          // "MOH1"
+#define HISTORY_FLUSH_MS      (15UL * 60UL * 1000UL)   // Guardado periódico en modo continuo
+#define HISTORY_QUERY_BATCH   16
+#define HISTORY_MIN_EPOCH     1600000000UL          // Antes de esto la hora no está sincronizada
+#define HISTORY_RTC_MAGIC     0x314A484DUL          // "MHJ1"
+#define HISTORY_JOURNAL_LEN   32                    // Muestras en RTC antes de volcar (~5 h a 10 min)
+#define HISTORY_JOURNAL_AGE_S (6UL * 3600UL)        // Antigüedad máxima de una muestra sin volcar
+
+typedef struct {
+  uint32_t width;                 // Segundos por bucket
+  uint16_t capacity;
+  uint16_t head;                  // Índice del bucket más reciente
+  uint16_t count;
+  history_bucket_t* buckets;
+} history_level_t;
+
+// Cobertura: crudo ~10 min en modo continuo (muestra cada 5 s), 2 h a 1 min,
+// 7 días a 15 min y 14 días a 1 h. ~45 KB en total.
+static history_bucket_t level_raw[128];
+static history_bucket_t level_1m[120];
+static history_bucket_t level_15m[672];
+static history_bucket_t level_1h[336];
+
+static history_level_t levels[HISTORY_LEVELS] = {
+  { 1,    128, 0, 0, level_raw },
+  { 60,   120, 0, 0, level_1m  },
+  { 900,  672, 0, 0, level_15m },
+  { 3600, 336, 0, 0, level_1h  },
+};
+
+// Muestras de los despertares desde el último volcado. En deep sleep los anillos
+// no se cargan: cada muestra va a este diario en RTC y el snapshot se lee, se
+// completa y se reescribe sólo cuando el diario se llena o envejece.
+typedef struct {
+  uint32_t ts;
+  int16_t value[HISTORY_SERIES];
+  uint8_t valid;                  // Bit s = la serie s tiene dato
+  int8_t door;
+} history_pending_t;
+
+typedef struct {
+  uint32_t magic;
+  uint8_t count;
+  history_pending_t s[HISTORY_JOURNAL_LEN];
+} history_rtc_t;
+
+RTC_DATA_ATTR static history_rtc_t hist_rtc;
+
+static int8_t hist_last_door = -1;
+static bool hist_loaded = false;          // Anillos en RAM al día con el snapshot
+static bool hist_dirty = false;
+static unsigned long hist_last_flush = 0;
+static bool hist_fs_ok = false;
+static SemaphoreHandle_t hist_mutex = NULL;
+
+// k = 0 es el bucket más antiguo
+static history_bucket_t* history_at(history_level_t &lv, uint16_t k)
+{
+  return &lv.buckets[(lv.head + lv.capacity - lv.count + 1 + k) % lv.capacity];
+}
+
+// Bucket que contiene ts (lo crea si es el siguiente). NULL si ts es anterior al bucket actual.
+static history_bucket_t* history_bucket_for(history_level_t &lv, uint32_t ts)
+{
+  uint32_t start = ts - ts % lv.width;
+  if (lv.count > 0) {
+    history_bucket_t* newest = &lv.buckets[lv.head];
+    if (newest->start == start) return newest;
+    if (start < newest->start) return NULL;
+    lv.head = (lv.head + 1) % lv.capacity;
+  } else {
+    lv.head = 0;
+  }
+  if (lv.count < lv.capacity) lv.count++;
+
+  history_bucket_t* b = &lv.buckets[lv.head];
+  memset(b, 0, sizeof(*b));
+  b->start = start;
+  for (int s = 0; s < HISTORY_SERIES; s++) {
+    b->min[s] = INT16_MAX;
+    b->max[s] = INT16_MIN;
+  }
+  return b;
+}
+
+static void history_merge(history_bucket_t* into, const history_bucket_t* from)
+{
+  for (int s = 0; s < HISTORY_SERIES; s++) {
+    if (from->n[s] == 0) continue;
+    if (from->min[s] < into->min[s]) into->min[s] = from->min[s];
+    if (from->max[s] > into->max[s]) into->max[s] = from->max[s];
+    into->sum[s] += from->sum[s];
+    into->n[s] += from->n[s];
+  }
+  into->opens += from->opens;
+}
+
+static bool history_load()
+{
+  File f = LittleFS.open(HISTORY_FILE, "r");
+  // Sin el snapshot, el temporal de un guardado completo al que le faltó el rename
+  if (!f) f = LittleFS.open(HISTORY_TMP_FILE, "r");
+  if (!f) return false;
+  uint32_t magic = 0;
+  bool ok = f.read((uint8_t*)&magic, sizeof(magic)) == sizeof(magic) && magic == HISTORY_MAGIC;
+  ok = ok && f.read((uint8_t*)&hist_last_door, sizeof(hist_last_door)) == sizeof(hist_last_door);
+  for (int l = 0; ok && l < HISTORY_LEVELS; l++) {
+    history_level_t &lv = levels[l];
+    uint16_t hdr[3];
+    ok = f.read((uint8_t*)hdr, sizeof(hdr)) == sizeof(hdr) && hdr[0] == lv.capacity && hdr[1] < lv.capacity && hdr[2] <= lv.capacity;
+    if (!ok) break;
+    lv.head = hdr[1];
+    lv.count = hdr[2];
+    size_t bytes = lv.capacity * sizeof(history_bucket_t);
+    ok = f.read((uint8_t*)lv.buckets, bytes) == bytes;
+  }
+  f.close();
+  if (!ok) {
+    // Snapshot de otra versión o truncado: empezar vacío
+    for (int l = 0; l < HISTORY_LEVELS; l++) levels[l].head = levels[l].count = 0;
+    hist_last_door = -1;
+  }
+  return ok;
+}
+
+void history_begin()
+{
+  if (hist_mutex) return;
+  hist_mutex = xSemaphoreCreateMutex();
+  if (hist_rtc.magic != HISTORY_RTC_MAGIC || hist_rtc.count > HISTORY_JOURNAL_LEN) {
+    memset(&hist_rtc, 0, sizeof(hist_rtc));
+    hist_rtc.magic = HISTORY_RTC_MAGIC;
+  }
+  hist_fs_ok = LittleFS.begin();
+  if (!hist_fs_ok) MLOGW("[HISTORY] LittleFS no disponible: historial sólo en RAM");
+  hist_last_flush = millis();
+}
+
+// Agrega una muestra a los cuatro niveles. Se llama con el mutex tomado.
+static void history_apply(uint32_t ts, const int16_t* value, uint8_t valid, int8_t door_state)
+{
+  // Sólo los cambios de estado cuentan como evento de puerta
+  bool opened = (door_state == 1 && hist_last_door == 0);
+  if (door_state >= 0) hist_last_door = door_state;
+  for (int l = 0; l < HISTORY_LEVELS; l++) {
+    history_bucket_t* b = history_bucket_for(levels[l], ts);
+    if (!b) continue;
+    for (int s = 0; s < HISTORY_SERIES; s++) {
+      if (!(valid & (1 << s))) continue;
+      if (value[s] < b->min[s]) b->min[s] = value[s];
+      if (value[s] > b->max[s]) b->max[s] = value[s];
+      b->sum[s] += value[s];
+      b->n[s]++;
+    }
+    if (opened) b->opens++;
+  }
+  hist_dirty = true;
+}
+
+// Carga el snapshot (una vez) y le aplica el diario RTC. Se llama con el mutex tomado.
+static void history_ensure_loaded()
+{
+  if (hist_loaded) return;
+  hist_loaded = true;
+  bool loaded = hist_fs_ok && history_load();
+  for (uint8_t i = 0; i < hist_rtc.count; i++) {
+    const history_pending_t &p = hist_rtc.s[i];
+    history_apply(p.ts, p.value, p.valid, p.door);
+  }
+  MLOGI("[HISTORY] Snapshot %s + %u muestras del diario (15min=%u, 1h=%u buckets)", loaded ? "cargado" : "no encontrado",
+                hist_rtc.count, levels[2].count, levels[3].count);
+  hist_rtc.count = 0;
+}
+
+void history_add_sample(time_t ts, float temp_c, float humidity_pct, int battery_pct, int door_state)
+{
+  if (!hist_mutex || ts < (time_t)HISTORY_MIN_EPOCH) return;
+
+  uint8_t valid = (!isnan(temp_c) ? 1 : 0) | (!isnan(humidity_pct) ? 2 : 0) | (battery_pct >= 0 ? 4 : 0);
+  int16_t value[HISTORY_SERIES] = {
+    (valid & 1) ? (int16_t)lroundf(temp_c * 10) : (int16_t)0,
+    (valid & 2) ? (int16_t)lroundf(humidity_pct * 10) : (int16_t)0,
+    (int16_t)battery_pct
+  };
+  int8_t door = door_state >= 0 ? (int8_t)door_state : (int8_t)-1;
+  xSemaphoreTake(hist_mutex, portMAX_DELAY);
+  bool sync = false;
+  // Diario lleno sin volcar (p. ej. sin LittleFS): pasa a los anillos en RAM
+  if (!hist_loaded && hist_rtc.count >= HISTORY_JOURNAL_LEN) history_ensure_loaded();
+  if (hist_loaded) {
+    history_apply((uint32_t)ts, value, valid, door);
+  } else {
+    history_pending_t &p = hist_rtc.s[hist_rtc.count++];
+    p.ts = (uint32_t)ts;
+    memcpy(p.value, value, sizeof(p.value));
+    p.valid = valid;
+    p.door = door;
+    sync = hist_rtc.count >= HISTORY_JOURNAL_LEN;
+  }
+  xSemaphoreGive(hist_mutex);
+
+  if (sync || (hist_loaded && millis() - hist_last_flush >= HISTORY_FLUSH_MS)) history_flush();
+}
+
+void history_flush()
+{
+  if (!hist_mutex || !hist_fs_ok) return;
+  xSemaphoreTake(hist_mutex, portMAX_DELAY);
+  if (!hist_loaded) {
+    // El diario sobrevive al deep sleep: se vuelca sólo si está lleno o envejeció
+    uint8_t n = hist_rtc.count;
+    bool due = n >= HISTORY_JOURNAL_LEN || (n > 0 && hist_rtc.s[n - 1].ts - hist_rtc.s[0].ts >= HISTORY_JOURNAL_AGE_S);
+    if (due) history_ensure_loaded();
+  }
+  if (!hist_dirty) {
+    xSemaphoreGive(hist_mutex);
+    return;
+  }
+  // Se escribe a un temporal y se renombra: un corte de energía no deja el snapshot a medias
+  File f = LittleFS.open(HISTORY_TMP_FILE, "w");
+  bool ok = (bool)f;
+  if (ok) {
+    uint32_t magic = HISTORY_MAGIC;
+    f.write((const uint8_t*)&magic, sizeof(magic));
+    f.write((const uint8_t*)&hist_last_door, sizeof(hist_last_door));
+    for (int l = 0; l < HISTORY_LEVELS; l++) {
+      const history_level_t &lv = levels[l];
+      uint16_t hdr[3] = { lv.capacity, lv.head, lv.count };
+      size_t bytes = lv.capacity * sizeof(history_bucket_t);
+      ok = ok && f.write((const uint8_t*)hdr, sizeof(hdr)) == sizeof(hdr);
+      ok = ok && f.write((const uint8_t*)lv.buckets, bytes) == bytes;
+    }
+    f.close();
+  }
+  // rename de LittleFS reemplaza el destino de forma atómica
+  if (ok) ok = LittleFS.rename(HISTORY_TMP_FILE, HISTORY_FILE);
+  if (ok) hist_dirty = false;
+  hist_last_flush = millis();
+  xSemaphoreGive(hist_mutex);
+  if (!ok) MLOGE("[HISTORY] ERROR guardando snapshot");
+}
+
+static bool history_covers(history_level_t &lv, uint32_t from)
+{
+  return lv.count > 0 && history_at(lv, 0)->start <= from;
+}
+
+// Nivel más grueso con ancho <= step que cubra from; si ninguno, el más fino que
+// lo cubra; si tampoco, el de mayor historia.
+static int history_pick_level(uint32_t from, uint32_t step)
+{
+  for (int l = HISTORY_LEVELS - 1; l >= 0; l--) {
+    if (levels[l].width <= step && history_covers(levels[l], from)) return l;
+  }
+  for (int l = 0; l < HISTORY_LEVELS; l++) {
+    if (history_covers(levels[l], from)) return l;
+  }
+  return HISTORY_LEVELS - 1;
+}
+
+// Primer bucket que termina después de cursor (búsqueda binaria; el anillo está ordenado)
+static uint16_t history_lower_bound(history_level_t &lv, uint32_t cursor)
+{
+  uint16_t lo = 0, hi = lv.count;
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+    if (history_at(lv, mid)->start + lv.width > cursor) hi = mid;
+    else lo = mid + 1;
+  }
+  return lo;
+}
+
+size_t history_query(uint32_t from, uint32_t to, uint32_t step, uint32_t* level_width,
+                     history_emit_fn emit, void* ctx)
+{
+  if (!hist_mutex || from > to) return 0;
+
+  xSemaphoreTake(hist_mutex, portMAX_DELAY);
+  history_ensure_loaded();
+  int l = history_pick_level(from, step);
+  xSemaphoreGive(hist_mutex);
+  history_level_t &lv = levels[l];
+  // El paso efectivo es múltiplo del ancho del nivel
+  uint32_t eff = step <= lv.width ? lv.width : step - step % lv.width;
+  if (level_width) *level_width = lv.width;
+
+  history_bucket_t batch[HISTORY_QUERY_BATCH];
+  history_bucket_t acc;
+  bool have_acc = false;
+  size_t emitted = 0;
+  uint32_t cursor = from;
+
+  while (true)
+  {
+    // Copia de un lote bajo el mutex; la emisión (red) ocurre fuera de él
+    uint16_t n = 0;
+    xSemaphoreTake(hist_mutex, portMAX_DELAY);
+    for (uint16_t k = history_lower_bound(lv, cursor); k < lv.count && n < HISTORY_QUERY_BATCH; k++) {
+      const history_bucket_t* b = history_at(lv, k);
+      if (b->start > to) break;
+      batch[n++] = *b;
+    }
+    xSemaphoreGive(hist_mutex);
+
+    for (uint16_t i = 0; i < n; i++) {
+      uint32_t key = batch[i].start - batch[i].start % eff;
+      if (have_acc && acc.start != key) {
+        emit(&acc, ctx);
+        emitted++;
+        have_acc = false;
+      }
+      if (!have_acc) {
+        acc = batch[i];
+        acc.start = key;
+        have_acc = true;
+      } else {
+        history_merge(&acc, &batch[i]);
+      }
+    }
+    if (n < HISTORY_QUERY_BATCH) break;
+    cursor = batch[n - 1].start + lv.width;
+  }
+
+  if (have_acc) {
+    emit(&acc, ctx);
+    emitted++;
+  }
+  return emitted;
+}
@@ -0,0 +1,48 @@
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <Arduino.h>
+
+// Historial local de temperatura, humedad, batería y aperturas de puerta.
+// Cada muestra actualiza de forma incremental cuatro niveles de rollup
+// (crudo, 1 minuto, 15 minutos y 1 hora) con mínimo/máximo/suma/conteo por
+// serie. Los niveles son anillos en RAM y se guardan como snapshot en LittleFS
+// (history_flush), así el historial sobrevive al deep sleep y a reinicios.
+// El snapshot (~45 KB) se carga sólo cuando hace falta: entre despertares las
+// muestras se acumulan en un diario en RTC y se vuelcan juntas cuando se llena
+// (32 muestras) o su primera muestra tiene 6 h; en modo continuo, cada 15 min.
+
+#define HISTORY_SERIES      3       // 0 = temperatura (x10), 1 = humedad (x10), 2 = batería (%)
+#define HISTORY_LEVELS      4
+
+typedef struct {
+  uint32_t start;                   // Inicio del bucket (epoch, s)
+  int16_t min[HISTORY_SERIES];
+  int16_t max[HISTORY_SERIES];
+  int32_t sum[HISTORY_SERIES];
+  uint16_t n[HISTORY_SERIES];       // Muestras por serie (0 = sin datos)
+  uint16_t opens;                   // Aperturas de puerta dentro del bucket
+} history_bucket_t;
+
+// Recibe cada punto de una consulta (ya agregado al paso pedido)
+typedef void (*history_emit_fn)(const history_bucket_t* point, void* ctx);
+
+// Monta LittleFS; el snapshot se carga con la primera consulta o volcado
+void history_begin();
+
+// Registra una lectura. NAN / valores negativos marcan series sin dato;
+// door_state -1 = desconocido. Requiere hora válida (NTP): si no, se ignora.
+void history_add_sample(time_t ts, float temp_c, float humidity_pct, int battery_pct, int door_state);
+
+// Guarda el snapshot si hubo cambios desde el último guardado; con el diario
+// RTC sin cargar, sólo si está lleno o envejeció (si no, queda en RTC)
+void history_flush();
+
+// Recorre los buckets en [from, to] agregados en pasos de step segundos. Elige el
+// nivel más grueso que no exceda step y cubra from. Retorna los puntos emitidos;
+// level_width recibe el ancho del nivel usado. Los datos se copian en lotes cortos,
+// así emit puede enviar por red sin bloquear las inserciones.
+size_t history_query(uint32_t from, uint32_t to, uint32_t step, uint32_t* level_width,
+                     history_emit_fn emit, void* ctx);
+
+#endif
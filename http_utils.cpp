@@ -1,22 +1,114 @@
 #include "http_utils.h"
 #include "config.h"
 #include "display_utils.h"
-#include "HTTPClient.h"
+#include "net_stats.h"
+#include "wake_stats.h"
+#include "wifi_link.h"
+#include "config_store.h"
 #include "WiFi.h"
+#include <WiFiClientSecure.h>
 #include <ArduinoJson.h>
 
+#define HTTP_TIMEOUT_MS   5000
+
+//  POST JSON con medición de cada fase (DNS, TCP, TLS, envío, primer byte, total).
+//  Retorna el código HTTP o un valor negativo si la petición no se completó.
+static int http_post_json(const String &url, const String &payload)
+{
+  net_sample_t sample;
+  for (int i = 0; i < NET_PHASE_COUNT; i++) sample.ms[i] = NET_MS_NONE;
+  sample.ok = false;
+
+  //  Separar esquema, host, puerto y ruta
+  bool https = url.startsWith("https://");
+  int host_start = url.indexOf("://") + 3;
+  int path_start = url.indexOf('/', host_start);
+  String host = path_start < 0 ? url.substring(host_start) : url.substring(host_start, path_start);
+  String path = path_start < 0 ? String("/") : url.substring(path_start);
+  uint16_t port = https ? 443 : 80;
+  int colon = host.indexOf(':');
+  if (colon >= 0) {
+    port = (uint16_t)host.substring(colon + 1).toInt();
+    host = host.substring(0, colon);
+  }
+
+  //  Radio despierta y potencia del nivel actual mientras dura el envío
+  wifi_link_update();
+  wifi_link_phase(LINK_PHASE_SEND);
+
+  int code = -1;
+  unsigned long t_start = millis();
+  IPAddress ip;
+  if (!WiFi.hostByName(host.c_str(), ip)) {
+    net_stats_record(&sample);
+    wifi_link_send_result(false, millis() - t_start);
+    wifi_link_phase(LINK_PHASE_IDLE);
+    return code;
+  }
+  sample.ms[NET_PHASE_DNS] = millis() - t_start;
+
+  WiFiClient plain;
+  WiFiClientSecure secure;
+  WiFiClient* client = &plain;
+  unsigned long t = millis();
+  bool connected;
+  if (https) {
+    //  WiFiClientSecure conecta y negocia TLS en una sola llamada: con https la fase
+    //  TLS incluye la conexión TCP. Se conecta a la IP ya resuelta (sin segunda
+    //  consulta DNS) y el nombre va como SNI.
+    secure.setInsecure();   // Igual que HTTPClient sin certificado CA
+    secure.setHandshakeTimeout(HTTP_TIMEOUT_MS / 1000);
+    client = &secure;
+    connected = secure.connect(ip, port, host.c_str(), NULL, NULL, NULL);
+    if (connected) sample.ms[NET_PHASE_TLS] = millis() - t;
+  } else {
+    connected = plain.connect(ip, port, HTTP_TIMEOUT_MS);
+    if (connected) sample.ms[NET_PHASE_CONNECT] = millis() - t;
+  }
+
+  if (connected) {
+    String head = "POST " + path + " HTTP/1.1\r\nHost: " + host +
+                  "\r\nContent-Type: application/json\r\nContent-Length: " + String(payload.length()) +
+                  "\r\nConnection: close\r\n\r\n";
+    t = millis();
+    bool sent = client->print(head) == head.length() && client->print(payload) == payload.length();
+    sample.ms[NET_PHASE_WRITE] = millis() - t;
+
+    t = millis();
+    while (sent && !client->available() && client->connected() && (millis() - t) < HTTP_TIMEOUT_MS) delay(1);
+    if (sent && client->available()) {
+      sample.ms[NET_PHASE_TTFB] = millis() - t;
+      //  Línea de estado "HTTP/1.1 200 OK" y encabezados; el cuerpo no se usa
+      String status = client->readStringUntil('\n');
+      int sp = status.indexOf(' ');
+      if (status.startsWith("HTTP/") && sp > 0) code = status.substring(sp + 1).toInt();
+      while (client->connected() || client->available()) {
+        String line = client->readStringUntil('\n');
+        if (line.length() <= 1) break;
+      }
+      sample.ms[NET_PHASE_TOTAL] = millis() - t_start;
+    }
+    client->stop();
+  }
+
+  sample.ok = (code >= 200 && code < 300);
+  net_stats_record(&sample);
+  wifi_link_send_result(sample.ok, millis() - t_start);
+  wifi_link_phase(LINK_PHASE_IDLE);
+  return code;
+}
+
 
 //  Función que permite enviar la temperatura, humedad y estado de la bateria al servidor mediante una solicitud HTTP
 void send_POST_temperature_humidity_battery(float temp, float hum, int volt_batt, int porc_batt) 
 {
-  HTTPClient http;
   String mac = WiFi.macAddress();
 
   int temp_int = (int)(temp * 10);
   int hum_int  = (int)hum;
 
   //  Se crea el body con la información para enviar en la solicitud HTTP
-  StaticJsonDocument<256> doc;
+  StaticJsonDocument<2048> doc;
 
   doc["mac"] = mac;
 
@@ -28,42 +120,44 @@ void send_POST_temperature_humidity_battery(float temp, float hum, int volt_batt
   battery["voltage"] = volt_batt;
   battery["level"] = porc_batt;
 
+  //  Resumen de latencias de las peticiones anteriores (histogramas en RTC)
+  net_stats_summary(doc.createNestedObject("net"));
+  //  Promedios de tiempo despierto y carga por perfil de despertar
+  wake_stats_summary(doc.createNestedObject("wake"));
+  //  Nivel del enlace, ajustes aplicados y resultados por nivel (política de la radio)
+  wifi_link_summary(doc.createNestedObject("link"));
+
   // Serializar a cadena
   String jsonPayload;
   serializeJson(doc, jsonPayload);
 
-  http.begin(endpoint_telemetry);
-  http.addHeader("Content-Type", "application/json");
-
-  // ⏳ Timeout de 5 segundos
-  http.setTimeout(5000);
-
-  int httpResponseCode = http.POST(jsonPayload);
+  // ⏳ Timeout de 5 segundos por fase
+  config_values_t cfg;
+  config_store_get(&cfg);
+  int httpResponseCode = http_post_json(cfg.telemetry_url, jsonPayload);
 
   if (httpResponseCode > 0) 
   {
     // Mostrar sólo confirmación (sin el mensaje "Apagando...")
     display_oled_message_2_line(
       "Información registrada.", 
-      ""
+      "",
+      500
     );
   } 
   else 
   {
     display_oled_wrap_message(
-      "Información no registrada."
+      "Información no registrada.",
+      500
     );
   }
-
-  http.end();
-  delay(500);
 }
 
 
 //  Función que permite enviar el estado de apertura de la puerta y de la bateria al servidor mediante una solicitud HTTP
 void send_POST_door_status_battery(int door_status, int battery_vol, int battery_lvl) 
 {
-  HTTPClient http;
   String mac = WiFi.macAddress();
 
   //  Se crea el body con la información para enviar en la solicitud HTTP
@@ -81,30 +175,25 @@ void send_POST_door_status_battery(int door_status, int battery_vol, int battery
   String jsonPayload;
   serializeJson(doc, jsonPayload);
 
-  // Enviar POST
-  http.begin(endpoint_door_sensor);
-  http.addHeader("Content-Type", "application/json");
-
-  // ⏳ Timeout de 5 segundos
-  http.setTimeout(5000);
-
-  int httpResponseCode = http.POST(jsonPayload);
+  // Enviar POST (⏳ timeout de 5 segundos por fase)
+  config_values_t cfg;
+  config_store_get(&cfg);
+  int httpResponseCode = http_post_json(cfg.door_url, jsonPayload);
 
   if (httpResponseCode > 0) 
   {
     // Mostrar sólo confirmación (sin el mensaje "Apagando...")
     display_oled_message_2_line(
       "Información registrada.", 
-      ""
+      "",
+      500
     );
   } 
   else 
   {
     display_oled_wrap_message(
-      "Información NO registrada."
+      "Información NO registrada.",
+      500
     );
   }
-
-  http.end();
-  delay(500);
 }
\ No newline at end of file
@@ -0,0 +1,412 @@
+#include "json_stream.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  JS_VALUE = 0,         // Se espera un valor
+  JS_OBJ_FIRST,         // Tras '{': clave o '}'
+  JS_OBJ_KEY,           // Tras ',' en objeto: clave
+  JS_COLON,             // Tras la clave: ':'
+  JS_ARR_FIRST,         // Tras '[': valor o ']'
+  JS_AFTER,             // Tras un valor dentro de un contenedor: ',' o cierre
+  JS_STRING,
+  JS_ESC,               // Tras '\'
+  JS_HEX,               // Dígitos de \uXXXX
+  JS_SURR_BS,           // Tras un sustituto alto: se exige '\'
+  JS_SURR_U,            // ... y luego 'u'
+  JS_NUMBER,
+  JS_LITERAL,
+  JS_DONE               // Valor raíz completo: sólo se admite espacio
+};
+
+static const char* const js_literals[3] = { "true", "false", "null" };
+
+static bool js_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool js_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+static json_status_t js_fail(json_parser_t* p, json_status_t s)
+{
+  p->status = s;
+  return s;
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool js_number_valid(const char* s, size_t n)
+{
+  size_t i = 0, start;
+  if (i < n && s[i] == '-') i++;
+  if (i >= n) return false;
+  if (s[i] == '0') i++;
+  else if (s[i] >= '1' && s[i] <= '9') { while (i < n && js_digit(s[i])) i++; }
+  else return false;
+  if (i < n && s[i] == '.') {
+    start = ++i;
+    while (i < n && js_digit(s[i])) i++;
+    if (i == start) return false;
+  }
+  if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+    i++;
+    if (i < n && (s[i] == '+' || s[i] == '-')) i++;
+    start = i;
+    while (i < n && js_digit(s[i])) i++;
+    if (i == start) return false;
+  }
+  return i == n;
+}
+
+static bool js_in_key(const json_parser_t* p)
+{
+  return p->resume == JS_COLON;
+}
+
+// Agrega un byte al string en curso (clave o valor)
+static bool js_put(json_parser_t* p, char c)
+{
+  if (js_in_key(p)) {
+    if (p->key_len >= JSON_MAX_KEY) return false;
+    p->key[p->key_len++] = c;
+  } else {
+    if (p->buf_len >= JSON_MAX_VALUE) return false;
+    p->buf[p->buf_len++] = c;
+  }
+  return true;
+}
+
+static bool js_put_utf8(json_parser_t* p, uint32_t cp)
+{
+  if (cp < 0x80) return js_put(p, (char)cp);
+  if (cp < 0x800) return js_put(p, (char)(0xC0 | (cp >> 6))) && js_put(p, (char)(0x80 | (cp & 0x3F)));
+  if (cp < 0x10000) {
+    return js_put(p, (char)(0xE0 | (cp >> 12))) && js_put(p, (char)(0x80 | ((cp >> 6) & 0x3F))) &&
+           js_put(p, (char)(0x80 | (cp & 0x3F)));
+  }
+  return js_put(p, (char)(0xF0 | (cp >> 18))) && js_put(p, (char)(0x80 | ((cp >> 12) & 0x3F))) &&
+         js_put(p, (char)(0x80 | ((cp >> 6) & 0x3F))) && js_put(p, (char)(0x80 | (cp & 0x3F)));
+}
+
+// Valida UTF-8 byte a byte (sin sobrelargos, sustitutos ni valores > U+10FFFF)
+static bool js_utf8_byte(json_parser_t* p, uint8_t b)
+{
+  if (p->utf8_need) {
+    if (b < p->utf8_lo || b > p->utf8_hi) return false;
+    p->utf8_need--;
+    p->utf8_lo = 0x80;
+    p->utf8_hi = 0xBF;
+    return true;
+  }
+  p->utf8_lo = 0x80;
+  p->utf8_hi = 0xBF;
+  if (b >= 0xC2 && b <= 0xDF) p->utf8_need = 1;
+  else if (b >= 0xE0 && b <= 0xEF) {
+    p->utf8_need = 2;
+    if (b == 0xE0) p->utf8_lo = 0xA0;
+    if (b == 0xED) p->utf8_hi = 0x9F;
+  } else if (b >= 0xF0 && b <= 0xF4) {
+    p->utf8_need = 3;
+    if (b == 0xF0) p->utf8_lo = 0x90;
+    if (b == 0xF4) p->utf8_hi = 0x8F;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static void js_value_done(json_parser_t* p)
+{
+  p->state = p->depth == 0 ? JS_DONE : JS_AFTER;
+}
+
+static json_status_t js_emit(json_parser_t* p, json_type_t type)
+{
+  p->buf[p->buf_len] = '\0';
+  json_event_t ev;
+  ev.depth = p->depth;
+  ev.key = (p->depth > 0 && p->stack[p->depth - 1] == '{') ? p->key : "";
+  ev.type = type;
+  ev.value = p->buf;
+  ev.len = p->buf_len;
+  p->buf_len = 0;
+  js_value_done(p);
+  if (p->fn && !p->fn(&ev, p->ctx)) return js_fail(p, JSON_ERR_ABORT);
+  return JSON_OK;
+}
+
+static json_status_t js_end_number(json_parser_t* p)
+{
+  if (!js_number_valid(p->buf, p->buf_len)) return js_fail(p, JSON_ERR_SYNTAX);
+  return js_emit(p, JSON_NUMBER);
+}
+
+static json_status_t js_push(json_parser_t* p, char open)
+{
+  if (p->depth >= JSON_MAX_DEPTH) return js_fail(p, JSON_ERR_DEPTH);
+  p->stack[p->depth++] = (uint8_t)open;
+  p->state = open == '{' ? JS_OBJ_FIRST : JS_ARR_FIRST;
+  return JSON_OK;
+}
+
+static json_status_t js_pop(json_parser_t* p, char close)
+{
+  char open = close == '}' ? '{' : '[';
+  if (p->depth == 0 || p->stack[p->depth - 1] != (uint8_t)open) return js_fail(p, JSON_ERR_SYNTAX);
+  p->depth--;
+  js_value_done(p);
+  return JSON_OK;
+}
+
+static json_status_t js_begin_value(json_parser_t* p, char c)
+{
+  switch (c) {
+    case '{': return js_push(p, '{');
+    case '[': return js_push(p, '[');
+    case '"':
+      p->resume = JS_AFTER;
+      p->buf_len = 0;
+      p->state = JS_STRING;
+      return JSON_OK;
+    case 't': case 'f': case 'n':
+      p->lit_pos = 1;
+      p->buf_len = 0;
+      p->buf[p->buf_len++] = c;
+      p->state = JS_LITERAL;
+      return JSON_OK;
+    default:
+      if (c == '-' || js_digit(c)) {
+        p->buf_len = 0;
+        p->buf[p->buf_len++] = c;
+        p->state = JS_NUMBER;
+        return JSON_OK;
+      }
+      return js_fail(p, JSON_ERR_SYNTAX);
+  }
+}
+
+static json_status_t js_step(json_parser_t* p, char c)
+{
+  switch (p->state) {
+    case JS_VALUE:
+      if (js_space(c)) return JSON_OK;
+      return js_begin_value(p, c);
+
+    case JS_ARR_FIRST:
+      if (js_space(c)) return JSON_OK;
+      if (c == ']') return js_pop(p, ']');
+      return js_begin_value(p, c);
+
+    case JS_OBJ_FIRST:
+    case JS_OBJ_KEY:
+      if (js_space(c)) return JSON_OK;
+      if (c == '}' && p->state == JS_OBJ_FIRST) return js_pop(p, '}');
+      if (c != '"') return js_fail(p, JSON_ERR_SYNTAX);
+      p->resume = JS_COLON;
+      p->key_len = 0;
+      p->state = JS_STRING;
+      return JSON_OK;
+
+    case JS_COLON:
+      if (js_space(c)) return JSON_OK;
+      if (c != ':') return js_fail(p, JSON_ERR_SYNTAX);
+      p->state = JS_VALUE;
+      return JSON_OK;
+
+    case JS_AFTER:
+      if (js_space(c)) return JSON_OK;
+      if (c == ',') {
+        p->state = p->stack[p->depth - 1] == '{' ? JS_OBJ_KEY : JS_VALUE;
+        return JSON_OK;
+      }
+      if (c == '}' || c == ']') return js_pop(p, c);
+      return js_fail(p, JSON_ERR_SYNTAX);
+
+    case JS_STRING:
+      if (p->utf8_need || (uint8_t)c >= 0x80) {
+        if (!js_utf8_byte(p, (uint8_t)c)) return js_fail(p, JSON_ERR_SYNTAX);
+        return js_put(p, c) ? JSON_OK : js_fail(p, JSON_ERR_LENGTH);
+      }
+      if (c == '"') {
+        if (js_in_key(p)) {
+          p->key[p->key_len] = '\0';
+          p->state = JS_COLON;
+          return JSON_OK;
+        }
+        return js_emit(p, JSON_STRING);
+      }
+      if (c == '\\') { p->state = JS_ESC; return JSON_OK; }
+      if ((uint8_t)c < 0x20) return js_fail(p, JSON_ERR_SYNTAX);
+      return js_put(p, c) ? JSON_OK : js_fail(p, JSON_ERR_LENGTH);
+
+    case JS_ESC: {
+      char out;
+      switch (c) {
+        case '"': out = '"'; break;
+        case '\\': out = '\\'; break;
+        case '/': out = '/'; break;
+        case 'b': out = '\b'; break;
+        case 'f': out = '\f'; break;
+        case 'n': out = '\n'; break;
+        case 'r': out = '\r'; break;
+        case 't': out = '\t'; break;
+        case 'u':
+          p->code = 0;
+          p->hex_digits = 0;
+          p->state = JS_HEX;
+          return JSON_OK;
+        default: return js_fail(p, JSON_ERR_SYNTAX);
+      }
+      p->state = JS_STRING;
+      return js_put(p, out) ? JSON_OK : js_fail(p, JSON_ERR_LENGTH);
+    }
+
+    case JS_HEX: {
+      uint8_t v;
+      if (js_digit(c)) v = c - '0';
+      else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+      else return js_fail(p, JSON_ERR_SYNTAX);
+      p->code = (p->code << 4) | v;
+      if (++p->hex_digits < 4) return JSON_OK;
+
+      uint32_t cp = p->code;
+      if (cp >= 0xD800 && cp <= 0xDBFF) {
+        if (p->high) return js_fail(p, JSON_ERR_SYNTAX);
+        p->high = cp;
+        p->state = JS_SURR_BS;
+        return JSON_OK;
+      }
+      if (cp >= 0xDC00 && cp <= 0xDFFF) {
+        if (!p->high) return js_fail(p, JSON_ERR_SYNTAX);
+        cp = 0x10000 + ((p->high - 0xD800) << 10) + (cp - 0xDC00);
+        p->high = 0;
+      } else if (p->high) {
+        return js_fail(p, JSON_ERR_SYNTAX);
+      }
+      // Los valores se entregan terminados en '\0': no se admite U+0000
+      if (cp == 0) return js_fail(p, JSON_ERR_SYNTAX);
+      p->state = JS_STRING;
+      return js_put_utf8(p, cp) ? JSON_OK : js_fail(p, JSON_ERR_LENGTH);
+    }
+
+    case JS_SURR_BS:
+      if (c != '\\') return js_fail(p, JSON_ERR_SYNTAX);
+      p->state = JS_SURR_U;
+      return JSON_OK;
+
+    case JS_SURR_U:
+      if (c != 'u') return js_fail(p, JSON_ERR_SYNTAX);
+      p->code = 0;
+      p->hex_digits = 0;
+      p->state = JS_HEX;
+      return JSON_OK;
+
+    case JS_NUMBER:
+      if (js_digit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+        if (p->buf_len >= JSON_MAX_VALUE) return js_fail(p, JSON_ERR_LENGTH);
+        p->buf[p->buf_len++] = c;
+        return JSON_OK;
+      }
+      // El carácter que cierra el número se procesa en el estado siguiente
+      if (js_end_number(p) != JSON_OK) return p->status;
+      return js_step(p, c);
+
+    case JS_LITERAL: {
+      const char* lit = p->buf[0] == 't' ? js_literals[0] : p->buf[0] == 'f' ? js_literals[1] : js_literals[2];
+      if (c != lit[p->lit_pos]) return js_fail(p, JSON_ERR_SYNTAX);
+      p->buf[p->buf_len++] = c;
+      if (lit[++p->lit_pos] != '\0') return JSON_OK;
+      return js_emit(p, p->buf[0] == 'n' ? JSON_NULL : JSON_BOOL);
+    }
+
+    case JS_DONE:
+      if (js_space(c)) return JSON_OK;
+      return js_fail(p, JSON_ERR_SYNTAX);
+  }
+  return js_fail(p, JSON_ERR_SYNTAX);
+}
+
+void json_parser_init(json_parser_t* p, json_value_fn fn, void* ctx)
+{
+  memset(p, 0, sizeof(*p));
+  p->state = JS_VALUE;
+  p->fn = fn;
+  p->ctx = ctx;
+}
+
+json_status_t json_parser_feed(json_parser_t* p, const char* data, size_t len)
+{
+  for (size_t i = 0; i < len && p->status == JSON_OK; i++) {
+    if (js_step(p, data[i]) != JSON_OK) break;
+    p->offset++;
+  }
+  return p->status;
+}
+
+json_status_t json_parser_finish(json_parser_t* p)
+{
+  if (p->status != JSON_OK) return p->status;
+  if (p->state == JS_NUMBER && js_end_number(p) != JSON_OK) return p->status;
+  return p->state == JS_DONE ? JSON_OK : JSON_INCOMPLETE;
+}
+
+json_status_t json_parse(const char* data, size_t len, json_value_fn fn, void* ctx)
+{
+  json_parser_t p;
+  json_parser_init(&p, fn, ctx);
+  if (json_parser_feed(&p, data, len) != JSON_OK) return p.status;
+  return json_parser_finish(&p);
+}
+
+typedef struct {
+  const char* key;
+  char* out;
+  size_t cap;
+  bool found;
+} js_find_ctx_t;
+
+static bool js_find_value(const json_event_t* ev, void* ctx)
+{
+  js_find_ctx_t* f = (js_find_ctx_t*)ctx;
+  if (ev->depth != 1 || strcmp(ev->key, f->key) != 0) return true;
+  // Con claves repetidas gana la última, como en JSON.parse
+  f->found = ev->type == JSON_STRING && ev->len < f->cap;
+  if (f->found) memcpy(f->out, ev->value, ev->len + 1);
+  return true;
+}
+
+bool json_find_string(const char* data, size_t len, const char* key, char* out, size_t cap)
+{
+  js_find_ctx_t f = { key, out, cap, false };
+  if (cap > 0) out[0] = '\0';
+  if (json_parse(data, len, js_find_value, &f) != JSON_OK) return false;
+  return f.found;
+}
+
+bool json_event_int(const json_event_t* ev, long min, long max, long* out)
+{
+  if (ev->type != JSON_NUMBER || strpbrk(ev->value, ".eE") != NULL) return false;
+  errno = 0;
+  long v = strtol(ev->value, NULL, 10);
+  if (errno != 0 || v < min || v > max) return false;
+  *out = v;
+  return true;
+}
+
+const char* json_status_name(json_status_t s)
+{
+  switch (s) {
+    case JSON_OK: return "ok";
+    case JSON_INCOMPLETE: return "incomplete";
+    case JSON_ERR_SYNTAX: return "syntax";
+    case JSON_ERR_DEPTH: return "depth";
+    case JSON_ERR_LENGTH: return "length";
+    case JSON_ERR_ABORT: return "aborted";
+  }
+  return "unknown";
+}
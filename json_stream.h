@@ -0,0 +1,93 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+// Parser JSON incremental (estilo SAX) para los cuerpos de las peticiones HTTP.
+// Recibe el texto por partes (json_parser_feed) y entrega cada valor escalar a
+// un callback con su profundidad y el nombre del miembro que lo contiene. No
+// reserva memoria: la profundidad, la longitud de las claves y la de los valores
+// están acotadas por las constantes de abajo y exceder cualquiera es un error.
+// Valida la gramática completa (RFC 8259): números, escapes, \uXXXX con pares
+// sustitutos (se decodifican a UTF-8), que los strings sean UTF-8 bien formado
+// y que no haya texto tras el valor raíz. A diferencia de JSON.parse o del
+// módulo json de Python, rechaza \u0000 y los sustitutos aislados ("\ud800"):
+// los valores se entregan como UTF-8 terminado en '\0', que no los representa.
+// No depende de Arduino.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_MAX_DEPTH      8
+#define JSON_MAX_KEY        32          // Bytes por nombre de miembro (UTF-8)
+#define JSON_MAX_VALUE      128         // Bytes por valor escalar (UTF-8)
+
+typedef enum {
+  JSON_STRING = 0,
+  JSON_NUMBER,
+  JSON_BOOL,
+  JSON_NULL
+} json_type_t;
+
+typedef enum {
+  JSON_OK = 0,
+  JSON_INCOMPLETE,                      // Falta texto (sólo al finalizar)
+  JSON_ERR_SYNTAX,
+  JSON_ERR_DEPTH,
+  JSON_ERR_LENGTH,                      // Clave o valor más largo que el límite
+  JSON_ERR_ABORT                        // El callback pidió cortar
+} json_status_t;
+
+typedef struct {
+  uint8_t depth;                        // 1 = miembro del objeto raíz
+  const char* key;                      // Miembro que contiene el valor ("" dentro de arreglos)
+  json_type_t type;
+  const char* value;                    // Texto terminado en '\0' (strings ya sin escapes)
+  uint16_t len;
+} json_event_t;
+
+// Retorna false para detener el análisis (json_parser_feed devuelve JSON_ERR_ABORT)
+typedef bool (*json_value_fn)(const json_event_t* ev, void* ctx);
+
+typedef struct {
+  uint8_t state;
+  uint8_t resume;                       // Estado al que vuelve un string al cerrarse
+  uint8_t depth;
+  uint8_t stack[JSON_MAX_DEPTH];        // '{' o '['
+  char key[JSON_MAX_KEY + 1];
+  uint8_t key_len;
+  char buf[JSON_MAX_VALUE + 1];
+  uint16_t buf_len;
+  uint8_t lit_pos;                      // Avance dentro de true/false/null
+  uint8_t hex_digits;
+  uint8_t utf8_need;                    // Bytes de continuación UTF-8 pendientes
+  uint8_t utf8_lo, utf8_hi;             // Rango válido del próximo byte de continuación
+  uint32_t code;                        // \uXXXX en curso
+  uint32_t high;                        // Sustituto alto pendiente
+  json_status_t status;
+  uint32_t offset;                      // Bytes consumidos (posición del error)
+  json_value_fn fn;
+  void* ctx;
+} json_parser_t;
+
+void json_parser_init(json_parser_t* p, json_value_fn fn, void* ctx);
+
+// Consume len bytes. Tras un error, las llamadas siguientes lo repiten sin avanzar.
+json_status_t json_parser_feed(json_parser_t* p, const char* data, size_t len);
+
+// Indica fin de la entrada: emite un número pendiente y verifica que el valor
+// raíz esté completo.
+json_status_t json_parser_finish(json_parser_t* p);
+
+// Analiza un texto completo (init + feed + finish)
+json_status_t json_parse(const char* data, size_t len, json_value_fn fn, void* ctx);
+
+// Copia en out el string del miembro key del objeto raíz. Retorna false si no
+// existe, no es un string, no cabe en cap o el texto no es JSON válido.
+bool json_find_string(const char* data, size_t len, const char* key, char* out, size_t cap);
+
+// Convierte un evento numérico entero a long. false si tiene fracción/exponente
+// o está fuera de [min, max].
+bool json_event_int(const json_event_t* ev, long min, long max, long* out);
+
+const char* json_status_name(json_status_t s);
+
+#endif
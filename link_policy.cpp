@@ -0,0 +1,95 @@
+#include "link_policy.h"
+#include <string.h>
+
+// Umbrales de RSSI efectivo de STRONG, MID y WEAK
+static const int16_t link_tier_dbm[LINK_TIER_EDGE] = { -60, -70, -78 };
+
+// Política adaptativa, por nivel: potencia y ahorro en reposo. Cerca del AP
+// basta poca potencia; en el borde se transmite al máximo y en reposo se
+// escucha cada DTIM para no perder beacons (MAX_MODEM los espacia).
+static const uint8_t link_tx_qdbm[LINK_TIER_COUNT]  = { 44, 60, 78, 84, 84 };   // 11, 15, 19,5, 21, 21 dBm
+// Al asociar, un escalón más: el RSSI guardado puede ser de otro AP o de otro lugar
+static const uint8_t link_assoc_qdbm[LINK_TIER_COUNT] = { 60, 78, 84, 84, 84 };
+static const uint8_t link_idle_ps[LINK_TIER_COUNT]  = { LINK_PS_MAX, LINK_PS_MAX, LINK_PS_MIN, LINK_PS_MIN, LINK_PS_MAX };
+
+void link_state_init(link_state_t* s)
+{
+  memset(s, 0, sizeof(*s));
+  s->tier = LINK_TIER_UNKNOWN;
+}
+
+void link_observe_rssi(link_state_t* s, int8_t rssi)
+{
+  if (rssi >= 0) return;
+  if (s->rssi == 0) s->rssi = rssi;
+  else s->rssi = (int8_t)(((int16_t)s->rssi + rssi) / 2);
+}
+
+void link_observe_result(link_state_t* s, bool ok)
+{
+  if (ok) s->fail_score -= s->fail_score >> 2;
+  else s->fail_score += (255 - s->fail_score + 3) >> 2;
+}
+
+static uint8_t link_tier_of(int16_t eff, int16_t margin)
+{
+  for (uint8_t t = 0; t < LINK_TIER_EDGE; t++) {
+    if (eff >= link_tier_dbm[t] + margin) return t;
+  }
+  return LINK_TIER_EDGE;
+}
+
+uint8_t link_tier(link_state_t* s)
+{
+  if (s->rssi == 0) {
+    s->tier = LINK_TIER_UNKNOWN;
+    return s->tier;
+  }
+  int16_t eff = s->rssi - (s->fail_score >> 4);
+  uint8_t t = link_tier_of(eff, 0);
+  // Para mejorar de nivel hace falta pasar el umbral con margen
+  if (s->tier < LINK_TIER_UNKNOWN && t < s->tier) {
+    t = link_tier_of(eff, LINK_HYST_DB);
+    if (t > s->tier) t = s->tier;
+  }
+  s->tier = t;
+  return t;
+}
+
+void link_settings(uint8_t policy, uint8_t tier, link_phase_t phase, link_settings_t* out)
+{
+  if (tier >= LINK_TIER_COUNT) tier = LINK_TIER_UNKNOWN;
+  if (policy == LINK_POLICY_FIXED) {
+    out->tx_qdbm = 0;
+    out->ps = phase == LINK_PHASE_ASSOC ? LINK_PS_NONE : LINK_PS_MAX;
+    out->no_11b = false;
+    return;
+  }
+  out->tx_qdbm = phase == LINK_PHASE_ASSOC ? link_assoc_qdbm[tier] : link_tx_qdbm[tier];
+  // Asociar y enviar con la radio despierta: las respuestas no esperan al próximo beacon
+  out->ps = phase == LINK_PHASE_IDLE ? link_idle_ps[tier] : (uint8_t)LINK_PS_NONE;
+  out->no_11b = tier <= LINK_TIER_MID;
+}
+
+void link_stats_record(link_stats_t* st, link_phase_t phase, uint8_t tier, bool ok, uint32_t ms)
+{
+  if (tier >= LINK_TIER_COUNT) return;
+  link_count_t* c = phase == LINK_PHASE_ASSOC ? &st->assoc[tier] : &st->send[tier];
+  if (++st->since_decay >= LINK_DECAY_EVERY) {
+    // Mitad a todos los conteos: pesan más los resultados recientes
+    for (uint8_t t = 0; t < LINK_TIER_COUNT; t++) {
+      link_count_t* all[2] = { &st->assoc[t], &st->send[t] };
+      for (uint8_t k = 0; k < 2; k++) {
+        all[k]->n >>= 1;
+        all[k]->fail >>= 1;
+        all[k]->ms >>= 1;
+      }
+    }
+    st->since_decay = 0;
+  }
+  if (c->n < UINT16_MAX) {
+    c->n++;
+    if (!ok) c->fail++;
+    c->ms += ms;
+  }
+}
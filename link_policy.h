@@ -0,0 +1,85 @@
+#ifndef LINK_POLICY_H
+#define LINK_POLICY_H
+
+// Política del enlace WiFi por fase (asociar, enviar, reposo). El estado
+// del enlace (RSSI suavizado y tasa reciente de fallos de asociación y de
+// envío) se reduce a un nivel: cada fallo reciente resta hasta 15 dB al
+// RSSI efectivo, y para subir de nivel hacen falta LINK_HYST_DB por encima
+// del umbral. Del nivel y la fase salen la potencia de transmisión, el modo
+// de ahorro de la radio y si se desactivan las tasas 802.11b (mínimo 6 Mbps
+// OFDM: menos tiempo al aire por trama cerca del AP). Los resultados se
+// acumulan por nivel (con decaimiento, como net_stats) para comparar
+// políticas. No depende de Arduino.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LINK_POLICY_FIXED       0       // Como antes: potencia del driver, MAX_MODEM siempre
+#define LINK_POLICY_ADAPTIVE    1
+
+#define LINK_HYST_DB            3
+#define LINK_DECAY_EVERY        64      // Resultados entre reducciones a la mitad
+
+typedef enum {
+  LINK_PHASE_ASSOC = 0,
+  LINK_PHASE_SEND,
+  LINK_PHASE_IDLE,
+  LINK_PHASE_COUNT
+} link_phase_t;
+
+typedef enum {
+  LINK_TIER_STRONG = 0,         // >= -60 dBm efectivos
+  LINK_TIER_MID,                // >= -70
+  LINK_TIER_WEAK,               // >= -78
+  LINK_TIER_EDGE,
+  LINK_TIER_UNKNOWN,            // Sin RSSI todavía (arranque en frío)
+  LINK_TIER_COUNT
+} link_tier_t;
+
+typedef enum {
+  LINK_PS_NONE = 0,
+  LINK_PS_MIN,                  // Escucha cada DTIM
+  LINK_PS_MAX                   // Escucha cada listen interval
+} link_ps_t;
+
+typedef struct {
+  uint8_t tx_qdbm;              // Potencia máxima en 0,25 dBm; 0 = la del driver
+  uint8_t ps;                   // link_ps_t
+  bool no_11b;
+} link_settings_t;
+
+typedef struct {
+  int8_t rssi;                  // Suavizado; 0 = desconocido
+  uint8_t fail_score;           // Fallos recientes (EWMA, 255 = todo falla)
+  uint8_t tier;                 // Último nivel elegido
+} link_state_t;
+
+typedef struct {
+  uint16_t n;
+  uint16_t fail;
+  uint32_t ms;                  // Suma de duraciones (éxitos y fallos)
+} link_count_t;
+
+typedef struct {
+  link_count_t assoc[LINK_TIER_COUNT];
+  link_count_t send[LINK_TIER_COUNT];
+  uint16_t since_decay;
+} link_stats_t;
+
+void link_state_init(link_state_t* s);
+
+// RSSI medido con el enlace arriba
+void link_observe_rssi(link_state_t* s, int8_t rssi);
+
+// Resultado de una asociación o un envío
+void link_observe_result(link_state_t* s, bool ok);
+
+// Nivel actual con histéresis (actualiza s->tier)
+uint8_t link_tier(link_state_t* s);
+
+void link_settings(uint8_t policy, uint8_t tier, link_phase_t phase, link_settings_t* out);
+
+// Acumula un resultado de la fase (ASSOC o SEND) en el nivel con que se hizo
+void link_stats_record(link_stats_t* st, link_phase_t phase, uint8_t tier, bool ok, uint32_t ms);
+
+#endif
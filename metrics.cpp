@@ -0,0 +1,398 @@
+#include "metrics.h"
+#include "ts_store.h"
+#include "config_store.h"
+#include "moe_log.h"
+#include "display_utils.h"
+#include "wake_stats.h"
+#include "door_events.h"
+#include "button_utils.h"
+#include "power_utils.h"
+#include "app_sched.h"
+#include "wifi_store.h"
+#include "wifi_link.h"
+#include <WiFi.h>
+#include <WebServer.h>
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+// Límites de los buckets de latencia en ms (histograma acumulado al renderizar)
+static const uint16_t latency_bounds_ms[METRICS_LATENCY_BUCKETS] = { 5, 10, 25, 50, 100, 250, 500, 1000, 5000 };
+
+// La tabla se llena al registrar las rutas (tarea OTA, antes de server.begin())
+static metrics_route_t routes[METRICS_MAX_ROUTES];
+static uint8_t route_count = 0;
+
+static std::atomic<uint32_t> wifi_disconnects(0);
+static std::atomic<uint32_t> wifi_connects(0);
+static std::atomic<uint32_t> ota_poll_loops(0);
+static bool metrics_ready = false;
+
+void metrics_init()
+{
+  if (metrics_ready) return;
+  WiFi.onEvent([](WiFiEvent_t event, WiFiEventInfo_t info) {
+    wifi_disconnects.fetch_add(1, std::memory_order_relaxed);
+  }, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+  WiFi.onEvent([](WiFiEvent_t event, WiFiEventInfo_t info) {
+    wifi_connects.fetch_add(1, std::memory_order_relaxed);
+  }, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  // La conexión vigente al registrar los eventos cuenta como la primera
+  if (WiFi.status() == WL_CONNECTED) wifi_connects.store(1, std::memory_order_relaxed);
+  metrics_ready = true;
+}
+
+metrics_route_t* metrics_route(const char* path, uint8_t method)
+{
+  for (uint8_t i = 0; i < route_count; i++) {
+    if (routes[i].method == method && strcmp(routes[i].path, path) == 0) return &routes[i];
+  }
+  if (route_count >= METRICS_MAX_ROUTES) return NULL;
+  metrics_route_t* r = &routes[route_count++];
+  r->path = path;
+  r->method = method;
+  return r;
+}
+
+void metrics_route_observe(metrics_route_t* route, uint32_t elapsed_us)
+{
+  if (!route) return;
+  // Comparación en µs: redondear a ms antes dejaría 5,9 ms en el bucket le="0.005"
+  uint8_t b = 0;
+  while (b < METRICS_LATENCY_BUCKETS && elapsed_us > latency_bounds_ms[b] * 1000UL) b++;
+  route->buckets[b].fetch_add(1, std::memory_order_relaxed);
+  route->sum_us.fetch_add(elapsed_us, std::memory_order_relaxed);
+  route->count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void metrics_count_poll()
+{
+  ota_poll_loops.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void metrics_header(resp_writer_t* out, const char* name, const char* type, const char* help)
+{
+  resp_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static const char* metrics_method_name(uint8_t method)
+{
+  switch (method) {
+    case HTTP_GET: return "GET";
+    case HTTP_POST: return "POST";
+    case HTTP_PUT: return "PUT";
+    case HTTP_PATCH: return "PATCH";
+    case HTTP_DELETE: return "DELETE";
+    default: return "ANY";
+  }
+}
+
+static void metrics_render_tasks(resp_writer_t* out)
+{
+#if configUSE_TRACE_FACILITY
+  UBaseType_t n = uxTaskGetNumberOfTasks();
+  // Instantánea en el arena de la petición (se libera al responder)
+  TaskStatus_t* tasks = (TaskStatus_t*)req_arena_alloc(n * sizeof(TaskStatus_t));
+  if (!tasks) return;
+  uint32_t total_runtime = 0;
+  n = uxTaskGetSystemState(tasks, n, &total_runtime);
+
+  // En ESP32 StackType_t es de 1 byte: la marca de agua ya está en bytes
+  metrics_header(out, "moe_task_stack_free_min_bytes", "gauge", "Minimo de pila libre observado por tarea");
+  for (UBaseType_t i = 0; i < n; i++) {
+    resp_printf(out, "moe_task_stack_free_min_bytes{task=\"%s\"} %u\n", tasks[i].pcTaskName, (unsigned)tasks[i].usStackHighWaterMark);
+  }
+#if configGENERATE_RUN_TIME_STATS
+  metrics_header(out, "moe_task_cpu_percent", "gauge", "Uso de CPU por tarea desde el arranque (suma de ambos nucleos = 200)");
+  for (UBaseType_t i = 0; i < n; i++) {
+    // total_runtime es por núcleo; en doble núcleo cada tarea se compara contra ese total
+    float pct = total_runtime ? (100.0f * tasks[i].ulRunTimeCounter) / total_runtime : 0.0f;
+    resp_printf(out, "moe_task_cpu_percent{task=\"%s\"} %.2f\n", tasks[i].pcTaskName, pct);
+  }
+#endif
+#else
+  // Sin trace facility sólo se conoce la tarea que atiende /metrics
+  metrics_header(out, "moe_task_stack_free_min_bytes", "gauge", "Minimo de pila libre observado por tarea");
+  resp_printf(out, "moe_task_stack_free_min_bytes{task=\"%s\"} %u\n", pcTaskGetTaskName(NULL), (unsigned)uxTaskGetStackHighWaterMark(NULL));
+#endif
+}
+
+// Ciclo de trabajo del modo continuo y corriente media estimada
+static void metrics_render_power(resp_writer_t* out)
+{
+  power_stats_t p;
+  power_get_stats(&p);
+  metrics_header(out, "moe_power_light_sleep_seconds_total", "counter", "Tiempo en light sleep automatico (ticks saltados por el idle)");
+  resp_printf(out, "moe_power_light_sleep_seconds_total %.3f\n", p.light_sleep_ms / 1000.0f);
+  metrics_header(out, "moe_power_awake_seconds_total", "counter", "Tiempo con la CPU despierta desde el inicio del modo continuo");
+  resp_printf(out, "moe_power_awake_seconds_total %.3f\n", p.awake_ms / 1000.0f);
+  metrics_header(out, "moe_power_estimated_current_ma", "gauge", "Corriente media estimada (CPU + radio)");
+  resp_printf(out, "moe_power_estimated_current_ma %.2f\n", p.current_ma);
+  metrics_header(out, "moe_wifi_listen_interval", "gauge", "Beacons entre escuchas con modem sleep (0 = sin modem sleep)");
+  resp_printf(out, "moe_wifi_listen_interval %u\n", p.modem_sleep ? (unsigned)p.listen_interval : 0u);
+}
+
+// Flancos y eventos de la puerta (modo continuo)
+static void metrics_render_door(resp_writer_t* out)
+{
+  door_stats_t d;
+  door_events_get_stats(&d);
+  metrics_header(out, "moe_door_edges_total", "counter", "Flancos del sensor de puerta procesados");
+  resp_printf(out, "moe_door_edges_total %u\n", (unsigned)d.edges);
+  metrics_header(out, "moe_door_edges_lost_total", "counter", "Flancos perdidos (anillo lleno o flanco intermedio faltante)");
+  resp_printf(out, "moe_door_edges_lost_total{cause=\"ring_full\"} %u\n", (unsigned)d.ring_dropped);
+  resp_printf(out, "moe_door_edges_lost_total{cause=\"missed\"} %u\n", (unsigned)d.edges_missed);
+  metrics_header(out, "moe_door_bounces_total", "counter", "Rafagas de rebote descartadas sin cambio de estado");
+  resp_printf(out, "moe_door_bounces_total %u\n", (unsigned)d.bounces);
+  metrics_header(out, "moe_door_pulses_total", "counter", "Pulsos cortos entregados como apertura y cierre");
+  resp_printf(out, "moe_door_pulses_total %u\n", (unsigned)d.pulses);
+  metrics_header(out, "moe_door_events_total", "counter", "Eventos de puerta publicados");
+  resp_printf(out, "moe_door_events_total %u\n", (unsigned)d.events);
+  metrics_header(out, "moe_door_events_dropped_total", "counter", "Eventos de puerta descartados por cola llena");
+  resp_printf(out, "moe_door_events_dropped_total %u\n", (unsigned)d.events_dropped);
+  metrics_header(out, "moe_door_event_latency_seconds", "gauge", "Del primer flanco a la publicacion del ultimo evento");
+  resp_printf(out, "moe_door_event_latency_seconds %.6f\n", d.last_latency_us / 1e6f);
+}
+
+// Trabajos del bucle de eventos del modo continuo
+static void metrics_render_sched(resp_writer_t* out)
+{
+  metrics_header(out, "moe_sched_job_runs_total", "counter", "Ejecuciones por trabajo del planificador");
+  for (int id = 0; id < SCHED_MAX_JOBS; id++) {
+    const sched_job_t* j = app_sched_job(id);
+    if (j) resp_printf(out, "moe_sched_job_runs_total{job=\"%s\"} %u\n", j->name, (unsigned)j->stats.runs);
+  }
+  metrics_header(out, "moe_sched_job_overruns_total", "counter", "Periodos saltados por retraso");
+  for (int id = 0; id < SCHED_MAX_JOBS; id++) {
+    const sched_job_t* j = app_sched_job(id);
+    if (j) resp_printf(out, "moe_sched_job_overruns_total{job=\"%s\"} %u\n", j->name, (unsigned)j->stats.overruns);
+  }
+  metrics_header(out, "moe_sched_job_runtime_seconds_total", "counter", "Tiempo de ejecucion acumulado por trabajo");
+  for (int id = 0; id < SCHED_MAX_JOBS; id++) {
+    const sched_job_t* j = app_sched_job(id);
+    if (j) resp_printf(out, "moe_sched_job_runtime_seconds_total{job=\"%s\"} %.6f\n", j->name, j->stats.runtime_us / 1e6);
+  }
+  metrics_header(out, "moe_sched_job_runtime_max_seconds", "gauge", "Ejecucion mas larga por trabajo");
+  for (int id = 0; id < SCHED_MAX_JOBS; id++) {
+    const sched_job_t* j = app_sched_job(id);
+    if (j) resp_printf(out, "moe_sched_job_runtime_max_seconds{job=\"%s\"} %.6f\n", j->name, j->stats.runtime_max_us / 1e6f);
+  }
+  metrics_header(out, "moe_sched_job_lateness_seconds_total", "counter", "Retraso acumulado del inicio respecto del plazo");
+  for (int id = 0; id < SCHED_MAX_JOBS; id++) {
+    const sched_job_t* j = app_sched_job(id);
+    if (j) resp_printf(out, "moe_sched_job_lateness_seconds_total{job=\"%s\"} %.6f\n", j->name, j->stats.late_us / 1e6);
+  }
+  metrics_header(out, "moe_sched_job_lateness_max_seconds", "gauge", "Mayor retraso del inicio respecto del plazo");
+  for (int id = 0; id < SCHED_MAX_JOBS; id++) {
+    const sched_job_t* j = app_sched_job(id);
+    if (j) resp_printf(out, "moe_sched_job_lateness_max_seconds{job=\"%s\"} %.6f\n", j->name, j->stats.late_max_us / 1e6f);
+  }
+}
+
+// Historial de cada red guardada (net = posición en la lista; 0 = la más reciente)
+static void metrics_render_wifi_nets(resp_writer_t* out)
+{
+  wifi_net_stats_t st[WIFI_STORE_MAX];
+  uint8_t n = wifi_store_stats(st);
+  metrics_header(out, "moe_wifi_net_attempts_total", "counter", "Intentos de conexion por red guardada");
+  for (uint8_t i = 0; i < n; i++) resp_printf(out, "moe_wifi_net_attempts_total{net=\"%u\"} %u\n", i, (unsigned)st[i].attempts);
+  metrics_header(out, "moe_wifi_net_successes_total", "counter", "Conexiones logradas por red guardada");
+  for (uint8_t i = 0; i < n; i++) resp_printf(out, "moe_wifi_net_successes_total{net=\"%u\"} %u\n", i, (unsigned)st[i].successes);
+  metrics_header(out, "moe_wifi_net_score", "gauge", "Exito reciente por red guardada (0..1)");
+  for (uint8_t i = 0; i < n; i++) resp_printf(out, "moe_wifi_net_score{net=\"%u\"} %.3f\n", i, st[i].score / 255.0f);
+  metrics_header(out, "moe_wifi_net_connect_seconds", "gauge", "Tiempo habitual hasta obtener IP por red guardada");
+  for (uint8_t i = 0; i < n; i++) resp_printf(out, "moe_wifi_net_connect_seconds{net=\"%u\"} %.3f\n", i, st[i].latency_ms / 1000.0f);
+}
+
+// Política del enlace: nivel actual, ajustes aplicados y resultados por nivel
+static void metrics_render_link(resp_writer_t* out)
+{
+  static const char* const tiers[LINK_TIER_COUNT] = { "strong", "mid", "weak", "edge", "unknown" };
+  wifi_link_info_t l;
+  wifi_link_get(&l);
+  metrics_header(out, "moe_link_policy", "gauge", "Politica de la radio (0 = fija, 1 = adaptativa)");
+  resp_printf(out, "moe_link_policy %u\n", l.policy);
+  metrics_header(out, "moe_link_tier", "gauge", "Nivel del enlace (0 = fuerte .. 3 = borde, 4 = desconocido)");
+  resp_printf(out, "moe_link_tier %u\n", l.state.tier);
+  metrics_header(out, "moe_link_rssi_dbm", "gauge", "RSSI suavizado del enlace");
+  resp_printf(out, "moe_link_rssi_dbm %d\n", l.state.rssi);
+  metrics_header(out, "moe_link_fail_score", "gauge", "Fallos recientes de asociacion y envio (0..1)");
+  resp_printf(out, "moe_link_fail_score %.3f\n", l.state.fail_score / 255.0f);
+  metrics_header(out, "moe_link_tx_power_dbm", "gauge", "Potencia maxima de transmision aplicada (0 = la del driver)");
+  resp_printf(out, "moe_link_tx_power_dbm %.2f\n", l.applied.tx_qdbm / 4.0f);
+  metrics_header(out, "moe_link_power_save", "gauge", "Modo de ahorro aplicado (0 = ninguno, 1 = DTIM, 2 = listen interval)");
+  resp_printf(out, "moe_link_power_save %u\n", l.applied.ps);
+  metrics_header(out, "moe_link_11b_disabled", "gauge", "Tasas 802.11b desactivadas en la estacion");
+  resp_printf(out, "moe_link_11b_disabled %u\n", l.applied.no_11b ? 1 : 0);
+  // Resultados por nivel con decaimiento (mitad cada LINK_DECAY_EVERY): gauges, no contadores
+  metrics_header(out, "moe_link_sends", "gauge", "Envios recientes por nivel del enlace");
+  for (uint8_t t = 0; t < LINK_TIER_COUNT; t++) resp_printf(out, "moe_link_sends{tier=\"%s\"} %u\n", tiers[t], (unsigned)l.stats.send[t].n);
+  metrics_header(out, "moe_link_send_failures", "gauge", "Envios fallidos recientes por nivel del enlace");
+  for (uint8_t t = 0; t < LINK_TIER_COUNT; t++) resp_printf(out, "moe_link_send_failures{tier=\"%s\"} %u\n", tiers[t], (unsigned)l.stats.send[t].fail);
+  metrics_header(out, "moe_link_send_seconds_avg", "gauge", "Duracion media de los envios por nivel");
+  for (uint8_t t = 0; t < LINK_TIER_COUNT; t++) {
+    if (l.stats.send[t].n) resp_printf(out, "moe_link_send_seconds_avg{tier=\"%s\"} %.3f\n", tiers[t], l.stats.send[t].ms / 1000.0f / l.stats.send[t].n);
+  }
+  metrics_header(out, "moe_link_assoc", "gauge", "Intentos de asociacion recientes por nivel del enlace");
+  for (uint8_t t = 0; t < LINK_TIER_COUNT; t++) resp_printf(out, "moe_link_assoc{tier=\"%s\"} %u\n", tiers[t], (unsigned)l.stats.assoc[t].n);
+  metrics_header(out, "moe_link_assoc_failures", "gauge", "Asociaciones fallidas recientes por nivel del enlace");
+  for (uint8_t t = 0; t < LINK_TIER_COUNT; t++) resp_printf(out, "moe_link_assoc_failures{tier=\"%s\"} %u\n", tiers[t], (unsigned)l.stats.assoc[t].fail);
+  metrics_header(out, "moe_link_assoc_seconds_avg", "gauge", "Duracion media de las asociaciones por nivel");
+  for (uint8_t t = 0; t < LINK_TIER_COUNT; t++) {
+    if (l.stats.assoc[t].n) resp_printf(out, "moe_link_assoc_seconds_avg{tier=\"%s\"} %.3f\n", tiers[t], l.stats.assoc[t].ms / 1000.0f / l.stats.assoc[t].n);
+  }
+}
+
+// Flancos y gestos del botón PRG
+static void metrics_render_button(resp_writer_t* out)
+{
+  button_stats_t b;
+  button_events_get_stats(&b);
+  metrics_header(out, "moe_button_edges_total", "counter", "Flancos del boton PRG procesados");
+  resp_printf(out, "moe_button_edges_total %u\n", (unsigned)b.edges);
+  metrics_header(out, "moe_button_edges_lost_total", "counter", "Flancos del boton descartados por anillo lleno");
+  resp_printf(out, "moe_button_edges_lost_total %u\n", (unsigned)b.ring_dropped);
+  metrics_header(out, "moe_button_bounces_total", "counter", "Flancos del boton ignorados por el antirrebote");
+  resp_printf(out, "moe_button_bounces_total %u\n", (unsigned)b.bounces);
+  metrics_header(out, "moe_button_gestures_total", "counter", "Gestos del boton reconocidos");
+  resp_printf(out, "moe_button_gestures_total{gesture=\"down\"} %u\n", (unsigned)b.downs);
+  resp_printf(out, "moe_button_gestures_total{gesture=\"clicks\"} %u\n", (unsigned)b.clicks);
+  resp_printf(out, "moe_button_gestures_total{gesture=\"long\"} %u\n", (unsigned)b.longs);
+  metrics_header(out, "moe_button_gestures_dropped_total", "counter", "Gestos del boton descartados por cola llena");
+  resp_printf(out, "moe_button_gestures_dropped_total %u\n", (unsigned)b.dropped);
+}
+
+// Despertares de deep sleep por perfil y causa (acumulados RTC, con decaimiento)
+static void metrics_render_wake(resp_writer_t* out)
+{
+  static const char* const profiles[WAKE_PROFILE_COUNT] = { "headless", "display" };
+  static const char* const kinds[WAKE_KIND_COUNT] = { "timer", "door", "button" };
+  wake_bucket_t b[WAKE_PROFILE_COUNT][WAKE_KIND_COUNT];
+  for (int p = 0; p < WAKE_PROFILE_COUNT; p++) {
+    for (int k = 0; k < WAKE_KIND_COUNT; k++) wake_stats_get((wake_profile_t)p, (wake_kind_t)k, &b[p][k]);
+  }
+  // Acumulados con decaimiento (mitad cada WAKE_STATS_DECAY_EVERY despertares):
+  // no son contadores monótonos, se exportan como gauges
+  metrics_header(out, "moe_wake_recent", "gauge", "Despertares medidos en la ventana con decaimiento");
+  for (int p = 0; p < WAKE_PROFILE_COUNT; p++) {
+    for (int k = 0; k < WAKE_KIND_COUNT; k++) {
+      resp_printf(out, "moe_wake_recent{profile=\"%s\",reason=\"%s\"} %u\n", profiles[p], kinds[k], (unsigned)b[p][k].wakes);
+    }
+  }
+  metrics_header(out, "moe_wake_awake_ms_avg", "gauge", "Tiempo despierto medio por despertar (ms)");
+  for (int p = 0; p < WAKE_PROFILE_COUNT; p++) {
+    for (int k = 0; k < WAKE_KIND_COUNT; k++) {
+      if (!b[p][k].wakes) continue;
+      resp_printf(out, "moe_wake_awake_ms_avg{profile=\"%s\",reason=\"%s\"} %u\n", profiles[p], kinds[k], (unsigned)(b[p][k].awake_ms / b[p][k].wakes));
+    }
+  }
+  metrics_header(out, "moe_wake_charge_uah_avg", "gauge", "Carga estimada media por despertar (uAh)");
+  for (int p = 0; p < WAKE_PROFILE_COUNT; p++) {
+    for (int k = 0; k < WAKE_KIND_COUNT; k++) {
+      if (!b[p][k].wakes) continue;
+      resp_printf(out, "moe_wake_charge_uah_avg{profile=\"%s\",reason=\"%s\"} %u\n", profiles[p], kinds[k], (unsigned)(b[p][k].charge_uah / b[p][k].wakes));
+    }
+  }
+  metrics_header(out, "moe_wake_headless_saving_ms", "gauge", "Tiempo despierto medio con pantalla menos sin pantalla, por causa (ms)");
+  for (int k = 0; k < WAKE_KIND_COUNT; k++) {
+    int32_t saving;
+    if (wake_stats_saving_ms((wake_kind_t)k, &saving)) resp_printf(out, "moe_wake_headless_saving_ms{reason=\"%s\"} %d\n", kinds[k], (int)saving);
+  }
+}
+
+static void metrics_render_routes(resp_writer_t* out)
+{
+  metrics_header(out, "moe_http_requests_total", "counter", "Peticiones atendidas por ruta");
+  for (uint8_t i = 0; i < route_count; i++) {
+    resp_printf(out, "moe_http_requests_total{route=\"%s\",method=\"%s\"} %u\n", routes[i].path,
+                metrics_method_name(routes[i].method), (unsigned)routes[i].count.load(std::memory_order_relaxed));
+  }
+
+  metrics_header(out, "moe_http_request_duration_seconds", "histogram", "Latencia de las peticiones por ruta");
+  for (uint8_t i = 0; i < route_count; i++) {
+    const metrics_route_t &r = routes[i];
+    if (r.count.load(std::memory_order_relaxed) == 0) continue;
+    const char* m = metrics_method_name(r.method);
+    uint32_t cumulative = 0;
+    for (uint8_t b = 0; b < METRICS_LATENCY_BUCKETS; b++) {
+      cumulative += r.buckets[b].load(std::memory_order_relaxed);
+      resp_printf(out, "moe_http_request_duration_seconds_bucket{route=\"%s\",method=\"%s\",le=\"%.3f\"} %u\n",
+                  r.path, m, latency_bounds_ms[b] / 1000.0f, (unsigned)cumulative);
+    }
+    cumulative += r.buckets[METRICS_LATENCY_BUCKETS].load(std::memory_order_relaxed);
+    resp_printf(out, "moe_http_request_duration_seconds_bucket{route=\"%s\",method=\"%s\",le=\"+Inf\"} %u\n", r.path, m, (unsigned)cumulative);
+    resp_printf(out, "moe_http_request_duration_seconds_sum{route=\"%s\",method=\"%s\"} %.6f\n", r.path, m,
+                r.sum_us.load(std::memory_order_relaxed) / 1e6);
+    resp_printf(out, "moe_http_request_duration_seconds_count{route=\"%s\",method=\"%s\"} %u\n", r.path, m, (unsigned)cumulative);
+  }
+}
+
+void metrics_render(resp_writer_t* out)
+{
+  metrics_header(out, "moe_uptime_seconds", "counter", "Segundos desde el arranque");
+  resp_printf(out, "moe_uptime_seconds %llu\n", (unsigned long long)(esp_timer_get_time() / 1000000ULL));
+
+  metrics_header(out, "moe_heap_free_bytes", "gauge", "Heap libre");
+  resp_printf(out, "moe_heap_free_bytes %u\n", (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT));
+  metrics_header(out, "moe_heap_min_free_bytes", "gauge", "Minimo de heap libre desde el arranque");
+  resp_printf(out, "moe_heap_min_free_bytes %u\n", (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+  metrics_header(out, "moe_heap_largest_free_block_bytes", "gauge", "Mayor bloque contiguo asignable (fragmentacion)");
+  resp_printf(out, "moe_heap_largest_free_block_bytes %u\n", (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+
+  metrics_render_tasks(out);
+  metrics_render_routes(out);
+
+  metrics_header(out, "moe_http_arena_high_water_bytes", "gauge", "Maximo usado del arena por peticion");
+  resp_printf(out, "moe_http_arena_high_water_bytes %u\n", (unsigned)req_arena_high_water());
+#ifdef MOE_ALLOC_DEBUG
+  metrics_header(out, "moe_http_handler_allocs_total", "counter", "Asignaciones de heap dentro de los handlers (MOE_ALLOC_DEBUG)");
+  resp_printf(out, "moe_http_handler_allocs_total %u\n", (unsigned)req_alloc_total());
+#endif
+
+  metrics_header(out, "moe_ota_poll_loops_total", "counter", "Iteraciones del bucle handleClient de la tarea OTA");
+  resp_printf(out, "moe_ota_poll_loops_total %u\n", (unsigned)ota_poll_loops.load(std::memory_order_relaxed));
+
+  // Referencia: registro sin comprimir de 14 bytes (t u32, 2 float, mV u16)
+  ts_store_stats_t ts;
+  ts_store_get_stats(&ts);
+  metrics_header(out, "moe_tsdb_samples_total", "counter", "Muestras agregadas al almacenamiento comprimido");
+  resp_printf(out, "moe_tsdb_samples_total %u\n", (unsigned)ts.samples);
+  metrics_header(out, "moe_tsdb_blocks_total", "counter", "Bloques sellados escritos en flash");
+  resp_printf(out, "moe_tsdb_blocks_total %u\n", (unsigned)ts.blocks);
+  metrics_header(out, "moe_tsdb_flash_bytes", "gauge", "Bytes ocupados por los archivos de series de tiempo");
+  resp_printf(out, "moe_tsdb_flash_bytes %u\n", (unsigned)ts.flash_bytes);
+  metrics_header(out, "moe_tsdb_compression_ratio", "gauge", "Tamano sin comprimir / tamano en flash de los bloques sellados");
+  resp_printf(out, "moe_tsdb_compression_ratio %.2f\n",
+              ts.blocks ? (ts.sealed_samples * 14.0f) / (ts.blocks * (float)TS_BLOCK_SIZE) : 0.0f);
+
+  metrics_header(out, "moe_config_nvs_writes_total", "counter", "Escrituras de configuracion en NVS desde el arranque");
+  resp_printf(out, "moe_config_nvs_writes_total %u\n", (unsigned)config_store_nvs_writes());
+  display_stats_t disp;
+  display_get_stats(&disp);
+  metrics_header(out, "moe_display_frames_total", "counter", "Frames de la pantalla OLED");
+  resp_printf(out, "moe_display_frames_total %u\n", (unsigned)disp.frames);
+  metrics_header(out, "moe_display_frames_skipped_total", "counter", "Frames sin cambios (no se transmitieron)");
+  resp_printf(out, "moe_display_frames_skipped_total %u\n", (unsigned)disp.skipped);
+  metrics_header(out, "moe_display_i2c_bytes_total", "counter", "Bytes I2C enviados al panel (comandos + datos)");
+  resp_printf(out, "moe_display_i2c_bytes_total %u\n", (unsigned)disp.bytes_total);
+  metrics_header(out, "moe_display_last_frame_bytes", "gauge", "Bytes I2C del ultimo frame");
+  resp_printf(out, "moe_display_last_frame_bytes %u\n", (unsigned)disp.last_bytes);
+  metrics_header(out, "moe_display_coalesced_total", "counter", "Mensajes de pantalla reemplazados antes de mostrarse");
+  resp_printf(out, "moe_display_coalesced_total %u\n", (unsigned)disp.coalesced);
+  metrics_render_wake(out);
+  metrics_render_door(out);
+  metrics_render_button(out);
+  metrics_render_power(out);
+  metrics_render_sched(out);
+  metrics_header(out, "moe_log_dropped_total", "counter", "Registros descartados por anillo lleno o error de escritura");
+  resp_printf(out, "moe_log_dropped_total %u\n", (unsigned)mlog_dropped());
+
+  uint32_t connects = wifi_connects.load(std::memory_order_relaxed);
+  metrics_header(out, "moe_wifi_rssi_dbm", "gauge", "RSSI de la conexion WiFi");
+  resp_printf(out, "moe_wifi_rssi_dbm %d\n", WiFi.status() == WL_CONNECTED ? (int)WiFi.RSSI() : 0);
+  metrics_header(out, "moe_wifi_disconnects_total", "counter", "Desconexiones de la estacion WiFi");
+  resp_printf(out, "moe_wifi_disconnects_total %u\n", (unsigned)wifi_disconnects.load(std::memory_order_relaxed));
+  metrics_header(out, "moe_wifi_reconnects_total", "counter", "Reconexiones (IP obtenida tras la primera conexion)");
+  resp_printf(out, "moe_wifi_reconnects_total %u\n", (unsigned)(connects > 0 ? connects - 1 : 0));
+  metrics_render_wifi_nets(out);
+  metrics_render_link(out);
+}
@@ -0,0 +1,39 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "req_arena.h"
+
+// Métricas de ejecución expuestas en GET /metrics (formato de texto Prometheus).
+// Los contadores son atómicos de 32 bits (lock-free en Xtensa) y se actualizan con
+// orden relajado: registrar una petición o un evento WiFi no toma ningún mutex.
+// Heap, pilas y tiempos de CPU se leen sólo al generar la respuesta.
+
+#define METRICS_MAX_ROUTES      32
+#define METRICS_LATENCY_BUCKETS 9       // Límites en ms: ver metrics.cpp (+Inf aparte)
+
+typedef struct {
+  const char* path;
+  uint8_t method;                                         // HTTPMethod de WebServer
+  std::atomic<uint32_t> count;
+  std::atomic<uint64_t> sum_us;                           // En µs: las rutas rápidas no suman 0
+  std::atomic<uint32_t> buckets[METRICS_LATENCY_BUCKETS + 1];   // No acumulados; el último es +Inf
+} metrics_route_t;
+
+// Registra los manejadores de eventos WiFi (desconexiones / reconexiones)
+void metrics_init();
+
+// Slot de métricas para una ruta (se crea en el primer llamado). NULL si la tabla está llena.
+metrics_route_t* metrics_route(const char* path, uint8_t method);
+
+// Registra una petición atendida con su latencia
+void metrics_route_observe(metrics_route_t* route, uint32_t elapsed_us);
+
+// Iteraciones del bucle handleClient() de la tarea OTA
+void metrics_count_poll();
+
+// Escribe el cuerpo de /metrics en la respuesta en curso
+void metrics_render(resp_writer_t* out);
+
+#endif
@@ -0,0 +1,374 @@
+#include "moe_log.h"
+#include "task_config.h"
+#include <LittleFS.h>
+#include "esp_ota_ops.h"
+
+#define MLOG_RTC_MAGIC      0x474F4C4DUL        // "MLOG"
+#define MLOG_FILE_MAGIC     "MLG1"
+#define MLOG_BUILD_ID_LEN   8
+#define MLOG_FILE_HEADER    16                  // magic, build id, reservado
+#define MLOG_FLUSH_PERIOD_MS 10000
+
+typedef struct {
+  uint32_t magic;
+  uint8_t build[MLOG_BUILD_ID_LEN];
+  uint16_t head;                                // Próximo byte a escribir
+  uint16_t used;
+  uint32_t dropped;
+  uint8_t ring[MLOG_RING_SIZE];
+} mlog_rtc_t;
+
+// El anillo sobrevive al deep sleep; sólo se descarta si cambió la imagen
+RTC_DATA_ATTR static mlog_rtc_t mlog_rtc;
+
+static portMUX_TYPE mlog_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool mlog_ready = false;
+static TaskHandle_t mlog_task = NULL;
+static SemaphoreHandle_t mlog_fs_mutex = NULL;
+
+static const uint8_t* mlog_build_id()
+{
+  return esp_ota_get_app_description()->app_elf_sha256;
+}
+
+static void mlog_ensure()
+{
+  if (mlog_ready) return;
+  const uint8_t* build = mlog_build_id();
+  portENTER_CRITICAL(&mlog_mux);
+  if (!mlog_ready) {
+    if (mlog_rtc.magic != MLOG_RTC_MAGIC || memcmp(mlog_rtc.build, build, MLOG_BUILD_ID_LEN) != 0 ||
+        mlog_rtc.head >= MLOG_RING_SIZE || mlog_rtc.used > MLOG_RING_SIZE) {
+      mlog_rtc.magic = MLOG_RTC_MAGIC;
+      memcpy(mlog_rtc.build, build, MLOG_BUILD_ID_LEN);
+      mlog_rtc.head = 0;
+      mlog_rtc.used = 0;
+      mlog_rtc.dropped = 0;
+    }
+    mlog_ready = true;
+  }
+  portEXIT_CRITICAL(&mlog_mux);
+}
+
+static void mlog_put(mlog_rec_t* r, const void* src, size_t n)
+{
+  if (r->len + n > MLOG_RECORD_MAX) return;
+  memcpy(r->data + r->len, src, n);
+  r->len += n;
+}
+
+// Un argumento más (los que exceden MLOG_MAX_ARGS o el tamaño del registro se omiten)
+static bool mlog_arg_room(mlog_rec_t* r, size_t n)
+{
+  if (r->nargs >= MLOG_MAX_ARGS || r->len + n > MLOG_RECORD_MAX) return false;
+  r->nargs++;
+  return true;
+}
+
+void mlog_rec_begin(mlog_rec_t* r, uint8_t level, const char* fmt)
+{
+  uint32_t ms = millis();
+  uint32_t addr = (uint32_t)(uintptr_t)fmt;
+  r->data[0] = 0;
+  r->data[1] = level << 4;
+  memcpy(r->data + 2, &ms, 4);
+  memcpy(r->data + 6, &addr, 4);
+  r->len = MLOG_HEADER_SIZE;
+  r->nargs = 0;
+}
+
+void mlog_rec_u32(mlog_rec_t* r, uint32_t v, char tag)
+{
+  if (!mlog_arg_room(r, 5)) return;
+  mlog_put(r, &tag, 1);
+  mlog_put(r, &v, 4);
+}
+
+void mlog_rec_u64(mlog_rec_t* r, uint64_t v)
+{
+  if (!mlog_arg_room(r, 9)) return;
+  char tag = 'q';
+  mlog_put(r, &tag, 1);
+  mlog_put(r, &v, 8);
+}
+
+void mlog_rec_float(mlog_rec_t* r, float v)
+{
+  if (!mlog_arg_room(r, 5)) return;
+  char tag = 'f';
+  mlog_put(r, &tag, 1);
+  mlog_put(r, &v, 4);
+}
+
+void mlog_rec_str(mlog_rec_t* r, const char* s)
+{
+  if (!s) s = "(null)";
+  size_t n = strnlen(s, MLOG_STR_MAX);
+  if (r->len + 2 + n > MLOG_RECORD_MAX) n = r->len + 2 < MLOG_RECORD_MAX ? MLOG_RECORD_MAX - r->len - 2 : 0;
+  if (!mlog_arg_room(r, 2 + n)) return;
+  uint8_t hdr[2] = { 's', (uint8_t)n };
+  mlog_put(r, hdr, 2);
+  mlog_put(r, s, n);
+}
+
+void mlog_commit(mlog_rec_t* r)
+{
+  mlog_ensure();
+  r->data[0] = r->len;
+  r->data[1] |= r->nargs;
+#ifdef MOE_LOG_SERIAL
+  char line[192];
+  mlog_format(r->data, line, sizeof(line));
+  Serial.println(line);
+#endif
+  bool wake = false;
+  portENTER_CRITICAL(&mlog_mux);
+  if (MLOG_RING_SIZE - mlog_rtc.used < r->len) {
+    mlog_rtc.dropped++;
+  } else {
+    size_t first = MLOG_RING_SIZE - mlog_rtc.head;
+    if (first > r->len) first = r->len;
+    memcpy(mlog_rtc.ring + mlog_rtc.head, r->data, first);
+    memcpy(mlog_rtc.ring, r->data + first, r->len - first);
+    mlog_rtc.head = (mlog_rtc.head + r->len) % MLOG_RING_SIZE;
+    mlog_rtc.used += r->len;
+    wake = mlog_rtc.used > MLOG_RING_SIZE / 2;
+  }
+  portEXIT_CRITICAL(&mlog_mux);
+  if (wake && mlog_task) xTaskNotifyGive(mlog_task);
+}
+
+// Copia registros completos desde la cola del anillo (hasta cap bytes) y los libera
+static size_t mlog_take(uint8_t* out, size_t cap)
+{
+  size_t n = 0;
+  portENTER_CRITICAL(&mlog_mux);
+  size_t tail = (mlog_rtc.head + MLOG_RING_SIZE - mlog_rtc.used) % MLOG_RING_SIZE;
+  while (n < mlog_rtc.used) {
+    size_t len = mlog_rtc.ring[(tail + n) % MLOG_RING_SIZE];
+    if (len < MLOG_HEADER_SIZE || n + len > mlog_rtc.used) {
+      // Anillo inconsistente: descartar el resto
+      mlog_rtc.used = n;
+      break;
+    }
+    if (n + len > cap) break;
+    for (size_t i = 0; i < len; i++) out[n + i] = mlog_rtc.ring[(tail + n + i) % MLOG_RING_SIZE];
+    n += len;
+  }
+  mlog_rtc.used -= n;
+  portEXIT_CRITICAL(&mlog_mux);
+  return n;
+}
+
+static bool mlog_header_matches(File &f)
+{
+  uint8_t hdr[MLOG_FILE_HEADER];
+  if (f.read(hdr, sizeof(hdr)) != sizeof(hdr)) return false;
+  return memcmp(hdr, MLOG_FILE_MAGIC, 4) == 0 && memcmp(hdr + 4, mlog_build_id(), MLOG_BUILD_ID_LEN) == 0;
+}
+
+// Abre /log.bin para agregar; rota si está lleno o es de otra imagen
+static File mlog_open_append()
+{
+  if (LittleFS.exists(MLOG_FILE)) {
+    File f = LittleFS.open(MLOG_FILE, "r");
+    bool same = f && mlog_header_matches(f);
+    size_t size = f ? f.size() : 0;
+    if (f) f.close();
+    if (same && size < MLOG_FILE_MAX) return LittleFS.open(MLOG_FILE, "a");
+    LittleFS.remove(MLOG_OLD_FILE);
+    LittleFS.rename(MLOG_FILE, MLOG_OLD_FILE);
+  }
+  File f = LittleFS.open(MLOG_FILE, "w");
+  if (f) {
+    uint8_t hdr[MLOG_FILE_HEADER] = { 0 };
+    memcpy(hdr, MLOG_FILE_MAGIC, 4);
+    memcpy(hdr + 4, mlog_build_id(), MLOG_BUILD_ID_LEN);
+    f.write(hdr, sizeof(hdr));
+  }
+  return f;
+}
+
+void mlog_flush()
+{
+  if (!mlog_fs_mutex) return;
+  mlog_ensure();
+  xSemaphoreTake(mlog_fs_mutex, portMAX_DELAY);
+  uint8_t chunk[512];
+  size_t n = mlog_take(chunk, sizeof(chunk));
+  if (n > 0) {
+    File f = mlog_open_append();
+    while (n > 0) {
+      if (!f || f.write(chunk, n) != n) {
+        portENTER_CRITICAL(&mlog_mux);
+        mlog_rtc.dropped++;
+        portEXIT_CRITICAL(&mlog_mux);
+      }
+      n = mlog_take(chunk, sizeof(chunk));
+    }
+    if (f) f.close();
+  }
+  xSemaphoreGive(mlog_fs_mutex);
+}
+
+void mlog_sleep()
+{
+  if (mlog_rtc.used > MLOG_RING_SIZE / 2) mlog_flush();
+}
+
+static void mlog_flush_task(void* arg)
+{
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MLOG_FLUSH_PERIOD_MS));
+    mlog_flush();
+  }
+}
+
+void mlog_begin()
+{
+  mlog_ensure();
+  if (mlog_fs_mutex) return;
+  mlog_fs_mutex = xSemaphoreCreateMutex();
+  task_spawn(TASK_LOG, mlog_flush_task, NULL, &mlog_task);
+}
+
+uint32_t mlog_dropped()
+{
+  return mlog_rtc.dropped;
+}
+
+static void mlog_appendf(char* out, size_t cap, size_t* len, const char* fmt, ...)
+{
+  if (*len + 1 >= cap) return;
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(out + *len, cap - *len, fmt, args);
+  va_end(args);
+  if (n > 0) *len = (size_t)n < cap - *len ? *len + n : cap - 1;
+}
+
+size_t mlog_format(const uint8_t* rec, char* out, size_t cap)
+{
+  static const char levels[] = "?EWID";
+  size_t len = 0;
+  if (cap == 0) return 0;
+  out[0] = '\0';
+  uint8_t size = rec[0];
+  uint32_t ms, addr;
+  memcpy(&ms, rec + 2, 4);
+  memcpy(&addr, rec + 6, 4);
+  uint8_t level = rec[1] >> 4;
+  mlog_appendf(out, cap, &len, "%10u %c ", (unsigned)ms, levels[level < 5 ? level : 0]);
+
+  const uint8_t* p = rec + MLOG_HEADER_SIZE;
+  const uint8_t* end = rec + size;
+  const char* fmt = (const char*)(uintptr_t)addr;
+  while (*fmt && len + 1 < cap) {
+    if (*fmt != '%') {
+      const char* lit = fmt;
+      while (*fmt && *fmt != '%') fmt++;
+      mlog_appendf(out, cap, &len, "%.*s", (int)(fmt - lit), lit);
+      continue;
+    }
+    if (fmt[1] == '%') {
+      mlog_appendf(out, cap, &len, "%%");
+      fmt += 2;
+      continue;
+    }
+    // Especificador: banderas, ancho y precisión se conservan; el modificador de
+    // longitud se reemplaza por el del tipo guardado
+    char spec[16];
+    size_t k = 0;
+    spec[k++] = *fmt++;
+    while (*fmt && strchr("-+ #0123456789.", *fmt) && k < sizeof(spec) - 4) spec[k++] = *fmt++;
+    while (*fmt && strchr("hlLqjzt", *fmt)) fmt++;
+    char conv = *fmt ? *fmt++ : 'd';
+    char tag = p < end ? (char)*p : 0;
+
+    if ((tag == 'i' || tag == 'p') && p + 5 <= end) {
+      uint32_t v;
+      memcpy(&v, p + 1, 4);
+      p += 5;
+      if (conv == 'p') {
+        mlog_appendf(out, cap, &len, "0x%08x", (unsigned)v);
+      } else if (strchr("di", conv)) {
+        spec[k++] = 'd'; spec[k] = '\0';
+        mlog_appendf(out, cap, &len, spec, (int)(int32_t)v);
+      } else if (strchr("uxXoc", conv)) {
+        spec[k++] = conv; spec[k] = '\0';
+        mlog_appendf(out, cap, &len, spec, (unsigned)v);
+      } else {
+        mlog_appendf(out, cap, &len, "<?>");
+      }
+    } else if (tag == 'q' && p + 9 <= end) {
+      uint64_t v;
+      memcpy(&v, p + 1, 8);
+      p += 9;
+      spec[k++] = 'l'; spec[k++] = 'l';
+      if (strchr("di", conv)) {
+        spec[k++] = 'd'; spec[k] = '\0';
+        mlog_appendf(out, cap, &len, spec, (long long)v);
+      } else if (strchr("uxXo", conv)) {
+        spec[k++] = conv; spec[k] = '\0';
+        mlog_appendf(out, cap, &len, spec, (unsigned long long)v);
+      } else {
+        mlog_appendf(out, cap, &len, "<?>");
+      }
+    } else if (tag == 'f' && p + 5 <= end) {
+      float v;
+      memcpy(&v, p + 1, 4);
+      p += 5;
+      if (strchr("fFeEgGaA", conv)) {
+        spec[k++] = conv; spec[k] = '\0';
+        mlog_appendf(out, cap, &len, spec, (double)v);
+      } else {
+        mlog_appendf(out, cap, &len, "<?>");
+      }
+    } else if (tag == 's' && p + 2 <= end && p + 2 + p[1] <= end) {
+      char s[MLOG_RECORD_MAX + 1];
+      size_t n = p[1];
+      memcpy(s, p + 2, n);
+      s[n] = '\0';
+      p += 2 + n;
+      if (conv == 's') {
+        spec[k++] = 's'; spec[k] = '\0';
+        mlog_appendf(out, cap, &len, spec, s);
+      } else {
+        mlog_appendf(out, cap, &len, "<?>");
+      }
+    } else {
+      // Falta el argumento (omitido por tamaño) o registro corrupto
+      mlog_appendf(out, cap, &len, "<?>");
+      p = end;
+    }
+  }
+  // Sin salto de línea final: lo agrega quien imprime
+  while (len > 0 && out[len - 1] == '\n') out[--len] = '\0';
+  return len;
+}
+
+// Lee un archivo de registros si lo generó esta imagen
+static bool mlog_scan_file(const char* path, mlog_record_fn fn, void* ctx)
+{
+  File f = LittleFS.open(path, "r");
+  if (!f) return true;
+  bool more = true;
+  if (mlog_header_matches(f)) {
+    uint8_t rec[MLOG_RECORD_MAX];
+    while (more && f.read(rec, 1) == 1) {
+      if (rec[0] < MLOG_HEADER_SIZE || f.read(rec + 1, rec[0] - 1) != (size_t)rec[0] - 1) break;
+      more = fn(rec, ctx);
+    }
+  }
+  f.close();
+  return more;
+}
+
+void mlog_scan(mlog_record_fn fn, void* ctx)
+{
+  if (!mlog_fs_mutex) return;
+  mlog_flush();
+  xSemaphoreTake(mlog_fs_mutex, portMAX_DELAY);
+  if (mlog_scan_file(MLOG_OLD_FILE, fn, ctx)) mlog_scan_file(MLOG_FILE, fn, ctx);
+  xSemaphoreGive(mlog_fs_mutex);
+}
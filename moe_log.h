@@ -0,0 +1,130 @@
+#ifndef MOE_LOG_H
+#define MOE_LOG_H
+
+#include <Arduino.h>
+#include <type_traits>
+
+// Registro binario estructurado. MLOGE/MLOGW/MLOGI/MLOGD se filtran en
+// compilación con MOE_LOG_LEVEL: los niveles deshabilitados desaparecen (ni
+// el formato ni los argumentos se evalúan). Un registro habilitado no se
+// formatea: guarda la dirección del literal de formato (vive en flash) y los
+// argumentos en binario en un anillo en memoria RTC, que sobrevive al deep
+// sleep. Una tarea de fondo lo vuelca a LittleFS (/log.bin, rota a /log.old)
+// al pasar de la mitad; antes de dormir se vuelca sólo si está lleno a medias.
+//
+// El texto se reconstruye en el dispositivo (GET /logs, misma imagen) o en el
+// host con tools/moe_log.py y el ELF del build (GET /logs/raw). Los archivos
+// llevan el prefijo del SHA-256 del ELF para detectar imágenes distintas.
+// Con MOE_LOG_SERIAL además se imprime cada registro formateado por Serial.
+//
+// Formatos estilo printf (verificados por el compilador); los argumentos
+// pueden ser enteros, float/double (se guardan como float), punteros o
+// cadenas C (se copian hasta MLOG_STR_MAX bytes). No usar desde ISR.
+
+#define MLOG_LEVEL_NONE     0
+#define MLOG_LEVEL_ERROR    1
+#define MLOG_LEVEL_WARN     2
+#define MLOG_LEVEL_INFO     3
+#define MLOG_LEVEL_DEBUG    4
+
+#ifndef MOE_LOG_LEVEL
+#define MOE_LOG_LEVEL       MLOG_LEVEL_INFO
+#endif
+
+#define MLOG_RING_SIZE      2048        // Anillo en RTC
+#define MLOG_FILE           "/log.bin"
+#define MLOG_OLD_FILE       "/log.old"
+#define MLOG_FILE_MAX       (32UL * 1024UL)
+#define MLOG_RECORD_MAX     255
+#define MLOG_HEADER_SIZE    10          // len, nivel|nargs, ms (u32), formato (u32)
+#define MLOG_MAX_ARGS       15
+#define MLOG_STR_MAX        48
+
+typedef struct {
+  uint8_t data[MLOG_RECORD_MAX];
+  uint8_t len;
+  uint8_t nargs;
+} mlog_rec_t;
+
+void mlog_rec_begin(mlog_rec_t* r, uint8_t level, const char* fmt);
+void mlog_rec_u32(mlog_rec_t* r, uint32_t v, char tag);
+void mlog_rec_u64(mlog_rec_t* r, uint64_t v);
+void mlog_rec_float(mlog_rec_t* r, float v);
+void mlog_rec_str(mlog_rec_t* r, const char* s);
+void mlog_commit(mlog_rec_t* r);
+
+// Codificación de argumentos según el tipo estático
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+mlog_arg(mlog_rec_t* r, T v)
+{
+  if (sizeof(T) > 4) mlog_rec_u64(r, (uint64_t)v);
+  else mlog_rec_u32(r, (uint32_t)v, 'i');
+}
+inline void mlog_arg(mlog_rec_t* r, double v) { mlog_rec_float(r, (float)v); }
+inline void mlog_arg(mlog_rec_t* r, const char* s) { mlog_rec_str(r, s); }
+inline void mlog_arg(mlog_rec_t* r, char* s) { mlog_rec_str(r, s); }
+template <typename T>
+inline void mlog_arg(mlog_rec_t* r, T* p) { mlog_rec_u32(r, (uint32_t)(uintptr_t)p, 'p'); }
+
+template <typename... A>
+inline void mlog_write(uint8_t level, const char* fmt, const A &... args)
+{
+  mlog_rec_t r;
+  mlog_rec_begin(&r, level, fmt);
+  int expand[] = { 0, (mlog_arg(&r, args), 0)... };
+  (void)expand;
+  mlog_commit(&r);
+}
+
+// Sólo para que el compilador verifique formato y argumentos (nunca se llama)
+static inline void mlog_check(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+static inline void mlog_check(const char* fmt, ...) { (void)fmt; }
+
+#define MLOG_AT(level, fmt, ...) do { \
+    if (0) mlog_check(fmt, ##__VA_ARGS__); \
+    mlog_write(level, fmt, ##__VA_ARGS__); \
+  } while (0)
+
+#if MOE_LOG_LEVEL >= MLOG_LEVEL_ERROR
+#define MLOGE(fmt, ...) MLOG_AT(MLOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define MLOGE(fmt, ...) do {} while (0)
+#endif
+#if MOE_LOG_LEVEL >= MLOG_LEVEL_WARN
+#define MLOGW(fmt, ...) MLOG_AT(MLOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define MLOGW(fmt, ...) do {} while (0)
+#endif
+#if MOE_LOG_LEVEL >= MLOG_LEVEL_INFO
+#define MLOGI(fmt, ...) MLOG_AT(MLOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define MLOGI(fmt, ...) do {} while (0)
+#endif
+#if MOE_LOG_LEVEL >= MLOG_LEVEL_DEBUG
+#define MLOGD(fmt, ...) MLOG_AT(MLOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define MLOGD(fmt, ...) do {} while (0)
+#endif
+
+// Requiere LittleFS montado; crea la tarea de volcado
+void mlog_begin();
+
+// Vuelca el anillo a LittleFS (bloqueante)
+void mlog_flush();
+
+// Antes de dormir: vuelca sólo si el anillo pasó de la mitad
+void mlog_sleep();
+
+// Texto de un registro (sólo válido con la misma imagen que lo generó).
+// Retorna la longitud escrita.
+size_t mlog_format(const uint8_t* rec, char* out, size_t cap);
+
+// Recorre los registros de /log.old y /log.bin generados por esta imagen
+typedef bool (*mlog_record_fn)(const uint8_t* rec, void* ctx);
+void mlog_scan(mlog_record_fn fn, void* ctx);
+
+// Registros descartados por anillo lleno o error de escritura
+uint32_t mlog_dropped();
+
+#endif
@@ -0,0 +1,80 @@
+#include "net_stats.h"
+
+typedef struct {
+  uint16_t hist[NET_PHASE_COUNT][NET_STATS_BUCKETS];
+  uint32_t last[NET_PHASE_COUNT];
+  uint16_t requests;
+  uint16_t fails;
+  uint16_t since_decay;
+} net_stats_rtc_t;
+
+// Persistente en deep sleep (se pone a cero en el arranque en frío)
+RTC_DATA_ATTR static net_stats_rtc_t net_rtc;
+
+static uint8_t net_bucket(uint32_t ms)
+{
+  if (ms == 0) return 0;
+  uint8_t b = 32 - __builtin_clz(ms);
+  return b < NET_STATS_BUCKETS ? b : NET_STATS_BUCKETS - 1;
+}
+
+static void net_add(uint8_t phase, uint32_t ms)
+{
+  net_rtc.last[phase] = ms;
+  if (ms == NET_MS_NONE) return;
+  uint16_t &c = net_rtc.hist[phase][net_bucket(ms)];
+  if (c < 0xFFFF) c++;
+}
+
+// Reduce todos los conteos a la mitad para que pesen más las muestras recientes
+static void net_decay()
+{
+  for (int p = 0; p < NET_PHASE_COUNT; p++) {
+    for (int b = 0; b < NET_STATS_BUCKETS; b++) net_rtc.hist[p][b] >>= 1;
+  }
+  net_rtc.requests >>= 1;
+  net_rtc.fails >>= 1;
+  net_rtc.since_decay = 0;
+}
+
+void net_stats_record(const net_sample_t* sample)
+{
+  for (int p = NET_PHASE_DNS; p < NET_PHASE_COUNT; p++) net_add(p, sample->ms[p]);
+  if (net_rtc.requests < 0xFFFF) net_rtc.requests++;
+  if (!sample->ok && net_rtc.fails < 0xFFFF) net_rtc.fails++;
+  if (++net_rtc.since_decay >= NET_STATS_DECAY_EVERY) net_decay();
+}
+
+void net_stats_record_assoc(uint32_t ms, bool ok)
+{
+  net_add(NET_PHASE_ASSOC, ok ? ms : NET_MS_NONE);
+}
+
+// Límite superior (ms) del bucket que contiene el percentil pct; -1 sin datos
+static int32_t net_percentile(uint8_t phase, uint8_t pct)
+{
+  uint32_t total = 0;
+  for (int b = 0; b < NET_STATS_BUCKETS; b++) total += net_rtc.hist[phase][b];
+  if (total == 0) return -1;
+  uint32_t target = (total * pct + 99) / 100;
+  uint32_t acc = 0;
+  for (int b = 0; b < NET_STATS_BUCKETS; b++) {
+    acc += net_rtc.hist[phase][b];
+    if (acc >= target) return b == 0 ? 1 : (int32_t)(1UL << b);
+  }
+  return (int32_t)(1UL << (NET_STATS_BUCKETS - 1));
+}
+
+void net_stats_summary(JsonObject out)
+{
+  out["n"] = net_rtc.requests;
+  out["fail"] = net_rtc.fails;
+  JsonArray p50 = out.createNestedArray("p50");
+  JsonArray p90 = out.createNestedArray("p90");
+  JsonArray last = out.createNestedArray("last");
+  for (int p = 0; p < NET_PHASE_COUNT; p++) {
+    p50.add(net_percentile(p, 50));
+    p90.add(net_percentile(p, 90));
+    last.add(net_rtc.last[p] == NET_MS_NONE ? -1 : (int32_t)net_rtc.last[p]);
+  }
+}
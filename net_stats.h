@@ -0,0 +1,44 @@
+#ifndef NET_STATS_H
+#define NET_STATS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Desglose de latencia del enlace de subida (POST al webhook).
+// Cada fase se acumula en un histograma log2 de milisegundos guardado en memoria
+// RTC, de modo que sobrevive al deep sleep y resume el comportamiento de la red
+// a lo largo de muchos despertares. Los conteos se reducen a la mitad cada
+// NET_STATS_DECAY_EVERY muestras (ventana móvil aproximada).
+
+typedef enum {
+  NET_PHASE_ASSOC = 0,      // Asociación WiFi hasta obtener IP
+  NET_PHASE_DNS,            // Resolución del host
+  NET_PHASE_CONNECT,        // Conexión TCP (sólo http)
+  NET_PHASE_TLS,            // Conexión TCP + handshake TLS (sólo https)
+  NET_PHASE_WRITE,          // Envío de encabezados y cuerpo
+  NET_PHASE_TTFB,           // Desde el fin del envío hasta el primer byte de respuesta
+  NET_PHASE_TOTAL,          // Petición completa (DNS .. fin de encabezados de respuesta)
+  NET_PHASE_COUNT
+} net_phase_t;
+
+#define NET_STATS_BUCKETS       13      // [0,1) [1,2) [2,4) ... [1024,2048) y >=2048 ms
+#define NET_STATS_DECAY_EVERY   64
+#define NET_MS_NONE             0xFFFFFFFFUL    // Fase no medida en esta petición
+
+typedef struct {
+  uint32_t ms[NET_PHASE_COUNT];
+  bool ok;
+} net_sample_t;
+
+// Registra una petición (las fases ASSOC y las no medidas se ignoran)
+void net_stats_record(const net_sample_t* sample);
+
+// Registra el tiempo de asociación WiFi de este despertar
+void net_stats_record_assoc(uint32_t ms, bool ok);
+
+// Añade al payload un resumen compacto:
+//   "net":{"n":..,"fail":..,"p50":[assoc,dns,conn,tls,write,ttfb,total],"p90":[...],"last":[...]}
+// Los percentiles son el límite superior del bucket (ms).
+void net_stats_summary(JsonObject out);
+
+#endif
@@ -0,0 +1,37 @@
+#include "oled_diff.h"
+#include <string.h>
+
+size_t oled_diff(uint8_t* prev, const uint8_t* next, bool full, oled_span_fn fn, void* ctx)
+{
+  size_t sent = 0;
+  for (uint8_t page = 0; page < OLED_PAGES; page++) {
+    uint8_t* p = prev + page * OLED_WIDTH;
+    const uint8_t* n = next + page * OLED_WIDTH;
+    if (full) {
+      memcpy(p, n, OLED_WIDTH);
+      fn(page, 0, OLED_WIDTH - 1, n, ctx);
+      sent += OLED_WIDTH;
+      continue;
+    }
+    int x = 0;
+    while (x < OLED_WIDTH) {
+      while (x < OLED_WIDTH && p[x] == n[x]) x++;
+      if (x == OLED_WIDTH) break;
+      // Extender el tramo mientras los huecos iguales sean cortos
+      int x0 = x, x1 = x, same = 0;
+      for (x = x0 + 1; x < OLED_WIDTH; x++) {
+        if (p[x] != n[x]) {
+          x1 = x;
+          same = 0;
+        } else if (++same > OLED_DIFF_MERGE_GAP) {
+          break;
+        }
+      }
+      memcpy(p + x0, n + x0, x1 - x0 + 1);
+      fn(page, (uint8_t)x0, (uint8_t)x1, n + x0, ctx);
+      sent += x1 - x0 + 1;
+      x = x1 + 1;
+    }
+  }
+  return sent;
+}
@@ -0,0 +1,27 @@
+#ifndef OLED_DIFF_H
+#define OLED_DIFF_H
+
+// Diferencias entre framebuffers del SSD1306 (128x64, 8 páginas de 8 filas;
+// un byte = una columna de 8 píxeles de una página). Compara el frame nuevo
+// con el último transmitido y entrega, por página, los tramos de columnas que
+// cambiaron. Dos tramos separados por hasta OLED_DIFF_MERGE_GAP columnas
+// iguales se envían juntos: reabrir la ventana de direcciones cuesta más que
+// reenviar esos bytes. No depende de Arduino.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define OLED_WIDTH          128
+#define OLED_PAGES          8
+#define OLED_FB_SIZE        (OLED_WIDTH * OLED_PAGES)
+#define OLED_DIFF_MERGE_GAP 10          // Comandos de ventana + encabezado I2C de datos
+
+// Tramo [x0, x1] de una página; data apunta a la columna x0 del frame nuevo
+typedef void (*oled_span_fn)(uint8_t page, uint8_t x0, uint8_t x1, const uint8_t* data, void* ctx);
+
+// Llama fn por cada tramo cambiado y lo copia a prev (prev queda igual a next).
+// Con full se entregan todas las páginas completas (panel en estado desconocido).
+// Retorna la cantidad de columnas entregadas; 0 si no hubo cambios.
+size_t oled_diff(uint8_t* prev, const uint8_t* next, bool full, oled_span_fn fn, void* ctx);
+
+#endif
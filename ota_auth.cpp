@@ -0,0 +1,188 @@
+#include "ota_auth.h"
+#include "moe_log.h"
+#include <Preferences.h>
+#include "esp_system.h"
+#include "mbedtls/sha256.h"
+
+#define OTA_AUTH_NS             "ota_auth"
+#define OTA_AUTH_DEFAULT_USER   "Telemetry"
+#define OTA_AUTH_DEFAULT_PASS   "Colombia123"
+#define OTA_AUTH_SALT_LEN       16
+#define OTA_AUTH_HASH_ROUNDS    1000        // Estiramiento de la clave; ~ms con el acelerador SHA
+
+typedef struct {
+  uint8_t token[OTA_AUTH_TOKEN_LEN / 2];
+  unsigned long last_used;
+  bool active;
+} ota_auth_session_t;
+
+// Caché de credenciales (se carga una vez en ota_auth_init)
+static char auth_user[OTA_AUTH_USER_MAX + 1] = OTA_AUTH_DEFAULT_USER;
+static uint8_t auth_salt[OTA_AUTH_SALT_LEN];
+static uint8_t auth_hash[32];
+static bool auth_loaded = false;
+
+static ota_auth_session_t auth_sessions[OTA_AUTH_MAX_SESSIONS];
+
+// SHA-256 iterado de sal | usuario | 0 | contraseña. El usuario forma parte del
+// hash para que una sola comparación cubra ambos campos.
+static void ota_auth_hash(const uint8_t* salt, const char* user, const char* pass, uint8_t* out)
+{
+  mbedtls_sha256_context sha;
+  const uint8_t sep = 0;
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts_ret(&sha, 0);
+  mbedtls_sha256_update_ret(&sha, salt, OTA_AUTH_SALT_LEN);
+  mbedtls_sha256_update_ret(&sha, (const uint8_t*)user, strlen(user));
+  mbedtls_sha256_update_ret(&sha, &sep, 1);
+  mbedtls_sha256_update_ret(&sha, (const uint8_t*)pass, strlen(pass));
+  mbedtls_sha256_finish_ret(&sha, out);
+  for (int i = 1; i < OTA_AUTH_HASH_ROUNDS; i++) {
+    mbedtls_sha256_starts_ret(&sha, 0);
+    mbedtls_sha256_update_ret(&sha, salt, OTA_AUTH_SALT_LEN);
+    mbedtls_sha256_update_ret(&sha, out, 32);
+    mbedtls_sha256_finish_ret(&sha, out);
+  }
+  mbedtls_sha256_free(&sha);
+}
+
+// Comparación sin salida temprana (tiempo independiente del contenido)
+static bool ota_auth_equal(const uint8_t* a, const uint8_t* b, size_t len)
+{
+  uint8_t diff = 0;
+  for (size_t i = 0; i < len; i++) diff |= a[i] ^ b[i];
+  return diff == 0;
+}
+
+static void ota_auth_clear_sessions()
+{
+  memset(auth_sessions, 0, sizeof(auth_sessions));
+}
+
+static void ota_auth_store(const char* user, const char* pass)
+{
+  esp_fill_random(auth_salt, sizeof(auth_salt));
+  ota_auth_hash(auth_salt, user, pass, auth_hash);
+  strlcpy(auth_user, user, sizeof(auth_user));
+
+  Preferences auth;
+  auth.begin(OTA_AUTH_NS, false);
+  auth.putString("user", auth_user);
+  auth.putBytes("salt", auth_salt, sizeof(auth_salt));
+  auth.putBytes("hash", auth_hash, sizeof(auth_hash));
+  auth.remove("pass");
+  auth.end();
+}
+
+void ota_auth_init()
+{
+  if (auth_loaded) return;
+  Preferences auth;
+  auth.begin(OTA_AUTH_NS, true);
+  String user = auth.getString("user", "");
+  bool hashed = auth.getBytes("salt", auth_salt, sizeof(auth_salt)) == sizeof(auth_salt) &&
+                auth.getBytes("hash", auth_hash, sizeof(auth_hash)) == sizeof(auth_hash);
+  String legacy_pass = hashed ? String() : auth.getString("pass", OTA_AUTH_DEFAULT_PASS);
+  auth.end();
+
+  if (user.length() == 0) {
+    ota_auth_store(OTA_AUTH_DEFAULT_USER, OTA_AUTH_DEFAULT_PASS);
+    MLOGI("[OTA][AUTH] Defaults stored");
+  } else if (!hashed) {
+    ota_auth_store(user.c_str(), legacy_pass.c_str());
+    MLOGI("[OTA][AUTH] Contraseña migrada a hash con sal");
+  } else {
+    strlcpy(auth_user, user.c_str(), sizeof(auth_user));
+  }
+  ota_auth_clear_sessions();
+  auth_loaded = true;
+}
+
+bool ota_auth_check(const char* user, const char* pass)
+{
+  uint8_t digest[32];
+  ota_auth_hash(auth_salt, user, pass, digest);
+  return ota_auth_equal(digest, auth_hash, sizeof(digest));
+}
+
+bool ota_auth_set(const char* user, const char* pass)
+{
+  // Truncarlo dejaría el hash calculado con un usuario distinto al guardado
+  size_t len = strlen(user);
+  if (len == 0 || len > OTA_AUTH_USER_MAX) return false;
+  ota_auth_store(user, pass);
+  ota_auth_clear_sessions();
+  MLOGI("[OTA][AUTH] Credentials updated");
+  return true;
+}
+
+void ota_auth_reset_defaults()
+{
+  ota_auth_set(OTA_AUTH_DEFAULT_USER, OTA_AUTH_DEFAULT_PASS);
+}
+
+const char* ota_auth_user()
+{
+  return auth_user;
+}
+
+static bool ota_auth_expired(const ota_auth_session_t &s)
+{
+  return !s.active || (millis() - s.last_used) > OTA_AUTH_SESSION_TTL_MS;
+}
+
+static bool ota_auth_parse_token(const char* token, uint8_t* out)
+{
+  if (!token || strlen(token) != OTA_AUTH_TOKEN_LEN) return false;
+  for (int i = 0; i < OTA_AUTH_TOKEN_LEN / 2; i++) {
+    if (!isxdigit((unsigned char)token[2 * i]) || !isxdigit((unsigned char)token[2 * i + 1])) return false;
+    char hex[3] = { token[2 * i], token[2 * i + 1], 0 };
+    out[i] = (uint8_t)strtoul(hex, NULL, 16);
+  }
+  return true;
+}
+
+static ota_auth_session_t* ota_auth_find(const char* token)
+{
+  uint8_t raw[OTA_AUTH_TOKEN_LEN / 2];
+  if (!ota_auth_parse_token(token, raw)) return NULL;
+  ota_auth_session_t* found = NULL;
+  // Se recorre toda la tabla para no revelar la posición de la sesión
+  for (int i = 0; i < OTA_AUTH_MAX_SESSIONS; i++) {
+    if (!ota_auth_expired(auth_sessions[i]) && ota_auth_equal(raw, auth_sessions[i].token, sizeof(raw))) {
+      found = &auth_sessions[i];
+    }
+  }
+  return found;
+}
+
+bool ota_auth_login(const char* user, const char* pass, char* token_out)
+{
+  if (!ota_auth_check(user, pass)) return false;
+
+  // Slot libre o vencido; si no hay, se reemplaza la sesión usada hace más tiempo
+  ota_auth_session_t* slot = &auth_sessions[0];
+  for (int i = 0; i < OTA_AUTH_MAX_SESSIONS; i++) {
+    if (ota_auth_expired(auth_sessions[i])) { slot = &auth_sessions[i]; break; }
+    if (auth_sessions[i].last_used < slot->last_used) slot = &auth_sessions[i];
+  }
+  esp_fill_random(slot->token, sizeof(slot->token));
+  slot->last_used = millis();
+  slot->active = true;
+  for (int i = 0; i < OTA_AUTH_TOKEN_LEN / 2; i++) snprintf(token_out + 2 * i, 3, "%02x", slot->token[i]);
+  return true;
+}
+
+bool ota_auth_session_valid(const char* token)
+{
+  ota_auth_session_t* s = ota_auth_find(token);
+  if (!s) return false;
+  s->last_used = millis();
+  return true;
+}
+
+void ota_auth_logout(const char* token)
+{
+  ota_auth_session_t* s = ota_auth_find(token);
+  if (s) memset(s, 0, sizeof(*s));
+}
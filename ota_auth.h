@@ -0,0 +1,46 @@
+#ifndef OTA_AUTH_H
+#define OTA_AUTH_H
+
+#include <Arduino.h>
+
+// Autenticación de la interfaz OTA.
+// Las credenciales se leen de NVS (namespace "ota_auth") una sola vez en
+// ota_auth_init() y se guardan como SHA-256 con sal (acelerador SHA por
+// hardware). Un login correcto entrega un token de sesión de vida corta que
+// las rutas que modifican estado validan contra una tabla en RAM, sin
+// accesos a NVS durante la petición.
+// Las funciones de sesión se llaman sólo desde la tarea OTA (sin bloqueo).
+
+#define OTA_AUTH_TOKEN_LEN      32          // Caracteres hex del token (16 bytes aleatorios)
+#define OTA_AUTH_MAX_SESSIONS   4
+#define OTA_AUTH_SESSION_TTL_MS (15UL * 60UL * 1000UL)   // Se renueva con cada uso
+#define OTA_AUTH_HEADER         "X-Auth-Token"
+#define OTA_AUTH_USER_MAX       32          // Caracteres del usuario (caché y NVS)
+
+// Carga las credenciales en RAM. Crea las de fábrica si no existen y migra
+// una contraseña guardada en texto plano al formato con sal.
+void ota_auth_init();
+
+// Compara usuario y contraseña en tiempo constante contra la caché
+bool ota_auth_check(const char* user, const char* pass);
+
+// Guarda credenciales nuevas (NVS + caché) e invalida todas las sesiones.
+// false (sin cambios) si el usuario está vacío o supera OTA_AUTH_USER_MAX.
+bool ota_auth_set(const char* user, const char* pass);
+
+// Restaura las credenciales de fábrica
+void ota_auth_reset_defaults();
+
+// Usuario actual (desde la caché)
+const char* ota_auth_user();
+
+// Verifica credenciales y abre una sesión. token_out recibe
+// OTA_AUTH_TOKEN_LEN + 1 caracteres. false si son incorrectas.
+bool ota_auth_login(const char* user, const char* pass, char* token_out);
+
+// true si el token corresponde a una sesión vigente (y la renueva)
+bool ota_auth_session_valid(const char* token);
+
+void ota_auth_logout(const char* token);
+
+#endif
@@ -0,0 +1,302 @@
+#include "ota_decompress.h"
+#include "moe_log.h"
+#include "heatshrink_dec.h"
+#include "rom/miniz.h"
+#include "esp_rom_crc.h"
+#include "esp_heap_caps.h"
+
+// Encabezado del contenedor heatshrink: "MOEH" | window_bits | lookahead_bits | 0 0 | tamaño(u32 LE)
+#define HS_HEADER_SIZE    12
+#define GZ_HEADER_SIZE    10
+#define GZ_TRAILER_SIZE   8
+
+// Banderas del encabezado gzip (RFC 1952)
+#define GZ_FHCRC          0x02
+#define GZ_FEXTRA         0x04
+#define GZ_FNAME          0x08
+#define GZ_FCOMMENT       0x10
+
+enum {
+  DEC_S_HEADER = 0,
+  DEC_S_GZ_XLEN,
+  DEC_S_GZ_SKIP,
+  DEC_S_GZ_ZSTRING,
+  DEC_S_BODY,
+  DEC_S_TRAILER,
+  DEC_S_DONE,
+  DEC_S_ERROR
+};
+
+static uint8_t dec_kind = OTA_COMP_NONE;
+static uint8_t dec_state = DEC_S_ERROR;
+static ota_decompress_sink_fn dec_sink = NULL;
+static const char* dec_error = "";
+static bool dec_no_memory = false;
+
+// Encabezado / trailer en curso
+static uint8_t dec_hdr[HS_HEADER_SIZE];
+static uint8_t dec_hdr_len = 0;
+static uint8_t dec_gz_flags = 0;
+static uint16_t dec_skip = 0;
+
+// gzip: inflador de la ROM (miniz) con diccionario circular de 32KB
+static tinfl_decompressor* dec_inflator = NULL;
+static uint8_t* dec_dict = NULL;
+static size_t dec_dict_ofs = 0;
+static uint32_t dec_crc = 0;
+static uint32_t dec_out_total = 0;
+
+// heatshrink: ventana de 2^W bytes
+static hs_decoder_t* dec_hs = NULL;
+static uint8_t* dec_hs_window = NULL;
+
+static bool dec_fail(const char* msg)
+{
+  dec_error = msg;
+  dec_state = DEC_S_ERROR;
+  return false;
+}
+
+static bool dec_hs_write(void* ctx, const uint8_t* buf, size_t len)
+{
+  return dec_sink(buf, len);
+}
+
+static uint32_t dec_read_u32(const uint8_t* b)
+{
+  return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+uint8_t ota_decompress_detect(const uint8_t* data, size_t len)
+{
+  if (len >= 2 && data[0] == 0x1F && data[1] == 0x8B) return OTA_COMP_GZIP;
+  if (len >= 4 && memcmp(data, "MOEH", 4) == 0) return OTA_COMP_HEATSHRINK;
+  return OTA_COMP_NONE;
+}
+
+bool ota_decompress_begin(uint8_t kind, ota_decompress_sink_fn sink)
+{
+  ota_decompress_end();
+  dec_kind = kind;
+  dec_sink = sink;
+  dec_error = "";
+  dec_no_memory = false;
+  dec_hdr_len = 0;
+  dec_state = DEC_S_HEADER;
+
+  if (kind == OTA_COMP_GZIP) {
+    // El diccionario necesita un bloque contiguo y no debe dejar al resto del
+    // sistema (WebServer, WiFi) sin heap durante la carga
+    size_t need = sizeof(tinfl_decompressor) + TINFL_LZ_DICT_SIZE;
+    if (heap_caps_get_largest_free_block(MALLOC_CAP_8BIT) < TINFL_LZ_DICT_SIZE ||
+        heap_caps_get_free_size(MALLOC_CAP_8BIT) < need + OTA_GZIP_HEAP_MARGIN) {
+      MLOGW("[OTA_DEC] gzip rechazado: heap libre %u, bloque max %u, necesita %u",
+            (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+            (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT), (unsigned)need);
+      dec_no_memory = true;
+      return dec_fail("sin memoria para inflate (usar heatshrink)");
+    }
+    dec_inflator = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+    dec_dict = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+    if (!dec_inflator || !dec_dict) {
+      ota_decompress_end();
+      dec_no_memory = true;
+      return dec_fail("sin memoria para inflate (usar heatshrink)");
+    }
+    tinfl_init(dec_inflator);
+    dec_dict_ofs = 0;
+    dec_crc = 0;
+    dec_out_total = 0;
+  } else if (kind == OTA_COMP_HEATSHRINK) {
+    // La ventana se reserva al leer el encabezado (depende de window_bits)
+  } else {
+    return dec_fail("formato de compresion desconocido");
+  }
+  MLOGI("[OTA_DEC] begin: %s", kind == OTA_COMP_GZIP ? "gzip" : "heatshrink");
+  return true;
+}
+
+// Siguiente campo opcional del encabezado gzip según las banderas pendientes
+static void dec_gz_next_header_field()
+{
+  if (dec_gz_flags & GZ_FEXTRA) {
+    dec_gz_flags &= ~GZ_FEXTRA;
+    dec_hdr_len = 0;
+    dec_state = DEC_S_GZ_XLEN;
+  } else if (dec_gz_flags & GZ_FNAME) {
+    dec_gz_flags &= ~GZ_FNAME;
+    dec_state = DEC_S_GZ_ZSTRING;
+  } else if (dec_gz_flags & GZ_FCOMMENT) {
+    dec_gz_flags &= ~GZ_FCOMMENT;
+    dec_state = DEC_S_GZ_ZSTRING;
+  } else if (dec_gz_flags & GZ_FHCRC) {
+    dec_gz_flags &= ~GZ_FHCRC;
+    dec_skip = 2;
+    dec_state = DEC_S_GZ_SKIP;
+  } else {
+    dec_state = DEC_S_BODY;
+  }
+}
+
+static bool dec_parse_header()
+{
+  if (dec_kind == OTA_COMP_GZIP) {
+    if (dec_hdr[0] != 0x1F || dec_hdr[1] != 0x8B || dec_hdr[2] != 8) return dec_fail("encabezado gzip invalido");
+    dec_gz_flags = dec_hdr[3];
+    dec_gz_next_header_field();
+    return true;
+  }
+
+  uint8_t w = dec_hdr[4];
+  uint8_t l = dec_hdr[5];
+  uint32_t size = dec_read_u32(dec_hdr + 8);
+  if (w < HS_MIN_WINDOW_BITS || w > HS_MAX_WINDOW_BITS) return dec_fail("ventana heatshrink no soportada");
+  dec_hs = (hs_decoder_t*)malloc(sizeof(hs_decoder_t));
+  dec_hs_window = (uint8_t*)malloc((size_t)1 << w);
+  if (!dec_hs || !dec_hs_window) {
+    dec_no_memory = true;
+    return dec_fail("sin memoria para heatshrink");
+  }
+  if (!hs_decoder_init(dec_hs, w, l, dec_hs_window, size, dec_hs_write, NULL)) return dec_fail(dec_hs->error);
+  MLOGI("[OTA_DEC] heatshrink: ventana=%u bytes, tamano=%u", (unsigned)(1u << w), (unsigned)size);
+  dec_state = DEC_S_BODY;
+  return true;
+}
+
+// Infla un bloque; retorna los bytes de entrada consumidos o -1 ante error
+static int dec_inflate(const uint8_t* data, size_t len)
+{
+  size_t consumed = 0;
+  while (true)
+  {
+    size_t in_bytes = len - consumed;
+    size_t out_bytes = TINFL_LZ_DICT_SIZE - dec_dict_ofs;
+    tinfl_status st = tinfl_decompress(dec_inflator, data + consumed, &in_bytes, dec_dict, dec_dict + dec_dict_ofs,
+                                       &out_bytes, TINFL_FLAG_HAS_MORE_INPUT);
+    consumed += in_bytes;
+
+    if (out_bytes > 0) {
+      dec_crc = esp_rom_crc32_le(dec_crc, dec_dict + dec_dict_ofs, out_bytes);
+      dec_out_total += out_bytes;
+      if (!dec_sink(dec_dict + dec_dict_ofs, out_bytes)) {
+        dec_fail("error escribiendo salida");
+        return -1;
+      }
+      dec_dict_ofs = (dec_dict_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+    }
+
+    if (st < TINFL_STATUS_DONE) {
+      dec_fail("flujo deflate corrupto");
+      return -1;
+    }
+    if (st == TINFL_STATUS_DONE) {
+      dec_hdr_len = 0;
+      dec_state = DEC_S_TRAILER;
+      return (int)consumed;
+    }
+    // Sin más salida pendiente y toda la entrada consumida: esperar el siguiente bloque
+    if (st == TINFL_STATUS_NEEDS_MORE_INPUT && consumed == len) return (int)consumed;
+  }
+}
+
+bool ota_decompress_feed(const uint8_t* data, size_t len)
+{
+  size_t i = 0;
+  while (i < len)
+  {
+    switch (dec_state)
+    {
+      case DEC_S_HEADER: {
+        size_t want = (dec_kind == OTA_COMP_GZIP) ? GZ_HEADER_SIZE : HS_HEADER_SIZE;
+        size_t n = min(want - dec_hdr_len, len - i);
+        memcpy(dec_hdr + dec_hdr_len, data + i, n);
+        dec_hdr_len += n;
+        i += n;
+        if (dec_hdr_len == want && !dec_parse_header()) return false;
+        break;
+      }
+
+      case DEC_S_GZ_XLEN:
+        dec_hdr[dec_hdr_len++] = data[i++];
+        if (dec_hdr_len == 2) {
+          dec_skip = (uint16_t)(dec_hdr[0] | (dec_hdr[1] << 8));
+          if (dec_skip > 0) dec_state = DEC_S_GZ_SKIP;
+          else dec_gz_next_header_field();
+        }
+        break;
+
+      case DEC_S_GZ_SKIP: {
+        size_t n = min((size_t)dec_skip, len - i);
+        i += n;
+        dec_skip -= n;
+        if (dec_skip == 0) dec_gz_next_header_field();
+        break;
+      }
+
+      case DEC_S_GZ_ZSTRING:
+        if (data[i++] == 0) dec_gz_next_header_field();
+        break;
+
+      case DEC_S_BODY:
+        if (dec_kind == OTA_COMP_GZIP) {
+          int used = dec_inflate(data + i, len - i);
+          if (used < 0) return false;
+          i += used;
+        } else {
+          if (!hs_decoder_feed(dec_hs, data + i, len - i)) return dec_fail(dec_hs->error);
+          i = len;
+          if (hs_decoder_done(dec_hs)) dec_state = DEC_S_DONE;
+        }
+        break;
+
+      case DEC_S_TRAILER: {
+        size_t n = min((size_t)(GZ_TRAILER_SIZE - dec_hdr_len), len - i);
+        memcpy(dec_hdr + dec_hdr_len, data + i, n);
+        dec_hdr_len += n;
+        i += n;
+        if (dec_hdr_len == GZ_TRAILER_SIZE) {
+          if (dec_read_u32(dec_hdr) != dec_crc) return dec_fail("CRC32 gzip no coincide");
+          if (dec_read_u32(dec_hdr + 4) != dec_out_total) return dec_fail("tamano gzip no coincide");
+          dec_state = DEC_S_DONE;
+        }
+        break;
+      }
+
+      case DEC_S_DONE:
+        return dec_fail("datos despues del final del archivo comprimido");
+
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+bool ota_decompress_finish()
+{
+  if (dec_state == DEC_S_DONE) return true;
+  if (dec_state != DEC_S_ERROR) dec_fail("archivo comprimido incompleto");
+  return false;
+}
+
+void ota_decompress_end()
+{
+  free(dec_inflator);
+  free(dec_dict);
+  free(dec_hs);
+  free(dec_hs_window);
+  dec_inflator = NULL;
+  dec_dict = NULL;
+  dec_hs = NULL;
+  dec_hs_window = NULL;
+}
+
+const char* ota_decompress_error()
+{
+  return dec_error;
+}
+
+bool ota_decompress_out_of_memory()
+{
+  return dec_no_memory;
+}
@@ -0,0 +1,41 @@
+#ifndef OTA_DECOMPRESS_H
+#define OTA_DECOMPRESS_H
+
+#include <Arduino.h>
+
+// Formatos de compresión aceptados en /update (detectados por magic)
+#define OTA_COMP_NONE         0
+#define OTA_COMP_GZIP         1     // 1F 8B: deflate estándar (ventana de 32KB)
+#define OTA_COMP_HEATSHRINK   2     // "MOEH": contenedor heatshrink (ventana 2^W, ver tools/moe_compress.py)
+
+#define OTA_COMP_SNIFF_LEN    4
+
+// gzip reserva ~43KB de heap (diccionario contiguo de 32KB + estado de tinfl):
+// se rechaza si después de reservarlo no quedaría este margen libre
+#define OTA_GZIP_HEAP_MARGIN  (24 * 1024)
+
+// Destino de los bytes descomprimidos
+typedef bool (*ota_decompress_sink_fn)(const uint8_t* data, size_t len);
+
+// Formato según los primeros OTA_COMP_SNIFF_LEN bytes
+uint8_t ota_decompress_detect(const uint8_t* data, size_t len);
+
+// Reserva la ventana y el estado del descompresor en heap (fuera de la pila de
+// la tarea OTA). Retorna false si no hay memoria.
+bool ota_decompress_begin(uint8_t kind, ota_decompress_sink_fn sink);
+
+// true si el último begin/encabezado falló por falta de heap
+bool ota_decompress_out_of_memory();
+
+// Consume datos comprimidos y entrega la salida al sink de forma incremental
+bool ota_decompress_feed(const uint8_t* data, size_t len);
+
+// true si el flujo terminó correctamente (tamaño/CRC del contenedor verificados)
+bool ota_decompress_finish();
+
+// Libera la memoria del descompresor
+void ota_decompress_end();
+
+const char* ota_decompress_error();
+
+#endif
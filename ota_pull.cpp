@@ -0,0 +1,385 @@
+#include "ota_pull.h"
+#include "moe_log.h"
+#include "config.h"
+#include "config_store.h"
+#include "task_config.h"
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <Preferences.h>
+#include <ArduinoJson.h>
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "mbedtls/sha256.h"
+#include "esp_rom_crc.h"
+
+#define OTA_PULL_NS                   "ota_pull"
+#define OTA_PULL_SECTOR_SIZE          4096
+#define OTA_PULL_CHUNK_SIZE           16384       // Bytes por petición Range (4 sectores)
+#define OTA_PULL_CHECK_EVERY_WAKES    36          // Consultar manifiesto cada 36 despertares (~6h a 10min)
+#define OTA_PULL_WAKE_BUDGET_MS       8000        // Tiempo máximo de descarga por despertar
+#define OTA_PULL_HTTP_TIMEOUT_MS      5000
+#define OTA_PULL_TASK_BUDGET_MS       60000
+#define OTA_PULL_RTC_MAGIC            0x31504F4DUL    // "MOP1"
+
+typedef struct {
+  char version[16];
+  char sha256[65];
+  char url[160];
+  char part[17];            // Etiqueta de la partición destino
+  uint32_t size;
+  uint32_t offset;          // Bytes ya escritos (múltiplo de sector)
+} ota_pull_job_t;
+
+typedef struct {
+  uint32_t magic;
+  bool has_job;
+  ota_pull_job_t job;
+  uint32_t crc;                 // CRC32 de has_job + job
+} ota_pull_rtc_t;
+
+// Contador de despertares y espejo del trabajo, persistentes en deep sleep: sin
+// descarga pendiente un despertar no abre NVS (en arranque en frío magic = 0)
+RTC_DATA_ATTR static uint16_t ota_pull_wakes = 0;
+RTC_DATA_ATTR static ota_pull_rtc_t pull_rtc;
+
+static ota_pull_job_t pull_job;
+static ota_pull_result_t pull_state = OTA_PULL_IDLE;
+static const char* pull_error = "";
+static TaskHandle_t pull_task_handle = NULL;
+static uint8_t pull_buf[1024];
+
+static ota_pull_result_t ota_pull_fail(const char* msg)
+{
+  pull_error = msg;
+  pull_state = OTA_PULL_ERROR;
+  MLOGE("[OTA_PULL] ERROR: %s", msg);
+  return pull_state;
+}
+
+// --- Persistencia del trabajo en NVS, reflejada en RTC ---
+static uint32_t ota_pull_rtc_crc()
+{
+  uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*)&pull_rtc.has_job, sizeof(pull_rtc.has_job));
+  return esp_rom_crc32_le(crc, (const uint8_t*)&pull_rtc.job, sizeof(pull_rtc.job));
+}
+
+static void ota_pull_rtc_set(const ota_pull_job_t* job)
+{
+  pull_rtc.has_job = job != NULL;
+  if (job) pull_rtc.job = *job;
+  else memset(&pull_rtc.job, 0, sizeof(pull_rtc.job));
+  pull_rtc.crc = ota_pull_rtc_crc();
+  pull_rtc.magic = OTA_PULL_RTC_MAGIC;
+}
+
+static bool ota_pull_load_job_nvs(ota_pull_job_t* job)
+{
+  Preferences prefs;
+  prefs.begin(OTA_PULL_NS, true);
+  bool exists = prefs.isKey("sha");
+  if (exists) {
+    prefs.getString("ver", job->version, sizeof(job->version));
+    prefs.getString("sha", job->sha256, sizeof(job->sha256));
+    prefs.getString("url", job->url, sizeof(job->url));
+    prefs.getString("part", job->part, sizeof(job->part));
+    job->size = prefs.getUInt("size", 0);
+    job->offset = prefs.getUInt("off", 0);
+  }
+  prefs.end();
+  return exists;
+}
+
+static bool ota_pull_load_job(ota_pull_job_t* job)
+{
+  if (pull_rtc.magic != OTA_PULL_RTC_MAGIC || pull_rtc.crc != ota_pull_rtc_crc()) {
+    ota_pull_job_t nvs;
+    memset(&nvs, 0, sizeof(nvs));
+    ota_pull_rtc_set(ota_pull_load_job_nvs(&nvs) ? &nvs : NULL);
+  }
+  if (pull_rtc.has_job) *job = pull_rtc.job;
+  return pull_rtc.has_job;
+}
+
+static void ota_pull_save_job(const ota_pull_job_t* job)
+{
+  Preferences prefs;
+  prefs.begin(OTA_PULL_NS, false);
+  prefs.putString("ver", job->version);
+  prefs.putString("sha", job->sha256);
+  prefs.putString("url", job->url);
+  prefs.putString("part", job->part);
+  prefs.putUInt("size", job->size);
+  prefs.putUInt("off", job->offset);
+  prefs.end();
+  ota_pull_rtc_set(job);
+}
+
+// En NVS además de RTC: la descarga continúa tras un corte de energía
+static void ota_pull_save_offset(uint32_t offset)
+{
+  Preferences prefs;
+  prefs.begin(OTA_PULL_NS, false);
+  prefs.putUInt("off", offset);
+  prefs.end();
+  pull_rtc.job.offset = offset;
+  pull_rtc.crc = ota_pull_rtc_crc();
+}
+
+static void ota_pull_clear_job()
+{
+  Preferences prefs;
+  prefs.begin(OTA_PULL_NS, false);
+  prefs.clear();
+  prefs.end();
+  ota_pull_rtc_set(NULL);
+}
+
+// Descarga y parsea el manifiesto. url relativa se resuelve contra la del manifiesto.
+static bool ota_pull_fetch_manifest(ota_pull_job_t* out)
+{
+  HTTPClient http;
+  http.begin(ota_manifest_url);
+  http.setTimeout(OTA_PULL_HTTP_TIMEOUT_MS);
+  int code = http.GET();
+  if (code != 200) {
+    http.end();
+    MLOGI("[OTA_PULL] manifiesto: HTTP %d", code);
+    return false;
+  }
+
+  StaticJsonDocument<384> doc;
+  DeserializationError err = deserializeJson(doc, http.getStream());
+  http.end();
+  if (err) return false;
+
+  const char* ver = doc["version"] | "";
+  const char* sha = doc["sha256"] | "";
+  const char* url = doc["url"] | "";
+  uint32_t size = doc["size"] | 0;
+  if (ver[0] == '\0' || strlen(sha) != 64 || url[0] == '\0' || size == 0) return false;
+
+  memset(out, 0, sizeof(*out));
+  strlcpy(out->version, ver, sizeof(out->version));
+  strlcpy(out->sha256, sha, sizeof(out->sha256));
+  out->size = size;
+  if (strncmp(url, "http://", 7) == 0 || strncmp(url, "https://", 8) == 0) {
+    strlcpy(out->url, url, sizeof(out->url));
+  } else {
+    String base = ota_manifest_url.substring(0, ota_manifest_url.lastIndexOf('/') + 1);
+    strlcpy(out->url, (base + url).c_str(), sizeof(out->url));
+  }
+  return true;
+}
+
+// Descarga un bloque Range en job->offset. Escribe directo en la partición.
+static bool ota_pull_download_chunk(const esp_partition_t* part, ota_pull_job_t* job)
+{
+  uint32_t want = min((uint32_t)OTA_PULL_CHUNK_SIZE, job->size - job->offset);
+  uint32_t last = job->offset + want - 1;
+
+  HTTPClient http;
+  http.begin(job->url);
+  http.setTimeout(OTA_PULL_HTTP_TIMEOUT_MS);
+  char range[40];
+  snprintf(range, sizeof(range), "bytes=%u-%u", (unsigned)job->offset, (unsigned)last);
+  http.addHeader("Range", range);
+  int code = http.GET();
+  // Un servidor sin soporte de Range responde 200 con el archivo completo:
+  // sólo sirve para el primer bloque (se lee el prefijo y se corta la conexión)
+  if (code != 206 && !(code == 200 && job->offset == 0)) {
+    http.end();
+    MLOGI("[OTA_PULL] Range %s: HTTP %d", range, code);
+    return false;
+  }
+
+  // Borrar los sectores del bloque (offset siempre alineado a sector)
+  uint32_t erase_len = (want + OTA_PULL_SECTOR_SIZE - 1) & ~(OTA_PULL_SECTOR_SIZE - 1);
+  if (esp_partition_erase_range(part, job->offset, erase_len) != ESP_OK) {
+    http.end();
+    return false;
+  }
+
+  WiFiClient* stream = http.getStreamPtr();
+  uint32_t got = 0;
+  unsigned long last_data = millis();
+  bool write_ok = true;
+  while (got < want && write_ok && (millis() - last_data) < OTA_PULL_HTTP_TIMEOUT_MS)
+  {
+    size_t avail = stream->available();
+    if (avail == 0) {
+      if (!http.connected()) break;
+      delay(1);
+      continue;
+    }
+    size_t n = stream->readBytes(pull_buf, min(avail, min(sizeof(pull_buf), (size_t)(want - got))));
+    write_ok = esp_partition_write(part, job->offset + got, pull_buf, n) == ESP_OK;
+    got += n;
+    last_data = millis();
+  }
+  http.end();
+
+  // Un bloque incompleto conserva los sectores completos recibidos
+  uint32_t advance = (got == want) ? want : (got & ~(OTA_PULL_SECTOR_SIZE - 1));
+  if (!write_ok) advance = 0;
+  job->offset += advance;
+  ota_pull_save_offset(job->offset);
+  return write_ok && got == want;
+}
+
+// Verifica el SHA-256 de lo escrito en la partición y la marca para arrancar
+static bool ota_pull_finish(const esp_partition_t* part, const ota_pull_job_t* job)
+{
+  mbedtls_sha256_context sha;
+  uint8_t digest[32];
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts_ret(&sha, 0);
+  bool read_ok = true;
+  for (uint32_t off = 0; off < job->size && read_ok; off += sizeof(pull_buf)) {
+    uint32_t n = min((uint32_t)sizeof(pull_buf), job->size - off);
+    read_ok = esp_partition_read(part, off, pull_buf, n) == ESP_OK;
+    if (read_ok) mbedtls_sha256_update_ret(&sha, pull_buf, n);
+  }
+  mbedtls_sha256_finish_ret(&sha, digest);
+  mbedtls_sha256_free(&sha);
+
+  char hex[65];
+  for (int i = 0; i < 32; i++) snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+  if (!read_ok || strcasecmp(hex, job->sha256) != 0) return false;
+
+  // esp_ota_set_boot_partition valida además el formato de la imagen
+  return esp_ota_set_boot_partition(part) == ESP_OK;
+}
+
+// check = false reanuda el trabajo guardado sin consultar el manifiesto (salvo
+// que no haya trabajo)
+static ota_pull_result_t ota_pull_run(uint32_t budget_ms, bool check)
+{
+  unsigned long start = millis();
+  pull_error = "";
+  if (WiFi.status() != WL_CONNECTED) return ota_pull_fail("sin WiFi");
+
+  const esp_partition_t* part = esp_ota_get_next_update_partition(NULL);
+  if (!part) return ota_pull_fail("sin particion OTA");
+
+  bool has_job = ota_pull_load_job(&pull_job);
+  ota_pull_job_t manifest;
+  bool has_manifest = (check || !has_job) && ota_pull_fetch_manifest(&manifest);
+
+  if (has_manifest) {
+    if (strcmp(manifest.version, FIRMWARE_VERSION) == 0) {
+      if (has_job) ota_pull_clear_job();
+      pull_state = OTA_PULL_UP_TO_DATE;
+      return pull_state;
+    }
+    // Trabajo nuevo si no había, si el manifiesto cambió o si cambió la partición destino
+    if (!has_job || strcasecmp(manifest.sha256, pull_job.sha256) != 0 || strcmp(pull_job.part, part->label) != 0) {
+      if (manifest.size > part->size) return ota_pull_fail("imagen mayor que la particion");
+      pull_job = manifest;
+      strlcpy(pull_job.part, part->label, sizeof(pull_job.part));
+      pull_job.offset = 0;
+      ota_pull_save_job(&pull_job);
+      has_job = true;
+      MLOGI("[OTA_PULL] Nueva version %s (%u bytes)", pull_job.version, (unsigned)pull_job.size);
+    }
+  } else if (!has_job) {
+    return ota_pull_fail("manifiesto no disponible");
+  }
+
+  if (pull_job.offset > 0) {
+    MLOGI("[OTA_PULL] Reanudando %s en %u/%u", pull_job.version, (unsigned)pull_job.offset, (unsigned)pull_job.size);
+  }
+
+  pull_state = OTA_PULL_IN_PROGRESS;
+  while (pull_job.offset < pull_job.size)
+  {
+    if (millis() - start >= budget_ms) {
+      MLOGW("[OTA_PULL] Presupuesto agotado: %u/%u bytes", (unsigned)pull_job.offset, (unsigned)pull_job.size);
+      return pull_state;
+    }
+    if (!ota_pull_download_chunk(part, &pull_job)) return ota_pull_fail("descarga interrumpida");
+  }
+
+  if (!ota_pull_finish(part, &pull_job)) {
+    // Imagen corrupta: descartar el progreso para descargarla de nuevo
+    ota_pull_clear_job();
+    return ota_pull_fail("verificacion de imagen fallida");
+  }
+  ota_pull_clear_job();
+  MLOGI("[OTA_PULL] Version %s verificada y lista para arrancar", pull_job.version);
+  pull_state = OTA_PULL_READY;
+  return pull_state;
+}
+
+ota_pull_result_t ota_pull_step(uint32_t budget_ms)
+{
+  return ota_pull_run(budget_ms, true);
+}
+
+ota_pull_result_t ota_pull_on_wake(int battery_pct)
+{
+  ota_pull_wakes++;
+  bool due = ota_pull_wakes >= OTA_PULL_CHECK_EVERY_WAKES;
+  // Sólo el espejo RTC: NVS se lee en el arranque en frío
+  ota_pull_job_t job;
+  bool pending = ota_pull_load_job(&job);
+  if (!pending && !due) return OTA_PULL_IDLE;
+  if (battery_pct >= 0 && battery_pct < config_get_pull_min_battery()) return OTA_PULL_IDLE;
+  if (due) ota_pull_wakes = 0;
+  // Una descarga pendiente continúa sin volver a pedir el manifiesto hasta la próxima consulta
+  return ota_pull_run(OTA_PULL_WAKE_BUDGET_MS, due);
+}
+
+static void ota_pull_task(void* parameter)
+{
+  // El manifiesto se consulta una vez; luego sólo se reanuda el trabajo
+  ota_pull_result_t r = ota_pull_run(OTA_PULL_TASK_BUDGET_MS, true);
+  while (r == OTA_PULL_IN_PROGRESS) r = ota_pull_run(OTA_PULL_TASK_BUDGET_MS, false);
+
+  if (r == OTA_PULL_READY) {
+    MLOGI("[OTA_PULL] Reiniciando con la nueva imagen...");
+    delay(500);
+    ESP.restart();
+  }
+  pull_task_handle = NULL;
+  task_profile_detach(TASK_OTA_PULL);
+  vTaskDelete(NULL);
+}
+
+bool ota_pull_start_async()
+{
+  if (pull_task_handle != NULL) return false;
+  pull_state = OTA_PULL_IN_PROGRESS;
+  BaseType_t r = task_spawn(TASK_OTA_PULL, ota_pull_task, NULL, &pull_task_handle);
+  if (r != pdPASS) {
+    pull_task_handle = NULL;
+    ota_pull_fail("no se pudo crear tarea");
+    return false;
+  }
+  return true;
+}
+
+bool ota_pull_busy()
+{
+  return pull_task_handle != NULL;
+}
+
+void ota_pull_discard()
+{
+  if (ota_pull_busy()) return;
+  ota_pull_job_t job;
+  if (!ota_pull_load_job(&job)) return;
+  MLOGI("[OTA_PULL] Trabajo %s descartado por una carga directa", job.version);
+  ota_pull_clear_job();
+  memset(&pull_job, 0, sizeof(pull_job));
+  pull_state = OTA_PULL_IDLE;
+  pull_error = "";
+}
+
+void ota_pull_get_status(ota_pull_status_t* out)
+{
+  out->state = pull_state;
+  out->error = pull_error;
+  strlcpy(out->version, pull_job.version, sizeof(out->version));
+  out->offset = pull_job.offset;
+  out->size = pull_job.size;
+}
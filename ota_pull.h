@@ -0,0 +1,53 @@
+#ifndef OTA_PULL_H
+#define OTA_PULL_H
+
+#include <Arduino.h>
+
+// Actualización por descarga (pull) desde un servidor HTTP local.
+// El dispositivo consulta un manifiesto JSON:
+//   {"version":"1.3.0","size":1234567,"sha256":"<hex>","url":"firmware.bin"}
+// y descarga la imagen con peticiones HTTP Range por bloques, escribiéndola
+// directamente en la partición OTA inactiva. El progreso se guarda en NVS, así
+// una descarga interrumpida continúa en el siguiente despertar; el trabajo se
+// refleja en RTC y los despertares sin descarga pendiente no abren NVS.
+
+typedef enum {
+  OTA_PULL_IDLE = 0,        // Sin descarga pendiente
+  OTA_PULL_UP_TO_DATE,      // El manifiesto anuncia la versión actual
+  OTA_PULL_IN_PROGRESS,     // Se agotó el presupuesto de tiempo; continúa luego
+  OTA_PULL_READY,           // Imagen verificada y marcada para arrancar (reiniciar)
+  OTA_PULL_ERROR
+} ota_pull_result_t;
+
+typedef struct {
+  ota_pull_result_t state;
+  char version[16];
+  uint32_t offset;
+  uint32_t size;
+  const char* error;
+} ota_pull_status_t;
+
+// Descarga (o reanuda) durante a lo sumo budget_ms. Bloqueante.
+ota_pull_result_t ota_pull_step(uint32_t budget_ms);
+
+// Política para despertares programados (modo normal): reanuda descargas
+// pendientes (sin volver a pedir el manifiesto) y consulta el manifiesto cada
+// OTA_PULL_CHECK_EVERY_WAKES despertares.
+// Requiere WiFi conectado. Retorna OTA_PULL_READY si hay que reiniciar.
+ota_pull_result_t ota_pull_on_wake(int battery_pct);
+
+// Lanza la descarga completa en una tarea propia (comando desde la UI OTA).
+// Al terminar con éxito el dispositivo reinicia con la nueva imagen.
+bool ota_pull_start_async();
+
+// true mientras corre la tarea de ota_pull_start_async (escribe la partición inactiva)
+bool ota_pull_busy();
+
+// Descarta el trabajo guardado (una carga directa reemplaza la partición
+// inactiva: reanudarlo la volvería a escribir). No hace nada con la tarea en curso.
+void ota_pull_discard();
+
+// Estado para la UI
+void ota_pull_get_status(ota_pull_status_t* out);
+
+#endif
@@ -0,0 +1,512 @@
+#include "ota_stream.h"
+#include "moe_log.h"
+#include "delta_patch.h"
+#include "ota_decompress.h"
+#include "task_config.h"
+#include <Update.h>
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "mbedtls/sha256.h"
+
+// Cada buffer cubre un sector de flash: Update borra y escribe por sectores de 4KB,
+// así cada entrega a la tarea escritora corresponde a un borrado + escritura.
+#define OTA_STREAM_BUF_SIZE       4096
+#define OTA_STREAM_BUF_COUNT      2
+// Si la escritura a flash no libera un buffer en este tiempo, se aborta la carga
+#define OTA_STREAM_STALL_TIMEOUT  5000
+
+typedef struct {
+  uint8_t data[OTA_STREAM_BUF_SIZE];
+  size_t len;
+} ota_stream_buffer_t;
+
+// Buffers en heap (no en la pila de 8KB de la tarea OTA); se liberan al terminar
+static ota_stream_buffer_t* ota_bufs = NULL;
+static int ota_fill_idx = -1;
+// Buffers que la tarea escritora no devolvió al abortar (flash bloqueada): se
+// conservan y la carga siguiente espera a recuperarlos antes de reiniciar las colas
+static uint8_t ota_bufs_out = 0;
+
+// Colas de índices: receptor -> escritor (llenos) y escritor -> receptor (libres)
+static QueueHandle_t ota_full_q = NULL;
+static QueueHandle_t ota_free_q = NULL;
+static TaskHandle_t ota_writer_handle = NULL;
+
+// Formato detectado por los primeros bytes de la carga
+enum {
+  OTA_FMT_UNKNOWN = 0,
+  OTA_FMT_IMAGE,          // Imagen de aplicación completa (magic 0xE9)
+  OTA_FMT_DELTA           // Parche delta contra la partición en ejecución (magic "MOED")
+};
+#define OTA_SNIFF_LEN 4
+
+static uint8_t ota_format = OTA_FMT_UNKNOWN;
+static uint8_t ota_sniff[OTA_SNIFF_LEN];
+static size_t ota_sniff_len = 0;
+
+// Capa de compresión (gzip / heatshrink) delante de la detección de formato
+#define OTA_COMP_PENDING 0xFF
+static uint8_t ota_compression = OTA_COMP_PENDING;
+static uint8_t ota_raw_sniff[OTA_COMP_SNIFF_LEN];
+static size_t ota_raw_sniff_len = 0;
+static bool ota_update_begun = false;
+
+// Hash del archivo recibido (contra el sha256 que envía el cliente) y, para
+// parches, hash de la imagen reconstruida (contra new_sha256 del encabezado)
+static mbedtls_sha256_context ota_sha;
+static mbedtls_sha256_context ota_image_sha;
+static uint8_t ota_expected_sha[32];
+static bool ota_has_expected_sha = false;
+static size_t ota_expected_size = 0;
+
+static delta_patch_t* ota_delta = NULL;
+static const esp_partition_t* ota_running_part = NULL;
+
+static volatile bool ota_write_failed = false;
+static bool ota_running = false;
+static unsigned long ota_start_ms = 0;
+static ota_stream_stats_t ota_stats = {};
+static char ota_error[64] = "";
+static bool ota_no_memory = false;    // El error fue falta de heap (la petición responde 507)
+
+static void ota_stream_set_error(const char* msg)
+{
+  strncpy(ota_error, msg, sizeof(ota_error) - 1);
+  ota_error[sizeof(ota_error) - 1] = '\0';
+  MLOGE("[OTA_STREAM] ERROR: %s", ota_error);
+}
+
+// Tarea escritora: toma buffers llenos, los escribe con Update.write() y los devuelve
+static void ota_stream_writer_task(void* parameter)
+{
+  uint8_t idx;
+  while (true)
+  {
+    if (xQueueReceive(ota_full_q, &idx, portMAX_DELAY) != pdTRUE) continue;
+
+    ota_stream_buffer_t* b = &ota_bufs[idx];
+    if (!ota_write_failed && b->len > 0) {
+      unsigned long t0 = millis();
+      size_t w = Update.write(b->data, b->len);
+      ota_stats.flash_ms += millis() - t0;
+      if (w != b->len) {
+        ota_write_failed = true;
+      } else {
+        ota_stats.bytes_written += w;
+      }
+    }
+    b->len = 0;
+    xQueueSend(ota_free_q, &idx, portMAX_DELAY);
+  }
+}
+
+static bool ota_stream_parse_sha(const char* hex, uint8_t* out)
+{
+  if (!hex || strlen(hex) != 64) return false;
+  for (int i = 0; i < 32; i++) {
+    char byte_str[3] = { hex[2 * i], hex[2 * i + 1], '\0' };
+    if (!isxdigit((unsigned char)byte_str[0]) || !isxdigit((unsigned char)byte_str[1])) return false;
+    out[i] = (uint8_t)strtoul(byte_str, NULL, 16);
+  }
+  return true;
+}
+
+// Obtiene un buffer libre para seguir recibiendo; mide el tiempo de espera (stall)
+static bool ota_stream_acquire_buffer()
+{
+  uint8_t idx;
+  if (xQueueReceive(ota_free_q, &idx, 0) != pdTRUE) {
+    unsigned long t0 = millis();
+    BaseType_t got = xQueueReceive(ota_free_q, &idx, pdMS_TO_TICKS(OTA_STREAM_STALL_TIMEOUT));
+    ota_stats.stall_ms += millis() - t0;
+    if (got != pdTRUE) return false;
+  }
+  ota_fill_idx = idx;
+  ota_bufs[idx].len = 0;
+  return true;
+}
+
+// Espera a que la tarea escritora devuelva todos los buffers (flash al día)
+static bool ota_stream_drain()
+{
+  if (ota_fill_idx >= 0) {
+    uint8_t idx = (uint8_t)ota_fill_idx;
+    ota_fill_idx = -1;
+    xQueueSend(ota_full_q, &idx, portMAX_DELAY);
+  }
+  uint8_t idx;
+  ota_bufs_out = OTA_STREAM_BUF_COUNT;
+  while (ota_bufs_out > 0 && xQueueReceive(ota_free_q, &idx, pdMS_TO_TICKS(OTA_STREAM_STALL_TIMEOUT)) == pdTRUE) {
+    ota_bufs_out--;
+  }
+  return ota_bufs_out == 0;
+}
+
+// drained = false si la tarea escritora aún tiene buffers (caso excepcional de
+// flash bloqueada): la memoria queda para la carga siguiente, que la reutiliza
+// cuando vuelven todos (ver ota_bufs_out)
+static void ota_stream_release(bool drained)
+{
+  if (ota_bufs && drained) {
+    free(ota_bufs);
+    ota_bufs = NULL;
+  }
+  ota_fill_idx = -1;
+  if (ota_delta) {
+    free(ota_delta);
+    ota_delta = NULL;
+  }
+  ota_decompress_end();
+  mbedtls_sha256_free(&ota_sha);
+  mbedtls_sha256_free(&ota_image_sha);
+  ota_running = false;
+}
+
+static void ota_stream_finish_stats()
+{
+  ota_stats.elapsed_ms = millis() - ota_start_ms;
+  ota_stats.kbps = ota_stats.elapsed_ms > 0 ? (uint32_t)((uint64_t)ota_stats.bytes_received * 1000 / 1024 / ota_stats.elapsed_ms) : 0;
+}
+
+bool ota_stream_begin(size_t expected_size, const char* expected_sha256_hex)
+{
+  if (ota_running) ota_stream_abort();
+
+  // Buffers retenidos por una carga abortada: la escritora los devuelve sin
+  // escribir (ota_write_failed sigue en true); sin ellos no se reinician las colas
+  uint8_t idx;
+  while (ota_bufs_out > 0 && xQueueReceive(ota_free_q, &idx, pdMS_TO_TICKS(OTA_STREAM_STALL_TIMEOUT)) == pdTRUE) {
+    ota_bufs_out--;
+  }
+  if (ota_bufs_out > 0) {
+    ota_stream_set_error("escritura anterior sin terminar");
+    return false;
+  }
+
+  memset(&ota_stats, 0, sizeof(ota_stats));
+  ota_error[0] = '\0';
+  ota_no_memory = false;
+  ota_write_failed = false;
+  ota_expected_size = expected_size;
+  ota_has_expected_sha = false;
+
+  if (expected_sha256_hex && expected_sha256_hex[0] != '\0') {
+    if (!ota_stream_parse_sha(expected_sha256_hex, ota_expected_sha)) {
+      ota_stream_set_error("sha256 invalido");
+      return false;
+    }
+    ota_has_expected_sha = true;
+  }
+
+  // Colas y tarea escritora se crean una sola vez y quedan bloqueadas entre cargas
+  if (ota_full_q == NULL) ota_full_q = xQueueCreate(OTA_STREAM_BUF_COUNT, sizeof(uint8_t));
+  if (ota_free_q == NULL) ota_free_q = xQueueCreate(OTA_STREAM_BUF_COUNT, sizeof(uint8_t));
+  if (!ota_full_q || !ota_free_q) {
+    ota_stream_set_error("sin memoria para colas");
+    return false;
+  }
+  if (ota_writer_handle == NULL) {
+    // Core 1: la recepción HTTP corre en la tarea OTA (core 0)
+    BaseType_t r = task_spawn(TASK_OTA_WRITER, ota_stream_writer_task, NULL, &ota_writer_handle);
+    if (r != pdPASS) {
+      ota_writer_handle = NULL;
+      ota_stream_set_error("no se pudo crear tarea escritora");
+      return false;
+    }
+  }
+
+  if (!ota_bufs) ota_bufs = (ota_stream_buffer_t*)malloc(sizeof(ota_stream_buffer_t) * OTA_STREAM_BUF_COUNT);
+  if (!ota_bufs) {
+    ota_no_memory = true;
+    ota_stream_set_error("sin memoria para buffers");
+    return false;
+  }
+  xQueueReset(ota_full_q);
+  xQueueReset(ota_free_q);
+  for (uint8_t i = 0; i < OTA_STREAM_BUF_COUNT; i++) {
+    ota_bufs[i].len = 0;
+    xQueueSend(ota_free_q, &i, 0);
+  }
+
+  // Update.begin() se difiere hasta conocer el formato (el tamaño de un parche
+  // no es el de la imagen que se escribe)
+  ota_format = OTA_FMT_UNKNOWN;
+  ota_sniff_len = 0;
+  ota_compression = OTA_COMP_PENDING;
+  ota_raw_sniff_len = 0;
+  ota_update_begun = false;
+
+  mbedtls_sha256_init(&ota_sha);
+  mbedtls_sha256_starts_ret(&ota_sha, 0);
+  mbedtls_sha256_init(&ota_image_sha);
+  mbedtls_sha256_starts_ret(&ota_image_sha, 0);
+
+  ota_running = true;
+  ota_start_ms = millis();
+  if (!ota_stream_acquire_buffer()) {
+    ota_stream_set_error("buffer no disponible");
+    ota_stream_abort();
+    return false;
+  }
+
+  MLOGI("[OTA_STREAM] begin: size=%u sha256=%s", (unsigned)expected_size, ota_has_expected_sha ? "si" : "no");
+  return true;
+}
+
+// Copia bytes de la imagen final al doble buffer; la tarea escritora los pasa a flash
+static bool ota_stream_image_write(const uint8_t* data, size_t len)
+{
+  if (ota_write_failed) {
+    ota_stream_set_error(Update.errorString());
+    return false;
+  }
+  if (ota_format == OTA_FMT_DELTA) mbedtls_sha256_update_ret(&ota_image_sha, data, len);
+
+  while (len > 0)
+  {
+    ota_stream_buffer_t* b = &ota_bufs[ota_fill_idx];
+    size_t n = min(len, (size_t)(OTA_STREAM_BUF_SIZE - b->len));
+    memcpy(b->data + b->len, data, n);
+    b->len += n;
+    data += n;
+    len -= n;
+
+    if (b->len == OTA_STREAM_BUF_SIZE) {
+      uint8_t idx = (uint8_t)ota_fill_idx;
+      ota_fill_idx = -1;
+      xQueueSend(ota_full_q, &idx, portMAX_DELAY);
+      if (!ota_stream_acquire_buffer()) {
+        ota_stream_set_error("timeout escribiendo flash");
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// --- Callbacks del motor delta ---
+static bool ota_delta_read_old(void* ctx, uint32_t offset, uint8_t* buf, size_t len)
+{
+  return esp_partition_read(ota_running_part, offset, buf, len) == ESP_OK;
+}
+
+static bool ota_delta_write_new(void* ctx, const uint8_t* buf, size_t len)
+{
+  return ota_stream_image_write(buf, len);
+}
+
+// Verifica que la partición en ejecución sea la base del parche y prepara Update
+static bool ota_delta_on_header(void* ctx, const delta_header_t* h)
+{
+  ota_running_part = esp_ota_get_running_partition();
+  if (!ota_running_part || h->old_size > ota_running_part->size) {
+    ota_stream_set_error("parche no corresponde a la particion actual");
+    return false;
+  }
+
+  // El buffer de llenado aún está vacío: se usa como ventana de lectura
+  uint8_t* scratch = ota_bufs[ota_fill_idx].data;
+  mbedtls_sha256_context base_sha;
+  uint8_t digest[32];
+  mbedtls_sha256_init(&base_sha);
+  mbedtls_sha256_starts_ret(&base_sha, 0);
+  bool read_ok = true;
+  for (uint32_t off = 0; off < h->old_size && read_ok; off += OTA_STREAM_BUF_SIZE) {
+    uint32_t n = min((uint32_t)OTA_STREAM_BUF_SIZE, h->old_size - off);
+    read_ok = esp_partition_read(ota_running_part, off, scratch, n) == ESP_OK;
+    if (read_ok) mbedtls_sha256_update_ret(&base_sha, scratch, n);
+  }
+  mbedtls_sha256_finish_ret(&base_sha, digest);
+  mbedtls_sha256_free(&base_sha);
+
+  if (!read_ok || memcmp(digest, h->old_sha256, sizeof(digest)) != 0) {
+    ota_stream_set_error("firmware base distinto al del parche");
+    return false;
+  }
+
+  if (!Update.begin(h->new_size)) {
+    ota_stream_set_error(Update.errorString());
+    return false;
+  }
+  ota_update_begun = true;
+  MLOGI("[OTA_STREAM] delta: base verificada (%u bytes) -> imagen nueva %u bytes",
+                (unsigned)h->old_size, (unsigned)h->new_size);
+  return true;
+}
+
+// Entrega bytes del archivo recibido al destino según el formato detectado
+static bool ota_stream_payload_write(const uint8_t* data, size_t len)
+{
+  if (ota_format == OTA_FMT_DELTA) {
+    if (!delta_patch_feed(ota_delta, data, len)) {
+      if (ota_error[0] == '\0') ota_stream_set_error(ota_delta->error);
+      return false;
+    }
+    return true;
+  }
+  return ota_stream_image_write(data, len);
+}
+
+// Decide el formato con los primeros bytes y prepara el destino
+static bool ota_stream_detect_format()
+{
+  if (delta_is_patch(ota_sniff, ota_sniff_len)) {
+    ota_delta = (delta_patch_t*)malloc(sizeof(delta_patch_t));
+    if (!ota_delta) {
+      ota_stream_set_error("sin memoria para parche");
+      return false;
+    }
+    delta_patch_init(ota_delta, ota_delta_read_old, ota_delta_write_new, ota_delta_on_header, NULL);
+    ota_format = OTA_FMT_DELTA;
+    MLOGI("[OTA_STREAM] Formato: parche delta");
+  } else {
+    // El tamaño esperado describe el archivo recibido: sólo coincide con la imagen sin compresión
+    size_t image_size = (ota_compression == OTA_COMP_NONE && ota_expected_size > 0) ? ota_expected_size : UPDATE_SIZE_UNKNOWN;
+    if (!Update.begin(image_size)) {
+      ota_stream_set_error(Update.errorString());
+      return false;
+    }
+    ota_update_begun = true;
+    ota_format = OTA_FMT_IMAGE;
+    MLOGI("[OTA_STREAM] Formato: imagen completa");
+  }
+  return ota_stream_payload_write(ota_sniff, ota_sniff_len);
+}
+
+// Bytes ya descomprimidos: detectar imagen completa / parche y entregarlos
+static bool ota_stream_payload_in(const uint8_t* data, size_t len)
+{
+  if (ota_format == OTA_FMT_UNKNOWN) {
+    size_t n = min(len, (size_t)(OTA_SNIFF_LEN - ota_sniff_len));
+    memcpy(ota_sniff + ota_sniff_len, data, n);
+    ota_sniff_len += n;
+    data += n;
+    len -= n;
+    if (ota_sniff_len < OTA_SNIFF_LEN) return true;
+    if (!ota_stream_detect_format()) return false;
+  }
+  return len == 0 || ota_stream_payload_write(data, len);
+}
+
+// Bytes tal como llegan por la red: pasan por el descompresor si corresponde
+static bool ota_stream_raw_in(const uint8_t* data, size_t len)
+{
+  if (ota_compression == OTA_COMP_NONE) return ota_stream_payload_in(data, len);
+  if (!ota_decompress_feed(data, len)) {
+    ota_no_memory = ota_decompress_out_of_memory();
+    if (ota_error[0] == '\0') ota_stream_set_error(ota_decompress_error());
+    return false;
+  }
+  return true;
+}
+
+bool ota_stream_write(const uint8_t* data, size_t len)
+{
+  if (!ota_running) return false;
+  if (ota_expected_size > 0 && ota_stats.bytes_received + len > ota_expected_size) {
+    ota_stream_set_error("archivo mayor al tamano esperado");
+    return false;
+  }
+
+  // El hash se calcula en la recepción (acelerador SHA por hardware) mientras la
+  // tarea escritora está ocupada con el buffer anterior
+  mbedtls_sha256_update_ret(&ota_sha, data, len);
+  ota_stats.bytes_received += len;
+
+  if (ota_compression == OTA_COMP_PENDING) {
+    size_t n = min(len, (size_t)(OTA_COMP_SNIFF_LEN - ota_raw_sniff_len));
+    memcpy(ota_raw_sniff + ota_raw_sniff_len, data, n);
+    ota_raw_sniff_len += n;
+    data += n;
+    len -= n;
+    if (ota_raw_sniff_len < OTA_COMP_SNIFF_LEN) return true;
+
+    ota_compression = ota_decompress_detect(ota_raw_sniff, ota_raw_sniff_len);
+    if (ota_compression != OTA_COMP_NONE && !ota_decompress_begin(ota_compression, ota_stream_payload_in)) {
+      ota_no_memory = ota_decompress_out_of_memory();
+      ota_stream_set_error(ota_decompress_error());
+      return false;
+    }
+    if (!ota_stream_raw_in(ota_raw_sniff, ota_raw_sniff_len)) return false;
+  }
+  return len == 0 || ota_stream_raw_in(data, len);
+}
+
+bool ota_stream_end()
+{
+  if (!ota_running) return false;
+
+  if (!ota_stream_drain()) {
+    ota_stream_set_error("timeout vaciando buffers");
+    ota_stream_finish_stats();
+    if (ota_update_begun) Update.abort();
+    ota_stream_release(false);
+    return false;
+  }
+  ota_stream_finish_stats();
+
+  uint8_t digest[32];
+  uint8_t image_digest[32];
+  mbedtls_sha256_finish_ret(&ota_sha, digest);
+  mbedtls_sha256_finish_ret(&ota_image_sha, image_digest);
+
+  if (ota_compression != OTA_COMP_NONE && ota_compression != OTA_COMP_PENDING && !ota_decompress_finish()) {
+    ota_stream_set_error(ota_decompress_error());
+  } else if (ota_format == OTA_FMT_UNKNOWN) {
+    ota_stream_set_error("archivo vacio");
+  } else if (ota_write_failed) {
+    ota_stream_set_error(Update.errorString());
+  } else if (ota_expected_size > 0 && ota_stats.bytes_received != ota_expected_size) {
+    ota_stream_set_error("tamano no coincide");
+  } else if (ota_has_expected_sha && memcmp(digest, ota_expected_sha, sizeof(digest)) != 0) {
+    ota_stream_set_error("sha256 no coincide");
+  } else if (ota_format == OTA_FMT_DELTA && !delta_patch_done(ota_delta)) {
+    ota_stream_set_error("parche incompleto");
+  } else if (ota_format == OTA_FMT_DELTA && memcmp(image_digest, ota_delta->header.new_sha256, sizeof(image_digest)) != 0) {
+    ota_stream_set_error("sha256 de imagen reconstruida no coincide");
+  } else if (!Update.end(true)) {
+    ota_stream_set_error(Update.errorString());
+  } else {
+    ota_stats.ok = true;
+  }
+
+  if (!ota_stats.ok && ota_update_begun) Update.abort();
+  ota_stream_release(true);
+
+  MLOGI("[OTA_STREAM] end: %s recibidos=%u escritos=%u tiempo=%ums %uKB/s flash=%ums stall=%ums",
+                ota_stats.ok ? "OK" : "FALLO", (unsigned)ota_stats.bytes_received, (unsigned)ota_stats.bytes_written,
+                (unsigned)ota_stats.elapsed_ms, (unsigned)ota_stats.kbps, (unsigned)ota_stats.flash_ms, (unsigned)ota_stats.stall_ms);
+  return ota_stats.ok;
+}
+
+void ota_stream_abort()
+{
+  if (!ota_running) return;
+  // Esperar a que la tarea escritora suelte los buffers antes de liberarlos
+  ota_write_failed = true;
+  bool drained = ota_stream_drain();
+  ota_stream_finish_stats();
+  if (ota_update_begun) Update.abort();
+  ota_stream_release(drained);
+  if (ota_error[0] == '\0') ota_stream_set_error("carga abortada");
+}
+
+bool ota_stream_in_progress()
+{
+  return ota_running;
+}
+
+const char* ota_stream_error()
+{
+  return ota_error;
+}
+
+bool ota_stream_out_of_memory()
+{
+  return ota_no_memory;
+}
+
+const ota_stream_stats_t& ota_stream_get_stats()
+{
+  return ota_stats;
+}
@@ -0,0 +1,47 @@
+#ifndef OTA_STREAM_H
+#define OTA_STREAM_H
+
+#include <Arduino.h>
+
+// Métricas de la última carga de firmware (se muestran en la UI OTA y en el log)
+typedef struct {
+  uint32_t bytes_received;      // Bytes recibidos por la red
+  uint32_t bytes_written;       // Bytes escritos a la partición OTA
+  uint32_t elapsed_ms;          // Tiempo total desde begin() hasta end()
+  uint32_t flash_ms;            // Tiempo acumulado dentro de Update.write() (tarea escritora)
+  uint32_t stall_ms;            // Tiempo que la recepción esperó por un buffer libre
+  uint32_t kbps;                // Throughput efectivo en KB/s
+  bool ok;                      // true si la imagen fue verificada y aceptada
+} ota_stream_stats_t;
+
+// Inicia una carga. expected_size y expected_sha256_hex describen el archivo recibido
+// (0 y NULL/"" si se desconocen). El archivo puede ser una imagen completa o un
+// parche delta (ver delta_patch.h); el formato se detecta por los primeros bytes.
+// Retorna false si no se pudo preparar la carga.
+bool ota_stream_begin(size_t expected_size, const char* expected_sha256_hex);
+
+// Entrega un bloque recibido. Se copia a un doble buffer y se escribe en flash
+// desde una tarea dedicada, de modo que la escritura se solapa con la recepción.
+bool ota_stream_write(const uint8_t* data, size_t len);
+
+// Finaliza la carga: vacía los buffers, verifica tamaño y SHA-256 (y, para parches,
+// el SHA-256 de la imagen reconstruida) y cierra Update.
+// Si la verificación falla la imagen se descarta y el arranque no cambia.
+bool ota_stream_end();
+
+// Aborta la carga en curso (conexión cortada, error del cliente, etc.)
+void ota_stream_abort();
+
+// true mientras hay una carga en curso
+bool ota_stream_in_progress();
+
+// Último error legible ("" si no hubo)
+const char* ota_stream_error();
+
+// true si la última carga falló por falta de heap (buffers o descompresor)
+bool ota_stream_out_of_memory();
+
+// Métricas de la carga en curso o de la última carga finalizada
+const ota_stream_stats_t& ota_stream_get_stats();
+
+#endif
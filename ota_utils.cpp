@@ -1,25 +1,48 @@
 #include "ota_utils.h"
+#include "moe_log.h"
 #include "config.h"
 #include "display_utils.h"
 #include "wifi_utils.h"
 #include "button_utils.h"
 #include "images.h"
 #include "logo_base64.h"
+#include "ota_stream.h"
+#include "ota_pull.h"
+#include "ota_auth.h"
+#include "metrics.h"
+#include "history_store.h"
+#include "ts_store.h"
+#include "config_store.h"
+#include "json_stream.h"
+#include "req_arena.h"
+#include "task_config.h"
+#include "power_utils.h"
 #include <WiFi.h>
+#include "esp_wifi.h"
 #include <WebServer.h>
 #include <ElegantOTA.h>
 #include <Update.h>
-#include <Preferences.h>
 #include <LittleFS.h>
 #include <math.h> // para isnan
+#include "lwip/sockets.h"
+
+// Vuelta máxima del bucle OTA sin tráfico (revisa los tiempos de espera de WebServer)
+#define OTA_SOCKET_WAIT_MS      1000
+#define OTA_HTTP_PORT           80
+
+// WebServer con acceso al socket del cliente en curso (para esperar en select())
+class OtaWebServer : public WebServer {
+public:
+  using WebServer::WebServer;
+  int client_fd() { return _currentClient ? _currentClient.fd() : -1; }
+};
 
 // Servidor web para OTA (global)
-WebServer server(80);
+OtaWebServer server(OTA_HTTP_PORT);
 bool ota_active = false;
 TaskHandle_t ota_task_handle = NULL;
 
-// Persistent preferences namespace and runtime flag for "continuous" mode
-static Preferences ota_prefs;
+// Runtime copy of the persistent "continuous" flag (config_store)
 static bool ota_continuous_mode = false;
 // Runtime flag reflecting mode changes requested via OTA (not persisted across reboot)
 static bool ota_runtime_normal = false;
@@ -41,85 +64,394 @@ void ota_set_device_metrics(float temp_c, float humidity_pct, int battery_pct, i
   ota_humidity_pct = humidity_pct;
   ota_battery_pct = battery_pct;
   ota_door_state = door_state;
+  time_t now = time(NULL);
+  history_add_sample(now, temp_c, humidity_pct, battery_pct, door_state);
+  // Las actualizaciones sólo de puerta no traen lectura del DHT
+  if (!isnan(temp_c) || !isnan(humidity_pct)) ts_store_append(now, temp_c, humidity_pct, battery_voltage);
+}
+
+// Cuerpos de /auth/login y /auth/change: strings del objeto raíz en buffers fijos
+typedef struct {
+  char username[OTA_AUTH_USER_MAX + 1];
+  char password[JSON_MAX_VALUE + 1];            // password (login) o current_password
+  char new_password[JSON_MAX_VALUE + 1];
+  char confirm_password[JSON_MAX_VALUE + 1];
+  bool user_too_long;
+} auth_body_t;
+
+static bool auth_body_value(const json_event_t* ev, void* ctx)
+{
+  auth_body_t* b = (auth_body_t*)ctx;
+  if (ev->depth != 1 || ev->type != JSON_STRING) return true;
+  if (strcmp(ev->key, "username") == 0) {
+    if (ev->len > OTA_AUTH_USER_MAX) {
+      b->user_too_long = true;
+      return false;
+    }
+    memcpy(b->username, ev->value, ev->len + 1);
+  } else if (strcmp(ev->key, "password") == 0 || strcmp(ev->key, "current_password") == 0) {
+    memcpy(b->password, ev->value, ev->len + 1);
+  } else if (strcmp(ev->key, "new_password") == 0) {
+    memcpy(b->new_password, ev->value, ev->len + 1);
+  } else if (strcmp(ev->key, "confirm_password") == 0) {
+    memcpy(b->confirm_password, ev->value, ev->len + 1);
+  }
+  return true;
+}
+
+// Campos ausentes quedan vacíos. false si el cuerpo no es un objeto JSON válido
+// o el usuario supera OTA_AUTH_USER_MAX (user_too_long)
+static bool auth_body_parse(auth_body_t* b)
+{
+  memset(b, 0, sizeof(*b));
+  const String &body = server.arg("plain");
+  const char* text = body.c_str();
+  while (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n') text++;
+  if (*text != '{') return false;
+  return json_parse(body.c_str(), body.length(), auth_body_value, b) == JSON_OK;
 }
 
-// Simple base64 decoder for PNG data (returns decoded length)
-static size_t base64_decode(const char* src, uint8_t* out) {
-  if (!src || !out) return 0;
-  const char* b64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-  unsigned char dtable[256];
-  memset(dtable, 0x80, 256);
-  for (int i = 0; i < 64; i++) dtable[(unsigned char)b64[i]] = i;
-  dtable['='] = 0;
-
-  size_t len = strlen(src);
-  size_t out_len = 0;
-  unsigned int val = 0;
-  int valb = -8;
+// --- Configuración por lotes (PATCH /api/config) ---
+// Los cambios se validan sobre una copia; sólo si todos son válidos se aplican juntos.
+typedef struct {
+  config_values_t cfg;
+  int8_t want_normal;               // -1 = sin cambio, 0 = continuo, 1 = normal (sólo en ejecución)
+  const char* error;
+  char field[JSON_MAX_KEY + 1];
+} config_patch_t;
+
+static bool config_url_valid(const char* url, size_t len)
+{
+  if (len > CONFIG_URL_MAX) return false;
+  if (strncmp(url, "http://", 7) != 0 && strncmp(url, "https://", 8) != 0) return false;
+  // Se devuelve sin escapar en la respuesta JSON
   for (size_t i = 0; i < len; i++) {
-    unsigned char c = src[i];
-    if (dtable[c] & 0x80) continue; // skip non-base64
-    val = (val << 6) + dtable[c];
-    valb += 6;
-    if (valb >= 0) {
-      out[out_len++] = (unsigned char)((val >> valb) & 0xFF);
-      valb -= 8;
+    uint8_t c = (uint8_t)url[i];
+    if (c <= 0x20 || c == '"' || c == '\\' || c >= 0x7F) return false;
+  }
+  return true;
+}
+
+static bool config_patch_value(const json_event_t* ev, void* ctx)
+{
+  config_patch_t* p = (config_patch_t*)ctx;
+  long n;
+  bool valid;
+  if (ev->depth != 1) {
+    p->error = "nested_value";
+  } else {
+    if (strcmp(ev->key, "interval") == 0) {
+      valid = json_event_int(ev, 1, 255, &n);
+      if (valid) p->cfg.interval_minutes = (uint8_t)n;
+    } else if (strcmp(ev->key, "pull_min_battery") == 0) {
+      valid = json_event_int(ev, 0, 100, &n);
+      if (valid) p->cfg.pull_min_battery = (uint8_t)n;
+    } else if (strcmp(ev->key, "listen_interval") == 0) {
+      valid = json_event_int(ev, 1, CONFIG_LISTEN_INTERVAL_MAX, &n);
+      if (valid) p->cfg.listen_interval = (uint8_t)n;
+    } else if (strcmp(ev->key, "headless_wake") == 0) {
+      valid = ev->type == JSON_BOOL;
+      if (valid) p->cfg.headless_wake = ev->value[0] == 't';
+    } else if (strcmp(ev->key, "mode") == 0) {
+      valid = ev->type == JSON_STRING && (strcmp(ev->value, "normal") == 0 || strcmp(ev->value, "continuous") == 0);
+      if (valid) p->want_normal = ev->value[0] == 'n';
+    } else if (strcmp(ev->key, "normal") == 0) {
+      // Compatibilidad con el cuerpo de /update/mode
+      valid = ev->type == JSON_BOOL;
+      if (valid) p->want_normal = ev->value[0] == 't';
+    } else if (strcmp(ev->key, "telemetry_url") == 0 || strcmp(ev->key, "door_url") == 0) {
+      valid = ev->type == JSON_STRING && config_url_valid(ev->value, ev->len);
+      if (valid) memcpy(ev->key[0] == 't' ? p->cfg.telemetry_url : p->cfg.door_url, ev->value, ev->len + 1);
+    } else {
+      p->error = "unknown_field";
+      valid = true;
     }
+    if (!valid) p->error = "invalid_value";
+  }
+  if (p->error) {
+    // El nombre se devuelve en la respuesta: sólo caracteres que no requieren escape
+    size_t i = 0;
+    for (; ev->key[i] && i < sizeof(p->field) - 1; i++) {
+      char c = ev->key[i];
+      p->field[i] = (c == '"' || c == '\\' || (uint8_t)c < 0x20) ? '_' : c;
+    }
+    p->field[i] = '\0';
+  }
+  return p->error == NULL;
+}
+
+// Configuración efectiva; el modo refleja el cambio en ejecución pedido por OTA
+static void config_send_json()
+{
+  config_values_t cfg;
+  config_store_get(&cfg);
+  bool normal = ota_runtime_normal || cfg.mode == MODE_NORMAL;
+  resp_writer_t w;
+  resp_begin(&w, server, 200, "application/json");
+  resp_printf(&w, "{\"interval\":%u,\"mode\":\"%s\",\"normal\":%s,\"pull_min_battery\":%u,\"headless_wake\":%s,\"listen_interval\":%u,\"telemetry_url\":",
+              cfg.interval_minutes, normal ? "normal" : "continuous", normal ? "true" : "false", cfg.pull_min_battery,
+              cfg.headless_wake ? "true" : "false", cfg.listen_interval);
+  resp_json_string(&w, cfg.telemetry_url);
+  resp_puts(&w, ",\"door_url\":");
+  resp_json_string(&w, cfg.door_url);
+  resp_puts(&w, "}");
+  resp_end(&w);
+}
+
+// Valida y aplica el cuerpo de la petición. Si falla responde 400 y retorna false.
+// want_normal queda con el cambio de modo pedido (se aplica tras responder).
+static bool config_patch_handle(int8_t* want_normal)
+{
+  config_patch_t patch;
+  config_store_get(&patch.cfg);
+  patch.want_normal = -1;
+  patch.error = NULL;
+  patch.field[0] = '\0';
+
+  const String &body = server.arg("plain");
+  const char* text = body.c_str();
+  while (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n') text++;
+  json_parser_t parser;
+  json_parser_init(&parser, config_patch_value, &patch);
+  json_status_t st = JSON_OK;
+  if (*text != '{') {
+    patch.error = "not_object";
+  } else {
+    json_parser_feed(&parser, body.c_str(), body.length());
+    st = json_parser_finish(&parser);
   }
-  return out_len;
+  char js[128];
+  if (patch.error) {
+    snprintf(js, sizeof(js), "{\"ok\":false,\"error\":\"%s\",\"field\":\"%s\"}", patch.error, patch.field);
+  } else if (st != JSON_OK) {
+    snprintf(js, sizeof(js), "{\"ok\":false,\"error\":\"%s\",\"offset\":%u}", json_status_name(st), (unsigned)parser.offset);
+  } else {
+    config_store_set(&patch.cfg);
+    *want_normal = patch.want_normal;
+    return true;
+  }
+  resp_send(server, 400, "application/json", js);
+  return false;
+}
+
+// Cambio de modo en ejecución (no persistente), después de haber respondido
+static void config_apply_mode(int8_t want_normal)
+{
+  if (want_normal < 0) return;
+  ota_runtime_normal = want_normal == 1;
+  delay(100);
+  ota_on_mode_changed(!ota_runtime_normal);
 }
 
-// --- Simple JSON-like extractor (no ArduinoJson) ---
-static String extract_json_value(const String &body, const char *key)
+// Valida el token de sesión de la petición; si no es válido responde 401
+static bool require_session()
 {
-  String k = String("\"") + key + String("\"");
-  int idx = body.indexOf(k);
-  if (idx < 0) return String();
-  int colon = body.indexOf(':', idx);
-  if (colon < 0) return String();
-  int start = body.indexOf('"', colon);
-  if (start < 0) return String();
-  start++; // after opening quote
-  int end = body.indexOf('"', start);
-  if (end < 0) return String();
-  return body.substring(start, end);
+  if (ota_auth_session_valid(server.header(OTA_AUTH_HEADER).c_str())) return true;
+  resp_send(server, 401, "application/json", "{\"ok\":false,\"error\":\"unauthorized\"}");
+  return false;
 }
 
-// --- Auth helpers using Preferences ---
-static void auth_ensure_defaults()
+// Temperatura, humedad, batería y puerta (null si no hay lectura). La coma
+// inicial se omite cuando es el primer miembro del objeto.
+static void device_info_sensors(resp_writer_t* w, bool after_first)
 {
-  Preferences auth;
-  auth.begin("ota_auth", false);
-  String u = auth.getString("user", "");
-  if (u.length() == 0) {
-    auth.putString("user", "Telemetry");
-    auth.putString("pass", "Colombia123");
-    Serial.println("[OTA][AUTH] Defaults stored");
+  const char* sep = after_first ? "," : "";
+  if (isnan(ota_temp_c)) resp_printf(w, "%s\"temperature\":null", sep);
+  else resp_printf(w, "%s\"temperature\":%.1f", sep, ota_temp_c);
+  if (isnan(ota_humidity_pct)) resp_puts(w, ",\"humidity\":null");
+  else resp_printf(w, ",\"humidity\":%.1f", ota_humidity_pct);
+  // /telemetry sólo expone temperatura y humedad
+  if (!after_first) return;
+  if (ota_battery_pct < 0) resp_puts(w, ",\"battery\":null");
+  else resp_printf(w, ",\"battery\":%d", ota_battery_pct);
+  if (ota_door_state < 0) resp_puts(w, ",\"door\":null");
+  else resp_printf(w, ",\"door\":%d", ota_door_state);
+}
+
+static void device_info_mac(resp_writer_t* w)
+{
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  resp_printf(w, ",\"mac\":\"%02X:%02X:%02X:%02X:%02X:%02X\"", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+// Las cargas multipart se autorizan al inicio; el resultado se reporta en el handler final
+static bool upload_authorized = false;
+static bool upload_pull_busy = false;     // /update: la descarga pull escribía la partición
+
+// Consume la decisión del inicio de la carga: una petición posterior sin parte
+// multipart (sin UPLOAD_FILE_START) no hereda la autorización de la anterior
+static bool upload_take_authorized()
+{
+  bool authorized = upload_authorized;
+  upload_authorized = false;
+  return authorized;
+}
+
+// Salida de /history: el escritor envía un chunk cada vez que se llena su buffer
+typedef struct {
+  resp_writer_t w;
+  bool first;
+} history_chunk_t;
+
+// Mínimo, máximo y media de una serie; escala 10 = un decimal
+static int history_format_series(char* dst, size_t cap, const history_bucket_t* p, int s, int scale)
+{
+  if (p->n[s] == 0) return snprintf(dst, cap, ",null,null,null");
+  float mean = (float)p->sum[s] / p->n[s];
+  if (scale == 10) {
+    return snprintf(dst, cap, ",%.1f,%.1f,%.1f", p->min[s] / 10.0f, p->max[s] / 10.0f, mean / 10.0f);
   }
-  auth.end();
+  return snprintf(dst, cap, ",%d,%d,%.0f", p->min[s], p->max[s], mean);
 }
 
-static bool auth_check_credentials(const String &user, const String &pass)
+static void history_emit_row(const history_bucket_t* p, void* ctx)
 {
-  Preferences auth;
-  auth.begin("ota_auth", true);
-  String su = auth.getString("user", "Telemetry");
-  String sp = auth.getString("pass", "Colombia123");
-  auth.end();
-  return (user == su && pass == sp);
+  history_chunk_t* out = (history_chunk_t*)ctx;
+  char row[144];
+  int n = snprintf(row, sizeof(row), "%s[%u", out->first ? "" : ",", (unsigned)p->start);
+  n += history_format_series(row + n, sizeof(row) - n, p, 0, 10);
+  n += history_format_series(row + n, sizeof(row) - n, p, 1, 10);
+  n += history_format_series(row + n, sizeof(row) - n, p, 2, 1);
+  snprintf(row + n, sizeof(row) - n, ",%u]", (unsigned)p->opens);
+  out->first = false;
+  resp_puts(&out->w, row);
 }
 
-static bool auth_set_credentials(const String &user, const String &pass)
+// Fila CSV de /history/raw (campos vacíos = lectura inválida)
+static bool ts_emit_csv_row(const ts_sample_t* s, void* ctx)
 {
-  Preferences auth;
-  auth.begin("ota_auth", false);
-  auth.putString("user", user);
-  auth.putString("pass", pass);
-  auth.end();
-  Serial.println("[OTA][AUTH] Credentials updated");
+  char row[64];
+  int n = snprintf(row, sizeof(row), "%u", (unsigned)s->t);
+  for (int i = 0; i < TS_SERIES; i++) {
+    if (s->v[i] == TS_VALUE_NONE) n += snprintf(row + n, sizeof(row) - n, ",");
+    else if (i < 2) n += snprintf(row + n, sizeof(row) - n, ",%.1f", s->v[i] / 10.0f);
+    else n += snprintf(row + n, sizeof(row) - n, ",%d", (int)s->v[i]);
+  }
+  resp_printf(&((history_chunk_t*)ctx)->w, "%s\n", row);
   return true;
 }
 
+// Línea de texto de /logs
+static bool mlog_emit_line(const uint8_t* rec, void* ctx)
+{
+  char line[192];
+  size_t n = mlog_format(rec, line, sizeof(line) - 1);
+  line[n++] = '\n';
+  resp_write((resp_writer_t*)ctx, line, n);
+  return true;
+}
+
+// Socket de escucha de WebServer, que no lo expone (WiFiServer no da su
+// descriptor): se busca entre los de lwIP el que escucha en el puerto y se
+// conserva mientras siga escuchando
+static int ota_listen_fd = -1;
+
+static bool ota_is_listener(int fd, uint16_t port)
+{
+  int listening = 0;
+  socklen_t len = sizeof(listening);
+  if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) < 0 || !listening) return false;
+  struct sockaddr_in addr;
+  socklen_t alen = sizeof(addr);
+  return getsockname(fd, (struct sockaddr*)&addr, &alen) == 0 && ntohs(addr.sin_port) == port;
+}
+
+static int ota_find_listener(uint16_t port)
+{
+  if (ota_listen_fd >= 0 && ota_is_listener(ota_listen_fd, port)) return ota_listen_fd;
+  ota_listen_fd = -1;
+  for (int fd = LWIP_SOCKET_OFFSET; fd < LWIP_SOCKET_OFFSET + CONFIG_LWIP_MAX_SOCKETS; fd++) {
+    if (ota_is_listener(fd, port)) return ota_listen_fd = fd;
+  }
+  return -1;
+}
+
+// Espera hasta que el servidor tenga una conexión nueva o el cliente en curso
+// datos o un cierre (o hasta timeout_ms, para los tiempos de espera de
+// WebServer). Sólo sus descriptores: un socket de otra tarea con datos sin leer
+// haría volver a select() de inmediato y la tarea no dejaría dormir a la CPU.
+static void ota_wait_sockets(uint32_t timeout_ms)
+{
+  fd_set rfds;
+  FD_ZERO(&rfds);
+  int maxfd = -1;
+  int fds[2] = { ota_find_listener(OTA_HTTP_PORT), server.client_fd() };
+  for (int i = 0; i < 2; i++) {
+    if (fds[i] < 0) continue;
+    FD_SET(fds[i], &rfds);
+    if (fds[i] > maxfd) maxfd = fds[i];
+  }
+  if (maxfd < 0) {
+    vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+    return;
+  }
+  struct timeval tv = { (time_t)(timeout_ms / 1000), (suseconds_t)((timeout_ms % 1000) * 1000) };
+  // Un descriptor cerrado entre el recorrido y select() da EBADF: se reintenta en la próxima vuelta
+  select(maxfd + 1, &rfds, NULL, NULL, &tv);
+}
+
+// Registro de rutas con conteo y latencia para /metrics
+static void on_route(const char* uri, HTTPMethod method, WebServer::THandlerFunction fn)
+{
+  metrics_route_t* m = metrics_route(uri, method);
+  server.on(uri, method, [m, uri, fn]() {
+    uint32_t t0 = micros();
+    req_alloc_track_begin();
+    fn();
+    uint32_t allocs = req_alloc_track_end();
+    req_arena_reset();
+    metrics_route_observe(m, micros() - t0);
+    task_profile_sample(uri);
+#ifdef MOE_ALLOC_DEBUG
+    if (allocs) MLOGI("[OTA][ALLOC] %s: %u asignaciones de heap", uri, (unsigned)allocs);
+#else
+    (void)allocs;
+#endif
+  });
+}
+
+// Variante para cargas: la latencia va desde el primer bloque hasta la respuesta final.
+// Las asignaciones se cuentan aparte para los bloques (régimen estable, deben ser 0)
+// y para el inicio y cierre de la carga (buffers de ota_stream, descompresor).
+static uint32_t upload_t0 = 0;
+static uint32_t upload_allocs_chunks = 0;
+static uint32_t upload_allocs_edges = 0;
+static void on_route(const char* uri, HTTPMethod method, WebServer::THandlerFunction fn, WebServer::THandlerFunction ufn)
+{
+  metrics_route_t* m = metrics_route(uri, method);
+  server.on(uri, method, [m, uri, fn]() {
+    req_alloc_track_begin();
+    fn();
+    uint32_t allocs = req_alloc_track_end();
+    req_arena_reset();
+    metrics_route_observe(m, micros() - upload_t0);
+    task_profile_sample(uri);
+#ifdef MOE_ALLOC_DEBUG
+    if (allocs || upload_allocs_chunks || upload_allocs_edges) {
+      MLOGI("[OTA][ALLOC] %s: %u asignaciones de heap (respuesta %u, inicio/cierre %u, bloques %u)", uri,
+            (unsigned)(allocs + upload_allocs_edges + upload_allocs_chunks), (unsigned)allocs,
+            (unsigned)upload_allocs_edges, (unsigned)upload_allocs_chunks);
+    }
+#else
+    (void)allocs;
+#endif
+  }, [uri, ufn]() {
+    HTTPUploadStatus status = server.upload().status;
+    if (status == UPLOAD_FILE_START) {
+      upload_t0 = micros();
+      upload_allocs_chunks = upload_allocs_edges = 0;
+    }
+    req_alloc_track_begin();
+    ufn();
+    uint32_t allocs = req_alloc_track_end();
+    if (status == UPLOAD_FILE_WRITE) upload_allocs_chunks += allocs;
+    else upload_allocs_edges += allocs;
+    // Cada bloque: la escritora a flash también se mide durante la carga
+    task_profile_sample(uri);
+  });
+}
+
 
 // HTML embebido para la interfaz OTA (modificado: añadida sección de Device Info y fetch a /update/device_info)
 const char* ota_html = R"rawliteral(
@@ -437,6 +769,23 @@ const char* ota_html = R"rawliteral(
     #resetBtn:hover { transform: translateY(-2px); }
     
     #resetBtn:active { transform: translateY(0); }
+
+    #pullBtn {
+      padding: 15px 25px;
+      background: linear-gradient(90deg, var(--muted) 0%, #5a636b 100%);
+      color: white;
+      border: none;
+      border-radius: 10px;
+      font-size: 16px;
+      font-weight: 600;
+      cursor: pointer;
+      transition: all 0.3s ease;
+      box-shadow: 0 6px 16px rgba(0,0,0,0.4);
+    }
+
+    #pullBtn:hover:not(:disabled) { transform: translateY(-2px); }
+
+    #pullBtn:disabled { opacity: 0.6; cursor: not-allowed; }
     
     #progress {
       margin-top: 30px;
@@ -650,6 +999,10 @@ const char* ota_html = R"rawliteral(
           <label for="intervalSelect" style="display:block;margin-bottom:6px;font-weight:700;color:rgba(255,255,255,0.9)">Tiempo entre cada envio de datos</label>
           <select id="intervalSelect" style="width:100%;padding:10px;border-radius:8px;background:#1e1e1e;border:1px solid rgba(255,255,255,0.04);color:#fff">
           </select>
+          <label style="display:flex;align-items:center;gap:8px;margin-top:12px;color:rgba(255,255,255,0.9)">
+            <input type="checkbox" id="headlessCheck" />
+            Modo normal: despertar sin pantalla (se enciende con el botón PRG)
+          </label>
         </div>
 
       <div class="warning-box">
@@ -669,7 +1022,7 @@ const char* ota_html = R"rawliteral(
       
         <div class="file-upload-section">
           <label class="file-input-wrapper" id="fileWrapper">
-            <input type="file" id="fileInput" accept=".bin" />
+            <input type="file" id="fileInput" accept=".bin,.moed,.gz,.hs" />
             <span class="file-input-label">
               📁 Selecciona o arrastra archivo .bin aquí
             </span>
@@ -684,7 +1037,7 @@ const char* ota_html = R"rawliteral(
         <button id="changeCredBtn" style="width:100%;padding:12px;border-radius:8px;background:#2b2b2b;color:#fff;border:1px solid rgba(255,255,255,0.03);font-weight:700;">Cambiar credenciales de acceso</button>
         <div id="changeCredForm" style="display:none;margin-top:12px;padding:12px;border-radius:8px;background:rgba(255,255,255,0.02);">
           <label style="font-size:13px;color:rgba(255,255,255,0.8);">Usuario</label>
-          <input id="newUser" placeholder="Nuevo usuario (opcional)" style="width:100%;padding:8px;margin-top:6px;border-radius:6px;background:#0f0f0f;border:1px solid rgba(255,255,255,0.04);color:#fff" />
+          <input id="newUser" maxlength="32" placeholder="Nuevo usuario (opcional)" style="width:100%;padding:8px;margin-top:6px;border-radius:6px;background:#0f0f0f;border:1px solid rgba(255,255,255,0.04);color:#fff" />
           <label style="font-size:13px;color:rgba(255,255,255,0.8);margin-top:8px;display:block;">Contraseña actual</label>
           <input id="currentPass" type="password" placeholder="Contraseña actual" style="width:100%;padding:8px;margin-top:6px;border-radius:6px;background:#0f0f0f;border:1px solid rgba(255,255,255,0.04);color:#fff" />
           <label style="font-size:13px;color:rgba(255,255,255,0.8);margin-top:8px;display:block;">Nueva contraseña</label>
@@ -701,6 +1054,7 @@ const char* ota_html = R"rawliteral(
       <div class="button-group">
         <button id="uploadBtn" disabled>Iniciar Actualización</button>
         <button id="resetBtn">Limpiar</button>
+        <button id="pullBtn">Buscar en servidor</button>
       </div>
       
       <div id="progress">
@@ -747,6 +1101,7 @@ const char* ota_html = R"rawliteral(
     const batterySwitch = document.getElementById('batterySwitch');
     const batterySwitchWrap = document.getElementById('batterySwitchWrap');
     const intervalSelect = document.getElementById('intervalSelect');
+    const headlessCheck = document.getElementById('headlessCheck');
     // continuousNote removed
     // logo upload controls removed
 
@@ -793,18 +1148,20 @@ const char* ota_html = R"rawliteral(
             if (data.ssid) deviceSSID.textContent = data.ssid; else deviceSSID.textContent = '--';
             if (data.rssi !== undefined && data.rssi !== null) deviceRSSI.textContent = `${data.rssi} dBm`; else deviceRSSI.textContent = '-- dBm';
             // After updating device info, refresh mode UI (depends on battery presence)
-            fetchMode();
+            fetchConfig();
           })
           .catch(err => {
             console.warn('fetchDeviceInfo failed', err);
           });
       }
 
-      // Fetch current persistent mode and update switch
-      function fetchMode() {
-        fetch('/update/mode')
+      // Configuración efectiva (modo e intervalo) en una sola petición
+      function fetchConfig() {
+        fetch('/api/config')
           .then(r => r.json())
           .then(m => {
+            if (m.interval && document.activeElement !== intervalSelect) intervalSelect.value = m.interval;
+            headlessCheck.checked = !!m.headless_wake;
             // UI mapping: switch ON -> Normal mode enabled
             batterySwitch.checked = !!m.normal;
             if (batterySwitch.checked) {
@@ -818,7 +1175,7 @@ const char* ota_html = R"rawliteral(
               batterySwitchWrap.style.opacity = '1';
             }
           })
-          .catch(err => { console.warn('fetchMode failed', err); });
+          .catch(err => { console.warn('fetchConfig failed', err); });
       }
 
       batterySwitch.addEventListener('change', () => {
@@ -829,10 +1186,10 @@ const char* ota_html = R"rawliteral(
 
         if (wantNormal) {
           if (!confirm('El dispositivo entrará en modo ahorro de energía. Para volver a modo continuo deberá hacerlo físicamente. ¿Continuar?')) {
-            fetchMode();
+            fetchConfig();
             return;
           }
-          fetch('/update/mode', { method: 'POST', headers: { 'Content-Type': 'application/json' }, body: JSON.stringify({ normal: true }) })
+          fetch('/api/config', { method: 'PATCH', headers: authHeaders({ 'Content-Type': 'application/json' }), body: JSON.stringify({ mode: 'normal' }) })
             .then(r => r.json())
             .then(j => {
               // After setting Normal, disable switch (revert requires physical reset)
@@ -841,11 +1198,11 @@ const char* ota_html = R"rawliteral(
               batterySwitchWrap.style.opacity = '0.6';
               alert('Modo Normal activado. Para volver a Modo Continuo reinicie físicamente el dispositivo.');
             })
-            .catch(err => { console.warn('set mode failed', err); fetchMode(); });
+            .catch(err => { console.warn('set mode failed', err); fetchConfig(); });
         } else {
           // Trying to unset via OTA is not allowed: refresh state and inform
           alert('La reversión a Modo Continuo no está permitida desde OTA. Por favor realice un reinicio físico para volver a Modo Continuo.');
-          fetchMode();
+          fetchConfig();
         }
       });
 
@@ -864,24 +1221,22 @@ const char* ota_html = R"rawliteral(
         }
       }
 
-      function fetchInterval() {
-        fetch('/update/interval').then(r=>r.json()).then(j=>{
-          if (j.interval) {
-            intervalSelect.value = j.interval;
-          }
-        }).catch(()=>{});
-      }
-
       intervalSelect.addEventListener('change', ()=>{
         const v = parseInt(intervalSelect.value);
-        fetch('/update/interval', { method:'POST', headers:{'Content-Type':'application/json'}, body: JSON.stringify({ interval: v }) })
-          .then(r => r.json()).then(j => {
-            // success
-          }).catch(()=>{ alert('Error guardando intervalo'); });
+        fetch('/api/config', { method:'PATCH', headers: authHeaders({'Content-Type':'application/json'}), body: JSON.stringify({ interval: v }) })
+          .then(r => { if (!r.ok) throw new Error(r.status); return r.json(); })
+          .then(j => { intervalSelect.value = j.interval; })
+          .catch(()=>{ alert('Error guardando intervalo'); });
+      });
+
+      headlessCheck.addEventListener('change', ()=>{
+        fetch('/api/config', { method:'PATCH', headers: authHeaders({'Content-Type':'application/json'}), body: JSON.stringify({ headless_wake: headlessCheck.checked }) })
+          .then(r => { if (!r.ok) throw new Error(r.status); return r.json(); })
+          .then(j => { headlessCheck.checked = !!j.headless_wake; })
+          .catch(()=>{ alert('Error guardando la configuración'); fetchConfig(); });
       });
 
       populateIntervalOptions();
-      fetchInterval();
     }
 
     // Attach auth modal handlers and initialize only after successful login
@@ -891,12 +1246,19 @@ const char* ota_html = R"rawliteral(
     const authPass = document.getElementById('authPass');
     const authMsg = document.getElementById('authMsg');
 
+    // Token de sesión: se envía en la cabecera X-Auth-Token en las peticiones que modifican estado
+    let authToken = '';
+    function authHeaders(extra) {
+      return Object.assign({ 'X-Auth-Token': authToken }, extra || {});
+    }
+
     function doLogin() {
       const payload = { username: authUser.value || '', password: authPass.value || '' };
       fetch('/auth/login', { method: 'POST', headers: { 'Content-Type': 'application/json' }, body: JSON.stringify(payload) })
         .then(r => r.json().catch(() => { return { ok: false }; }))
         .then(j => {
           if (j && j.ok) {
+            authToken = j.token || '';
             authOverlay.style.display = 'none';
             initAuthenticatedUI();
           } else {
@@ -931,7 +1293,7 @@ const char* ota_html = R"rawliteral(
         new_password: newPass.value || '',
         confirm_password: confirmPass.value || ''
       };
-      fetch('/auth/change', { method:'POST', headers:{'Content-Type':'application/json'}, body: JSON.stringify(payload) })
+      fetch('/auth/change', { method:'POST', headers: authHeaders({'Content-Type':'application/json'}), body: JSON.stringify(payload) })
         .then(r => r.json())
         .then(j => {
           if (j.ok) {
@@ -950,7 +1312,7 @@ const char* ota_html = R"rawliteral(
       if (!confirm('ATENCIÓN: Esto borrará las credenciales WiFi y reiniciará el dispositivo. ¿Continuar?')) return;
       status.textContent = 'Borrando credenciales y reiniciando...';
       status.className = 'status-message info';
-      fetch('/factory_reset', { method: 'POST' })
+      fetch('/factory_reset', { method: 'POST', headers: authHeaders() })
         .then(r => {
           if (r.ok) {
             status.textContent = '✓ Reiniciando...';
@@ -1025,6 +1387,41 @@ const char* ota_html = R"rawliteral(
 
     // logo upload handlers removed
 
+    // SHA-256 (FIPS 180-4) para navegadores sin crypto.subtle; 1,5 MB en decenas de ms
+    function sha256Hex(buf) {
+      const prime = n => { for (let d = 2; d * d <= n; d++) if (n % d === 0) return false; return true; };
+      const frac = x => ((x - Math.floor(x)) * 4294967296) >>> 0;
+      const K = new Uint32Array(64), H = new Uint32Array(8), W = new Uint32Array(64);
+      for (let p = 2, i = 0; i < 64; p++) {
+        if (!prime(p)) continue;
+        if (i < 8) H[i] = frac(Math.sqrt(p));
+        K[i++] = frac(Math.cbrt(p));
+      }
+      const len = buf.byteLength, total = ((len + 72) >> 6) << 6;
+      const m = new Uint8Array(total);
+      m.set(new Uint8Array(buf));
+      m[len] = 0x80;
+      const dv = new DataView(m.buffer);
+      dv.setUint32(total - 8, Math.floor(len / 0x20000000));
+      dv.setUint32(total - 4, (len * 8) >>> 0);
+      const rot = (x, n) => (x >>> n) | (x << (32 - n));
+      for (let off = 0; off < total; off += 64) {
+        for (let i = 0; i < 16; i++) W[i] = dv.getUint32(off + i * 4);
+        for (let i = 16; i < 64; i++) {
+          const x = W[i - 15], y = W[i - 2];
+          W[i] = W[i - 16] + (rot(x, 7) ^ rot(x, 18) ^ (x >>> 3)) + W[i - 7] + (rot(y, 17) ^ rot(y, 19) ^ (y >>> 10));
+        }
+        let [a, b, c, d, e, f, g, h] = H;
+        for (let i = 0; i < 64; i++) {
+          const t1 = (h + (rot(e, 6) ^ rot(e, 11) ^ rot(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + W[i]) | 0;
+          const t2 = ((rot(a, 2) ^ rot(a, 13) ^ rot(a, 22)) + ((a & b) ^ (a & c) ^ (b & c))) | 0;
+          h = g; g = f; f = e; e = (d + t1) | 0; d = c; c = b; b = a; a = (t1 + t2) | 0;
+        }
+        H[0] += a; H[1] += b; H[2] += c; H[3] += d; H[4] += e; H[5] += f; H[6] += g; H[7] += h;
+      }
+      return Array.from(H, x => x.toString(16).padStart(8, '0')).join('');
+    }
+
     uploadBtn.addEventListener('click', () => {
       const file = fileInput.files[0];
       if (!file) return;
@@ -1045,6 +1442,16 @@ const char* ota_html = R"rawliteral(
       progressFill.style.width = '5%';
       progressPercent.textContent = '5%';
 
+      // SHA-256 de la imagen para verificación en el dispositivo. crypto.subtle sólo
+      // existe en contextos seguros y la página se sirve por http: sin él se calcula en JS
+      const hashPromise = file.arrayBuffer().then(buf => (window.crypto && window.crypto.subtle)
+        ? crypto.subtle.digest('SHA-256', buf).then(d => Array.from(new Uint8Array(d)).map(b => b.toString(16).padStart(2, '0')).join(''))
+        : sha256Hex(buf)).catch(() => '');
+
+      hashPromise.then(sha => startUpload(file, sha));
+    });
+
+    function startUpload(file, sha) {
       const formData = new FormData();
       formData.append('file', file);
 
@@ -1062,7 +1469,9 @@ const char* ota_html = R"rawliteral(
       xhr.addEventListener('load', () => {
         console.log('XHR load - Status:', xhr.status, 'Response:', xhr.responseText.substring(0, 100));
         if (xhr.status === 200) {
-          status.textContent = '✓ ¡Actualización completada! El dispositivo se reiniciará en 5 segundos...';
+          let speed = '';
+          try { const j = JSON.parse(xhr.responseText); if (j.kbps !== undefined) speed = ` (${j.kbps} KB/s)`; } catch (e) {}
+          status.textContent = '✓ ¡Actualización completada' + speed + '! El dispositivo se reiniciará en 5 segundos...';
           status.className = 'status-message success';
           progressFill.style.width = '100%';
           progressPercent.textContent = '100%';
@@ -1072,7 +1481,9 @@ const char* ota_html = R"rawliteral(
             window.location.reload();
           }, 5000);
         } else {
-          status.textContent = '✗ Error HTTP ' + xhr.status + ': ' + xhr.statusText;
+          let reason = xhr.statusText;
+          try { const j = JSON.parse(xhr.responseText); if (j.error) reason = j.error; } catch (e) {}
+          status.textContent = '✗ Error HTTP ' + xhr.status + ': ' + reason;
           status.className = 'status-message error';
           uploadBtn.disabled = false;
           resetBtn.disabled = false;
@@ -1104,9 +1515,49 @@ const char* ota_html = R"rawliteral(
       });
 
       console.log('Enviando multipart/form-data a /update - Tamaño:', file.size, 'bytes');
-      xhr.open('POST', '/update');  // POST a /update (manejado por el servidor OTA personalizado)
+      let url = '/update?size=' + file.size;
+      if (sha) url += '&sha256=' + sha;
+      xhr.open('POST', url);  // POST a /update (manejado por el servidor OTA personalizado)
+      xhr.setRequestHeader('X-Auth-Token', authToken);
       xhr.timeout = 120000; // 120 segundos de timeout
       xhr.send(formData);
+    }
+
+    // Actualización por descarga: el dispositivo consulta el manifiesto y descarga la imagen
+    const pullBtn = document.getElementById('pullBtn');
+    function pollPull() {
+      fetch('/update/pull').then(r => r.json()).then(j => {
+        if (j.state === 'in_progress') {
+          const pct = j.size ? Math.round(j.offset * 100 / j.size) : 0;
+          progressFill.style.width = pct + '%';
+          progressPercent.textContent = pct + '%';
+          status.textContent = '⏳ Descargando ' + j.version + '...';
+          setTimeout(pollPull, 1000);
+        } else if (j.state === 'up_to_date') {
+          status.textContent = '✓ El firmware ya está actualizado';
+          status.className = 'status-message success';
+          pullBtn.disabled = false;
+        } else if (j.state === 'error') {
+          status.textContent = '✗ Error: ' + j.error;
+          status.className = 'status-message error';
+          pullBtn.disabled = false;
+        }
+      }).catch(() => {
+        // El dispositivo se reinicia al completar la descarga
+        status.textContent = '✓ Descarga completada. Reiniciando...';
+        status.className = 'status-message success';
+        setTimeout(() => window.location.reload(), 5000);
+      });
+    }
+    pullBtn.addEventListener('click', () => {
+      pullBtn.disabled = true;
+      progressDiv.classList.add('active');
+      status.textContent = '⏳ Consultando servidor de firmware...';
+      status.className = 'status-message info';
+      fetch('/update/pull', { method: 'POST', headers: authHeaders() }).then(r => {
+        if (r.status === 200) setTimeout(pollPull, 1000);
+        else { status.textContent = '✗ Ya hay una descarga en curso'; status.className = 'status-message error'; pullBtn.disabled = false; }
+      }).catch(() => { pullBtn.disabled = false; });
     });
   </script>
 </body>
@@ -1116,240 +1567,225 @@ const char* ota_html = R"rawliteral(
 // Tarea FreeRTOS para manejar OTA en paralelo (implementación propia sin ElegantOTA)
 void ota_background_task(void *parameter)
 {
-  Serial.println("\n=== [OTA] Iniciando tarea OTA ===");
-  Serial.print("[OTA] WiFi conectado: ");
-  Serial.println(WiFi.status() == WL_CONNECTED ? "SÍ" : "NO");
-  Serial.print("[OTA] IP: ");
-  Serial.println(WiFi.localIP());
+  IPAddress ip = WiFi.localIP();
+  MLOGI("=== [OTA] Iniciando tarea OTA ===");
+  MLOGI("[OTA] WiFi conectado: %s, IP: %u.%u.%u.%u", WiFi.status() == WL_CONNECTED ? "SÍ" : "NO", ip[0], ip[1], ip[2], ip[3]);
 
-  Serial.println("[OTA] Configurando servidor (handlers OTA personalizados)...");
+  MLOGI("[OTA] Configurando servidor (handlers OTA personalizados)...");
 
   // Initialize LittleFS to allow storing uploaded logo
   if (!LittleFS.begin()) {
-    Serial.println("[OTA] ERROR: LittleFS.begin() failed");
+    MLOGE("[OTA] ERROR: LittleFS.begin() failed");
   } else {
-    Serial.println("[OTA] LittleFS mounted");
+    MLOGI("[OTA] LittleFS mounted");
   }
 
   // GET / -> página principal
-  server.on("/", HTTP_GET, []() {
-    Serial.println("[OTA] GET / - Sirviendo página OTA");
-    String page = String(ota_html);
-    // Use the /logo.png path; the handler will serve LittleFS file if present or fallback to Base64
-    page.replace("__LOGO__", String("/logo.png"));
-    server.send(200, "text/html", page);
+  on_route("/", HTTP_GET, []() {
+    MLOGD("[OTA] GET / - Sirviendo página OTA");
+    // Se envía directo desde flash; __LOGO__ apunta a /logo.png (LittleFS o Base64 embebido)
+    const char* logo = strstr(ota_html, "__LOGO__");
+    resp_writer_t w;
+    resp_begin(&w, server, 200, "text/html");
+    if (logo) {
+      resp_write(&w, ota_html, logo - ota_html);
+      resp_puts(&w, "/logo.png");
+      resp_puts(&w, logo + 8);
+    } else {
+      resp_puts(&w, ota_html);
+    }
+    resp_end(&w);
   });
 
   // GET /logo.png -> serve from LittleFS if available, else decode Base64 and stream
-  server.on("/logo.png", HTTP_GET, []() {
+  on_route("/logo.png", HTTP_GET, []() {
     if (LittleFS.exists("/logo.png")) {
       File f = LittleFS.open("/logo.png", "r");
-      if (!f) { server.send(500, "text/plain", "file open fail"); return; }
+      if (!f) { resp_send(server, 500, "text/plain", "file open fail"); return; }
       server.sendHeader("Connection", "close");
       server.streamFile(f, "image/png");
       f.close();
-      Serial.println("[OTA] /logo.png: served from LittleFS");
+      MLOGD("[OTA] /logo.png: served from LittleFS");
       return;
     }
-    // Fallback: decode embedded Base64 and stream
-    const char* b64 = logo_base64;
-    if (!b64 || b64[0] == '\0') {
-      Serial.println("[OTA] /logo.png: no logo data");
-      server.send(404, "text/plain", "no logo");
+    // Sin logo subido: el embebido se decodifica por bloques directo a la respuesta
+    if (!logo_base64 || logo_base64[0] == '\0') {
+      MLOGW("[OTA] /logo.png: no logo data");
+      resp_send(server, 404, "text/plain", "no logo");
       return;
     }
-    size_t b64len = strlen(b64);
-    Serial.printf("[OTA] /logo.png: b64len=%u\n", (unsigned)b64len);
-    size_t maxBin = (b64len / 4) * 3 + 16;
-    uint8_t* buf = (uint8_t*)malloc(maxBin);
-    if (!buf) { server.send(500, "text/plain", "OOM"); return; }
-    size_t decLen = base64_decode(b64, buf);
-    Serial.printf("[OTA] /logo.png: decoded=%u bytes\n", (unsigned)decLen);
-    WiFiClient client = server.client();
-    String hdr = "HTTP/1.1 200 OK\r\n";
-    hdr += "Content-Type: image/png\r\n";
-    hdr += "Content-Length: "; hdr += String((int)decLen); hdr += "\r\n";
-    hdr += "Connection: close\r\n\r\n";
-    client.print(hdr);
-    size_t wrote = client.write(buf, decLen);
-    Serial.printf("[OTA] /logo.png: wrote=%u bytes to client\n", (unsigned)wrote);
-    client.flush();
-    free(buf);
+    resp_writer_t w;
+    resp_begin(&w, server, 200, "image/png");
+    resp_write_base64(&w, logo_base64);
+    resp_end(&w);
   });
 
   // GET /update/identity -> devuelve versión
-  server.on("/update/identity", HTTP_GET, []() {
-    String json = "{\"version\":\"" + String(FIRMWARE_VERSION) + "\"}";
-    server.send(200, "application/json", json);
+  on_route("/update/identity", HTTP_GET, []() {
+    resp_send(server, 200, "application/json", "{\"version\":\"" FIRMWARE_VERSION "\"}");
   });
 
   // Nuevo: GET /update/device_info -> devuelve JSON completo con métricas + ip/mac
-  server.on("/update/device_info", HTTP_GET, []() {
-    String json = "{";
-    json += "\"version\":\"" + String(FIRMWARE_VERSION) + "\"";
-
-    // temperatura
-    if (isnan(ota_temp_c)) {
-      json += ",\"temperature\":null";
-    } else {
-      json += ",\"temperature\":" + String(ota_temp_c, 1);
-    }
-
-    // humedad
-    if (isnan(ota_humidity_pct)) {
-      json += ",\"humidity\":null";
-    } else {
-      json += ",\"humidity\":" + String(ota_humidity_pct, 1);
-    }
-
-    // bateria
-    if (ota_battery_pct < 0) {
-      json += ",\"battery\":null";
-    } else {
-      json += ",\"battery\":" + String(ota_battery_pct);
-    }
-
-    // estado de la puerta
-    if (ota_door_state < 0) {
-      json += ",\"door\":null";
-    } else {
-      json += ",\"door\":" + String(ota_door_state);
-    }
-
-    // ip y mac
-    json += ",\"ip\":\"" + WiFi.localIP().toString() + "\"";
-    json += ",\"mac\":\"" + WiFi.macAddress() + "\"";
-
-    // Add connected SSID and RSSI
-    json += ",\"ssid\":\"" + WiFi.SSID() + "\"";
-    json += ",\"rssi\":" + String(WiFi.RSSI());
-
-    json += "}";
-
-    server.send(200, "application/json", json);
+  on_route("/update/device_info", HTTP_GET, []() {
+    resp_writer_t w;
+    resp_begin(&w, server, 200, "application/json");
+    resp_puts(&w, "{\"version\":\"" FIRMWARE_VERSION "\"");
+    device_info_sensors(&w, true);
+
+    // ip, mac, SSID y RSSI de la conexión actual (sin String: bytes y registro del AP)
+    IPAddress ip = WiFi.localIP();
+    resp_printf(&w, ",\"ip\":\"%u.%u.%u.%u\"", ip[0], ip[1], ip[2], ip[3]);
+    device_info_mac(&w);
+    wifi_ap_record_t ap;
+    bool linked = esp_wifi_sta_get_ap_info(&ap) == ESP_OK;
+    resp_puts(&w, ",\"ssid\":");
+    resp_json_string(&w, linked ? (const char*)ap.ssid : "");
+    resp_printf(&w, ",\"rssi\":%d", linked ? ap.rssi : 0);
+    // Corriente media estimada con el ciclo de trabajo (light sleep / despierto) y el modem sleep
+    power_stats_t pw;
+    power_get_stats(&pw);
+    resp_printf(&w, ",\"current_ma\":%.1f}", pw.current_ma);
+    resp_end(&w);
   });
 
   // GET /telemetry -> devuelve solo temperatura, humedad y MAC
-  server.on("/telemetry", HTTP_GET, []() {
-    String json = "{";
-    if (isnan(ota_temp_c)) {
-      json += "\"temperature\":null";
-    } else {
-      json += "\"temperature\":" + String(ota_temp_c, 1);
-    }
-    if (isnan(ota_humidity_pct)) {
-      json += ",\"humidity\":null";
-    } else {
-      json += ",\"humidity\":" + String(ota_humidity_pct, 1);
-    }
-    // Añadir MAC del dispositivo
-    json += ",\"mac\":\"" + WiFi.macAddress() + "\"";
-    json += "}";
-    server.send(200, "application/json", json);
+  on_route("/telemetry", HTTP_GET, []() {
+    resp_writer_t w;
+    resp_begin(&w, server, 200, "application/json");
+    resp_puts(&w, "{");
+    device_info_sensors(&w, false);
+    device_info_mac(&w);
+    resp_puts(&w, "}");
+    resp_end(&w);
   });
 
   // --- Authentication endpoints ---
   // POST /auth/login -> {"username":"...","password":"..."}
-  server.on("/auth/login", HTTP_POST, []() {
-    String body = server.arg("plain");
-    Serial.println("[OTA][AUTH] /auth/login body: " + body);
-    String u = extract_json_value(body, "username");
-    String p = extract_json_value(body, "password");
-    // Log masked values for debugging
-    Serial.println(String("[OTA][AUTH] login try user='") + u + "' pass_len=" + String(p.length()));
-    Preferences auth;
-    auth.begin("ota_auth", true);
-    String su = auth.getString("user", "Telemetry");
-    String sp = auth.getString("pass", "Colombia123");
-    auth.end();
-    Serial.println(String("[OTA][AUTH] stored user='") + su + "' stored_pass_len=" + String(sp.length()));
-    if (auth_check_credentials(u, p)) {
-      server.send(200, "application/json", "{\"ok\":true}");
+  on_route("/auth/login", HTTP_POST, []() {
+    auth_body_t body;
+    bool parsed = auth_body_parse(&body);
+    // Sólo el largo del usuario: el cuerpo no se registra
+    MLOGD("[OTA][AUTH] login try user_len=%u pass_len=%u", (unsigned)strlen(body.username), (unsigned)strlen(body.password));
+    char token[OTA_AUTH_TOKEN_LEN + 1];
+    if (parsed && ota_auth_login(body.username, body.password, token)) {
+      char js[OTA_AUTH_TOKEN_LEN + 32];
+      snprintf(js, sizeof(js), "{\"ok\":true,\"token\":\"%s\"}", token);
+      resp_send(server, 200, "application/json", js);
     } else {
-      server.send(401, "application/json", "{\"ok\":false}");
+      resp_send(server, 401, "application/json", "{\"ok\":false}");
     }
   });
 
+  // POST /auth/logout -> cierra la sesión del token enviado
+  on_route("/auth/logout", HTTP_POST, []() {
+    ota_auth_logout(server.header(OTA_AUTH_HEADER).c_str());
+    resp_send(server, 200, "application/json", "{\"ok\":true}");
+  });
+
   // GET /auth/user -> devuelve el usuario actual (no devuelve la contraseña)
-  server.on("/auth/user", HTTP_GET, []() {
-    Preferences auth;
-    auth.begin("ota_auth", true);
-    String u = auth.getString("user", "Telemetry");
-    auth.end();
-    String js = String("{\"user\":\"") + u + String("\"}");
-    server.send(200, "application/json", js);
+  on_route("/auth/user", HTTP_GET, []() {
+    resp_writer_t w;
+    resp_begin(&w, server, 200, "application/json");
+    resp_puts(&w, "{\"user\":");
+    resp_json_string(&w, ota_auth_user());
+    resp_puts(&w, "}");
+    resp_end(&w);
   });
 
   // POST /auth/change -> cambiar usuario/clave
   // body: {"username":"newUser","current_password":"cur","new_password":"new","confirm_password":"new"}
-  server.on("/auth/change", HTTP_POST, []() {
-    String body = server.arg("plain");
-    String newUser = extract_json_value(body, "username");
-    String cur = extract_json_value(body, "current_password");
-    String np = extract_json_value(body, "new_password");
-    String cp = extract_json_value(body, "confirm_password");
-    if (np.length() == 0 || np != cp) {
-      server.send(400, "application/json", "{\"ok\":false,\"error\":\"password_mismatch\"}");
+  on_route("/auth/change", HTTP_POST, []() {
+    if (!require_session()) return;
+    auth_body_t body;
+    if (!auth_body_parse(&body)) {
+      resp_send(server, 400, "application/json", body.user_too_long ? "{\"ok\":false,\"error\":\"username_too_long\"}"
+                                                                    : "{\"ok\":false,\"error\":\"invalid_json\"}");
+      return;
+    }
+    if (body.new_password[0] == '\0' || strcmp(body.new_password, body.confirm_password) != 0) {
+      resp_send(server, 400, "application/json", "{\"ok\":false,\"error\":\"password_mismatch\"}");
       return;
     }
     // verify current password against stored credentials
-    Preferences authR;
-    authR.begin("ota_auth", true);
-    String storedUser = authR.getString("user", "Telemetry");
-    authR.end();
-    if (!auth_check_credentials(storedUser, cur)) {
-      server.send(403, "application/json", "{\"ok\":false,\"error\":\"invalid_current\"}");
+    if (!ota_auth_check(ota_auth_user(), body.password)) {
+      resp_send(server, 403, "application/json", "{\"ok\":false,\"error\":\"invalid_current\"}");
       return;
     }
     // set username to provided value or keep existing
-    String finalUser = newUser.length() ? newUser : storedUser;
-    auth_set_credentials(finalUser, np);
-    server.send(200, "application/json", "{\"ok\":true}");
+    if (body.username[0] == '\0') strlcpy(body.username, ota_auth_user(), sizeof(body.username));
+    ota_auth_set(body.username, body.new_password);
+    resp_send(server, 200, "application/json", "{\"ok\":true}");
   });
 
   // POST /upload_logo -> recibir PNG y guardarlo en LittleFS
-  server.on("/upload_logo", HTTP_POST, []() {
+  on_route("/upload_logo", HTTP_POST, []() {
     // final handler: respond OK and trigger no restart
-    server.send(200, "application/json", "{\"ok\":true}\n");
+    if (!upload_take_authorized()) {
+      resp_send(server, 401, "application/json", "{\"ok\":false,\"error\":\"unauthorized\"}");
+      return;
+    }
+    resp_send(server, 200, "application/json", "{\"ok\":true}\n");
   }, []() {
     HTTPUpload &upload = server.upload();
     static File logoFile = File();
     if (upload.status == UPLOAD_FILE_START) {
-      Serial.printf("[OTA] logo upload start: %s\n", upload.filename.c_str());
+      upload_authorized = ota_auth_session_valid(server.header(OTA_AUTH_HEADER).c_str());
+      if (!upload_authorized) return;
+      MLOGI("[OTA] logo upload start: %s", upload.filename.c_str());
       if (LittleFS.exists("/logo.png")) LittleFS.remove("/logo.png");
       logoFile = LittleFS.open("/logo.png", "w");
-      if (!logoFile) Serial.println("[OTA] ERROR: cannot open /logo.png for writing");
+      if (!logoFile) MLOGE("[OTA] ERROR: cannot open /logo.png for writing");
     } else if (upload.status == UPLOAD_FILE_WRITE) {
       if (logoFile) logoFile.write(upload.buf, upload.currentSize);
     } else if (upload.status == UPLOAD_FILE_END) {
       if (logoFile) {
         logoFile.close();
-        Serial.printf("[OTA] logo upload complete, size=%u\n", upload.totalSize);
+        MLOGI("[OTA] logo upload complete, size=%u", upload.totalSize);
       }
     } else if (upload.status == UPLOAD_FILE_ABORTED) {
-      Serial.println("[OTA] logo upload aborted");
+      MLOGW("[OTA] logo upload aborted");
       if (logoFile) { logoFile.close(); LittleFS.remove("/logo.png"); }
     }
   });
 
   
 
-  // POST /update -> manejo de carga OTA usando Update API
-  server.on("/update", HTTP_POST, []() {
+  // POST /update?size=<bytes>&sha256=<hex> -> carga OTA con doble buffer y verificación
+  // size y sha256 son opcionales; si se envían, la imagen se rechaza antes de reiniciar
+  // cuando no coinciden.
+  on_route("/update", HTTP_POST, []() {
     // Compleción de la petición
-    if (Update.hasError()) {
-      Serial.println("[OTA] Resultado: FALLÓ");
-      server.send(500, "text/plain", "FAIL");
+    bool pull_busy = upload_pull_busy;
+    upload_pull_busy = false;
+    if (!upload_take_authorized()) {
+      resp_send(server, 401, "application/json", "{\"ok\":false,\"error\":\"unauthorized\"}");
+      return;
+    }
+    if (pull_busy) {
+      resp_send(server, 409, "application/json", "{\"ok\":false,\"error\":\"actualizacion en curso\"}");
+      return;
+    }
+    const ota_stream_stats_t &st = ota_stream_get_stats();
+    if (!st.ok) {
+      MLOGE("[OTA] Resultado: FALLÓ");
+      // 507: sin heap para los buffers o el descompresor (gzip necesita ~43KB)
+      resp_writer_t w;
+      resp_begin(&w, server, ota_stream_out_of_memory() ? 507 : 500, "application/json");
+      resp_puts(&w, "{\"ok\":false,\"error\":");
+      resp_json_string(&w, ota_stream_error());
+      resp_puts(&w, "}");
+      resp_end(&w);
     } else {
       // Antes de reiniciar, establecer flag para forzar AP en próximo arranque
-      Preferences p;
-      p.begin("moe_wifi", false);
-      p.putBool("force_ap", true);
-      p.end();
-
-      server.sendHeader("Connection", "close");
-      server.send(200, "text/plain", "OK");
-      Serial.println("[OTA] Actualización completada con éxito, marcando force_ap y reiniciando...");
+      config_set_force_ap(true);
+      config_store_flush();
+
+      char js[128];
+      snprintf(js, sizeof(js), "{\"ok\":true,\"bytes\":%u,\"ms\":%u,\"kbps\":%u,\"flash_ms\":%u,\"stall_ms\":%u}",
+               (unsigned)st.bytes_received, (unsigned)st.elapsed_ms, (unsigned)st.kbps,
+               (unsigned)st.flash_ms, (unsigned)st.stall_ms);
+      resp_send(server, 200, "application/json", js);
+      MLOGI("[OTA] Actualización completada con éxito, marcando force_ap y reiniciando...");
       delay(100);
       ESP.restart();
     }
@@ -1357,119 +1793,241 @@ void ota_background_task(void *parameter)
     // Handler de upload
     HTTPUpload& upload = server.upload();
     if (upload.status == UPLOAD_FILE_START) {
-      Serial.printf("[OTA] UploadStart: %s\n", upload.filename.c_str());
-      if (!Update.begin(UPDATE_SIZE_UNKNOWN)) {
-        Update.printError(Serial);
+      // Sin sesión válida no se inicia el stream: los bloques siguientes se descartan
+      upload_authorized = ota_auth_session_valid(server.header(OTA_AUTH_HEADER).c_str());
+      if (!upload_authorized) return;
+      // La tarea de pull escribe la misma partición inactiva
+      upload_pull_busy = ota_pull_busy();
+      if (upload_pull_busy) {
+        MLOGW("[OTA] Carga rechazada: descarga pull en curso");
+        return;
       }
+      ota_pull_discard();
+      MLOGI("[OTA] UploadStart: %s", upload.filename.c_str());
+      // Con modem sleep el AP retiene los paquetes hasta el próximo beacon escuchado
+      wifi_power_save(false);
+      size_t expected = (size_t)server.arg("size").toInt();
+      ota_stream_begin(expected, server.arg("sha256").c_str());
     } else if (upload.status == UPLOAD_FILE_WRITE) {
-      if (Update.write(upload.buf, upload.currentSize) != (int)upload.currentSize) {
-        Update.printError(Serial);
+      // Tras un error se descartan los bloques restantes; el resultado se reporta al final
+      if (ota_stream_in_progress() && !ota_stream_write(upload.buf, upload.currentSize)) {
+        ota_stream_abort();
       }
     } else if (upload.status == UPLOAD_FILE_END) {
-      if (Update.end(true)) {
-        Serial.printf("[OTA] Update Success: %u bytes\n", upload.totalSize);
-      } else {
-        Update.printError(Serial);
+      if (ota_stream_in_progress() && ota_stream_end()) {
+        MLOGI("[OTA] Update Success: %u bytes", upload.totalSize);
       }
+      wifi_power_save(true);
     } else if (upload.status == UPLOAD_FILE_ABORTED) {
-      Serial.println("[OTA] Upload Aborted");
+      MLOGW("[OTA] Upload Aborted");
+      ota_stream_abort();
+      wifi_power_save(true);
     }
   });
 
+  // GET /update/stats -> métricas de la última carga (throughput, tiempo en flash, esperas)
+  on_route("/update/stats", HTTP_GET, []() {
+    const ota_stream_stats_t &st = ota_stream_get_stats();
+    resp_writer_t w;
+    resp_begin(&w, server, 200, "application/json");
+    resp_printf(&w, "{\"ok\":%s,\"in_progress\":%s,\"bytes\":%u,\"written\":%u,\"ms\":%u,\"kbps\":%u,\"flash_ms\":%u,\"stall_ms\":%u,\"error\":",
+                st.ok ? "true" : "false", ota_stream_in_progress() ? "true" : "false",
+                (unsigned)st.bytes_received, (unsigned)st.bytes_written, (unsigned)st.elapsed_ms,
+                (unsigned)st.kbps, (unsigned)st.flash_ms, (unsigned)st.stall_ms);
+    resp_json_string(&w, ota_stream_error());
+    resp_puts(&w, "}");
+    resp_end(&w);
+  });
+
+  // GET /update/pull -> estado de la descarga desde el servidor de firmware
+  on_route("/update/pull", HTTP_GET, []() {
+    static const char* const names[] = { "idle", "up_to_date", "in_progress", "ready", "error" };
+    ota_pull_status_t st;
+    ota_pull_get_status(&st);
+    resp_writer_t w;
+    resp_begin(&w, server, 200, "application/json");
+    resp_printf(&w, "{\"state\":\"%s\",\"version\":", names[st.state]);
+    resp_json_string(&w, st.version);
+    resp_printf(&w, ",\"offset\":%u,\"size\":%u,\"error\":", (unsigned)st.offset, (unsigned)st.size);
+    resp_json_string(&w, st.error);
+    resp_puts(&w, "}");
+    resp_end(&w);
+  });
+
+  // POST /update/pull -> consultar el manifiesto y descargar la imagen en segundo plano
+  on_route("/update/pull", HTTP_POST, []() {
+    if (!require_session()) return;
+    if (ota_stream_in_progress() || !ota_pull_start_async()) {
+      resp_send(server, 409, "application/json", "{\"ok\":false,\"error\":\"actualizacion en curso\"}");
+      return;
+    }
+    resp_send(server, 200, "application/json", "{\"ok\":true}");
+  });
+
   // POST /factory_reset -> borrar credenciales y reiniciar (desde UI OTA)
-  server.on("/factory_reset", HTTP_POST, []() {
-    Serial.println("[OTA] POST /factory_reset recibido: borrando credenciales...");
+  on_route("/factory_reset", HTTP_POST, []() {
+    if (!require_session()) return;
+    MLOGI("[OTA] POST /factory_reset recibido: borrando credenciales...");
     erase_wifi_credentials();
     // Reset OTA auth credentials to defaults upon factory reset
-    Preferences auth;
-    auth.begin("ota_auth", false);
-    auth.putString("user", "Telemetry");
-    auth.putString("pass", "Colombia123");
-    auth.end();
-    server.send(200, "text/plain", "OK");
+    ota_auth_reset_defaults();
+    resp_send(server, 200, "text/plain", "OK");
     delay(200);
     ESP.restart();
   });
 
-  // GET/POST /update/interval -> consulta y cambia intervalo en minutos (persistente en moe_cfg)
-  server.on("/update/interval", HTTP_GET, []() {
-    Preferences prefs;
-    prefs.begin("moe_cfg", true);
-    uint8_t interval = prefs.getUChar("interval_minutes", 10);
-    prefs.end();
-    String js = String("{\"interval\":") + String(interval) + String("}");
-    server.send(200, "application/json", js);
+  // GET/POST /update/interval -> consulta y cambia intervalo en minutos (persistente vía config_store)
+  on_route("/update/interval", HTTP_GET, []() {
+    char js[24];
+    snprintf(js, sizeof(js), "{\"interval\":%u}", config_get_interval_minutes());
+    resp_send(server, 200, "application/json", js);
   });
 
-  server.on("/update/interval", HTTP_POST, []() {
-    String body = server.arg("plain");
-    int idx = body.indexOf("interval");
-    int newInterval = -1;
-    if (idx >= 0) {
-      int colon = body.indexOf(':', idx);
-      if (colon >= 0) {
-        String v = body.substring(colon + 1);
-        v.trim();
-        newInterval = v.toInt();
-      }
-    }
-    if (newInterval <= 0) {
-      server.send(400, "application/json", "{\"error\":\"invalid interval\"}");
-      return;
-    }
-    Preferences prefs;
-    prefs.begin("moe_cfg", false);
-    prefs.putUChar("interval_minutes", (uint8_t)newInterval);
-    prefs.end();
-    String js = String("{\"interval\":") + String(newInterval) + String("}");
-    server.send(200, "application/json", js);
+  on_route("/update/interval", HTTP_POST, []() {
+    if (!require_session()) return;
+    // Mismo validador que PATCH /api/config; se vuelca a NVS desde config_store_tick
+    int8_t want_normal;
+    if (!config_patch_handle(&want_normal)) return;
+    char js[24];
+    snprintf(js, sizeof(js), "{\"interval\":%u}", config_get_interval_minutes());
+    resp_send(server, 200, "application/json", js);
+    config_apply_mode(want_normal);
   });
 
-  // GET/POST /update/mode -> consulta y cambia modo persistente (moe_cfg -> key 'mode')
-  server.on("/update/mode", HTTP_GET, []() {
-    Preferences prefs;
-    prefs.begin("moe_cfg", true);
-    uint8_t mode = prefs.getUChar("mode", MODE_CONTINUOUS);
-    prefs.end();
+  // GET/POST /update/mode -> consulta y cambia modo persistente (config_store -> 'mode')
+  on_route("/update/mode", HTTP_GET, []() {
+    uint8_t mode = config_get_mode();
     // If OTA runtime flag is set, prefer that (so UI reflects immediate change)
     bool normal = ota_runtime_normal || (mode == MODE_NORMAL);
-    String js = String("{\"normal\":") + (normal ? "true" : "false") + String("}");
-    server.send(200, "application/json", js);
+    resp_send(server, 200, "application/json", normal ? "{\"normal\":true}" : "{\"normal\":false}");
   });
 
-  server.on("/update/mode", HTTP_POST, []() {
-    String body = server.arg("plain");
-    bool wantNormal = (body.indexOf("true") >= 0) || (body.indexOf("1") >= 0 && body.indexOf("continuous") == -1);
-    // If client requests normal mode, persist 'mode' = MODE_NORMAL. If they request false, do not allow reverting via OTA
-    if (wantNormal) {
-      // Do NOT persist mode across reboots. Trigger immediate Normal-mode behavior
-      ota_runtime_normal = true;
-      ota_on_mode_changed(false);
-      server.send(200, "application/json", "{\"normal\":true}");
-    } else {
-      ota_runtime_normal = false;
-      ota_on_mode_changed(true);
-      server.send(200, "application/json", "{\"normal\":false}");
-    }
+  on_route("/update/mode", HTTP_POST, []() {
+    if (!require_session()) return;
+    // Body {"normal":true}: Normal en ejecución (no persiste entre reinicios)
+    int8_t want_normal;
+    if (!config_patch_handle(&want_normal)) return;
+    if (want_normal < 0) want_normal = 0;
+    resp_send(server, 200, "application/json", want_normal ? "{\"normal\":true}" : "{\"normal\":false}");
+    config_apply_mode(want_normal);
+  });
+
+  // GET/PATCH /api/config -> configuración completa. PATCH aplica varios campos a la vez
+  // (interval, mode, pull_min_battery, headless_wake, listen_interval, telemetry_url, door_url): si
+  // alguno es inválido no se aplica ninguno. Responde con la configuración efectiva. listen_interval
+  // rige desde la próxima asociación WiFi.
+  on_route("/api/config", HTTP_GET, []() {
+    config_send_json();
+  });
+
+  on_route("/api/config", HTTP_PATCH, []() {
+    if (!require_session()) return;
+    int8_t want_normal;
+    if (!config_patch_handle(&want_normal)) return;
+    if (want_normal >= 0) ota_runtime_normal = want_normal == 1;
+    config_send_json();
+    config_apply_mode(want_normal);
+  });
+
+  // GET /history?from=<epoch>&to=<epoch>&step=<s> -> buckets agregados, enviados por chunks
+  // Filas: [inicio, tmin, tmax, tmedia, hmin, hmax, hmedia, bmin, bmax, bmedia, aperturas]
+  on_route("/history", HTTP_GET, []() {
+    uint32_t to = server.hasArg("to") ? strtoul(server.arg("to").c_str(), NULL, 10) : (uint32_t)time(NULL);
+    uint32_t from = server.hasArg("from") ? strtoul(server.arg("from").c_str(), NULL, 10) : to - 86400;
+    uint32_t step = strtoul(server.arg("step").c_str(), NULL, 10);
+
+    history_chunk_t out;
+    out.first = true;
+    resp_begin(&out.w, server, 200, "application/json");
+    resp_stream(&out.w);
+    resp_printf(&out.w, "{\"from\":%u,\"to\":%u,\"rows\":[", (unsigned)from, (unsigned)to);
+    uint32_t width = 0;
+    size_t rows = history_query(from, to, step, &width, history_emit_row, &out);
+    resp_printf(&out.w, "],\"level\":%u,\"count\":%u}", (unsigned)width, (unsigned)rows);
+    resp_end(&out.w);
+  });
+
+  // GET /history/raw?from=<epoch>&to=<epoch> -> lecturas completas del almacenamiento comprimido (CSV)
+  on_route("/history/raw", HTTP_GET, []() {
+    uint32_t to = server.hasArg("to") ? strtoul(server.arg("to").c_str(), NULL, 10) : (uint32_t)time(NULL);
+    uint32_t from = server.hasArg("from") ? strtoul(server.arg("from").c_str(), NULL, 10) : to - 86400;
+
+    history_chunk_t out;
+    out.first = true;
+    resp_begin(&out.w, server, 200, "text/csv");
+    resp_stream(&out.w);
+    resp_puts(&out.w, "t,temperature,humidity,battery_mv\n");
+    ts_store_scan(from, to, ts_emit_csv_row, &out);
+    resp_end(&out.w);
+  });
+
+  // GET /logs -> registro binario formateado como texto (/log.old y /log.bin de esta imagen)
+  on_route("/logs", HTTP_GET, []() {
+    if (!require_session()) return;
+    resp_writer_t w;
+    resp_begin(&w, server, 200, "text/plain; charset=utf-8");
+    resp_stream(&w);
+    mlog_scan(mlog_emit_line, &w);
+    resp_end(&w);
   });
 
+  // GET /logs/raw[?old=1] -> archivo binario tal cual, para tools/moe_log.py
+  on_route("/logs/raw", HTTP_GET, []() {
+    if (!require_session()) return;
+    mlog_flush();
+    const char* path = server.hasArg("old") ? MLOG_OLD_FILE : MLOG_FILE;
+    File f = LittleFS.open(path, "r");
+    if (!f) { resp_send(server, 404, "text/plain", "no log"); return; }
+    server.sendHeader("Connection", "close");
+    server.streamFile(f, "application/octet-stream");
+    f.close();
+  });
+
+  // GET /metrics -> heap, pilas, CPU por tarea, peticiones y WiFi (formato Prometheus)
+  on_route("/metrics", HTTP_GET, []() {
+    resp_writer_t w;
+    resp_begin(&w, server, 200, "text/plain; version=0.0.4");
+    metrics_render(&w);
+    resp_end(&w);
+  });
+
+#ifdef MOE_STACK_PROFILE
+  // GET /debug/stacks -> informe de perfilado: pico de pila por tarea y carga que lo produjo
+  on_route("/debug/stacks", HTTP_GET, []() {
+    resp_writer_t w;
+    resp_begin(&w, server, 200, "text/plain");
+    char line[128];
+    for (uint8_t i = 0; i < TASK_COUNT; i++) {
+      task_profile_format((task_id_t)i, line, sizeof(line));
+      resp_printf(&w, "%s\n", line);
+    }
+    resp_end(&w);
+    task_profile_report();
+  });
+#endif
+
+  // Cabecera del token de sesión (WebServer sólo conserva las cabeceras declaradas)
+  static const char* auth_headers[] = { OTA_AUTH_HEADER };
+  server.collectHeaders(auth_headers, 1);
+
   // Iniciar servidor
-  Serial.println("[OTA] Iniciando servidor WebServer en puerto 80...");
+  MLOGI("[OTA] Iniciando servidor WebServer en puerto 80...");
   server.begin();
-  Serial.println("[OTA] Servidor WebServer iniciado ✓");
+  MLOGI("[OTA] Servidor WebServer iniciado ✓");
 
   ota_active = true;
 
-  Serial.println("✓ Servidor OTA listo");
-  Serial.println("✓ Dirección: http://" + WiFi.localIP().toString());
-  Serial.println("✓ Acceso: http://" + WiFi.localIP().toString() + "/");
-  Serial.println("[OTA] Esperando conexiones...\n");
+  MLOGI("✓ Servidor OTA listo en http://%u.%u.%u.%u/", ip[0], ip[1], ip[2], ip[3]);
+  MLOGI("[OTA] Esperando conexiones...");
 
-  // Bucle infinito: manejar peticiones OTA
+  // Bucle infinito: manejar peticiones OTA. Entre peticiones la tarea queda
+  // bloqueada en select() (sin delay(1) por vuelta), lo que permite el light sleep.
+  server.enableDelay(false);
   while (true)
   {
     server.handleClient();
-    delay(1);
+    metrics_count_poll();
+    ota_wait_sockets(OTA_SOCKET_WAIT_MS);
   }
 
   vTaskDelete(NULL); // Nunca se alcanza, pero por seguridad
@@ -1478,51 +2036,39 @@ void ota_background_task(void *parameter)
 // Inicializa OTA en una tarea FreeRTOS
 void init_ota_background()
 {
-  Serial.println("[OTA_INIT] Verificando precondiciones...");
-  Serial.print("[OTA_INIT] WiFi conectado: ");
-  Serial.println(WiFi.status() == WL_CONNECTED ? "SÍ" : "NO");
-  Serial.print("[OTA_INIT] Task handle: ");
-  Serial.println(ota_task_handle == NULL ? "NULL (ok)" : "YA EXISTE");
+  MLOGI("[OTA_INIT] Verificando precondiciones...");
+  MLOGI("[OTA_INIT] WiFi conectado: %s, task handle: %s", WiFi.status() == WL_CONNECTED ? "SÍ" : "NO",
+        ota_task_handle == NULL ? "NULL (ok)" : "YA EXISTE");
 
-  // Cargar el modo continuo desde Preferences (persistente entre reinicios)
-  ota_prefs.begin("moe", true); // read-only here
-  ota_continuous_mode = ota_prefs.getBool("continuous", false);
-  ota_prefs.end();
-  Serial.printf("[OTA_INIT] continuous_mode=%s\n", ota_continuous_mode ? "true" : "false");
+  // Modo continuo persistente (ya cargado por config_store)
+  ota_continuous_mode = config_get_continuous();
+  MLOGI("[OTA_INIT] continuous_mode=%s", ota_continuous_mode ? "true" : "false");
 
-  // Ensure auth defaults exist
-  auth_ensure_defaults();
+  // Cargar credenciales en RAM (crea las de fábrica si no existen)
+  ota_auth_init();
+  metrics_init();
 
   if (ota_task_handle == NULL && WiFi.status() == WL_CONNECTED)
   {
-    Serial.println("[OTA_INIT] Creando tarea FreeRTOS...");
-    
-    // Crear tarea con 16KB de stack (suficiente para la carga OTA)
-    BaseType_t result = xTaskCreatePinnedToCore(
-      ota_background_task,     // Función de la tarea
-      "OTA_Task",              // Nombre
-      8192,                    // Stack size
-      NULL,                     // Parámetros
-      1,                        // Prioridad (0-24, 1 es bajo)
-      &ota_task_handle,         // Handle
-      0                         // Core (0 o 1)
-    );
-    
-    Serial.print("[OTA_INIT] Resultado de xTaskCreatePinnedToCore: ");
-    Serial.println(result == pdPASS ? "✓ ÉXITO" : "✗ FALLO");
+    MLOGI("[OTA_INIT] Creando tarea FreeRTOS...");
     
+    // Pila, prioridad y núcleo según task_config (TASK_STACK_OTA)
+    BaseType_t result = task_spawn(TASK_OTA, ota_background_task, NULL, &ota_task_handle);
+
+    MLOGI("[OTA_INIT] Resultado de task_spawn: %s", result == pdPASS ? "✓ ÉXITO" : "✗ FALLO");
+
     if (result != pdPASS) {
-      Serial.println("[OTA_INIT] ERROR: No se pudo crear la tarea OTA");
+      MLOGE("[OTA_INIT] ERROR: No se pudo crear la tarea OTA");
       ota_task_handle = NULL;
     }
   }
   else
   {
     if (ota_task_handle != NULL) {
-      Serial.println("[OTA_INIT] ERROR: Tarea OTA ya existe");
+      MLOGE("[OTA_INIT] ERROR: Tarea OTA ya existe");
     }
     if (WiFi.status() != WL_CONNECTED) {
-      Serial.println("[OTA_INIT] ERROR: WiFi no disponible");
+      MLOGE("[OTA_INIT] ERROR: WiFi no disponible");
     }
   }
 }
@@ -1533,6 +2079,7 @@ void stop_ota_background()
   if (ota_task_handle != NULL)
   {
     server.stop();
+    task_profile_detach(TASK_OTA);
     vTaskDelete(ota_task_handle);
     ota_task_handle = NULL;
     ota_active = false;
@@ -1549,10 +2096,8 @@ bool is_ota_active()
 void ota_set_continuous_mode(bool enabled)
 {
   ota_continuous_mode = enabled;
-  ota_prefs.begin("moe", false); // RW
-  ota_prefs.putBool("continuous", ota_continuous_mode);
-  ota_prefs.end();
-  Serial.printf("[OTA] ota_set_continuous_mode=%s\n", ota_continuous_mode ? "true" : "false");
+  config_set_continuous(ota_continuous_mode);
+  MLOGI("[OTA] ota_set_continuous_mode=%s", ota_continuous_mode ? "true" : "false");
   // Notify application of mode change immediately
   ota_on_mode_changed(ota_continuous_mode);
 }
@@ -1571,6 +2116,6 @@ bool ota_is_continuous_mode()
 bool ota_toggle_continuous_mode()
 {
   ota_set_continuous_mode(!ota_continuous_mode);
-  Serial.printf("[OTA] ota_toggle_continuous_mode -> %s\n", ota_continuous_mode ? "true" : "false");
+  MLOGI("[OTA] ota_toggle_continuous_mode -> %s", ota_continuous_mode ? "true" : "false");
   return ota_continuous_mode;
 }
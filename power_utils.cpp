@@ -1,9 +1,15 @@
 #include "power_utils.h"
+#include "moe_log.h"
 #include "esp_bt.h"
 #include "esp_wifi.h"
 #include "esp_pm.h"
 #include "esp_sleep.h"
 #include "driver/rtc_io.h"
+#include "driver/gpio.h"
+#include "esp_freertos_hooks.h"
+#include "config.h"
+#include "config_store.h"
+#include <WiFi.h>
 
 // Función para deshabilitar completamente Bluetooth
 void disable_bluetooth()
@@ -14,27 +20,94 @@ void disable_bluetooth()
   // Liberar memoria del controlador Bluetooth
   esp_bt_controller_deinit();
   
-  Serial.println("✅ Bluetooth completamente deshabilitado");
+  MLOGI("✅ Bluetooth completamente deshabilitado");
 }
 
 // Función para configurar frecuencia de CPU más baja cuando sea posible
 void configure_cpu_frequency()
 {
-  // Configurar el CPU para usar frecuencia más baja cuando no esté en uso intensivo
+  // Configurar el CPU para usar frecuencia más baja cuando no esté en uso intensivo.
+  // esp_pm_configure rechaza light_sleep_enable si el core no tiene tickless idle:
+  // en ese caso se pide sólo el escalado de frecuencia.
   esp_pm_config_esp32s3_t pm_config = {
     .max_freq_mhz = 240,      // Frecuencia máxima cuando se necesita rendimiento
     .min_freq_mhz = 80,       // Frecuencia mínima para ahorrar energía
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
     .light_sleep_enable = true // Habilitar light sleep automático
+#else
+    .light_sleep_enable = false
+#endif
   };
   
   esp_err_t ret = esp_pm_configure(&pm_config);
   if (ret == ESP_OK) {
-    Serial.println("✅ Gestión de energía CPU configurada");
+    MLOGI("✅ Gestión de energía CPU configurada (light sleep: %s)", pm_config.light_sleep_enable ? "sí" : "no, core sin tickless idle");
   } else {
-    Serial.println("❌ Error configurando gestión de energía CPU");
+    MLOGE("❌ Error configurando gestión de energía CPU (%d)", (int)ret);
   }
 }
 
+// Ticks de FreeRTOS vistos por el tick hook del núcleo 0
+static volatile uint32_t power_ticks_seen = 0;
+static TickType_t power_tick_start = 0;
+static bool power_counting = false;
+
+static void IRAM_ATTR power_tick_hook()
+{
+  power_ticks_seen++;
+}
+
+void power_light_sleep_begin()
+{
+  // Puerta y botón PRG arman su propio despertar por GPIO junto con su ISR
+  esp_sleep_enable_gpio_wakeup();
+  if (!power_counting) {
+    power_tick_start = xTaskGetTickCount();
+    power_ticks_seen = 0;
+    power_counting = esp_register_freertos_tick_hook_for_cpu(power_tick_hook, 0) == ESP_OK;
+  }
+}
+
+void power_light_sleep_end()
+{
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+  if (power_counting) {
+    esp_deregister_freertos_tick_hook_for_cpu(power_tick_hook, 0);
+    power_counting = false;
+  }
+}
+
+void power_get_stats(power_stats_t* out)
+{
+  uint32_t elapsed = 0, seen = 0;
+  if (power_counting) {
+    elapsed = (uint32_t)(xTaskGetTickCount() - power_tick_start);
+    seen = power_ticks_seen;
+  }
+  uint32_t slept = elapsed > seen ? elapsed - seen : 0;
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+  out->light_sleep = true;
+#else
+  out->light_sleep = false;
+#endif
+  out->light_sleep_ms = slept * portTICK_PERIOD_MS;
+  out->awake_ms = (elapsed - slept) * portTICK_PERIOD_MS;
+  out->listen_interval = config_get_listen_interval();
+  wifi_ps_type_t ps = WIFI_PS_NONE;
+  bool radio = WiFi.getMode() != WIFI_OFF && esp_wifi_get_ps(&ps) == ESP_OK;
+  out->modem_sleep = radio && ps != WIFI_PS_NONE;
+
+  float cpu = POWER_I_AWAKE_MA;
+  if (elapsed) cpu = (slept * POWER_I_LIGHT_SLEEP_MA + (elapsed - slept) * POWER_I_AWAKE_MA) / elapsed;
+  float rx = 0.0f;
+  if (radio) {
+    // Modem sleep: la radio sólo escucha un beacon de cada listen_interval (MIN_MODEM: cada DTIM, se toma 1)
+    uint8_t every = ps == WIFI_PS_MAX_MODEM ? out->listen_interval : 1;
+    rx = out->modem_sleep ? POWER_I_RADIO_RX_MA * POWER_BEACON_RX_MS / (every * POWER_BEACON_MS) : POWER_I_RADIO_RX_MA;
+  }
+  out->current_ma = cpu + rx;
+}
+
 // Función para deshabilitar periféricos no utilizados
 void disable_unused_peripherals()
 {
@@ -48,7 +121,7 @@ void disable_unused_peripherals()
   // Deshabilitar LEDC si no se usa
   // ledc_fade_func_uninstall();
   
-  Serial.println("✅ Periféricos no utilizados deshabilitados");
+  MLOGI("✅ Periféricos no utilizados deshabilitados");
 }
 
 // Función para configurar dominios de alimentación para máximo ahorro
@@ -57,14 +130,14 @@ void configure_power_domains()
   // Configurar dominios RTC para mantener solo lo necesario
   esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);      // Mantener para GPIO wakeup
   
-  Serial.println("✅ Dominios de alimentación optimizados");
+  MLOGI("✅ Dominios de alimentación optimizados");
 }
 
 // Función de inicialización completa de optimización energética
 void init_power_optimization()
 {
   Serial.begin(115200);
-  Serial.println("🔋 Iniciando optimizaciones de energía...");
+  MLOGI("🔋 Iniciando optimizaciones de energía...");
   
   // Aplicar todas las optimizaciones
   disable_bluetooth();
@@ -72,7 +145,7 @@ void init_power_optimization()
   disable_unused_peripherals();
   configure_power_domains();
   
-  Serial.println("🔋 Optimizaciones de energía completadas");
+  MLOGI("🔋 Optimizaciones de energía completadas");
   Serial.flush(); // Asegurar que se imprima todo antes de continuar
   delay(100);
 }
\ No newline at end of file
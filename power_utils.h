@@ -12,4 +12,36 @@ void configure_power_domains();
 // Función de inicialización completa de ahorro energético
 void init_power_optimization();
 
+// Light sleep automático del modo continuo. Con el core compilado con tickless
+// idle (CONFIG_FREERTOS_USE_TICKLESS_IDLE) el idle de FreeRTOS duerme la CPU
+// cuando todas las tareas esperan; el WiFi queda en modem sleep (ver
+// wifi_power_save) y la puerta y el botón PRG despiertan por GPIO. Sin tickless
+// idle sólo se aplica el escalado de frecuencia.
+//
+// Ciclo de trabajo: los ticks que FreeRTOS salta al dormir no pasan por el
+// tick hook, así que (ticks transcurridos - ticks vistos) es el tiempo en
+// light sleep. La corriente media se estima con corrientes de referencia.
+#define POWER_I_LIGHT_SLEEP_MA  1.0f    // CPU en light sleep (placa incluida, sin pantalla)
+#define POWER_I_AWAKE_MA        25.0f   // CPU despierta (80-240 MHz), radio apagada
+#define POWER_I_RADIO_RX_MA     95.0f   // Radio escuchando
+#define POWER_BEACON_RX_MS      3.0f    // Radio encendida por beacon escuchado
+#define POWER_BEACON_MS         102.4f  // Intervalo de beacon típico (100 TU)
+
+// Habilita el despertar por GPIO y empieza a contar el ciclo de trabajo
+void power_light_sleep_begin();
+
+// Antes del deep sleep: quita las fuentes de despertar propias del light sleep
+void power_light_sleep_end();
+
+typedef struct {
+  bool light_sleep;             // Light sleep automático disponible
+  uint32_t light_sleep_ms;      // Desde power_light_sleep_begin
+  uint32_t awake_ms;
+  uint8_t listen_interval;
+  bool modem_sleep;
+  float current_ma;             // Corriente media estimada (CPU + radio)
+} power_stats_t;
+
+void power_get_stats(power_stats_t* out);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include "req_arena.h"
+#include "moe_log.h"
+#include <atomic>
+#include <stdarg.h>
+
+// Sólo la tarea que atiende el servidor web (OTA o portal AP, nunca ambos a la vez) usa el arena
+static uint8_t arena[REQ_ARENA_SIZE] __attribute__((aligned(8)));
+static size_t arena_used = 0;
+static size_t arena_peak = 0;
+
+void* req_arena_alloc(size_t size)
+{
+  size_t start = (arena_used + 7) & ~(size_t)7;
+  if (size == 0 || start > REQ_ARENA_SIZE || size > REQ_ARENA_SIZE - start) return NULL;
+  arena_used = start + size;
+  if (arena_used > arena_peak) arena_peak = arena_used;
+  return arena + start;
+}
+
+void req_arena_reset()
+{
+  arena_used = 0;
+}
+
+size_t req_arena_used()
+{
+  return arena_used;
+}
+
+size_t req_arena_high_water()
+{
+  return arena_peak;
+}
+
+static const char* resp_status_text(int code)
+{
+  switch (code) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 409: return "Conflict";
+    case 413: return "Payload Too Large";
+    case 500: return "Internal Server Error";
+    default: return "";
+  }
+}
+
+static void resp_raw(resp_writer_t* w, const void* data, size_t len)
+{
+  if (w->failed || len == 0) return;
+  if (w->client.write((const uint8_t*)data, len) != len) w->failed = true;
+}
+
+// length < 0: Transfer-Encoding chunked
+static void resp_header(resp_writer_t* w, long length)
+{
+  char hdr[192];
+  int n = snprintf(hdr, sizeof(hdr), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\n", w->code, resp_status_text(w->code), w->type);
+  if (length < 0) n += snprintf(hdr + n, sizeof(hdr) - n, "Transfer-Encoding: chunked\r\n");
+  else n += snprintf(hdr + n, sizeof(hdr) - n, "Content-Length: %ld\r\n", length);
+  n += snprintf(hdr + n, sizeof(hdr) - n, "Connection: close\r\n\r\n");
+  resp_raw(w, hdr, n < (int)sizeof(hdr) ? n : sizeof(hdr) - 1);
+}
+
+static void resp_chunk(resp_writer_t* w, const char* data, size_t len)
+{
+  if (len == 0) return;
+  char size[12];
+  int n = snprintf(size, sizeof(size), "%x\r\n", (unsigned)len);
+  resp_raw(w, size, n);
+  resp_raw(w, data, len);
+  resp_raw(w, "\r\n", 2);
+}
+
+void resp_stream(resp_writer_t* w)
+{
+  if (w->streaming) return;
+  resp_header(w, -1);
+  w->streaming = true;
+}
+
+static void resp_flush(resp_writer_t* w)
+{
+  resp_stream(w);
+  resp_chunk(w, w->buf, w->len);
+  w->len = 0;
+}
+
+void resp_begin(resp_writer_t* w, WebServer &srv, int code, const char* type)
+{
+  w->client = srv.client();
+  w->code = code;
+  w->type = type;
+  w->len = 0;
+  w->streaming = false;
+  w->failed = false;
+  w->truncated = false;
+  w->cap = RESP_CHUNK_SIZE;
+  w->buf = (char*)req_arena_alloc(w->cap);
+  if (!w->buf) {
+    // Arena casi lleno: usar lo que quede
+    w->cap = REQ_ARENA_SIZE > req_arena_used() + 8 ? REQ_ARENA_SIZE - req_arena_used() - 8 : 0;
+    w->buf = w->cap ? (char*)req_arena_alloc(w->cap) : NULL;
+    if (!w->buf) w->cap = 0;
+  }
+}
+
+void resp_write(resp_writer_t* w, const char* data, size_t len)
+{
+  if (w->cap == 0) {
+    resp_stream(w);
+    resp_chunk(w, data, len);
+    return;
+  }
+  while (len > 0) {
+    if (w->len == w->cap) resp_flush(w);
+    if (w->len == 0 && len >= w->cap) {
+      // Bloque grande con el buffer vacío: va como un chunk sin copiarlo
+      resp_stream(w);
+      resp_chunk(w, data, len);
+      return;
+    }
+    size_t n = w->cap - w->len;
+    if (n > len) n = len;
+    memcpy(w->buf + w->len, data, n);
+    w->len += n;
+    data += n;
+    len -= n;
+  }
+}
+
+void resp_puts(resp_writer_t* w, const char* s)
+{
+  if (s) resp_write(w, s, strlen(s));
+}
+
+void resp_printf(resp_writer_t* w, const char* fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  va_list first;
+  va_copy(first, args);
+  size_t room = w->cap - w->len;
+  int n = room ? vsnprintf(w->buf + w->len, room, fmt, first) : vsnprintf(NULL, 0, fmt, first);
+  va_end(first);
+  if (n > 0 && (size_t)n < room) {
+    w->len += n;
+  } else if (n > 0 && (size_t)n < w->cap) {
+    // Cabe en un buffer vacío: enviar lo acumulado y formatear de nuevo
+    resp_flush(w);
+    vsnprintf(w->buf, w->cap, fmt, args);
+    w->len = n;
+  } else if (n > 0) {
+    // Fragmento mayor que el buffer: formatear en un bloque temporal del arena
+    char* tmp = (char*)req_arena_alloc(n + 1);
+    if (tmp) {
+      vsnprintf(tmp, n + 1, fmt, args);
+      resp_write(w, tmp, n);
+    } else {
+      w->truncated = true;
+    }
+  }
+  va_end(args);
+}
+
+void resp_json_string(resp_writer_t* w, const char* s)
+{
+  resp_write(w, "\"", 1);
+  if (s) {
+    const char* run = s;
+    for (; *s; s++) {
+      uint8_t c = (uint8_t)*s;
+      if (c >= 0x20 && c != '"' && c != '\\') continue;
+      resp_write(w, run, s - run);
+      run = s + 1;
+      if (c == '"') resp_write(w, "\\\"", 2);
+      else if (c == '\\') resp_write(w, "\\\\", 2);
+      else if (c == '\n') resp_write(w, "\\n", 2);
+      else resp_printf(w, "\\u%04x", c);
+    }
+    resp_write(w, run, s - run);
+  }
+  resp_write(w, "\"", 1);
+}
+
+static int8_t resp_base64_value(uint8_t c)
+{
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
+
+void resp_write_base64(resp_writer_t* w, const char* b64)
+{
+  char out[96];
+  size_t n = 0;
+  uint32_t acc = 0;
+  int bits = 0;
+  for (; b64 && *b64 && *b64 != '='; b64++) {
+    int8_t v = resp_base64_value((uint8_t)*b64);
+    if (v < 0) continue;
+    acc = (acc << 6) | (uint32_t)v;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      out[n++] = (char)(acc >> bits);
+      if (n == sizeof(out)) {
+        resp_write(w, out, n);
+        n = 0;
+      }
+    }
+  }
+  resp_write(w, out, n);
+}
+
+void resp_end(resp_writer_t* w)
+{
+  if (w->streaming) {
+    resp_flush(w);
+    resp_raw(w, "0\r\n\r\n", 5);
+  } else {
+    resp_header(w, (long)w->len);
+    resp_raw(w, w->buf, w->len);
+  }
+  w->len = 0;
+  if (w->truncated) MLOGW("[HTTP] Respuesta truncada: arena agotado");
+}
+
+void resp_send(WebServer &srv, int code, const char* type, const char* body)
+{
+  resp_writer_t w;
+  resp_begin(&w, srv, code, type);
+  resp_puts(&w, body);
+  resp_end(&w);
+}
+
+#ifdef MOE_ALLOC_DEBUG
+// Envoltorios de enlazado (-Wl,--wrap=...): cuentan sólo las asignaciones de
+// la tarea marcada por req_alloc_track_begin()
+static TaskHandle_t alloc_task = NULL;
+static std::atomic<uint32_t> alloc_count(0);
+static std::atomic<uint32_t> alloc_total(0);
+
+extern "C" void* __real_malloc(size_t size);
+extern "C" void* __real_calloc(size_t n, size_t size);
+extern "C" void* __real_realloc(void* ptr, size_t size);
+
+static inline void alloc_note()
+{
+  if (alloc_task && alloc_task == xTaskGetCurrentTaskHandle()) alloc_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" void* __wrap_malloc(size_t size)
+{
+  alloc_note();
+  return __real_malloc(size);
+}
+
+extern "C" void* __wrap_calloc(size_t n, size_t size)
+{
+  alloc_note();
+  return __real_calloc(n, size);
+}
+
+extern "C" void* __wrap_realloc(void* ptr, size_t size)
+{
+  alloc_note();
+  return __real_realloc(ptr, size);
+}
+
+void req_alloc_track_begin()
+{
+  alloc_count.store(0, std::memory_order_relaxed);
+  alloc_task = xTaskGetCurrentTaskHandle();
+}
+
+uint32_t req_alloc_track_end()
+{
+  alloc_task = NULL;
+  uint32_t n = alloc_count.load(std::memory_order_relaxed);
+  alloc_total.fetch_add(n, std::memory_order_relaxed);
+  return n;
+}
+
+uint32_t req_alloc_total()
+{
+  return alloc_total.load(std::memory_order_relaxed);
+}
+#else
+void req_alloc_track_begin() {}
+uint32_t req_alloc_track_end() { return 0; }
+uint32_t req_alloc_total() { return 0; }
+#endif
@@ -0,0 +1,73 @@
+#ifndef REQ_ARENA_H
+#define REQ_ARENA_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+
+// Memoria por petición para los handlers web. Un arena de desplazamiento
+// (bump) estático entrega buffers de trabajo y se reinicia completo al
+// terminar cada petición (on_route), así armar una respuesta no toca el heap.
+// El escritor de respuestas formatea en un buffer del arena y envía la
+// respuesta con Content-Length; si no cabe pasa a chunked y sigue
+// escribiendo directo al cliente. Las cabeceras HTTP se arman igual que
+// WebServer::send (Content-Type, longitud, Connection: close).
+//
+// Con MOE_ALLOC_DEBUG definido y el enlazado con
+// -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc se cuentan las asignaciones
+// de heap hechas por la tarea que atiende la petición mientras corre el
+// handler (ver README).
+
+#define REQ_ARENA_SIZE      4096
+#define RESP_CHUNK_SIZE     1024        // Buffer del escritor; al llenarse se envía un chunk
+
+// Bloque de `size` bytes alineado a 8, válido hasta req_arena_reset(). NULL si no cabe.
+void* req_arena_alloc(size_t size);
+
+// Libera todo lo entregado por el arena
+void req_arena_reset();
+
+// Bytes en uso y máximo observado desde el arranque
+size_t req_arena_used();
+size_t req_arena_high_water();
+
+typedef struct {
+  WiFiClient client;
+  char* buf;
+  size_t cap;
+  size_t len;
+  int code;
+  const char* type;
+  bool streaming;                       // Cabecera chunked ya enviada
+  bool failed;                          // El cliente dejó de aceptar datos
+  bool truncated;                       // Algún fragmento no cupo (sin arena libre)
+} resp_writer_t;
+
+// Prepara una respuesta; el buffer sale del arena (si no hay, se escribe en chunks pequeños)
+void resp_begin(resp_writer_t* w, WebServer &srv, int code, const char* type);
+
+// Envía la cabecera chunked de inmediato (respuestas largas o de tamaño desconocido)
+void resp_stream(resp_writer_t* w);
+
+void resp_write(resp_writer_t* w, const char* data, size_t len);
+void resp_puts(resp_writer_t* w, const char* s);
+void resp_printf(resp_writer_t* w, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Cadena JSON entre comillas con escapes ("" si s es NULL)
+void resp_json_string(resp_writer_t* w, const char* s);
+
+// Decodifica Base64 (imágenes embebidas) directo al cuerpo, por bloques, sin
+// copiar la imagen completa. Ignora saltos de línea y termina en el relleno '='.
+void resp_write_base64(resp_writer_t* w, const char* b64);
+
+// Termina la respuesta (Content-Length o chunk final)
+void resp_end(resp_writer_t* w);
+
+// Respuesta completa de un solo cuerpo
+void resp_send(WebServer &srv, int code, const char* type, const char* body);
+
+// Contador de asignaciones de heap durante los handlers (sólo MOE_ALLOC_DEBUG)
+void req_alloc_track_begin();
+uint32_t req_alloc_track_end();         // Asignaciones desde track_begin
+uint32_t req_alloc_total();             // Acumulado de todas las peticiones
+
+#endif
@@ -0,0 +1,190 @@
+#include "sched.h"
+#include <string.h>
+
+#define SCHED_SLOT_MASK     (SCHED_WHEEL_SLOTS - 1)
+#define SCHED_MAX_DELTA     ((1UL << (SCHED_WHEEL_BITS * SCHED_WHEEL_LEVELS)) - 1)
+
+enum { SCHED_FREE = 0, SCHED_STOPPED, SCHED_ARMED };
+
+static uint32_t sched_now_tick(sched_t* s, uint64_t* now_us)
+{
+  uint64_t t = s->clock(s->clock_ctx);
+  if (now_us) *now_us = t;
+  return (uint32_t)((t - s->origin_us) / 1000);
+}
+
+static uint16_t sched_slot_for(sched_t* s, uint32_t expires)
+{
+  uint32_t delta = expires - s->tick;
+  if (delta > SCHED_MAX_DELTA) {
+    // Más allá del nivel superior: se reubica al bajar en la cascada
+    expires = s->tick + SCHED_MAX_DELTA;
+    delta = SCHED_MAX_DELTA;
+  }
+  uint8_t level = 0;
+  while (level < SCHED_WHEEL_LEVELS - 1 && delta >= (1UL << (SCHED_WHEEL_BITS * (level + 1)))) level++;
+  return level * SCHED_WHEEL_SLOTS + ((expires >> (SCHED_WHEEL_BITS * level)) & SCHED_SLOT_MASK);
+}
+
+static void sched_link(sched_t* s, int8_t id)
+{
+  sched_job_t* j = &s->jobs[id];
+  j->slot = sched_slot_for(s, j->expires);
+  int8_t* head = &s->wheel[0][0] + j->slot;
+  j->prev = -1;
+  j->next = *head;
+  if (*head >= 0) s->jobs[*head].prev = id;
+  *head = id;
+  j->state = SCHED_ARMED;
+}
+
+static void sched_unlink(sched_t* s, int8_t id)
+{
+  sched_job_t* j = &s->jobs[id];
+  if (j->state != SCHED_ARMED) return;
+  if (j->prev >= 0) s->jobs[j->prev].next = j->next;
+  else (&s->wheel[0][0])[j->slot] = j->next;
+  if (j->next >= 0) s->jobs[j->next].prev = j->prev;
+  j->next = j->prev = -1;
+  j->state = SCHED_STOPPED;
+}
+
+// Baja un nivel la ranura que corresponde al tick actual
+static uint8_t sched_cascade(sched_t* s, uint8_t level)
+{
+  uint8_t index = (s->tick >> (SCHED_WHEEL_BITS * level)) & SCHED_SLOT_MASK;
+  int8_t id = s->wheel[level][index];
+  s->wheel[level][index] = -1;
+  while (id >= 0) {
+    int8_t next = s->jobs[id].next;
+    sched_link(s, id);
+    id = next;
+  }
+  return index;
+}
+
+static void sched_execute(sched_t* s, int8_t id)
+{
+  sched_job_t* j = &s->jobs[id];
+  uint64_t start_us;
+  uint32_t now = sched_now_tick(s, &start_us);
+  uint64_t deadline_us = s->origin_us + (uint64_t)j->expires * 1000;
+  uint32_t late = start_us > deadline_us ? (uint32_t)(start_us - deadline_us) : 0;
+
+  // Se rearma antes de ejecutar para que el trabajo pueda detenerse o
+  // reprogramarse a sí mismo
+  if (j->period_ms) {
+    uint32_t behind = now - j->expires;
+    uint32_t skipped = (int32_t)behind >= 0 ? behind / j->period_ms : 0;
+    j->stats.overruns += skipped;
+    j->expires += (skipped + 1) * j->period_ms;
+    sched_link(s, id);
+  }
+
+  j->fn(j->ctx);
+
+  uint32_t runtime = (uint32_t)(s->clock(s->clock_ctx) - start_us);
+  j->stats.runs++;
+  j->stats.runtime_us += runtime;
+  if (runtime > j->stats.runtime_max_us) j->stats.runtime_max_us = runtime;
+  j->stats.late_us += late;
+  if (late > j->stats.late_max_us) j->stats.late_max_us = late;
+}
+
+void sched_init(sched_t* s, sched_clock_fn clock, void* clock_ctx)
+{
+  memset(s, 0, sizeof(*s));
+  memset(s->wheel, -1, sizeof(s->wheel));
+  s->clock = clock;
+  s->clock_ctx = clock_ctx;
+  s->origin_us = clock(clock_ctx);
+}
+
+int sched_add(sched_t* s, const char* name, sched_job_fn fn, void* ctx, uint32_t delay_ms, uint32_t period_ms)
+{
+  for (int8_t id = 0; id < SCHED_MAX_JOBS; id++) {
+    sched_job_t* j = &s->jobs[id];
+    if (j->state != SCHED_FREE) continue;
+    memset(j, 0, sizeof(*j));
+    j->name = name;
+    j->fn = fn;
+    j->ctx = ctx;
+    j->period_ms = period_ms;
+    j->next = j->prev = -1;
+    j->state = SCHED_STOPPED;
+    if (delay_ms != SCHED_NEVER) sched_start(s, id, delay_ms);
+    return id;
+  }
+  return -1;
+}
+
+bool sched_start(sched_t* s, int id, uint32_t delay_ms)
+{
+  if (id < 0 || id >= SCHED_MAX_JOBS || s->jobs[id].state == SCHED_FREE) return false;
+  sched_unlink(s, (int8_t)id);
+  // Nunca antes del próximo tick a procesar (ni en el que se está vaciando)
+  uint32_t first = s->running ? s->tick + 1 : s->tick;
+  uint32_t expires = sched_now_tick(s, NULL) + delay_ms;
+  s->jobs[id].expires = (int32_t)(expires - first) < 0 ? first : expires;
+  sched_link(s, (int8_t)id);
+  return true;
+}
+
+void sched_stop(sched_t* s, int id)
+{
+  if (id < 0 || id >= SCHED_MAX_JOBS) return;
+  sched_unlink(s, (int8_t)id);
+}
+
+void sched_remove(sched_t* s, int id)
+{
+  if (id < 0 || id >= SCHED_MAX_JOBS) return;
+  sched_unlink(s, (int8_t)id);
+  s->jobs[id].state = SCHED_FREE;
+}
+
+bool sched_armed(const sched_t* s, int id)
+{
+  return id >= 0 && id < SCHED_MAX_JOBS && s->jobs[id].state == SCHED_ARMED;
+}
+
+uint32_t sched_run(sched_t* s)
+{
+  uint32_t now = sched_now_tick(s, NULL);
+  s->running = true;
+  while ((int32_t)(now - s->tick) >= 0) {
+    uint8_t index = s->tick & SCHED_SLOT_MASK;
+    // Al completar una vuelta de un nivel se baja la ranura siguiente del superior
+    for (uint8_t l = 1; index == 0 && l < SCHED_WHEEL_LEVELS; l++) {
+      index = sched_cascade(s, l);
+    }
+    int8_t* head = &s->wheel[0][s->tick & SCHED_SLOT_MASK];
+    while (*head >= 0) {
+      int8_t id = *head;
+      sched_unlink(s, id);
+      sched_execute(s, id);
+    }
+    s->tick++;
+  }
+  s->running = false;
+  return sched_next_ms(s);
+}
+
+uint32_t sched_next_ms(sched_t* s)
+{
+  uint32_t now = sched_now_tick(s, NULL);
+  uint32_t best = SCHED_NEVER;
+  for (uint8_t id = 0; id < SCHED_MAX_JOBS; id++) {
+    const sched_job_t* j = &s->jobs[id];
+    if (j->state != SCHED_ARMED) continue;
+    uint32_t left = (int32_t)(j->expires - now) > 0 ? j->expires - now : 0;
+    if (left < best) best = left;
+  }
+  return best;
+}
+
+const sched_job_t* sched_job(const sched_t* s, int id)
+{
+  if (id < 0 || id >= SCHED_MAX_JOBS || s->jobs[id].state == SCHED_FREE) return NULL;
+  return &s->jobs[id];
+}
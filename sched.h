@@ -0,0 +1,89 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+// Planificador cooperativo de trabajos con rueda de temporizadores jerárquica.
+// Cuatro niveles de 64 ranuras con tick de 1 ms: el nivel 0 cubre 64 ms, el 1
+// 4 s, el 2 262 s y el 3 4,6 h; un plazo más lejano se ubica en la última
+// ranura alcanzable y se reubica al bajar de nivel. Alta, baja y despacho son
+// O(1); el próximo plazo (para dormir hasta él) recorre la tabla de trabajos,
+// que es chica.
+//
+// Trabajos periódicos (sin deriva: el próximo plazo es el anterior + periodo;
+// si se perdieron periodos se cuentan como overruns y se retoma la fase) o de
+// una vez. Un trabajo sin plazo (SCHED_NEVER) queda detenido hasta que algo lo
+// arranque: así se atan las fuentes de eventos. Por trabajo se acumulan
+// ejecuciones, tiempo de ejecución y retraso respecto del plazo.
+//
+// No depende de Arduino ni de FreeRTOS: el reloj se inyecta, de modo que el
+// mismo código corre en el host con tiempo simulado. No es reentrante ni
+// seguro entre tareas: todo se llama desde la tarea que ejecuta sched_run.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCHED_MAX_JOBS      16
+#define SCHED_WHEEL_BITS    6
+#define SCHED_WHEEL_SLOTS   (1 << SCHED_WHEEL_BITS)
+#define SCHED_WHEEL_LEVELS  4
+#define SCHED_NEVER         0xFFFFFFFFUL    // Plazo/espera: ninguno
+
+// Reloj monotónico en microsegundos
+typedef uint64_t (*sched_clock_fn)(void* ctx);
+typedef void (*sched_job_fn)(void* ctx);
+
+typedef struct {
+  uint32_t runs;
+  uint32_t overruns;            // Periodos saltados por retraso
+  uint64_t runtime_us;
+  uint32_t runtime_max_us;
+  uint64_t late_us;             // Inicio real - plazo
+  uint32_t late_max_us;
+} sched_stats_t;
+
+typedef struct {
+  const char* name;             // Literal o cadena estática
+  sched_job_fn fn;
+  void* ctx;
+  uint32_t expires;             // Tick (ms desde sched_init)
+  uint32_t period_ms;           // 0 = una vez
+  int8_t next;                  // Enlaces en la ranura de la rueda
+  int8_t prev;
+  uint16_t slot;                // Ranura: nivel * SCHED_WHEEL_SLOTS + índice
+  uint8_t state;
+  sched_stats_t stats;
+} sched_job_t;
+
+typedef struct {
+  sched_clock_fn clock;
+  void* clock_ctx;
+  uint64_t origin_us;
+  uint32_t tick;                // Próximo tick a procesar
+  bool running;
+  int8_t wheel[SCHED_WHEEL_LEVELS][SCHED_WHEEL_SLOTS];
+  sched_job_t jobs[SCHED_MAX_JOBS];
+} sched_t;
+
+void sched_init(sched_t* s, sched_clock_fn clock, void* clock_ctx);
+
+// Alta de un trabajo. delay_ms = SCHED_NEVER lo deja detenido. period_ms = 0:
+// se ejecuta una vez y queda detenido (se puede volver a arrancar).
+// Retorna el id o -1 si la tabla está llena.
+int sched_add(sched_t* s, const char* name, sched_job_fn fn, void* ctx, uint32_t delay_ms, uint32_t period_ms);
+
+// (Re)arma el trabajo para dentro de delay_ms (0 = en la próxima vuelta)
+bool sched_start(sched_t* s, int id, uint32_t delay_ms);
+void sched_stop(sched_t* s, int id);
+void sched_remove(sched_t* s, int id);
+bool sched_armed(const sched_t* s, int id);
+
+// Ejecuta los trabajos vencidos en orden de plazo y retorna los ms hasta el
+// próximo plazo (0 si ya venció otro, SCHED_NEVER si no hay ninguno armado)
+uint32_t sched_run(sched_t* s);
+
+// ms hasta el próximo plazo sin ejecutar nada
+uint32_t sched_next_ms(sched_t* s);
+
+// Nombre y estadísticas del trabajo id (NULL si el id está libre)
+const sched_job_t* sched_job(const sched_t* s, int id);
+
+#endif
@@ -17,8 +17,10 @@ void get_temperature_humidity()
   temperature = dht.readTemperature();
   humidity = dht.readHumidity();
 
-  display_temperature = isnan(temperature) ? "Temp: Error" : "Temp: " + String(temperature, 1) + " °C";
-  display_humidity = isnan(humidity) ? "Hum: Error"  : "Hum: " + String(humidity, 1) + " %";
+  if (isnan(temperature)) display_temperature = "Temp: Error";
+  else display_temperature.format("Temp: %.1f °C", temperature);
+  if (isnan(humidity)) display_humidity = "Hum: Error";
+  else display_humidity.format("Hum: %.1f %%", humidity);
 
   delay(20);
 }
@@ -37,7 +39,7 @@ void get_battery_status()
   battery_level = map(battery_voltage, 3300, 4200, 0, 100);
   battery_level = constrain(battery_level, 0, 100);
 
-  display_battery_voltage = "Bat: " + String(battery_voltage) + " mv";
-  display_battery_level = "Bat: " + String(battery_level) + " %";
+  display_battery_voltage.format("Bat: %d mv", battery_voltage);
+  display_battery_level.format("Bat: %d %%", battery_level);
   delay(20);
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "sleep_utils.h"
+#include "moe_log.h"
 #include "config.h"
 #include "wifi_utils.h"
 #include "display_utils.h"
@@ -7,7 +8,11 @@
 #include <WiFi.h>
 #include <esp_sleep.h>
 #include <esp_wifi.h>
-#include <Preferences.h>
+#include "config_store.h"
+#include "wake_stats.h"
+#include "door_events.h"
+#include "button_utils.h"
+#include "power_utils.h"
 #ifdef CONFIG_BT_ENABLED
 #include "esp_bt.h"
 #endif
@@ -70,13 +75,15 @@ void configure_deep_sleep()
   //  Se configura el PIN que servirá como interrupción externa
   esp_sleep_enable_ext0_wakeup(DOOR_SENSOR_PIN, 0);     //0 para despertar por estado LOW y 1 para despertar por estado HIGH
 
+  //  Botón PRG (EXT1): despertar con pantalla aunque el perfil por defecto sea sin pantalla
+  rtc_gpio_pullup_en(PRG_BUTTON_PIN);
+  rtc_gpio_pulldown_dis(PRG_BUTTON_PIN);
+  esp_sleep_enable_ext1_wakeup(1ULL << PRG_BUTTON_PIN, ESP_EXT1_WAKEUP_ALL_LOW);
+
   //  Se configura el tiempo que el sensor va a dormir en el modo DeepSleep
-  // Leer intervalo persistente (en minutos) si está disponible en NVS
+  // Intervalo persistente (en minutos) desde la configuración cacheada
   {
-    Preferences prefs;
-    prefs.begin("moe_cfg", true);
-    uint8_t minutes = prefs.getUChar("interval_minutes", 10);
-    prefs.end();
+    uint8_t minutes = config_get_interval_minutes();
     Deep_Sleep_Time_S = (uint16_t)minutes * 60;
     Deep_Sleep_time_uS = (uint64_t)Deep_Sleep_Time_S * 1000000ULL;
   }
@@ -92,11 +99,17 @@ void enter_deep_sleep()
 {
   // If device is in continuous mode, skip deep-sleep here
   if (current_mode == MODE_CONTINUOUS) {
-    Serial.println("[SLEEP] Current mode is CONTINUOUS - skipping deep sleep");
+    MLOGI("[SLEEP] Current mode is CONTINUOUS - skipping deep sleep");
     return;
   }
 
-  // Apagar la pantalla OLED completamente antes de dormir (corta Vext)
+  // La puerta pasa de la interrupción GPIO a EXT0 y el botón a EXT1
+  door_events_stop();
+  button_events_stop();
+  power_light_sleep_end();
+
+  // Dejar que se lean los mensajes pendientes y apagar la pantalla OLED (corta Vext)
+  display_drain(DISPLAY_DRAIN_MAX_MS);
   VextOFF();
 
   // Detener WiFi y driver para máximo ahorro
@@ -106,32 +119,40 @@ void enter_deep_sleep()
   WiFi.mode(WIFI_OFF);
   esp_wifi_stop();
   esp_wifi_deinit();
+  wake_stats_wifi(false);
 
   // Deshabilitar Bluetooth controlador si está presente (silencioso si no está)
 #ifdef CONFIG_BT_ENABLED
   esp_bt_controller_disable();
 #endif
 
+  // Volcar cambios de configuración pendientes (el espejo RTC ya los conserva,
+  // pero NVS debe tenerlos ante un corte de energía durante el sueño)
+  config_store_flush();
+  // Registro: sólo se escribe a flash si el anillo RTC pasó de la mitad
+  mlog_sleep();
+
   // Configurar wakeup sources and timer
   configure_deep_sleep();
 
-  Serial.println("[SLEEP] Entering DEEP SLEEP (WiFi/Bluetooth off, display off)");
+  MLOGI("[SLEEP] Entering DEEP SLEEP (WiFi/Bluetooth off, display off)");
+  wake_stats_end();
   esp_deep_sleep_start();
 }
 
 // Strong implementation of ota_on_mode_changed to react when OTA UI changes mode
 void ota_on_mode_changed(bool continuous)
 {
-  Serial.printf("[SLEEP] ota_on_mode_changed -> continuous=%s\n", continuous ? "true" : "false");
+  MLOGI("[SLEEP] ota_on_mode_changed -> continuous=%s", continuous ? "true" : "false");
   if (continuous) {
-    // Ensure WiFi active and no sleeping
+    // WiFi activo en modem sleep (escucha cada listen interval); la CPU entra en light sleep entre eventos
     WiFi.mode(WIFI_STA);
-    WiFi.setSleep(false);
-    Serial.println("[SLEEP] Continuous mode: staying awake");
+    wifi_power_save(true);
+    MLOGI("[SLEEP] Continuous mode: staying connected (modem sleep)");
   } else {
     // Set runtime mode to NORMAL (do NOT persist across reboots) and enter deep-sleep cycle
     current_mode = MODE_NORMAL;
-    Serial.println("[SLEEP] Switching to MODE_NORMAL (runtime only). Entering deep sleep cycle now.");
+    MLOGI("[SLEEP] Switching to MODE_NORMAL (runtime only). Entering deep sleep cycle now.");
     enter_deep_sleep();
   }
 }
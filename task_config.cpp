@@ -0,0 +1,107 @@
+#include "task_config.h"
+
+const task_config_t task_config[TASK_COUNT] = {
+  { "loopTask",   TASK_STACK_LOOP,       1, 1 },
+  { "OTA_Task",   TASK_STACK_OTA,        1, 0 },
+  { "OTA_Writer", TASK_STACK_OTA_WRITER, 2, 1 },
+  { "OTA_Pull",   TASK_STACK_OTA_PULL,   1, 0 },
+  { "Log_Flush",  TASK_STACK_LOG,        1, 0 },
+  { "Display",    TASK_STACK_DISPLAY,    1, 1 },
+  { "Door",       TASK_STACK_DOOR,       3, 1 },
+  { "Button",     TASK_STACK_BUTTON,     3, 1 },
+  { "AP_Portal",  TASK_STACK_PORTAL,     1, 1 },
+};
+
+// Tareas vivas y mínimo de pila libre observado (en todas las instancias de cada tarea)
+static TaskHandle_t task_handles[TASK_COUNT];
+static uint32_t task_min_free[TASK_COUNT] = { UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX };
+static const char* task_peak_workload[TASK_COUNT];
+// Muestreo y bajas pueden ocurrir en núcleos distintos
+static portMUX_TYPE task_mux = portMUX_INITIALIZER_UNLOCKED;
+
+BaseType_t task_spawn(task_id_t id, TaskFunction_t fn, void* arg, TaskHandle_t* handle)
+{
+  const task_config_t &c = task_config[id];
+  TaskHandle_t h = NULL;
+  BaseType_t r = xTaskCreatePinnedToCore(fn, c.name, c.stack_bytes + TASK_PROFILE_HEADROOM, arg, c.priority, &h, c.core);
+  if (handle) *handle = r == pdPASS ? h : NULL;
+  if (r == pdPASS) task_profile_attach(id, h);
+  return r;
+}
+
+void task_profile_attach(task_id_t id, TaskHandle_t handle)
+{
+  portENTER_CRITICAL(&task_mux);
+  task_handles[id] = handle;
+  portEXIT_CRITICAL(&task_mux);
+}
+
+void task_profile_detach(task_id_t id)
+{
+  // Última muestra antes de que la tarea desaparezca
+  task_profile_sample(NULL);
+  portENTER_CRITICAL(&task_mux);
+  task_handles[id] = NULL;
+  portEXIT_CRITICAL(&task_mux);
+}
+
+void task_profile_sample(const char* workload)
+{
+#ifdef MOE_STACK_PROFILE
+  uint32_t peak[TASK_COUNT];
+  uint8_t changed = 0;
+  portENTER_CRITICAL(&task_mux);
+  for (uint8_t i = 0; i < TASK_COUNT; i++) {
+    if (!task_handles[i]) continue;
+    uint32_t free_bytes = uxTaskGetStackHighWaterMark(task_handles[i]);
+    if (free_bytes >= task_min_free[i]) continue;
+    task_min_free[i] = free_bytes;
+    if (workload) task_peak_workload[i] = workload;
+    peak[changed++] = i;
+  }
+  portEXIT_CRITICAL(&task_mux);
+  for (uint8_t k = 0; k < changed; k++) {
+    char line[128];
+    task_profile_format((task_id_t)peak[k], line, sizeof(line));
+    Serial.printf("[STACK] %s\n", line);
+  }
+#else
+  (void)workload;
+#endif
+}
+
+size_t task_profile_format(task_id_t id, char* out, size_t cap)
+{
+  const task_config_t &c = task_config[id];
+  uint32_t size = c.stack_bytes + TASK_PROFILE_HEADROOM;
+  portENTER_CRITICAL(&task_mux);
+  uint32_t free_bytes = task_min_free[id];
+  if (task_handles[id]) {
+    uint32_t now = uxTaskGetStackHighWaterMark(task_handles[id]);
+    if (now < free_bytes) free_bytes = now;
+  }
+  const char* workload = task_peak_workload[id];
+  portEXIT_CRITICAL(&task_mux);
+
+  if (free_bytes == UINT32_MAX) {
+    int n = snprintf(out, cap, "%s: %u B configurados, sin muestras", c.name, (unsigned)c.stack_bytes);
+    return n > 0 ? (size_t)n : 0;
+  }
+  // Sugerencia: pico + 25 % (mínimo 1 KB) redondeado a 512 B
+  uint32_t used = size > free_bytes ? size - free_bytes : 0;
+  uint32_t margin = used / 4 > 1024 ? used / 4 : 1024;
+  uint32_t suggest = (used + margin + 511) & ~511u;
+  int n = snprintf(out, cap, "%s: %u B configurados, pico %u B (%s), sugerido %u B",
+                   c.name, (unsigned)c.stack_bytes, (unsigned)used, workload ? workload : "-", (unsigned)suggest);
+  return n > 0 ? (size_t)n : 0;
+}
+
+void task_profile_report()
+{
+  char line[128];
+  Serial.println("[STACK] Informe de pilas:");
+  for (uint8_t i = 0; i < TASK_COUNT; i++) {
+    task_profile_format((task_id_t)i, line, sizeof(line));
+    Serial.printf("[STACK]   %s\n", line);
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef TASK_CONFIG_H
+#define TASK_CONFIG_H
+
+#include <Arduino.h>
+
+// Tabla única de tareas FreeRTOS (pila, prioridad y núcleo). Los tamaños se
+// ajustan con el modo de perfilado: compilar con -DMOE_STACK_PROFILE crea
+// cada tarea con TASK_PROFILE_HEADROOM bytes extra, muestrea la marca de agua
+// de todas las tareas registradas después de cada carga de trabajo (página,
+// logo, carga de firmware, login, portal AP...) y atribuye cada nuevo pico a
+// la carga que lo produjo. El informe (Serial y GET /debug/stacks) sugiere un
+// tamaño con margen; ese valor se copia aquí.
+//
+// FreeRTOS (ESP-IDF) ya pinta las pilas con 0xA5 al crear la tarea:
+// uxTaskGetStackHighWaterMark mide desde el tope hasta el primer byte pisado.
+
+// Pilas en bytes (en ESP32 StackType_t es de 1 byte)
+#define TASK_STACK_LOOP         8192    // loopTask de Arduino: setup/loop y trabajos de app_sched
+#define TASK_STACK_OTA          8192    // Servidor web OTA y recepción de cargas
+#define TASK_STACK_OTA_WRITER   4096    // Escritura a flash de ota_stream
+#define TASK_STACK_OTA_PULL     6144    // Descarga HTTP(S) de ota_pull (TLS)
+#define TASK_STACK_LOG          4096    // Volcado del registro binario a LittleFS
+#define TASK_STACK_DISPLAY      3072    // Dibujo de texto y envío I2C al OLED
+#define TASK_STACK_DOOR         2048    // Filtro de rebotes de los flancos de la puerta
+#define TASK_STACK_BUTTON       2048    // Reconocedor de gestos del botón PRG
+#define TASK_STACK_PORTAL       6144    // Portal AP: WebServer + DNSServer y escaneo por canal
+
+#ifdef MOE_STACK_PROFILE
+#define TASK_PROFILE_HEADROOM   4096    // Extra para medir sin desbordar
+#else
+#define TASK_PROFILE_HEADROOM   0
+#endif
+
+typedef enum {
+  TASK_LOOP,
+  TASK_OTA,
+  TASK_OTA_WRITER,
+  TASK_OTA_PULL,
+  TASK_LOG,
+  TASK_DISPLAY,
+  TASK_DOOR,
+  TASK_BUTTON,
+  TASK_PORTAL,
+  TASK_COUNT
+} task_id_t;
+
+typedef struct {
+  const char* name;
+  uint32_t stack_bytes;                 // Sin TASK_PROFILE_HEADROOM
+  UBaseType_t priority;
+  BaseType_t core;
+} task_config_t;
+
+extern const task_config_t task_config[TASK_COUNT];
+
+// xTaskCreatePinnedToCore con los valores de la tabla; registra la tarea para el perfilado
+BaseType_t task_spawn(task_id_t id, TaskFunction_t fn, void* arg, TaskHandle_t* handle);
+
+// Registrar una tarea creada fuera de task_spawn (loopTask) o darla de baja antes de borrarla
+void task_profile_attach(task_id_t id, TaskHandle_t handle);
+void task_profile_detach(task_id_t id);
+
+// Muestrea las tareas registradas y atribuye los picos nuevos a `workload`
+// (literal o cadena estática). No hace nada sin MOE_STACK_PROFILE.
+void task_profile_sample(const char* workload);
+
+// Línea del informe de una tarea: tamaño, pico usado, carga que lo produjo y sugerencia
+size_t task_profile_format(task_id_t id, char* out, size_t cap);
+
+// Informe completo por Serial
+void task_profile_report();
+
+#endif
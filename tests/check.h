@@ -0,0 +1,59 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+// Aserciones mínimas para las pruebas en el host: un fallo se informa con
+// archivo y línea y la prueba sigue; check_done() da el código de salida.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+static int check_failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    fprintf(stderr, "%s:%d: falló: %s\n", __FILE__, __LINE__, #cond); \
+    check_failures++; \
+  } \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+  long long check_a_ = (long long)(a), check_b_ = (long long)(b); \
+  if (check_a_ != check_b_) { \
+    fprintf(stderr, "%s:%d: falló: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, check_a_, check_b_); \
+    check_failures++; \
+  } \
+} while (0)
+
+// Generador determinista (xorshift32): los casos aleatorios se repiten igual
+static uint32_t check_rand_state = 0x9E3779B9u;
+
+static inline uint32_t check_rand()
+{
+  uint32_t x = check_rand_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return check_rand_state = x;
+}
+
+static inline uint32_t check_rand_below(uint32_t n)
+{
+  return n ? check_rand() % n : 0;
+}
+
+static inline double check_seconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline int check_done(const char* name)
+{
+  if (check_failures) fprintf(stderr, "%s: %d fallos\n", name, check_failures);
+  else printf("%s: ok\n", name);
+  return check_failures ? 1 : 0;
+}
+
+#endif
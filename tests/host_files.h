@@ -0,0 +1,57 @@
+#ifndef HOST_FILES_H
+#define HOST_FILES_H
+
+// Archivos temporales y herramientas de tools/ para las pruebas que verifican
+// contra lo que generan los scripts del host (parches delta, imágenes
+// comprimidas). PYTHON y MOE_TOOLS cambian el intérprete y el directorio.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+typedef std::vector<uint8_t> bytes_t;
+
+// Ruta nueva en el directorio temporal (el archivo queda creado y vacío)
+static inline std::string host_temp_path(const char* tag)
+{
+  const char* dir = getenv("TMPDIR");
+  std::string path = std::string(dir && *dir ? dir : "/tmp") + "/moe_" + tag + "_XXXXXX";
+  int fd = mkstemp(&path[0]);
+  if (fd >= 0) close(fd);
+  return path;
+}
+
+static inline bool host_write_file(const std::string &path, const bytes_t &data)
+{
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) return false;
+  bool ok = data.empty() || fwrite(data.data(), 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && ok;
+}
+
+static inline bool host_read_file(const std::string &path, bytes_t* out)
+{
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+  out->clear();
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out->insert(out->end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+// Ejecuta tools/<script> con los argumentos dados (sin su salida). true si terminó con 0.
+static inline bool host_run_tool(const char* script, const std::string &args)
+{
+  const char* python = getenv("PYTHON");
+  const char* tools = getenv("MOE_TOOLS");
+  std::string cmd = std::string(python && *python ? python : "python3") + " " +
+                    (tools && *tools ? tools : "../tools") + "/" + script + " " + args + " > /dev/null";
+  return system(cmd.c_str()) == 0;
+}
+
+#endif
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+"""Compara json_stream con el módulo json de Python (modo estricto).
+
+Uso:
+  json_diff.py build/test_json_stream [documentos]
+
+Genera documentos válidos, mutados y bytes al azar (semilla fija), los pasa
+en hex a `test_json_stream --verdicts` y compara cada estado con el de Python:
+aceptado por Python = "ok", rechazado = "syntax" o "incomplete".
+
+Diferencias esperadas (no cuentan como desacuerdo):
+  - Sustitutos aislados (\\ud800, \\udc00, ...) y U+0000: Python los acepta;
+    json_stream los rechaza con JSON_ERR_SYNTAX porque entrega los valores
+    como UTF-8 terminado en '\\0'.
+  - Límites del parser (profundidad 8, clave 32 B, valor 128 B): "depth" o
+    "length". Un documento aceptado por Python dentro de los límites tiene que
+    dar "ok".
+"""
+
+import json
+import random
+import subprocess
+import sys
+
+MAX_DEPTH = 8
+MAX_KEY = 32
+MAX_VALUE = 128
+
+PIECES = ["a", "Z", "0", " ", "\\\"", "\\\\", "\\/", "\\b", "\\n", "\\u0041", "\\u00e9",
+          "\\u20AC", "\\ud83d\\ude00", "é", "€", "\U0001F600", "\\ud800", "\\udfff",
+          "\\u0000", "\\ud800\\u0041"]
+NUMBERS = ["0", "-1", "42", "3.25", "-0.0", "1e9", "2E-3", "1E+2", "123456789012345678901234567890"]
+
+
+def gen_string(rnd, max_pieces):
+    return '"' + "".join(rnd.choice(PIECES) for _ in range(rnd.randrange(max_pieces + 1))) + '"'
+
+
+def gen_value(rnd, depth):
+    kind = rnd.randrange(7 if depth < MAX_DEPTH + 1 else 5)
+    if kind == 0:
+        return gen_string(rnd, 8)
+    if kind == 1:
+        return rnd.choice(NUMBERS)
+    if kind == 2:
+        return rnd.choice(["true", "false"])
+    if kind == 3:
+        return "null"
+    if kind == 4:
+        return gen_string(rnd, 40)
+    if kind == 5:
+        return "[" + rnd.choice([",", " , "]).join(gen_value(rnd, depth + 1) for _ in range(rnd.randrange(4))) + "]"
+    members = [gen_string(rnd, 10) + rnd.choice([":", " :\n"]) + gen_value(rnd, depth + 1)
+               for _ in range(rnd.randrange(4))]
+    return "{" + ",".join(members) + "}"
+
+
+def mutate(rnd, doc):
+    alphabet = b'{}[]",:\\ 0123456789.eE+-tfnulrsaxu\x80\xc3\xed\xff\t'
+    doc = bytearray(doc)
+    for _ in range(1 + rnd.randrange(3)):
+        if not doc:
+            break
+        at = rnd.randrange(len(doc))
+        op = rnd.randrange(4)
+        c = alphabet[rnd.randrange(len(alphabet))]
+        if op == 0:
+            del doc[at]
+        elif op == 1:
+            doc.insert(at, c)
+        elif op == 2:
+            doc[at] = c
+        else:
+            del doc[at:]
+    return bytes(doc)
+
+
+def documents(rnd, count):
+    for i in range(count):
+        kind = i % 4
+        if kind == 3:
+            yield bytes(rnd.randrange(256) for _ in range(rnd.randrange(12)))
+            continue
+        doc = gen_value(rnd, 0).encode("utf-8")
+        yield mutate(rnd, doc) if kind else doc
+
+
+class Reject(Exception):
+    pass
+
+
+def python_view(doc):
+    """None si Python lo rechaza; si no, (excepción esperada, excede límites)."""
+    sizes = {"value": 0}
+
+    def number(text):
+        sizes["value"] = max(sizes["value"], len(text))
+        return text
+
+    def constant(_):
+        raise Reject()
+
+    try:
+        value = json.loads(doc.decode("utf-8"), parse_int=number, parse_float=number,
+                           parse_constant=constant, object_pairs_hook=lambda pairs: ("obj", pairs))
+    except (UnicodeDecodeError, ValueError, Reject, RecursionError):
+        return None
+
+    exception = False
+    limits = sizes["value"] > MAX_VALUE
+
+    def bad(s):
+        return "\x00" in s or any(0xD800 <= ord(ch) <= 0xDFFF for ch in s)
+
+    def utf8_len(s):
+        return len(s.encode("utf-8", "surrogatepass"))
+
+    def walk(v, depth):
+        nonlocal exception, limits
+        if isinstance(v, tuple):
+            depth += 1
+            for k, item in v[1]:
+                exception |= bad(k)
+                limits |= utf8_len(k) > MAX_KEY
+                walk(item, depth)
+        elif isinstance(v, list):
+            depth += 1
+            for item in v:
+                walk(item, depth)
+        elif isinstance(v, str):
+            exception |= bad(v)
+            limits |= utf8_len(v) > MAX_VALUE
+        limits |= depth > MAX_DEPTH
+
+    walk(value, 0)
+    return exception, limits
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 2
+    count = int(sys.argv[2]) if len(sys.argv) > 2 else 40000
+    rnd = random.Random(1234)
+    docs = list(documents(rnd, count))
+    out = subprocess.run([sys.argv[1], "--verdicts"], input="".join(d.hex() + "\n" for d in docs),
+                         capture_output=True, text=True, check=True).stdout.split()
+    if len(out) != len(docs):
+        print("json_diff: se esperaban %d estados, llegaron %d" % (len(docs), len(out)))
+        return 1
+
+    stats = {"accepted": 0, "rejected": 0, "exception": 0, "limits": 0}
+    disagreements = 0
+    for doc, got in zip(docs, out):
+        view = python_view(doc)
+        if got in ("depth", "length"):
+            stats["limits"] += 1
+            if view is not None and not view[1]:
+                want = "rechazo" if view[0] else "ok"
+            else:
+                continue
+        elif view is None:
+            stats["rejected"] += 1
+            if got in ("syntax", "incomplete"):
+                continue
+            want = "rechazo"
+        elif view[0]:
+            stats["exception"] += 1
+            if got == "syntax":
+                continue
+            want = "syntax (excepción)"
+        else:
+            stats["accepted"] += 1
+            if got == "ok" or view[1]:
+                continue
+            want = "ok"
+        disagreements += 1
+        if disagreements <= 20:
+            print("json_diff: %r -> %s, Python: %s" % (doc, got, want))
+
+    print("json_diff: %d documentos, %d aceptados, %d rechazados, %d excepciones esperadas, %d por límites, "
+          "%d desacuerdos" % (len(docs), stats["accepted"], stats["rejected"], stats["exception"],
+                              stats["limits"], disagreements))
+    return 1 if disagreements else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
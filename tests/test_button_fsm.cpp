@@ -0,0 +1,205 @@
+// Pruebas de button_fsm con guiones de flancos. Un guion es una lista de
+// eventos con su instante en ms:
+//   D<ms>  flanco de bajada (presionado)    U<ms>  flanco de subida (suelto)
+//   P<ms>  sólo pasa el tiempo hasta ms     H      presionado al iniciar (primero)
+// Entre eventos los plazos se atienden en el instante que indica
+// button_fsm_poll, como la tarea de gestos. La salida es un gesto por palabra:
+//   D<n>@<t>  BUTTON_DOWN   C<n>@<t>/<ms>  BUTTON_CLICKS   L<n>@<t>/<ms>  BUTTON_LONG
+// (n = pulsaciones, t = inicio de la secuencia, ms = duración de la última).
+// Con --script el guion se lee de la entrada estándar (p. ej. flancos
+// capturados en Linux con gpiomon y convertidos a este formato).
+
+#include "button_fsm.h"
+#include "check.h"
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+
+typedef struct {
+  std::string out;
+  uint32_t at;                  // Instante del poll que entregó el gesto
+} recorder_t;
+
+static void on_gesture(const button_gesture_t* g, void* ctx)
+{
+  recorder_t* r = (recorder_t*)ctx;
+  char word[48];
+  if (g->type == BUTTON_DOWN) snprintf(word, sizeof(word), "D%u@%u", g->count, (unsigned)g->t_ms);
+  else snprintf(word, sizeof(word), "%c%u@%u/%u", g->type == BUTTON_CLICKS ? 'C' : 'L', g->count,
+                (unsigned)g->t_ms, (unsigned)g->press_ms);
+  if (!r->out.empty()) r->out += ' ';
+  r->out += word;
+}
+
+// Atiende los plazos que vencen hasta t (inclusive)
+static void advance(button_fsm_t* f, uint32_t* now, uint32_t t)
+{
+  uint32_t wait = button_fsm_poll(f, *now);
+  while (wait != BUTTON_FSM_IDLE && *now + wait <= t) {
+    *now += wait;
+    wait = button_fsm_poll(f, *now);
+  }
+  *now = t;
+}
+
+static std::string run_script(const char* script, uint32_t* bounces = NULL)
+{
+  button_fsm_t f;
+  recorder_t r;
+  uint32_t now = 0;
+  const char* p = script;
+  while (*p == ' ') p++;
+  bool held = *p == 'H';
+  if (held) p++;
+  button_fsm_init(&f, held, 0, on_gesture, &r);
+  while (*p) {
+    char op = *p++;
+    if (op == ' ' || op == '\n') continue;
+    char* end;
+    uint32_t t = (uint32_t)strtoul(p, &end, 10);
+    if (end == p || (op != 'D' && op != 'U' && op != 'P')) {
+      fprintf(stderr, "guion inválido cerca de '%s'\n", p - 1);
+      check_failures++;
+      break;
+    }
+    p = end;
+    advance(&f, &now, t);
+    if (op != 'P') button_fsm_edge(&f, op == 'D', t);
+  }
+  if (bounces) *bounces = f.bounces;
+  return r.out;
+}
+
+typedef struct {
+  const char* name;
+  const char* script;
+  const char* want;
+} script_case_t;
+
+static const script_case_t scripts[] = {
+  { "click", "D0 U80 P1000", "D1@0 C1@0/80" },
+  { "click con rebotes", "D0 U3 D6 U9 D12 U100 D103 U106 P1000", "D1@0 C1@0/100" },
+  { "doble", "D0 U80 D200 U280 P1000", "D1@0 D2@0 C2@0/80" },
+  { "triple", "D0 U80 D200 U280 D400 U490 P1000", "D1@0 D2@0 D3@0 C3@0/90" },
+  { "seis", "D0 U50 D200 U250 D400 U450 D600 U650 D800 U850 D1000 U1050 P2000",
+    "D1@0 D2@0 D3@0 D4@0 D5@0 D6@0 C6@0/50" },
+  { "dos clicks separados", "D0 U80 D600 U700 P2000", "D1@0 C1@0/80 D1@600 C1@600/100" },
+  { "límite del silencio", "D0 U80 D479 U520 P1500", "D1@0 D2@0 C2@0/41" },
+  { "silencio cumplido", "D0 U80 D480 U520 P1500", "D1@0 C1@0/80 D1@480 C1@480/40" },
+  { "larga", "D0 U5500 P7000", "D1@0 L1@0/5000" },
+  { "click y larga", "D0 U80 D200 U5300 P7000", "D1@0 D2@0 L2@0/5000" },
+  { "larga y luego click", "D0 U6000 D6200 U6280 P7000", "D1@0 L1@0/5000 D1@6200 C1@6200/80" },
+  { "presionado al iniciar, corta", "H U300 P1000", "C1@0/300" },
+  { "presionado al iniciar, larga", "H P6000 U6000 P7000", "L1@0/5000" },
+  { "pulso de 10 ms", "D0 U10 P1000", "D1@0 C1@0/25" },
+  { "pulsación dentro del bloqueo", "D0 U80 D90 P1000", "D1@0 D2@0" },   // Se acepta a los 105 ms
+};
+
+static void test_scripts()
+{
+  for (size_t i = 0; i < sizeof(scripts) / sizeof(scripts[0]); i++) {
+    std::string got = run_script(scripts[i].script);
+    if (got != scripts[i].want) {
+      fprintf(stderr, "%s: '%s' -> '%s', se esperaba '%s'\n", scripts[i].name, scripts[i].script, got.c_str(),
+              scripts[i].want);
+      check_failures++;
+    }
+  }
+  uint32_t bounces = 0;
+  run_script("D0 U3 D6 U9 D12 U100 D103 U106 P1000", &bounces);
+  CHECK_EQ(bounces, 6);
+}
+
+static void test_poll_deadlines()
+{
+  button_fsm_t f;
+  recorder_t r;
+  button_fsm_init(&f, false, 0, on_gesture, &r);
+  CHECK_EQ(button_fsm_poll(&f, 0), BUTTON_FSM_IDLE);
+  button_fsm_edge(&f, true, 1000);
+  CHECK_EQ(button_fsm_poll(&f, 1000), BUTTON_DEBOUNCE_MS);     // Fin del bloqueo
+  CHECK_EQ(button_fsm_poll(&f, 1000 + BUTTON_DEBOUNCE_MS), BUTTON_LONG_PRESS_MS - BUTTON_DEBOUNCE_MS);
+  button_fsm_edge(&f, false, 1100);
+  CHECK_EQ(button_fsm_poll(&f, 1100 + BUTTON_DEBOUNCE_MS), BUTTON_CLICK_GAP_MS - BUTTON_DEBOUNCE_MS);
+  CHECK_EQ(button_fsm_poll(&f, 1100 + BUTTON_CLICK_GAP_MS), BUTTON_FSM_IDLE);
+  CHECK(r.out == "D1@1000 C1@1000/100");
+
+  // Cruce del contador de ms (uint32) a mitad de la secuencia
+  recorder_t w;
+  button_fsm_init(&f, false, 0xFFFFFF00u, on_gesture, &w);
+  button_fsm_edge(&f, true, 0xFFFFFF00u);
+  button_fsm_edge(&f, false, 0xFFFFFF00u + 300);
+  button_fsm_poll(&f, 0xFFFFFF00u + 300 + BUTTON_CLICK_GAP_MS);
+  CHECK(w.out == "D1@4294967040 C1@4294967040/300");
+}
+
+// Flancos al azar con rebotes: cada secuencia entrega DOWN 1..n consecutivos y
+// termina en exactamente un CLICKS o LONG con la misma cuenta
+typedef struct {
+  int seq_open;
+  int last_down;
+  int closed;
+  int failures;
+} invariant_t;
+
+static void on_checked(const button_gesture_t* g, void* ctx)
+{
+  invariant_t* v = (invariant_t*)ctx;
+  if (g->type == BUTTON_DOWN) {
+    if (g->count != v->last_down + 1 && g->count != 255) v->failures++;
+    v->last_down = g->count;
+    v->seq_open = 1;
+  } else {
+    if (!v->seq_open || g->count != v->last_down) v->failures++;
+    if (g->type == BUTTON_LONG && g->press_ms != BUTTON_LONG_PRESS_MS) v->failures++;
+    v->seq_open = 0;
+    v->last_down = 0;
+    v->closed++;
+  }
+}
+
+static void test_random()
+{
+  for (int round = 0; round < 2000; round++) {
+    button_fsm_t f;
+    invariant_t v = {};
+    button_fsm_init(&f, false, 0, on_checked, &v);
+    uint32_t now = 0, t = 0;
+    bool level = false;
+    for (int e = 0; e < 200; e++) {
+      // Rebotes cortos, pulsaciones normales, silencios y alguna larga
+      uint32_t r = check_rand_below(10);
+      t += r < 4 ? 1 + check_rand_below(5) : r < 8 ? 20 + check_rand_below(300)
+         : r < 9 ? 400 + check_rand_below(800) : 4000 + check_rand_below(3000);
+      advance(&f, &now, t);
+      level = !level;
+      button_fsm_edge(&f, level, t);
+    }
+    if (level) {
+      t += 10;
+      advance(&f, &now, t);
+      button_fsm_edge(&f, false, t);
+    }
+    advance(&f, &now, t + BUTTON_LONG_PRESS_MS + BUTTON_CLICK_GAP_MS);
+    CHECK_EQ(v.failures, 0);
+    CHECK_EQ(v.seq_open, 0);                    // Todo cerrado al final
+    CHECK(v.closed > 0);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc > 1 && strcmp(argv[1], "--script") == 0) {
+    std::string script;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0) script.append(buf, n);
+    puts(run_script(script.c_str()).c_str());
+    return check_failures ? 1 : 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0) return check_done("button_fsm bench");
+  test_scripts();
+  test_poll_deadlines();
+  test_random();
+  return check_done("button_fsm");
+}
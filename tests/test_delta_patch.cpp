@@ -0,0 +1,329 @@
+// Pruebas de delta_patch contra imágenes de partición en archivos: la base y
+// la imagen nueva se escriben en archivos temporales, tools/moe_delta.py genera
+// el parche y el motor lo aplica leyendo la base del archivo y escribiendo la
+// salida en otro, como ota_stream lo hace contra las particiones: el
+// encabezado valida la imagen base (tamaño y SHA-256) y al final se compara el
+// SHA-256 de lo escrito con new_sha256. Se prueban además parches dañados.
+
+#include "delta_patch.h"
+#include "check.h"
+#include "host_files.h"
+#include "sha256.h"
+#include <string.h>
+
+typedef struct {
+  FILE* old_f;
+  size_t old_size;
+  FILE* new_f;
+  sha256_t new_hash;
+} part_io_t;
+
+static bool read_old(void* ctx, uint32_t offset, uint8_t* buf, size_t len)
+{
+  part_io_t* io = (part_io_t*)ctx;
+  return fseek(io->old_f, offset, SEEK_SET) == 0 && fread(buf, 1, len, io->old_f) == len;
+}
+
+static bool write_new(void* ctx, const uint8_t* buf, size_t len)
+{
+  part_io_t* io = (part_io_t*)ctx;
+  sha256_update(&io->new_hash, buf, len);
+  return fwrite(buf, 1, len, io->new_f) == len;
+}
+
+// Como ota_delta_on_header: la base tiene que ser exactamente la del parche
+static bool on_header(void* ctx, const delta_header_t* h)
+{
+  part_io_t* io = (part_io_t*)ctx;
+  if (h->old_size != io->old_size) return false;
+  sha256_t s;
+  sha256_init(&s);
+  uint8_t buf[DELTA_IO_CHUNK], digest[32];
+  for (uint32_t off = 0; off < h->old_size; off += sizeof(buf)) {
+    size_t n = h->old_size - off < sizeof(buf) ? h->old_size - off : sizeof(buf);
+    if (!read_old(io, off, buf, n)) return false;
+    sha256_update(&s, buf, n);
+  }
+  sha256_final(&s, digest);
+  return memcmp(digest, h->old_sha256, sizeof(digest)) == 0;
+}
+
+typedef enum { APPLY_OK, APPLY_FEED_ERROR, APPLY_INCOMPLETE, APPLY_SHA_MISMATCH } apply_result_t;
+
+typedef struct {
+  apply_result_t result;
+  const char* error;
+  bytes_t out;
+} applied_t;
+
+static delta_patch_t engine;
+
+// Aplica patch sobre el archivo base en trozos de hasta max_chunk bytes
+static applied_t apply(const std::string &old_path, const bytes_t &patch, uint32_t max_chunk)
+{
+  applied_t r = { APPLY_OK, NULL, {} };
+  std::string new_path = host_temp_path("new");
+  part_io_t io;
+  io.old_f = fopen(old_path.c_str(), "rb");
+  io.new_f = fopen(new_path.c_str(), "wb");
+  CHECK(io.old_f && io.new_f);
+  fseek(io.old_f, 0, SEEK_END);
+  io.old_size = (size_t)ftell(io.old_f);
+  sha256_init(&io.new_hash);
+
+  delta_patch_init(&engine, read_old, write_new, on_header, &io);
+  size_t i = 0;
+  while (i < patch.size()) {
+    size_t n = 1 + check_rand_below(max_chunk);
+    if (n > patch.size() - i) n = patch.size() - i;
+    if (!delta_patch_feed(&engine, patch.data() + i, n)) {
+      r.result = APPLY_FEED_ERROR;
+      r.error = engine.error;
+      break;
+    }
+    i += n;
+  }
+  if (r.result == APPLY_OK && !delta_patch_done(&engine)) r.result = APPLY_INCOMPLETE;
+  if (r.result == APPLY_OK) {
+    uint8_t digest[32];
+    sha256_final(&io.new_hash, digest);
+    if (memcmp(digest, engine.header.new_sha256, sizeof(digest)) != 0) r.result = APPLY_SHA_MISMATCH;
+  }
+  fclose(io.old_f);
+  fclose(io.new_f);
+  host_read_file(new_path, &r.out);
+  unlink(new_path.c_str());
+  return r;
+}
+
+// "Firmware" sintético: tablas, texto y código con direcciones que se repiten
+static bytes_t make_base(size_t size)
+{
+  bytes_t b(size);
+  for (size_t i = 0; i < size; i++) {
+    switch ((i / 4096) % 3) {
+      case 0: b[i] = (uint8_t)check_rand(); break;
+      case 1: b[i] = (uint8_t)("moe_telemetry config door sensor "[i % 33]); break;
+      default: b[i] = (uint8_t)((i * 7) ^ (i >> 8)); break;
+    }
+  }
+  return b;
+}
+
+// Imagen nueva: parches de bytes sueltos, un bloque insertado, uno borrado y cola nueva
+static bytes_t make_target(const bytes_t &base)
+{
+  bytes_t t = base;
+  for (int k = 0; k < 40; k++) t[check_rand_below(t.size())] ^= (uint8_t)(1 + check_rand_below(255));
+  size_t at = check_rand_below(t.size());
+  bytes_t ins(1 + base.size() / 40 + check_rand_below(base.size() / 20 + 1));
+  for (auto &c : ins) c = (uint8_t)check_rand();
+  t.insert(t.begin() + at, ins.begin(), ins.end());
+  size_t del_len = base.size() / 50 + 1;
+  size_t del = check_rand_below(t.size() - del_len);
+  t.erase(t.begin() + del, t.begin() + del + del_len);
+  for (size_t k = 0; k < 100 + base.size() / 200; k++) t.push_back((uint8_t)check_rand());
+  return t;
+}
+
+typedef struct {
+  std::string old_path;
+  bytes_t base;
+  bytes_t target;
+  bytes_t patch;
+} fixture_t;
+
+static bool make_fixture(fixture_t* f, const bytes_t &base, const bytes_t &target)
+{
+  f->base = base;
+  f->target = target;
+  f->old_path = host_temp_path("old");
+  std::string new_path = host_temp_path("target"), patch_path = host_temp_path("patch");
+  bool ok = host_write_file(f->old_path, base) && host_write_file(new_path, target) &&
+            host_run_tool("moe_delta.py", "diff " + f->old_path + " " + new_path + " " + patch_path) &&
+            host_read_file(patch_path, &f->patch);
+  unlink(new_path.c_str());
+  unlink(patch_path.c_str());
+  return ok;
+}
+
+static void test_round_trips()
+{
+  static const size_t sizes[] = { 300, 20000, 150000 };
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    fixture_t f;
+    bytes_t base = make_base(sizes[s]);
+    CHECK(make_fixture(&f, base, make_target(base)));
+    CHECK(delta_is_patch(f.patch.data(), f.patch.size()));
+    static const uint32_t chunks[] = { 1, 7, 4096 };
+    for (size_t c = 0; c < 3; c++) {
+      applied_t r = apply(f.old_path, f.patch, chunks[c]);
+      if (r.result != APPLY_OK) fprintf(stderr, "ida y vuelta %zu B / trozos %u: %d %s\n", sizes[s], chunks[c], r.result, r.error ? r.error : "");
+      CHECK_EQ(r.result, APPLY_OK);
+      CHECK(r.out == f.target);
+    }
+    unlink(f.old_path.c_str());
+  }
+
+  // Imagen idéntica y sin nada en común con la base
+  fixture_t same, other;
+  bytes_t base = make_base(30000);
+  CHECK(make_fixture(&same, base, base));
+  CHECK(same.patch.size() < 200);
+  applied_t r = apply(same.old_path, same.patch, 512);
+  CHECK(r.result == APPLY_OK && r.out == base);
+  CHECK(make_fixture(&other, base, make_base(5000)));
+  r = apply(other.old_path, other.patch, 512);
+  CHECK(r.result == APPLY_OK && r.out == other.target);
+  unlink(same.old_path.c_str());
+  unlink(other.old_path.c_str());
+}
+
+static void test_damaged(const fixture_t &f)
+{
+  // Base distinta de la del parche (un byte): se rechaza antes de escribir
+  std::string wrong = host_temp_path("wrong");
+  bytes_t b = f.base;
+  b[b.size() / 2] ^= 1;
+  host_write_file(wrong, b);
+  applied_t r = apply(wrong, f.patch, 64);
+  CHECK_EQ(r.result, APPLY_FEED_ERROR);
+  CHECK(r.error && strcmp(r.error, "imagen base rechazada") == 0);
+  CHECK(r.out.empty());
+  b.pop_back();                                 // Otro tamaño
+  host_write_file(wrong, b);
+  CHECK_EQ(apply(wrong, f.patch, 64).result, APPLY_FEED_ERROR);
+  unlink(wrong.c_str());
+
+  // Parche truncado: no hay error de formato, pero la imagen no se completa
+  for (size_t cut : { (size_t)10, (size_t)DELTA_HEADER_SIZE, (size_t)DELTA_HEADER_SIZE + 3, f.patch.size() / 2,
+                      f.patch.size() - 1 }) {
+    bytes_t t(f.patch.begin(), f.patch.begin() + cut);
+    CHECK_EQ(apply(f.old_path, t, 256).result, APPLY_INCOMPLETE);
+  }
+
+  // Datos tras el final
+  bytes_t longer = f.patch;
+  longer.push_back(0);
+  r = apply(f.old_path, longer, 256);
+  CHECK_EQ(r.result, APPLY_FEED_ERROR);
+
+  // new_sha256 que no corresponde: la imagen se produce pero no verifica
+  bytes_t bad_hash = f.patch;
+  bad_hash[48] ^= 0x80;
+  CHECK_EQ(apply(f.old_path, bad_hash, 256).result, APPLY_SHA_MISMATCH);
+  // Un byte del cuerpo alterado (último byte: literal o extra) cambia la imagen
+  bytes_t bad_body = f.patch;
+  bad_body.back() ^= 0x55;
+  r = apply(f.old_path, bad_body, 256);
+  CHECK_EQ(r.result, APPLY_SHA_MISMATCH);
+  CHECK(r.out != f.target);
+
+  // Magic y versión
+  bytes_t bad_magic = f.patch;
+  bad_magic[0] = 'X';
+  CHECK_EQ(apply(f.old_path, bad_magic, 256).result, APPLY_FEED_ERROR);
+  bytes_t bad_version = f.patch;
+  bad_version[4] = 2;
+  CHECK_EQ(apply(f.old_path, bad_version, 256).result, APPLY_FEED_ERROR);
+}
+
+// Encabezado válido para la base del fixture y registros escritos a mano
+static bytes_t crafted(const fixture_t &f, uint32_t new_size, const bytes_t &records)
+{
+  bytes_t p(f.patch.begin(), f.patch.begin() + DELTA_HEADER_SIZE);
+  for (int i = 0; i < 4; i++) p[12 + i] = (uint8_t)(new_size >> (8 * i));
+  p.insert(p.end(), records.begin(), records.end());
+  return p;
+}
+
+static bytes_t varint(uint32_t v)
+{
+  bytes_t out;
+  do {
+    uint8_t b = v & 0x7F;
+    v >>= 7;
+    out.push_back(v ? b | 0x80 : b);
+  } while (v);
+  return out;
+}
+
+static bytes_t cat(std::initializer_list<bytes_t> parts)
+{
+  bytes_t out;
+  for (const bytes_t &p : parts) out.insert(out.end(), p.begin(), p.end());
+  return out;
+}
+
+static const char* crafted_error(const fixture_t &f, uint32_t new_size, const bytes_t &records)
+{
+  applied_t r = apply(f.old_path, crafted(f, new_size, records), 1 + check_rand_below(8));
+  CHECK_EQ(r.result, APPLY_FEED_ERROR);
+  return r.error ? r.error : "";
+}
+
+static void test_crafted(const fixture_t &f)
+{
+  uint32_t old_size = (uint32_t)f.base.size();
+  // Registro válido escrito a mano: 4 bytes iguales a la base y 2 extra
+  bytes_t ok = cat({ varint(4), varint(2), varint(0), varint(4), varint(0), { 'h', 'i' } });
+  applied_t r = apply(f.old_path, crafted(f, 6, ok), 3);
+  CHECK_EQ(r.result, APPLY_SHA_MISMATCH);       // new_sha256 es el del fixture
+  CHECK(r.out.size() == 6 && memcmp(r.out.data(), f.base.data(), 4) == 0 && r.out[4] == 'h');
+
+  // Varint de 6 bytes, y de 5 con bits por encima de 32
+  CHECK(strcmp(crafted_error(f, 10, { 0x80, 0x80, 0x80, 0x80, 0x80, 0x01 }), "varint invalido") == 0);
+  CHECK(strcmp(crafted_error(f, 10, { 0xFF, 0xFF, 0xFF, 0xFF, 0x10 }), "varint invalido") == 0);
+  CHECK(strcmp(crafted_error(f, 10, { 0x80, 0x80, 0x80, 0x80, 0x1F }), "varint invalido") == 0);
+  // 5 bytes dentro de 32 bits: el varint es válido (0xFFFFFFFF) y falla el límite
+  CHECK(strcmp(crafted_error(f, 10, { 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x00, 0x00 }), "registro excede new_size") == 0);
+  // El mismo en zero_run
+  CHECK(strcmp(crafted_error(f, 10, cat({ varint(10), varint(0), varint(0), { 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 } })),
+               "varint invalido") == 0);
+
+  // Seek más allá del final de la base y antes del inicio
+  CHECK(strcmp(crafted_error(f, 2, cat({ varint(0), varint(1), varint((old_size + 1) * 2), { 'x' } })),
+               "seek fuera de la imagen base") == 0);
+  CHECK(strcmp(crafted_error(f, 2, cat({ varint(0), varint(1), varint(1), { 'x' } })),
+               "seek fuera de la imagen base") == 0);
+  // Copia que lee más allá de la base (tras un seek legal al final)
+  CHECK(strcmp(crafted_error(f, 10, cat({ varint(0), varint(1), varint(old_size * 2), { 'x' },
+                                          varint(4), varint(0), varint(0), varint(4) })),
+               "lectura fuera de la imagen base") == 0);
+  // zero_run / lit_len mayores que el diff del registro
+  CHECK(strcmp(crafted_error(f, 10, cat({ varint(3), varint(0), varint(0), varint(4) })), "zero_run excede diff") == 0);
+  CHECK(strcmp(crafted_error(f, 10, cat({ varint(3), varint(0), varint(0), varint(1), varint(3) })),
+               "lit_len excede diff") == 0);
+  // new_size 0
+  CHECK(strcmp(crafted_error(f, 0, {}), "new_size invalido") == 0);
+}
+
+static void bench()
+{
+  fixture_t f;
+  bytes_t base = make_base(1 << 20);
+  CHECK(make_fixture(&f, base, make_target(base)));
+  double t0 = check_seconds();
+  applied_t r = apply(f.old_path, f.patch, 4096);
+  double dt = check_seconds() - t0;
+  CHECK(r.result == APPLY_OK && r.out == f.target);
+  printf("delta_patch: imagen de %zu B desde un parche de %zu B en %.1f ms (%.0f MB/s, con E/S de archivos y SHA-256)\n",
+         r.out.size(), f.patch.size(), dt * 1e3, r.out.size() / dt / 1e6);
+  unlink(f.old_path.c_str());
+}
+
+int main(int argc, char** argv)
+{
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+    bench();
+    return check_done("delta_patch bench");
+  }
+  test_round_trips();
+  fixture_t f;
+  bytes_t base = make_base(40000);
+  CHECK(make_fixture(&f, base, make_target(base)));
+  test_damaged(f);
+  test_crafted(f);
+  unlink(f.old_path.c_str());
+  return check_done("delta_patch");
+}
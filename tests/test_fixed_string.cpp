@@ -0,0 +1,142 @@
+// Pruebas de FixedString: truncado (sin cortar caracteres UTF-8), append y
+// formato, y una prueba de resistencia que repite 30 días de actualizaciones
+// cada 5 s (lecturas, pantalla, log) verificando que el heap no cambia.
+
+#include "fixed_string.h"
+#include "check.h"
+#include <math.h>
+#include <string.h>
+#if defined(__SANITIZE_ADDRESS__)
+extern "C" size_t __sanitizer_get_current_allocated_bytes(void);
+static size_t heap_in_use() { return __sanitizer_get_current_allocated_bytes(); }
+#else
+#include <malloc.h>
+static size_t heap_in_use() { return mallinfo2().uordblks; }
+#endif
+
+static void test_basics()
+{
+  FixedString<8> s;
+  CHECK_EQ(s.length(), 0);
+  CHECK(s == "");
+  CHECK(!s.truncated());
+  CHECK_EQ(FixedString<8>::capacity(), 8);
+
+  s = "abc";
+  s.append("def");
+  CHECK(s == "abcdef");
+  CHECK_EQ(s.length(), 6);
+  s.append(NULL);
+  CHECK(s == "abcdef");
+  s.append("gh");
+  CHECK(s == "abcdefgh" && !s.truncated());
+  s.append("i");
+  CHECK(s == "abcdefgh" && s.truncated());
+  s.set("x");
+  CHECK(s == "x" && !s.truncated());            // set limpia la marca
+
+  FixedString<16> f;
+  f.format("Bat: %d %%", 87);
+  CHECK(f == "Bat: 87 %");
+  f.appendf(" %s", "ok");
+  CHECK(f == "Bat: 87 % ok");
+  CHECK_EQ(f.length(), strlen(f.c_str()));
+  f.format("%s", "0123456789abcdefXYZ");
+  CHECK(f == "0123456789abcdef" && f.truncated());
+  CHECK_EQ(f.length(), 16);
+  f.appendf("%d", 1);                           // Lleno: no cambia, sigue truncado
+  CHECK(f == "0123456789abcdef" && f.truncated());
+  f.format("%.1f", 21.55);
+  CHECK(f == "21.6" || f == "21.5");
+  CHECK(!f.truncated());
+  CHECK(f != "21");
+  CHECK(strcmp((const char*)f, f.c_str()) == 0);
+}
+
+static void test_utf8()
+{
+  // "°" = C2 B0, "€" = E2 82 AC, "😀" = F0 9F 98 80
+  FixedString<6> s;
+  s = "abcd\xc2\xb0";                           // Cabe justo
+  CHECK(s == "abcd\xc2\xb0" && !s.truncated());
+  s = "abcde\xc2\xb0";                          // No cabe el segundo byte: se quita entero
+  CHECK(s == "abcde" && s.truncated());
+  s = "abcd\xe2\x82\xac";
+  CHECK(s == "abcd" && s.truncated());
+  s = "ab\xf0\x9f\x98\x80x";
+  CHECK(s == "ab\xf0\x9f\x98\x80" && s.truncated());
+  s = "abc\xf0\x9f\x98\x80";
+  CHECK(s == "abc" && s.truncated());
+
+  FixedString<6> f;
+  f.format("T%.1f\xc2\xb0" "C", 21.5);          // "T21.5°C" = 8 bytes
+  CHECK(f == "T21.5" && f.truncated());
+  f.format("%s", "ab");
+  f.appendf("%s", "cd\xe2\x82\xac");
+  CHECK(f == "abcd" && f.truncated());
+
+  // fixed_utf8_trim sobre tramos sueltos
+  const char* t = "a\xe2\x82\xac";
+  CHECK_EQ(fixed_utf8_trim(t, 0, 4), 4);
+  CHECK_EQ(fixed_utf8_trim(t, 0, 3), 1);
+  CHECK_EQ(fixed_utf8_trim(t, 0, 2), 1);
+  CHECK_EQ(fixed_utf8_trim(t, 1, 1), 1);
+  CHECK_EQ(fixed_utf8_trim(t, 2, 3), 3);        // Sólo continuaciones: no retrocede antes de start
+}
+
+// Lo que el firmware formatea en cada actualización (sensors.cpp, display_utils.cpp, .ino)
+typedef FixedString<24> line_t;                 // DISPLAY_LINE_MAX
+
+static line_t temp_line, hum_line, bat_v, bat_pct, ip_line, version_line, msg[4];
+
+static void update(uint32_t i)
+{
+  float temperature = 15.0f + (i % 200) / 10.0f;
+  float humidity = (i % 97 == 0) ? NAN : 40.0f + (i % 300) / 10.0f;
+  temp_line.format("Temp: %.1f \xc2\xb0" "C", temperature);
+  if (isnan(humidity)) hum_line = "--.-%";
+  else hum_line.format("Hum: %.1f %%", humidity);
+  bat_v.format("Bat: %d mv", 3300 + (int)(i % 900));
+  bat_pct.format("Bat: %d %%", (int)(i % 101));
+  ip_line.format("IP: %u.%u.%u.%u", 192u, 168u, (i >> 8) & 0xFF, i & 0xFF);
+  version_line.format("v%s", "1.4.2");
+  // Mensaje partido en palabras como display_oled_message
+  const char* text = "Puerta abierta en laboratorio principal desde hace un momento";
+  for (int l = 0; l < 4; l++) msg[l].clear();
+  int l = 0;
+  for (const char* s = text; *s && l < 4;) {
+    size_t word = strcspn(s, " ");
+    if (msg[l].length() + word + 1 > 20) l++;
+    if (l < 4) msg[l].appendf(msg[l].length() ? " %.*s" : "%.*s", (int)word, s);
+    s += word;
+    while (*s == ' ') s++;
+  }
+}
+
+static void test_soak()
+{
+  const uint32_t updates = 30u * 24 * 3600 / 5;    // 30 días cada 5 s
+  update(0);                                        // Primer uso de printf/locale fuera de la medición
+  size_t base = heap_in_use(), peak = base;
+  for (uint32_t i = 1; i <= updates; i++) {
+    update(i);
+    size_t now = heap_in_use();
+    if (now > peak) peak = now;
+  }
+  CHECK_EQ(heap_in_use(), base);
+  CHECK_EQ(peak, base);
+  CHECK(!temp_line.truncated() && !hum_line.truncated());
+  CHECK(strncmp(msg[0].c_str(), "Puerta abierta en", 17) == 0);
+  printf("fixed_string: %u actualizaciones, heap %zu B antes y después, pico %zu B\n", updates, base, peak);
+}
+
+int main(int argc, char** argv)
+{
+  bool bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+  if (!bench) {
+    test_basics();
+    test_utf8();
+  }
+  test_soak();
+  return check_done(bench ? "fixed_string bench" : "fixed_string");
+}
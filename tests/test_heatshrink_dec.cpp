@@ -0,0 +1,260 @@
+// Pruebas de heatshrink_dec con flujos generados por tools/moe_compress.py
+// (contenedor "MOEH"): ida y vuelta con varias ventanas, entrada byte a byte y
+// en trozos al azar, flujos truncados y dañados. Con --bench, velocidad de
+// decodificación con la ventana por defecto (1 KB).
+
+#include "heatshrink_dec.h"
+#include "check.h"
+#include "host_files.h"
+#include <string.h>
+
+#define HS_CONTAINER_HEADER 12
+
+typedef struct {
+  bytes_t out;
+} sink_t;
+
+static bool sink_write(void* ctx, const uint8_t* buf, size_t len)
+{
+  sink_t* s = (sink_t*)ctx;
+  CHECK(len <= HS_OUT_CHUNK);
+  s->out.insert(s->out.end(), buf, buf + len);
+  return true;
+}
+
+typedef struct {
+  uint8_t w, l;
+  uint32_t size;
+  bytes_t stream;               // Sin el encabezado del contenedor
+} hs_file_t;
+
+static bool compress(const bytes_t &data, uint8_t w, uint8_t l, hs_file_t* out)
+{
+  std::string in_path = host_temp_path("plain"), out_path = host_temp_path("hs");
+  char args[64];
+  snprintf(args, sizeof(args), " -w %u -l %u", w, l);
+  bytes_t file;
+  bool ok = host_write_file(in_path, data) &&
+            host_run_tool("moe_compress.py", "heatshrink " + in_path + " " + out_path + args) &&
+            host_read_file(out_path, &file);
+  unlink(in_path.c_str());
+  unlink(out_path.c_str());
+  if (!ok || file.size() < HS_CONTAINER_HEADER || memcmp(file.data(), "MOEH", 4) != 0) return false;
+  out->w = file[4];
+  out->l = file[5];
+  out->size = (uint32_t)file[8] | (uint32_t)file[9] << 8 | (uint32_t)file[10] << 16 | (uint32_t)file[11] << 24;
+  out->stream.assign(file.begin() + HS_CONTAINER_HEADER, file.end());
+  return out->w == w && out->l == l && out->size == data.size();
+}
+
+typedef struct {
+  bool fed;                     // feed nunca falló
+  bool done;
+  const char* error;
+  bytes_t out;
+} decoded_t;
+
+static hs_decoder_t dec;
+static uint8_t window[1 << HS_MAX_WINDOW_BITS];
+
+static decoded_t decode(uint8_t w, uint8_t l, uint32_t size, const bytes_t &stream, uint32_t max_chunk)
+{
+  sink_t sink;
+  decoded_t r = { true, false, NULL, {} };
+  CHECK(hs_decoder_init(&dec, w, l, window, size, sink_write, &sink));
+  size_t i = 0;
+  while (i < stream.size()) {
+    size_t n = 1 + check_rand_below(max_chunk);
+    if (n > stream.size() - i) n = stream.size() - i;
+    if (!hs_decoder_feed(&dec, stream.data() + i, n)) {
+      r.fed = false;
+      r.error = dec.error;
+      break;
+    }
+    i += n;
+  }
+  r.done = hs_decoder_done(&dec);
+  r.out = sink.out;
+  return r;
+}
+
+// Texto repetitivo, bytes al azar y tramos de ceros, como una imagen de firmware
+static bytes_t sample_data(size_t size)
+{
+  bytes_t b(size);
+  for (size_t i = 0; i < size; i++) {
+    switch ((i / 700) % 4) {
+      case 0: b[i] = (uint8_t)("GET /metrics HTTP/1.1 moe_sched_job_runs "[i % 41]); break;
+      case 1: b[i] = (uint8_t)check_rand(); break;
+      case 2: b[i] = 0; break;
+      default: b[i] = (uint8_t)(i >> 3); break;
+    }
+  }
+  return b;
+}
+
+static void test_round_trips()
+{
+  static const uint8_t params[][2] = { { 4, 3 }, { 8, 4 }, { 10, 5 }, { 12, 8 } };
+  bytes_t data = sample_data(24000);
+  for (size_t k = 0; k < sizeof(params) / sizeof(params[0]); k++) {
+    hs_file_t f;
+    CHECK(compress(data, params[k][0], params[k][1], &f));
+    CHECK(f.stream.size() < data.size());
+    for (uint32_t chunk : { 1u, 13u, 1024u }) {
+      decoded_t r = decode(f.w, f.l, f.size, f.stream, chunk);
+      if (!r.fed || !r.done || r.out != data) {
+        fprintf(stderr, "w=%u l=%u trozos %u: %s\n", f.w, f.l, chunk, r.error ? r.error : "incompleto o distinto");
+        check_failures++;
+      }
+    }
+  }
+
+  // Vacío, un byte y todo igual (una referencia que se solapa consigo misma)
+  hs_file_t f;
+  CHECK(compress(bytes_t(), 10, 5, &f));
+  decoded_t r = decode(f.w, f.l, f.size, f.stream, 4);
+  CHECK(r.done && r.out.empty());
+  CHECK(compress(bytes_t(1, 0x5A), 10, 5, &f));
+  r = decode(f.w, f.l, f.size, f.stream, 4);
+  CHECK(r.done && r.out == bytes_t(1, 0x5A));
+  bytes_t same(5000, 0xAB);
+  CHECK(compress(same, 10, 5, &f));
+  CHECK(f.stream.size() < same.size() / 10);
+  r = decode(f.w, f.l, f.size, f.stream, 4);
+  CHECK(r.done && r.out == same);
+}
+
+// Flujo escrito a mano (bits MSB primero)
+typedef struct {
+  bytes_t out;
+  uint32_t acc;
+  int n;
+} bit_writer_t;
+
+static void put_bits(bit_writer_t* b, uint32_t value, int bits)
+{
+  for (int i = bits - 1; i >= 0; i--) {
+    b->acc = (b->acc << 1) | ((value >> i) & 1);
+    if (++b->n == 8) {
+      b->out.push_back((uint8_t)b->acc);
+      b->acc = 0;
+      b->n = 0;
+    }
+  }
+}
+
+static bytes_t finish_bits(bit_writer_t* b)
+{
+  if (b->n) b->out.push_back((uint8_t)(b->acc << (8 - b->n)));
+  return b->out;
+}
+
+static void test_damaged()
+{
+  bytes_t data = sample_data(6000);
+  hs_file_t f;
+  CHECK(compress(data, 10, 5, &f));
+
+  // Truncado: sin error de formato, pero incompleto
+  for (size_t cut : { (size_t)0, (size_t)1, f.stream.size() / 2, f.stream.size() - 1 }) {
+    bytes_t t(f.stream.begin(), f.stream.begin() + cut);
+    decoded_t r = decode(f.w, f.l, f.size, t, 16);
+    CHECK(r.fed);
+    CHECK(!r.done);
+    CHECK(r.out.size() < data.size());
+  }
+  // Bytes después del final
+  bytes_t longer = f.stream;
+  longer.push_back(0);
+  decoded_t r = decode(f.w, f.l, f.size, longer, 16);
+  CHECK(!r.fed && strcmp(r.error, "datos despues del final") == 0);
+
+  // Referencia antes del inicio: al comenzar, y tras 3 literales con distancia 4
+  bit_writer_t b = {};
+  put_bits(&b, 0, 1);
+  put_bits(&b, 5, 10);
+  put_bits(&b, 2, 5);
+  r = decode(10, 5, 10, finish_bits(&b), 1);
+  CHECK(!r.fed && strcmp(r.error, "referencia antes del inicio") == 0);
+  CHECK(r.out.empty());
+
+  b = {};
+  for (int k = 0; k < 3; k++) {
+    put_bits(&b, 1, 1);
+    put_bits(&b, 'a' + k, 8);
+  }
+  put_bits(&b, 0, 1);
+  put_bits(&b, 3, 10);                          // Distancia 4 con 3 bytes producidos
+  put_bits(&b, 0, 5);
+  r = decode(10, 5, 10, finish_bits(&b), 1);
+  CHECK(!r.fed && strcmp(r.error, "referencia antes del inicio") == 0);
+
+  // La misma con distancia 3 es válida y se solapa: "abc" + "abcabca"
+  b = {};
+  for (int k = 0; k < 3; k++) {
+    put_bits(&b, 1, 1);
+    put_bits(&b, 'a' + k, 8);
+  }
+  put_bits(&b, 0, 1);
+  put_bits(&b, 2, 10);
+  put_bits(&b, 6, 5);
+  r = decode(10, 5, 10, finish_bits(&b), 1);
+  CHECK(r.fed && r.done);
+  CHECK(r.out == bytes_t({ 'a', 'b', 'c', 'a', 'b', 'c', 'a', 'b', 'c', 'a' }));
+
+  // Referencia que pasa del tamaño original
+  r = decode(10, 5, 8, finish_bits(&b), 1);
+  CHECK(!r.fed && strcmp(r.error, "referencia excede el tamano original") == 0);
+
+  // Parámetros fuera de rango
+  sink_t sink;
+  CHECK(!hs_decoder_init(&dec, 3, 3, window, 10, sink_write, &sink));
+  CHECK(!hs_decoder_init(&dec, 13, 5, window, 10, sink_write, &sink));
+  CHECK(!hs_decoder_init(&dec, 10, 10, window, 10, sink_write, &sink));
+  CHECK(!hs_decoder_init(&dec, 10, 2, window, 10, sink_write, &sink));
+
+  // Bytes al azar: nunca lee fuera de la ventana ni entrega de más
+  for (int round = 0; round < 3000; round++) {
+    bytes_t junk(1 + check_rand_below(64));
+    for (auto &c : junk) c = (uint8_t)check_rand();
+    r = decode(4 + check_rand_below(9), 3, 200, junk, 8);
+    CHECK(r.out.size() <= 200);
+  }
+}
+
+static bool count_only(void* ctx, const uint8_t*, size_t len)
+{
+  *(size_t*)ctx += len;
+  return true;
+}
+
+static void bench()
+{
+  bytes_t data = sample_data(256 * 1024);
+  hs_file_t f;
+  CHECK(compress(data, 10, 5, &f));
+  const int reps = 40;
+  size_t total = 0;
+  double t0 = check_seconds();
+  for (int i = 0; i < reps; i++) {
+    hs_decoder_init(&dec, f.w, f.l, window, f.size, count_only, &total);
+    hs_decoder_feed(&dec, f.stream.data(), f.stream.size());
+    CHECK(hs_decoder_done(&dec));
+  }
+  double dt = check_seconds() - t0;
+  CHECK_EQ(total, (size_t)reps * data.size());
+  printf("heatshrink_dec: %zu -> %zu B (w=10 l=5), %.0f MB/s de salida, estado %zu B + ventana 1024 B\n",
+         f.stream.size(), data.size(), total / dt / 1e6, sizeof(hs_decoder_t));
+}
+
+int main(int argc, char** argv)
+{
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+    bench();
+    return check_done("heatshrink_dec bench");
+  }
+  test_round_trips();
+  test_damaged();
+  return check_done("heatshrink_dec");
+}
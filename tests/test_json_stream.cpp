@@ -0,0 +1,368 @@
+// Pruebas de json_stream: casos de la gramática, eventos, límites, helpers y
+// fuzz propio (documentos generados y mutados: el análisis por partes debe dar
+// lo mismo que el análisis de una vez). Con --verdicts lee documentos en hex,
+// uno por línea, e imprime el estado de cada uno (lo usa json_diff.py para
+// comparar con el módulo json de Python). Con --bench mide velocidad.
+
+#include "json_stream.h"
+#include "check.h"
+#include <string>
+#include <string.h>
+
+typedef struct {
+  std::string log;              // Eventos serializados
+  int abort_after;              // Corta tras n eventos (0 = no)
+  int n;
+} events_t;
+
+static bool record(const json_event_t* ev, void* ctx)
+{
+  events_t* e = (events_t*)ctx;
+  char head[64];
+  snprintf(head, sizeof(head), "%u:%d:", ev->depth, ev->type);
+  e->log += head;
+  e->log += ev->key;
+  e->log += '=';
+  e->log.append(ev->value, ev->len);
+  e->log += '\n';
+  CHECK_EQ(strlen(ev->value), ev->len);
+  e->n++;
+  return !(e->abort_after && e->n >= e->abort_after);
+}
+
+static json_status_t parse(const std::string &doc, events_t* ev = NULL)
+{
+  return json_parse(doc.data(), doc.size(), ev ? record : NULL, ev);
+}
+
+// Mismo documento en trozos de largo aleatorio (1 = byte a byte)
+static json_status_t parse_chunked(const std::string &doc, events_t* ev, uint32_t max_chunk)
+{
+  json_parser_t p;
+  json_parser_init(&p, record, ev);
+  size_t i = 0;
+  while (i < doc.size()) {
+    size_t n = 1 + check_rand_below(max_chunk);
+    if (n > doc.size() - i) n = doc.size() - i;
+    if (json_parser_feed(&p, doc.data() + i, n) != JSON_OK) return p.status;
+    i += n;
+  }
+  return json_parser_finish(&p);
+}
+
+typedef struct {
+  const char* doc;
+  json_status_t want;
+} table_case_t;
+
+static const table_case_t table[] = {
+  { "{}", JSON_OK },
+  { " [ ] ", JSON_OK },
+  { "0", JSON_OK },
+  { "-0.5e+10", JSON_OK },
+  { "\"\"", JSON_OK },
+  { "true", JSON_OK },
+  { "{\"a\":[1,{\"b\":null}],\"c\":\"x\"}", JSON_OK },
+  { "\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"", JSON_OK },
+  { "\"\\u00e9\\u20AC\\ud83d\\ude00\"", JSON_OK },
+  { "\"\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\"", JSON_OK },
+  { "", JSON_INCOMPLETE },
+  { "{", JSON_INCOMPLETE },
+  { "\"abc", JSON_INCOMPLETE },
+  { "[1,", JSON_INCOMPLETE },
+  { "tru", JSON_INCOMPLETE },
+  { "{,}", JSON_ERR_SYNTAX },
+  { "[1,]", JSON_ERR_SYNTAX },
+  { "{\"a\":1,}", JSON_ERR_SYNTAX },
+  { "{\"a\" 1}", JSON_ERR_SYNTAX },
+  { "{1:2}", JSON_ERR_SYNTAX },
+  { "[1 2]", JSON_ERR_SYNTAX },
+  { "[}", JSON_ERR_SYNTAX },
+  { "01", JSON_ERR_SYNTAX },
+  { "1.", JSON_ERR_SYNTAX },
+  { ".5", JSON_ERR_SYNTAX },
+  { "1e", JSON_ERR_SYNTAX },
+  { "+1", JSON_ERR_SYNTAX },
+  { "-", JSON_ERR_SYNTAX },
+  { "1-2", JSON_ERR_SYNTAX },
+  { "NaN", JSON_ERR_SYNTAX },
+  { "Infinity", JSON_ERR_SYNTAX },
+  { "True", JSON_ERR_SYNTAX },
+  { "nul", JSON_INCOMPLETE },
+  { "nulL", JSON_ERR_SYNTAX },
+  { "{} {}", JSON_ERR_SYNTAX },
+  { "1 2", JSON_ERR_SYNTAX },
+  { "'a'", JSON_ERR_SYNTAX },
+  { "\"\\x\"", JSON_ERR_SYNTAX },
+  { "\"\\u12G4\"", JSON_ERR_SYNTAX },
+  { "\"a\tb\"", JSON_ERR_SYNTAX },            // Control sin escapar
+  { "\"\xc0\xaf\"", JSON_ERR_SYNTAX },        // UTF-8 sobrelargo
+  { "\"\xed\xa0\x80\"", JSON_ERR_SYNTAX },    // Sustituto codificado en UTF-8
+  { "\"\xf4\x90\x80\x80\"", JSON_ERR_SYNTAX },// > U+10FFFF
+  { "\"\xe2\x82\"", JSON_ERR_SYNTAX },        // Secuencia incompleta
+  { "\xef\xbb\xbf{}", JSON_ERR_SYNTAX },      // BOM
+  // Diferencias deliberadas con Python (json.loads las acepta): los valores
+  // se entregan como UTF-8 terminado en '\0', que no puede representar un
+  // sustituto aislado ni U+0000
+  { "\"\\ud800\"", JSON_ERR_SYNTAX },
+  { "\"\\udc00\"", JSON_ERR_SYNTAX },
+  { "\"\\ud800x\"", JSON_ERR_SYNTAX },
+  { "\"\\ud800\\u0041\"", JSON_ERR_SYNTAX },
+  { "\"\\ud800\\ud800\"", JSON_ERR_SYNTAX },
+  { "\"\\u0000\"", JSON_ERR_SYNTAX },
+  { "\"a\\u0000b\"", JSON_ERR_SYNTAX },
+};
+
+static void test_table()
+{
+  for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+    std::string doc = table[i].doc;
+    json_status_t got = parse(doc);
+    if (got != table[i].want) {
+      fprintf(stderr, "caso %zu '%s': %s, se esperaba %s\n", i, table[i].doc, json_status_name(got),
+              json_status_name(table[i].want));
+      check_failures++;
+    }
+    events_t e1 = { "", 0, 0 }, e2 = { "", 0, 0 };
+    parse(doc, &e1);
+    CHECK_EQ(parse_chunked(doc, &e2, 1), got);
+    CHECK(e1.log == e2.log);
+  }
+}
+
+static void test_events()
+{
+  std::string doc = "{\"a\":1,\"b\":[true,\"x\\u00e9\"],\"c\":{\"d\":null},\"e\":-2.5e3}";
+  events_t e = { "", 0, 0 };
+  CHECK_EQ(parse(doc, &e), JSON_OK);
+  CHECK(e.log == "1:1:a=1\n2:2:=true\n2:0:=x\xc3\xa9\n2:3:d=null\n1:1:e=-2.5e3\n");
+
+  // Número raíz: se emite al finalizar
+  events_t n = { "", 0, 0 };
+  CHECK_EQ(parse("42", &n), JSON_OK);
+  CHECK(n.log == "0:1:=42\n");
+
+  events_t ab = { "", 2, 0 };
+  CHECK_EQ(parse(doc, &ab), JSON_ERR_ABORT);
+  CHECK_EQ(ab.n, 2);
+
+  // Tras un error, feed lo repite sin avanzar
+  json_parser_t p;
+  json_parser_init(&p, NULL, NULL);
+  CHECK_EQ(json_parser_feed(&p, "[1,]", 4), JSON_ERR_SYNTAX);
+  CHECK_EQ(p.offset, 3);
+  CHECK_EQ(json_parser_feed(&p, "1", 1), JSON_ERR_SYNTAX);
+  CHECK_EQ(p.offset, 3);
+}
+
+static void test_limits()
+{
+  std::string deep(JSON_MAX_DEPTH, '[');
+  deep += std::string(JSON_MAX_DEPTH, ']');
+  CHECK_EQ(parse(deep), JSON_OK);
+  CHECK_EQ(parse("[" + deep + "]"), JSON_ERR_DEPTH);
+
+  std::string key(JSON_MAX_KEY, 'k');
+  CHECK_EQ(parse("{\"" + key + "\":1}"), JSON_OK);
+  CHECK_EQ(parse("{\"" + key + "k\":1}"), JSON_ERR_LENGTH);
+
+  std::string val(JSON_MAX_VALUE, 'v');
+  CHECK_EQ(parse("\"" + val + "\""), JSON_OK);
+  CHECK_EQ(parse("\"" + val + "v\""), JSON_ERR_LENGTH);
+  CHECK_EQ(parse("\"" + val.substr(1) + "\\u00e9\""), JSON_ERR_LENGTH);   // 2 bytes en UTF-8
+  CHECK_EQ(parse(std::string(JSON_MAX_VALUE, '1')), JSON_OK);
+  CHECK_EQ(parse(std::string(JSON_MAX_VALUE + 1, '1')), JSON_ERR_LENGTH);
+}
+
+static bool event_int(const char* doc, long min, long max, long* out)
+{
+  struct ctx_t { long min, max, *out; bool ok; } c = { min, max, out, false };
+  json_parse(doc, strlen(doc), [](const json_event_t* ev, void* ctx) {
+    ctx_t* c = (ctx_t*)ctx;
+    c->ok = json_event_int(ev, c->min, c->max, c->out);
+    return true;
+  }, &c);
+  return c.ok;
+}
+
+static void test_helpers()
+{
+  char out[16];
+  const char* doc = "{\"mode\":\"normal\",\"n\":{\"mode\":\"x\"},\"mode\":\"continuo\"}";
+  CHECK(json_find_string(doc, strlen(doc), "mode", out, sizeof(out)));
+  CHECK(strcmp(out, "continuo") == 0);          // Gana la última
+  CHECK(!json_find_string(doc, strlen(doc), "n", out, sizeof(out)));
+  CHECK(!json_find_string(doc, strlen(doc), "zz", out, sizeof(out)));
+  CHECK(!json_find_string(doc, strlen(doc), "mode", out, 8));   // No cabe
+  CHECK(!json_find_string("{\"mode\":\"x\"", 11, "mode", out, sizeof(out)));
+
+  long v = 0;
+  CHECK(event_int("300", 60, 86400, &v) && v == 300);
+  CHECK(!event_int("30", 60, 86400, &v));
+  CHECK(!event_int("300.0", 60, 86400, &v));
+  CHECK(!event_int("3e2", 60, 86400, &v));
+  CHECK(!event_int("\"300\"", 60, 86400, &v));
+  CHECK(!event_int("99999999999999999999", 0, 86400, &v));
+  CHECK(event_int("-5", -10, 10, &v) && v == -5);
+}
+
+// --- Fuzz propio ---
+
+static void gen_string(std::string &out, uint32_t max_bytes)
+{
+  static const char* const pieces[] = {
+    "a", "Z", "0", " ", "\\\"", "\\\\", "\\/", "\\n", "\\t", "\\u0041", "\\u00e9", "\\u20ac",
+    "\\ud83d\\ude00", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\\ud800", "\\u0000"
+  };
+  out += '"';
+  uint32_t n = check_rand_below(max_bytes / 6 + 1);
+  for (uint32_t i = 0; i < n; i++) {
+    uint32_t k = check_rand_below(sizeof(pieces) / sizeof(pieces[0]) * 4);
+    // Los sustitutos aislados y \u0000 aparecen poco
+    if (k >= 16 * 4 && check_rand_below(8)) k = 0;
+    out += pieces[k / 4];
+  }
+  out += '"';
+}
+
+static void gen_value(std::string &out, int depth)
+{
+  static const char* const numbers[] = { "0", "-1", "42", "3.25", "-0.0", "1e9", "2E-3", "123456789012345678" };
+  uint32_t kind = check_rand_below(depth < JSON_MAX_DEPTH ? 7 : 5);
+  switch (kind) {
+    case 0: gen_string(out, 40); break;
+    case 1: out += numbers[check_rand_below(8)]; break;
+    case 2: out += check_rand_below(2) ? "true" : "false"; break;
+    case 3: out += "null"; break;
+    case 4: gen_string(out, 20); break;
+    case 5: {
+      out += '[';
+      uint32_t n = check_rand_below(4);
+      for (uint32_t i = 0; i < n; i++) {
+        if (i) out += check_rand_below(4) ? "," : " , ";
+        gen_value(out, depth + 1);
+      }
+      out += ']';
+      break;
+    }
+    default: {
+      out += '{';
+      uint32_t n = check_rand_below(4);
+      for (uint32_t i = 0; i < n; i++) {
+        if (i) out += ',';
+        gen_string(out, JSON_MAX_KEY / 2);
+        out += check_rand_below(3) ? ":" : " :\n";
+        gen_value(out, depth + 1);
+      }
+      out += '}';
+      break;
+    }
+  }
+}
+
+static void mutate(std::string &doc)
+{
+  static const char alphabet[] = "{}[]\",:\\ 0123456789.eE+-tfnulrsaxu\x80\xc3\xed\xff";
+  uint32_t edits = 1 + check_rand_below(3);
+  for (uint32_t i = 0; i < edits && !doc.empty(); i++) {
+    size_t at = check_rand_below(doc.size());
+    char c = alphabet[check_rand_below(sizeof(alphabet) - 1)];
+    switch (check_rand_below(4)) {
+      case 0: doc.erase(at, 1); break;
+      case 1: doc.insert(at, 1, c); break;
+      case 2: doc[at] = c; break;
+      default: doc.resize(at); break;
+    }
+  }
+}
+
+static void test_fuzz()
+{
+  int ok = 0, rejected = 0;
+  for (int round = 0; round < 40000; round++) {
+    std::string doc;
+    gen_value(doc, 0);
+    bool mutated = round % 2;
+    if (mutated) mutate(doc);
+    bool has_exception = doc.find("\\ud800") != std::string::npos || doc.find("\\u0000") != std::string::npos;
+
+    events_t whole = { "", 0, 0 }, chunked = { "", 0, 0 };
+    json_status_t st = parse(doc, &whole);
+    CHECK_EQ(parse_chunked(doc, &chunked, 1 + check_rand_below(16)), st);
+    CHECK(whole.log == chunked.log);
+    if (!mutated) {
+      // Generado dentro de los límites: sólo se rechaza por las excepciones
+      if (has_exception) CHECK_EQ(st, JSON_ERR_SYNTAX);
+      else if (st != JSON_OK && st != JSON_ERR_LENGTH) {
+        fprintf(stderr, "válido rechazado (%s): %s\n", json_status_name(st), doc.c_str());
+        check_failures++;
+      }
+    }
+    if (st == JSON_OK) ok++;
+    else rejected++;
+  }
+  CHECK(ok > 15000 && rejected > 10000);
+}
+
+static int hex_value(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static int verdicts()
+{
+  static char line[1 << 16];
+  while (fgets(line, sizeof(line), stdin)) {
+    std::string doc;
+    for (size_t i = 0; hex_value(line[i]) >= 0 && hex_value(line[i + 1]) >= 0; i += 2) {
+      doc += (char)(hex_value(line[i]) << 4 | hex_value(line[i + 1]));
+    }
+    puts(json_status_name(parse(doc)));
+  }
+  return 0;
+}
+
+static void bench()
+{
+  // Cuerpo típico de PATCH /api/config
+  const char* body = "{\"interval\":300,\"mode\":\"normal\",\"pull_min_battery\":40,"
+                     "\"telemetry_url\":\"https://telemetry.example.org/api/v1/telemetry\","
+                     "\"door_url\":\"https://telemetry.example.org/api/v1/door\","
+                     "\"headless_wake\":true,\"listen_interval\":3}";
+  size_t len = strlen(body);
+  const int reps = 400000;
+  double t0 = check_seconds();
+  for (int i = 0; i < reps; i++) CHECK_EQ(json_parse(body, len, NULL, NULL), JSON_OK);
+  double dt = check_seconds() - t0;
+  printf("json_stream: cuerpo de %zu B en %.2f us, %.0f MB/s; estado del parser %zu B\n", len, dt / reps * 1e6,
+         (double)len * reps / dt / 1e6, sizeof(json_parser_t));
+
+  std::string big = "[";
+  while (big.size() < (1 << 20)) {
+    if (big.size() > 1) big += ',';
+    big += body;
+  }
+  big += ']';
+  t0 = check_seconds();
+  for (int i = 0; i < 20; i++) CHECK_EQ(parse(big), JSON_OK);
+  dt = check_seconds() - t0;
+  printf("json_stream: documento de %zu B, %.0f MB/s\n", big.size(), (double)big.size() * 20 / dt / 1e6);
+}
+
+int main(int argc, char** argv)
+{
+  if (argc > 1 && strcmp(argv[1], "--verdicts") == 0) return verdicts();
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+    bench();
+    return check_done("json_stream bench");
+  }
+  test_table();
+  test_events();
+  test_limits();
+  test_helpers();
+  test_fuzz();
+  return check_done("json_stream");
+}
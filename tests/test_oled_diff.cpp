@@ -0,0 +1,168 @@
+// Pruebas de oled_diff con un panel simulado: cada tramo se escribe en una
+// copia de la RAM del SSD1306, que al final de cada frame tiene que coincidir
+// con el frame nuevo. Se verifica además la forma de los tramos (dentro de la
+// página, empiezan y terminan en columnas cambiadas, huecos > MERGE_GAP).
+
+#include "oled_diff.h"
+#include "check.h"
+#include <string.h>
+
+#define MAX_SPANS   (OLED_PAGES * OLED_WIDTH)
+
+typedef struct {
+  uint8_t page, x0, x1;
+} span_t;
+
+typedef struct {
+  uint8_t ram[OLED_FB_SIZE];    // Panel simulado
+  const uint8_t* next;
+  span_t spans[MAX_SPANS];
+  int n;
+  size_t columns;
+} panel_t;
+
+static void on_span(uint8_t page, uint8_t x0, uint8_t x1, const uint8_t* data, void* ctx)
+{
+  panel_t* p = (panel_t*)ctx;
+  CHECK(page < OLED_PAGES);
+  CHECK(x0 <= x1 && x1 < OLED_WIDTH);
+  CHECK(data == p->next + page * OLED_WIDTH + x0);
+  memcpy(p->ram + page * OLED_WIDTH + x0, data, x1 - x0 + 1);
+  if (p->n < MAX_SPANS) p->spans[p->n++] = { page, x0, x1 };
+  p->columns += x1 - x0 + 1;
+}
+
+// Aplica un frame y verifica el resultado; retorna la cantidad de tramos
+static int frame(panel_t* p, uint8_t* prev, const uint8_t* next, bool full)
+{
+  uint8_t before[OLED_FB_SIZE];
+  memcpy(before, prev, sizeof(before));
+  p->next = next;
+  p->n = 0;
+  p->columns = 0;
+  size_t sent = oled_diff(prev, next, full, on_span, p);
+  CHECK_EQ(sent, p->columns);
+  CHECK(memcmp(prev, next, OLED_FB_SIZE) == 0);
+  CHECK(memcmp(p->ram, next, OLED_FB_SIZE) == 0);
+  if (full) return p->n;
+
+  for (int i = 0; i < p->n; i++) {
+    const span_t &s = p->spans[i];
+    const uint8_t* b = before + s.page * OLED_WIDTH;
+    const uint8_t* n = next + s.page * OLED_WIDTH;
+    CHECK(b[s.x0] != n[s.x0]);
+    CHECK(b[s.x1] != n[s.x1]);
+    // Dentro del tramo no hay más de MERGE_GAP columnas iguales seguidas
+    int same = 0;
+    for (int x = s.x0; x <= s.x1; x++) {
+      same = b[x] == n[x] ? same + 1 : 0;
+      CHECK(same <= OLED_DIFF_MERGE_GAP);
+    }
+    if (i > 0 && p->spans[i - 1].page == s.page) {
+      CHECK(p->spans[i - 1].x1 < s.x0);
+      CHECK(s.x0 - p->spans[i - 1].x1 - 1 > OLED_DIFF_MERGE_GAP);
+    } else if (i > 0) {
+      CHECK(p->spans[i - 1].page < s.page);
+    }
+  }
+  return p->n;
+}
+
+static panel_t panel;
+static uint8_t prev[OLED_FB_SIZE], next[OLED_FB_SIZE];
+
+static void reset_all()
+{
+  memset(&panel, 0, sizeof(panel));
+  memset(prev, 0, sizeof(prev));
+  memset(next, 0, sizeof(next));
+}
+
+static void test_cases()
+{
+  reset_all();
+  CHECK_EQ(frame(&panel, prev, next, false), 0);                // Idéntico
+  CHECK_EQ(panel.columns, 0);
+
+  next[3 * OLED_WIDTH + 40] = 0x81;                             // Un byte
+  CHECK_EQ(frame(&panel, prev, next, false), 1);
+  CHECK_EQ(panel.columns, 1);
+  CHECK(panel.spans[0].page == 3 && panel.spans[0].x0 == 40 && panel.spans[0].x1 == 40);
+
+  next[10] = 1;                                                 // Hueco de 10: un tramo
+  next[10 + OLED_DIFF_MERGE_GAP + 1] = 1;
+  CHECK_EQ(frame(&panel, prev, next, false), 1);
+  CHECK_EQ(panel.columns, OLED_DIFF_MERGE_GAP + 2);
+
+  next[50] = 1;                                                 // Hueco de 11: dos tramos
+  next[50 + OLED_DIFF_MERGE_GAP + 2] = 1;
+  CHECK_EQ(frame(&panel, prev, next, false), 2);
+  CHECK_EQ(panel.columns, 2);
+
+  next[OLED_WIDTH - 1] = 7;                                     // Fin de página 0 e inicio de la 1
+  next[OLED_WIDTH] = 7;
+  CHECK_EQ(frame(&panel, prev, next, false), 2);
+  CHECK(panel.spans[0].page == 0 && panel.spans[0].x1 == OLED_WIDTH - 1);
+  CHECK(panel.spans[1].page == 1 && panel.spans[1].x0 == 0);
+
+  memset(next + 5 * OLED_WIDTH, 0xFF, OLED_WIDTH);              // Página entera
+  CHECK_EQ(frame(&panel, prev, next, false), 1);
+  CHECK_EQ(panel.columns, OLED_WIDTH);
+
+  memset(panel.ram, 0xAA, sizeof(panel.ram));                   // Panel desconocido
+  CHECK_EQ(frame(&panel, prev, next, true), OLED_PAGES);
+  CHECK_EQ(panel.columns, OLED_FB_SIZE);
+  CHECK_EQ(frame(&panel, prev, next, false), 0);
+}
+
+// Frames parecidos a los reales: texto que cambia en pocas columnas, a veces
+// una pantalla nueva y a veces ruido
+static void random_frame()
+{
+  switch (check_rand_below(20)) {
+    case 0:
+      for (int i = 0; i < OLED_FB_SIZE; i++) next[i] = (uint8_t)check_rand();
+      break;
+    case 1:
+      memset(next, 0, OLED_FB_SIZE);
+      break;
+    default: {
+      int edits = 1 + check_rand_below(6);
+      for (int e = 0; e < edits; e++) {
+        int page = check_rand_below(OLED_PAGES);
+        int x = check_rand_below(OLED_WIDTH);
+        int w = 1 + check_rand_below(30);
+        for (int k = x; k < x + w && k < OLED_WIDTH; k++) {
+          if (check_rand_below(4)) next[page * OLED_WIDTH + k] = (uint8_t)check_rand();
+        }
+      }
+      break;
+    }
+  }
+}
+
+static void test_random(int frames, bool report)
+{
+  reset_all();
+  frame(&panel, prev, next, true);
+  long spans = 0, columns = 0;
+  double t0 = check_seconds();
+  for (int f = 0; f < frames; f++) {
+    random_frame();
+    spans += frame(&panel, prev, next, false);
+    columns += panel.columns;
+  }
+  double dt = check_seconds() - t0;
+  if (report) {
+    printf("oled_diff: %d frames, %.1f tramos y %.1f de %d columnas por frame, %.2f us por frame (con verificación)\n",
+           frames, (double)spans / frames, (double)columns / frames, OLED_FB_SIZE, dt / frames * 1e6);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  bool bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+  if (!bench) test_cases();
+  test_random(bench ? 200000 : 20000, true);
+  return check_done(bench ? "oled_diff bench" : "oled_diff");
+}
@@ -0,0 +1,235 @@
+// Pruebas de sched con tiempo simulado: el reloj inyectado es una variable
+// que la prueba avanza (hasta el próximo plazo, como el bucle de app_sched) y
+// los trabajos registran el instante en que corrieron.
+
+#include "sched.h"
+#include "check.h"
+#include <string.h>
+
+static uint64_t now_us = 0;
+
+static uint64_t sim_clock(void*)
+{
+  return now_us;
+}
+
+typedef struct {
+  int id;
+  uint32_t runs;
+  uint64_t last_us;
+  uint64_t cost_us;             // Tiempo que "tarda" el trabajo
+  sched_t* s;
+  int action;                   // Qué hace el trabajo al correr
+  uint32_t* order;              // Registro de orden (aleatoria)
+  uint32_t* order_n;
+} job_t;
+
+enum { ACT_NONE, ACT_STOP_SELF, ACT_REARM_0 };
+
+static void job_fn(void* ctx)
+{
+  job_t* j = (job_t*)ctx;
+  j->runs++;
+  j->last_us = now_us;
+  if (j->order) j->order[(*j->order_n)++] = (uint32_t)j->id;
+  now_us += j->cost_us;
+  if (j->action == ACT_STOP_SELF) sched_stop(j->s, j->id);
+  else if (j->action == ACT_REARM_0) sched_start(j->s, j->id, 0);
+}
+
+// Avanza el tiempo de espera en espera hasta end_us, como app_sched_loop
+static void simulate(sched_t* s, uint64_t end_us)
+{
+  while (now_us < end_us) {
+    uint32_t wait = sched_run(s);
+    uint64_t step = wait == SCHED_NEVER ? end_us - now_us : (uint64_t)wait * 1000;
+    if (step == 0) step = 1000;
+    now_us = now_us + step < end_us ? now_us + step : end_us;
+  }
+  sched_run(s);
+}
+
+static void test_periodic()
+{
+  static sched_t s;
+  now_us = 1000000;
+  sched_init(&s, sim_clock, NULL);
+  job_t j = {};
+  j.s = &s;
+  j.id = sched_add(&s, "sensors", job_fn, &j, 0, 5000);
+  CHECK(j.id >= 0);
+  CHECK(sched_armed(&s, j.id));
+  CHECK_EQ(sched_next_ms(&s), 0);
+  simulate(&s, 1000000 + 7ULL * 3600 * 1000000);
+  CHECK_EQ(j.runs, 7 * 3600 / 5 + 1);           // t = 0, 5 s, ... 7 h
+  const sched_job_t* info = sched_job(&s, j.id);
+  CHECK_EQ(info->stats.overruns, 0);
+  CHECK_EQ(info->stats.late_max_us, 0);         // Sin deriva: siempre en el plazo
+  CHECK_EQ((j.last_us - 1000000) % 5000000, 0);
+}
+
+static void test_far_one_shot()
+{
+  static sched_t s;
+  now_us = 0;
+  sched_init(&s, sim_clock, NULL);
+  job_t j = {};
+  j.s = &s;
+  // 6 h: más allá del nivel superior (4,6 h), se reubica en la cascada
+  const uint32_t delay = 6 * 3600 * 1000;
+  j.id = sched_add(&s, "far", job_fn, &j, delay, 0);
+  CHECK_EQ(sched_next_ms(&s), delay);
+  simulate(&s, (uint64_t)delay * 1000 - 1000);
+  CHECK_EQ(j.runs, 0);
+  simulate(&s, (uint64_t)delay * 1000 + 5000000);
+  CHECK_EQ(j.runs, 1);
+  CHECK_EQ(j.last_us, (uint64_t)delay * 1000);
+  CHECK(!sched_armed(&s, j.id));                // Una vez: queda detenido
+  CHECK_EQ(sched_next_ms(&s), SCHED_NEVER);
+  CHECK(sched_start(&s, j.id, 10));             // Se puede volver a arrancar
+  simulate(&s, now_us + 20000);
+  CHECK_EQ(j.runs, 2);
+}
+
+static void test_overrun()
+{
+  static sched_t s;
+  now_us = 0;
+  sched_init(&s, sim_clock, NULL);
+  job_t j = {};
+  j.s = &s;
+  j.id = sched_add(&s, "p", job_fn, &j, 100, 100);
+  simulate(&s, 100000);
+  CHECK_EQ(j.runs, 1);
+  // La tarea estuvo bloqueada 250,007 ms más allá del plazo de los 200 ms:
+  // se saltan los de 300 y 400 y se retoma la fase en 500
+  now_us = 450007;
+  sched_run(&s);
+  const sched_job_t* info = sched_job(&s, j.id);
+  CHECK_EQ(j.runs, 2);
+  CHECK_EQ(info->stats.overruns, 2);
+  CHECK_EQ(info->stats.late_max_us, 250007);
+  CHECK_EQ(sched_next_ms(&s), 50);           // En ticks: 500 - 450
+  simulate(&s, 500000);
+  CHECK_EQ(j.runs, 3);
+  CHECK_EQ(j.last_us, 500000);
+}
+
+static void test_runtime_and_self()
+{
+  static sched_t s;
+  now_us = 0;
+  sched_init(&s, sim_clock, NULL);
+  job_t slow = {}, stopper = {}, again = {};
+  slow.s = stopper.s = again.s = &s;
+  slow.cost_us = 1500;
+  slow.id = sched_add(&s, "slow", job_fn, &slow, 10, 10);
+  stopper.action = ACT_STOP_SELF;
+  stopper.id = sched_add(&s, "stop", job_fn, &stopper, 5, 5);
+  again.action = ACT_REARM_0;
+  again.id = sched_add(&s, "again", job_fn, &again, SCHED_NEVER, 0);
+  CHECK(!sched_armed(&s, again.id));
+  CHECK(sched_start(&s, again.id, 0));
+
+  // Rearmarse con 0 dentro del trabajo: una vez por vuelta, no en bucle
+  sched_run(&s);
+  CHECK_EQ(again.runs, 1);
+  sched_run(&s);
+  CHECK_EQ(again.runs, 1);                      // Mismo tick: espera al siguiente
+  now_us += 1000;
+  sched_run(&s);
+  CHECK_EQ(again.runs, 2);
+  sched_stop(&s, again.id);
+
+  simulate(&s, 100000);
+  CHECK_EQ(stopper.runs, 1);                    // Periódico detenido desde su propio trabajo
+  CHECK(!sched_armed(&s, stopper.id));
+  const sched_job_t* info = sched_job(&s, slow.id);
+  CHECK(slow.runs >= 9);
+  CHECK_EQ(info->stats.runtime_max_us, 1500);
+  CHECK_EQ(info->stats.runtime_us, (uint64_t)slow.runs * 1500);
+
+  sched_remove(&s, slow.id);
+  CHECK(sched_job(&s, slow.id) == NULL);
+  CHECK(!sched_start(&s, slow.id, 0));
+  CHECK(!sched_start(&s, -1, 0));
+  CHECK(!sched_start(&s, SCHED_MAX_JOBS, 0));
+}
+
+static void test_table_full()
+{
+  static sched_t s;
+  now_us = 0;
+  sched_init(&s, sim_clock, NULL);
+  job_t j = {};
+  for (int i = 0; i < SCHED_MAX_JOBS; i++) CHECK_EQ(sched_add(&s, "j", job_fn, &j, SCHED_NEVER, 0), i);
+  CHECK_EQ(sched_add(&s, "j", job_fn, &j, SCHED_NEVER, 0), -1);
+  sched_remove(&s, 7);
+  CHECK_EQ(sched_add(&s, "j", job_fn, &j, SCHED_NEVER, 0), 7);
+  CHECK_EQ(sched_next_ms(&s), SCHED_NEVER);
+}
+
+// Trabajos de una vez con plazos al azar (de 1 ms a 5 h, cruzando todos los
+// niveles) y el reloj avanzando a saltos: cada uno corre en la primera vuelta
+// pasado su plazo y, dentro de una vuelta, en orden de plazo
+static void test_random()
+{
+  static sched_t s;
+  for (int round = 0; round < 200; round++) {
+    now_us = (uint64_t)check_rand() * 1000;
+    sched_init(&s, sim_clock, NULL);
+    job_t jobs[SCHED_MAX_JOBS];
+    uint32_t deadline[SCHED_MAX_JOBS];
+    uint32_t order[SCHED_MAX_JOBS * 2], order_n = 0;
+    memset(jobs, 0, sizeof(jobs));
+    uint64_t origin = now_us;
+    for (int i = 0; i < SCHED_MAX_JOBS; i++) {
+      static const uint32_t ranges[] = { 64, 4096, 262144, 18000000 };
+      uint32_t delay = 1 + check_rand_below(ranges[check_rand_below(4)]);
+      jobs[i].s = &s;
+      jobs[i].order = order;
+      jobs[i].order_n = &order_n;
+      jobs[i].id = sched_add(&s, "r", job_fn, &jobs[i], delay, 0);
+      deadline[i] = delay;
+    }
+    uint64_t end = origin + 18000000ULL * 1000 + 1000;
+    uint64_t prev_run = origin;
+    while (now_us < end) {
+      uint32_t before = order_n;
+      sched_run(&s);
+      for (uint32_t k = before; k < order_n; k++) {
+        int i = (int)order[k];
+        uint64_t due = origin + (uint64_t)deadline[i] * 1000;
+        CHECK(jobs[i].last_us >= due);
+        CHECK(prev_run < due);                  // No corrió ya en la vuelta anterior
+        if (k > before) CHECK(deadline[order[k - 1]] <= deadline[i]);
+      }
+      prev_run = now_us;
+      uint32_t wait = sched_next_ms(&s);
+      uint64_t step = wait == SCHED_NEVER ? end - now_us : (uint64_t)wait * 1000;
+      // A veces la tarea despierta tarde (otras fuentes, CPU ocupada)
+      step += check_rand_below(4) == 0 ? check_rand_below(3000000) : 0;
+      if (step == 0) step = 1000;
+      now_us += step;
+    }
+    CHECK_EQ(order_n, SCHED_MAX_JOBS);
+    for (int i = 0; i < SCHED_MAX_JOBS; i++) CHECK_EQ(jobs[i].runs, 1);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+    double t0 = check_seconds();
+    test_periodic();
+    printf("sched: 7 h simuladas con un periódico de 5 s en %.2f s\n", check_seconds() - t0);
+    return check_done("sched bench");
+  }
+  test_periodic();
+  test_far_one_shot();
+  test_overrun();
+  test_runtime_and_self();
+  test_table_full();
+  test_random();
+  return check_done("sched");
+}
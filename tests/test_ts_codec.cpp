@@ -0,0 +1,231 @@
+// Pruebas de ts_codec: ida y vuelta exacta, llenado del bloque, CRC,
+// decodificación de bloques arbitrarios (no debe leer fuera ni desplazar de
+// más) y, con --bench, densidad y velocidad.
+
+#include "ts_codec.h"
+#include "check.h"
+#include <string.h>
+
+#define MAX_SAMPLES     1200
+
+typedef struct {
+  ts_sample_t s[MAX_SAMPLES];
+  int n;
+  int stop_at;                  // Corta la decodificación tras n muestras (0 = no)
+} collect_t;
+
+static bool collect(const ts_sample_t* s, void* ctx)
+{
+  collect_t* c = (collect_t*)ctx;
+  if (c->n < MAX_SAMPLES) c->s[c->n] = *s;
+  c->n++;
+  return !(c->stop_at && c->n >= c->stop_at);
+}
+
+static bool sample_eq(const ts_sample_t* a, const ts_sample_t* b)
+{
+  return a->t == b->t && memcmp(a->v, b->v, sizeof(a->v)) == 0;
+}
+
+// Lecturas realistas: cada ~60 s con jitter, derivas lentas y algún error del DHT
+static void realistic(ts_sample_t* s, uint32_t* t, int32_t* temp, int32_t* hum, int32_t* mv)
+{
+  *t += 60 + check_rand_below(3) - 1;
+  if (check_rand_below(10) == 0) *temp += (int32_t)check_rand_below(5) - 2;
+  if (check_rand_below(6) == 0) *hum += (int32_t)check_rand_below(7) - 3;
+  if (check_rand_below(40) == 0) *mv -= 1;
+  s->t = *t;
+  bool dht_error = check_rand_below(200) == 0;
+  s->v[0] = dht_error ? TS_VALUE_NONE : *temp;
+  s->v[1] = dht_error ? TS_VALUE_NONE : *hum;
+  s->v[2] = *mv;
+}
+
+// Cualquier cosa: saltos de tiempo grandes, repetidos y valores extremos
+static void wild(ts_sample_t* s, uint32_t* t)
+{
+  switch (check_rand_below(6)) {
+    case 0: break;
+    case 1: *t += check_rand_below(65); break;
+    case 2: *t += check_rand_below(5000); break;
+    case 3: *t += check_rand(); break;
+    default: *t += 60; break;
+  }
+  s->t = *t;
+  for (int i = 0; i < TS_SERIES; i++) {
+    switch (check_rand_below(5)) {
+      case 0: s->v[i] = (int32_t)check_rand(); break;
+      case 1: s->v[i] = INT32_MIN; break;
+      case 2: s->v[i] = INT32_MAX; break;
+      case 3: s->v[i] = -1; break;
+      default: s->v[i] = (int32_t)check_rand_below(3); break;
+    }
+  }
+}
+
+// Llena un bloque hasta que no quepan más muestras y verifica la ida y vuelta
+static int fill_and_check(bool realistic_data)
+{
+  static ts_encoder_t e;
+  static ts_sample_t in[MAX_SAMPLES];
+  ts_encoder_reset(&e);
+  uint32_t t = 1700000000u + check_rand_below(1000);
+  int32_t temp = 215, hum = 480, mv = 4100;
+  int n = 0;
+  while (n < MAX_SAMPLES) {
+    ts_sample_t s;
+    if (realistic_data) realistic(&s, &t, &temp, &hum, &mv);
+    else wild(&s, &t);
+    if (!ts_encoder_append(&e, &s)) break;
+    in[n++] = s;
+  }
+  CHECK(n > 0 && n < MAX_SAMPLES);
+  CHECK_EQ(ts_encoder_count(&e), n);
+
+  const ts_block_header_t* h = (const ts_block_header_t*)e.block;
+  CHECK(h->data_len <= TS_BLOCK_PAYLOAD);
+  CHECK_EQ(h->t_min, in[0].t);
+  CHECK_EQ(h->t_max, in[n - 1].t);
+
+  collect_t c;
+  memset(&c, 0, sizeof(c));
+  CHECK(ts_encoder_decode(&e, collect, &c));
+  CHECK_EQ(c.n, n);
+  for (int i = 0; i < n && i < c.n; i++) CHECK(sample_eq(&c.s[i], &in[i]));
+
+  ts_encoder_seal(&e);
+  CHECK(ts_block_valid(e.block));
+  memset(&c, 0, sizeof(c));
+  CHECK(ts_block_decode(e.block, collect, &c));
+  CHECK_EQ(c.n, n);
+  for (int i = 0; i < n && i < c.n; i++) CHECK(sample_eq(&c.s[i], &in[i]));
+  return n;
+}
+
+static void test_basics()
+{
+  ts_encoder_t e;
+  ts_encoder_reset(&e);
+  CHECK_EQ(ts_encoder_count(&e), 0);
+  CHECK(!ts_block_valid(e.block));              // Vacío: count = 0
+
+  ts_sample_t a = { 1000, { 215, 480, 4100 } };
+  ts_sample_t b = { 1060, { 215, 480, 4100 } };
+  ts_sample_t c3 = { 1120, { 215, 480, 4100 } };
+  ts_sample_t older = { 999, { 0, 0, 0 } };
+  CHECK(ts_encoder_append(&e, &a));
+  CHECK(ts_encoder_append(&e, &b));
+  CHECK(ts_encoder_append(&e, &c3));
+  // Primera muestra: 96 bits; dod 60 = '10' + 7; dod 0 = '0'; '0' por serie igual
+  const ts_block_header_t* h = (const ts_block_header_t*)e.block;
+  CHECK_EQ(h->data_len, (96 + (9 + 3) + (1 + 3) + 7) / 8);
+
+  CHECK(!ts_encoder_append(&e, &older));        // Fuera de orden
+  CHECK(ts_encoder_append(&e, &c3));            // Mismo instante: se admite
+  CHECK_EQ(ts_encoder_count(&e), 4);
+
+  // Cortar desde el callback
+  collect_t c;
+  memset(&c, 0, sizeof(c));
+  c.stop_at = 2;
+  CHECK(ts_encoder_decode(&e, collect, &c));
+  CHECK_EQ(c.n, 2);
+}
+
+static void test_crc()
+{
+  ts_encoder_t e;
+  ts_encoder_reset(&e);
+  uint32_t t = 5000;
+  int32_t temp = 200, hum = 500, mv = 4000;
+  for (int i = 0; i < 40; i++) {
+    ts_sample_t s;
+    realistic(&s, &t, &temp, &hum, &mv);
+    ts_encoder_append(&e, &s);
+  }
+  ts_encoder_seal(&e);
+  CHECK(ts_block_valid(e.block));
+  const ts_block_header_t* h = (const ts_block_header_t*)e.block;
+  collect_t c;
+  // Cualquier bit del flujo invalida el bloque
+  for (uint32_t bit = 0; bit < (uint32_t)h->data_len * 8; bit += 7) {
+    e.block[sizeof(ts_block_header_t) + bit / 8] ^= (uint8_t)(1u << (bit & 7));
+    CHECK(!ts_block_valid(e.block));
+    memset(&c, 0, sizeof(c));
+    CHECK(!ts_block_decode(e.block, collect, &c));
+    CHECK_EQ(c.n, 0);
+    e.block[sizeof(ts_block_header_t) + bit / 8] ^= (uint8_t)(1u << (bit & 7));
+  }
+  CHECK(ts_block_valid(e.block));
+}
+
+// Bloques abiertos arbitrarios (p. ej. RTC corrupta): el decodificador no
+// confía en el flujo. ASan/UBSan detectan lecturas fuera o desplazamientos >= 32.
+static void test_garbage()
+{
+  static ts_encoder_t e;
+  for (int round = 0; round < 20000; round++) {
+    ts_encoder_reset(&e);
+    for (size_t i = sizeof(ts_block_header_t); i < TS_BLOCK_SIZE; i++) e.block[i] = (uint8_t)check_rand();
+    ts_block_header_t* h = (ts_block_header_t*)e.block;
+    h->count = (uint16_t)check_rand_below(400);
+    h->data_len = (uint16_t)check_rand_below(TS_BLOCK_PAYLOAD + 40);
+    h->t_min = check_rand();
+    collect_t c;
+    memset(&c, 0, sizeof(c));
+    bool ok = ts_encoder_decode(&e, collect, &c);
+    if (h->data_len > TS_BLOCK_PAYLOAD) CHECK(!ok);
+    CHECK(c.n <= h->count);
+  }
+}
+
+static void bench()
+{
+  const int blocks = 20000;
+  static ts_encoder_t e;
+  static ts_sample_t in[MAX_SAMPLES];
+  uint32_t t = 1700000000u;
+  int32_t temp = 215, hum = 480, mv = 4100;
+  long samples = 0, bytes = 0;
+  double enc_s = 0, dec_s = 0;
+  for (int b = 0; b < blocks; b++) {
+    int n = 0;
+    for (; n < MAX_SAMPLES; n++) realistic(&in[n], &t, &temp, &hum, &mv);
+    double t0 = check_seconds();
+    ts_encoder_reset(&e);
+    for (n = 0; n < MAX_SAMPLES && ts_encoder_append(&e, &in[n]); n++) {}
+    ts_encoder_seal(&e);
+    double t1 = check_seconds();
+    collect_t c;
+    c.n = 0;
+    c.stop_at = 0;
+    ts_block_decode(e.block, collect, &c);
+    double t2 = check_seconds();
+    CHECK_EQ(c.n, n);
+    enc_s += t1 - t0;
+    dec_s += t2 - t1;
+    samples += n;
+    bytes += ((const ts_block_header_t*)e.block)->data_len;
+    t = in[n - 1].t;
+  }
+  printf("ts_codec: %ld muestras en %d bloques, %.2f B/muestra de flujo (%.2f con encabezado; %zu sin comprimir)\n",
+         samples, blocks, (double)bytes / samples, (double)blocks * TS_BLOCK_SIZE / samples, sizeof(ts_sample_t));
+  printf("ts_codec: codifica %.1f M muestras/s, decodifica %.1f M muestras/s\n",
+         samples / enc_s / 1e6, samples / dec_s / 1e6);
+}
+
+int main(int argc, char** argv)
+{
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+    bench();
+    return check_done("ts_codec bench");
+  }
+  test_basics();
+  test_crc();
+  long total = 0;
+  for (int i = 0; i < 2000; i++) total += fill_and_check(true);
+  for (int i = 0; i < 2000; i++) fill_and_check(false);
+  CHECK(total / 2000 > 100);                    // Lecturas reales: > 100 por bloque
+  test_garbage();
+  return check_done("ts_codec");
+}
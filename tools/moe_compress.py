@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Comprime imágenes de firmware (o parches .moed) para subirlas a /update.
+
+Uso:
+  moe_compress.py heatshrink in.bin out.hs [-w WINDOW_BITS] [-l LOOKAHEAD_BITS]
+  moe_compress.py gzip       in.bin out.gz
+  moe_compress.py unpack     in.hs  out.bin
+
+El dispositivo detecta el formato por los primeros bytes y descomprime en
+streaming hacia el actualizador:
+  - gzip (1F 8B): deflate estándar, ventana de 32 KB.
+  - heatshrink: contenedor "MOEH" | window_bits | lookahead_bits | 0 0 |
+    tamaño original (u32 LE) seguido del flujo heatshrink. La ventana del
+    decodificador es de 2^window_bits bytes (por defecto 1 KB).
+"""
+
+import gzip
+import struct
+import sys
+
+HS_MAGIC = b"MOEH"
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.n = 0
+
+    def put(self, value, bits):
+        for i in range(bits - 1, -1, -1):
+            self.acc = (self.acc << 1) | ((value >> i) & 1)
+            self.n += 1
+            if self.n == 8:
+                self.out.append(self.acc)
+                self.acc = 0
+                self.n = 0
+
+    def finish(self):
+        if self.n:
+            self.out.append(self.acc << (8 - self.n))
+        return bytes(self.out)
+
+
+def hs_encode(data, w, l):
+    window = 1 << w
+    max_len = 1 << l
+    # Una referencia cuesta 1+w+l bits; un literal 9 bits
+    min_len = (1 + w + l) // 9 + 1
+    chains = {}
+    bw = BitWriter()
+    i = 0
+    n = len(data)
+    while i < n:
+        best_len, best_dist = 0, 0
+        if i + 3 <= n:
+            key = data[i:i + 3]
+            cands = chains.get(key)
+            if cands:
+                limit = min(max_len, n - i)
+                for p in reversed(cands[-32:]):
+                    dist = i - p
+                    if dist > window:
+                        break
+                    k = 3
+                    while k < limit and data[p + k] == data[i + k]:
+                        k += 1
+                    if k > best_len:
+                        best_len, best_dist = k, dist
+                        if k == limit:
+                            break
+        step = best_len if best_len >= min_len else 1
+        if step > 1:
+            bw.put(0, 1)
+            bw.put(best_dist - 1, w)
+            bw.put(best_len - 1, l)
+        else:
+            bw.put(1, 1)
+            bw.put(data[i], 8)
+        for k in range(i, min(i + step, n - 2)):
+            chains.setdefault(data[k:k + 3], []).append(k)
+        i += step
+    return bw.finish()
+
+
+def hs_decode(stream, w, l, size):
+    """Implementación de referencia (misma lógica que heatshrink_dec.cpp)."""
+    out = bytearray()
+    bits = ((b >> (7 - k)) & 1 for b in stream for k in range(8))
+
+    def take(n):
+        v = 0
+        for _ in range(n):
+            v = (v << 1) | next(bits)
+        return v
+
+    while len(out) < size:
+        if take(1):
+            out.append(take(8))
+        else:
+            dist = take(w) + 1
+            count = take(l) + 1
+            if dist > len(out):
+                raise ValueError("referencia antes del inicio")
+            for _ in range(count):
+                out.append(out[-dist])
+    return bytes(out[:size])
+
+
+def main(argv):
+    if len(argv) < 4 or argv[1] not in ("heatshrink", "gzip", "unpack"):
+        print(__doc__)
+        return 1
+    w, l = 10, 5
+    args = argv[4:]
+    while args:
+        if args[0] == "-w":
+            w = int(args[1])
+        elif args[0] == "-l":
+            l = int(args[1])
+        args = args[2:]
+    with open(argv[2], "rb") as f:
+        data = f.read()
+
+    if argv[1] == "gzip":
+        out = gzip.compress(data, compresslevel=9, mtime=0)
+    elif argv[1] == "heatshrink":
+        if not (4 <= w <= 12 and 3 <= l < w):
+            raise SystemExit("parámetros heatshrink fuera de rango (4<=w<=12, 3<=l<w)")
+        stream = hs_encode(data, w, l)
+        out = HS_MAGIC + bytes([w, l, 0, 0]) + struct.pack("<I", len(data)) + stream
+        if hs_decode(stream, w, l, len(data)) != data:
+            raise SystemExit("error interno: la verificación de heatshrink falló")
+    else:
+        if data[:4] != HS_MAGIC:
+            raise SystemExit("no es un contenedor MOEH")
+        w, l = data[4], data[5]
+        (size,) = struct.unpack_from("<I", data, 8)
+        out = hs_decode(data[12:], w, l, size)
+
+    with open(argv[3], "wb") as f:
+        f.write(out)
+    print("%s: %d -> %d bytes (%.1f%%)" % (argv[1], len(data), len(out), 100.0 * len(out) / max(1, len(data))))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
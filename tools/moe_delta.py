@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+"""Genera y aplica parches delta (formato MOED) entre dos builds de firmware.
+
+Uso:
+  moe_delta.py diff  old.bin new.bin patch.moed
+  moe_delta.py apply old.bin patch.moed out.bin
+
+El parche se sube al mismo endpoint /update que una imagen completa; el
+dispositivo lo detecta por su magic, lo aplica desde la partición en ejecución
+hacia la partición OTA inactiva y verifica el SHA-256 del resultado.
+old.bin debe ser exactamente la imagen que corre en el dispositivo.
+Ver delta_patch.h para la descripción del formato.
+"""
+
+import hashlib
+import struct
+import sys
+
+MAGIC = b"MOED"
+VERSION = 1
+KEY_LEN = 8           # Bytes usados para indexar la imagen base
+INDEX_STRIDE = 4      # Posiciones indexadas en la base (cada 4 bytes)
+MIN_MATCH = 24        # Coincidencia exacta mínima para abrir una región diff
+MAX_CANDIDATES = 8    # Candidatos por clave a evaluar
+
+
+def varint(n):
+    out = bytearray()
+    while True:
+        b = n & 0x7F
+        n >>= 7
+        if n:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return bytes(out)
+
+
+def zigzag(n):
+    return (n << 1) ^ (n >> 31) if n >= 0 else ((-n) << 1) - 1
+
+
+def read_varint(buf, pos):
+    value = shift = 0
+    while True:
+        b = buf[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return value, pos
+
+
+def build_index(old):
+    index = {}
+    for i in range(0, len(old) - KEY_LEN + 1, INDEX_STRIDE):
+        lst = index.setdefault(old[i:i + KEY_LEN], [])
+        if len(lst) < MAX_CANDIDATES:
+            lst.append(i)
+    return index
+
+
+def exact_len(old, i, new, j):
+    n = 0
+    limit = min(len(old) - i, len(new) - j)
+    step = 64
+    while n < limit:
+        k = min(step, limit - n)
+        if old[i + n:i + n + k] == new[j + n:j + n + k]:
+            n += k
+        else:
+            while n < limit and old[i + n] == new[j + n]:
+                n += 1
+            break
+    return n
+
+
+def approx_extend(old, i, new, j, length):
+    """Extiende una coincidencia mientras la mayoría de bytes sigan coincidiendo
+    (código recompilado: referencias que cambian dentro de bloques iguales)."""
+    window = 16
+    while True:
+        a = i + length
+        b = j + length
+        k = min(window, len(old) - a, len(new) - b)
+        if k <= 0:
+            return length
+        same = sum(1 for t in range(k) if old[a + t] == new[b + t])
+        if same * 2 < k:
+            return length
+        length += k
+
+
+def find_match(index, old, new, j):
+    best_i, best_len = -1, 0
+    for i in index.get(new[j:j + KEY_LEN], ()):
+        n = exact_len(old, i, new, j)
+        if n > best_len:
+            best_i, best_len = i, n
+    return best_i, best_len
+
+
+def encode_diff(old, i, new, j, length):
+    out = bytearray()
+    k = 0
+    while k < length:
+        z = k
+        while z < length and old[i + z] == new[j + z]:
+            z += 1
+        # Un literal termina tras 4 bytes iguales seguidos (vuelven a ser zero_run)
+        e = last = z
+        while e < length and e - last < 4:
+            if old[i + e] != new[j + e]:
+                last = e + 1
+            e += 1
+        out += varint(z - k) + varint(last - z)
+        out += bytes((new[j + t] - old[i + t]) & 0xFF for t in range(z, last))
+        k = last
+    return bytes(out)
+
+
+def make_patch(old, new):
+    index = build_index(old)
+    segments = []   # (new_start, old_start, length)
+    j = 0
+    while j + KEY_LEN <= len(new):
+        i, n = find_match(index, old, new, j)
+        if n >= MIN_MATCH:
+            n = approx_extend(old, i, new, j, n)
+            segments.append((j, i, n))
+            j += n
+        else:
+            j += 1
+
+    out = bytearray()
+    out += MAGIC + bytes([VERSION, 0, 0, 0])
+    out += struct.pack("<II", len(old), len(new))
+    out += hashlib.sha256(old).digest() + hashlib.sha256(new).digest()
+
+    old_pos = 0
+    new_pos = 0
+    # Primer registro sin diff si el inicio no coincide con la base
+    if not segments or segments[0][0] > 0:
+        first_old = segments[0][1] if segments else 0
+        extra_end = segments[0][0] if segments else len(new)
+        out += varint(0) + varint(extra_end) + varint(zigzag(first_old))
+        out += new[0:extra_end]
+        old_pos = first_old
+        new_pos = extra_end
+
+    for k, (nj, oi, n) in enumerate(segments):
+        assert nj == new_pos and oi == old_pos
+        extra_end = segments[k + 1][0] if k + 1 < len(segments) else len(new)
+        next_old = segments[k + 1][1] if k + 1 < len(segments) else oi + n
+        out += varint(n) + varint(extra_end - (nj + n)) + varint(zigzag(next_old - (oi + n)))
+        out += encode_diff(old, oi, new, nj, n)
+        out += new[nj + n:extra_end]
+        old_pos = next_old
+        new_pos = extra_end
+    return bytes(out)
+
+
+def apply_patch(old, patch):
+    """Implementación de referencia (misma lógica que delta_patch.cpp)."""
+    if patch[:4] != MAGIC or patch[4] != VERSION:
+        raise ValueError("no es un parche MOED v1")
+    old_size, new_size = struct.unpack_from("<II", patch, 8)
+    if old_size != len(old) or hashlib.sha256(old).digest() != patch[16:48]:
+        raise ValueError("la imagen base no coincide con el parche")
+    pos = 80
+    old_pos = 0
+    new = bytearray()
+    while len(new) < new_size:
+        diff_len, pos = read_varint(patch, pos)
+        extra_len, pos = read_varint(patch, pos)
+        seek, pos = read_varint(patch, pos)
+        seek = (seek >> 1) ^ -(seek & 1)
+        left = diff_len
+        while left > 0:
+            z, pos = read_varint(patch, pos)
+            lit, pos = read_varint(patch, pos)
+            new += old[old_pos:old_pos + z]
+            old_pos += z
+            for t in range(lit):
+                new.append((old[old_pos + t] + patch[pos + t]) & 0xFF)
+            old_pos += lit
+            pos += lit
+            left -= z + lit
+        new += patch[pos:pos + extra_len]
+        pos += extra_len
+        old_pos += seek
+    if hashlib.sha256(new).digest() != patch[48:80]:
+        raise ValueError("sha256 de la imagen resultante no coincide")
+    return bytes(new)
+
+
+def main(argv):
+    if len(argv) != 5 or argv[1] not in ("diff", "apply"):
+        print(__doc__)
+        return 1
+    with open(argv[2], "rb") as f:
+        old = f.read()
+    with open(argv[3], "rb") as f:
+        data = f.read()
+    if argv[1] == "diff":
+        patch = make_patch(old, data)
+        apply_patch(old, patch)  # autoverificación
+        with open(argv[4], "wb") as f:
+            f.write(patch)
+        print("parche: %d bytes (imagen nueva %d bytes, %.1f%%)" % (len(patch), len(data), 100.0 * len(patch) / len(data)))
+    else:
+        new = apply_patch(old, data)
+        with open(argv[4], "wb") as f:
+            f.write(new)
+        print("imagen: %d bytes" % len(new))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
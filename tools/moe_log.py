@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""Decodifica el registro binario del dispositivo (moe_log) con el ELF del build.
+
+Uso:
+  moe_log.py firmware.elf log.bin [log.old ...] [--force]
+
+Los archivos se obtienen con GET /logs/raw (y /logs/raw?old=1). Cada registro
+guarda la dirección del literal de formato, que se busca en las secciones del
+ELF; por eso hace falta el ELF exacto de la imagen que generó el registro. El
+encabezado del archivo ("MLG1" + 8 bytes del SHA-256 del ELF) se compara con
+el ELF indicado; --force decodifica aunque no coincidan.
+
+Formato del registro (little endian):
+  u8 tamaño total | u8 nivel<<4 | nargs | u32 ms | u32 dirección del formato
+  argumentos: 'i' u32 | 'q' u64 | 'f' float32 | 'p' u32 | 's' u8 largo + bytes
+"""
+
+import hashlib
+import re
+import struct
+import sys
+
+FILE_MAGIC = b"MLG1"
+FILE_HEADER = 16
+RECORD_HEADER = 10
+LEVELS = "?EWID"
+SPEC_RE = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)([hlLqjzt]*)([a-zA-Z%])")
+
+
+class Elf:
+    """Lectura mínima de secciones ELF32/ELF64 (sin dependencias)."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        self.sha = hashlib.sha256(self.data).digest()
+        if self.data[:4] != b"\x7fELF":
+            raise ValueError("no es un archivo ELF")
+        is64 = self.data[4] == 2
+        endian = "<" if self.data[5] == 1 else ">"
+        if is64:
+            shoff, = struct.unpack_from(endian + "Q", self.data, 0x28)
+            shentsize, shnum = struct.unpack_from(endian + "HH", self.data, 0x3A)
+            fmt = endian + "IIQQQQ"
+        else:
+            shoff, = struct.unpack_from(endian + "I", self.data, 0x20)
+            shentsize, shnum = struct.unpack_from(endian + "HH", self.data, 0x2E)
+            fmt = endian + "IIIIII"
+        self.sections = []
+        for i in range(shnum):
+            _, sh_type, flags, addr, offset, size = struct.unpack_from(fmt, self.data, shoff + i * shentsize)
+            # SHF_ALLOC y con contenido en el archivo (no SHT_NOBITS)
+            if flags & 0x2 and sh_type != 8 and size:
+                self.sections.append((addr, offset, size))
+
+    def cstring(self, addr):
+        for base, offset, size in self.sections:
+            if base <= addr < base + size:
+                start = offset + addr - base
+                end = self.data.index(b"\0", start, offset + size)
+                return self.data[start:end].decode("utf-8", "replace")
+        return None
+
+
+def parse_args(rec, nargs):
+    args = []
+    p = RECORD_HEADER
+    for _ in range(nargs):
+        if p >= len(rec):
+            break
+        tag = chr(rec[p])
+        if tag in "ip":
+            args.append((tag, struct.unpack_from("<I", rec, p + 1)[0]))
+            p += 5
+        elif tag == "q":
+            args.append((tag, struct.unpack_from("<Q", rec, p + 1)[0]))
+            p += 9
+        elif tag == "f":
+            args.append((tag, struct.unpack_from("<f", rec, p + 1)[0]))
+            p += 5
+        elif tag == "s":
+            n = rec[p + 1]
+            args.append((tag, rec[p + 2:p + 2 + n].decode("utf-8", "replace")))
+            p += 2 + n
+        else:
+            break
+    return args
+
+
+def format_record(fmt, args):
+    """Igual que mlog_format(): el modificador de longitud lo decide el tipo guardado."""
+    it = iter(args)
+
+    def repl(m):
+        flags, _, conv = m.groups()
+        if conv == "%":
+            return "%"
+        arg = next(it, None)
+        if arg is None:
+            return "<?>"
+        tag, v = arg
+        if conv == "p" and tag in "ip":
+            return "0x%08x" % v
+        if tag in "ipq":
+            bits = 64 if tag == "q" else 32
+            if conv in "di":
+                if v >= 1 << (bits - 1):
+                    v -= 1 << bits
+                return ("%" + flags + "d") % v
+            if conv in "uxXo":
+                return ("%" + flags + conv) % v
+            if conv == "c" and tag != "q":
+                return ("%" + flags + "c") % chr(v & 0xFF)
+        elif tag == "f" and conv in "fFeEgG":
+            return ("%" + flags + conv) % v
+        elif tag == "s" and conv == "s":
+            return ("%" + flags + "s") % v
+        return "<?>"
+
+    return SPEC_RE.sub(repl, fmt).rstrip("\n")
+
+
+def decode_file(elf, path, force):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < FILE_HEADER or data[:4] != FILE_MAGIC:
+        sys.exit("%s: encabezado inválido" % path)
+    build = data[4:12]
+    if build != elf.sha[:8]:
+        msg = "%s: generado por otra imagen (%s, ELF %s)" % (path, build.hex(), elf.sha[:8].hex())
+        if not force:
+            sys.exit(msg + "; usar --force para decodificar igual")
+        print("# " + msg, file=sys.stderr)
+    p = FILE_HEADER
+    while p < len(data):
+        size = data[p]
+        if size < RECORD_HEADER or p + size > len(data):
+            print("# registro truncado en el byte %d" % p, file=sys.stderr)
+            break
+        rec = data[p:p + size]
+        p += size
+        level = rec[1] >> 4
+        nargs = rec[1] & 0x0F
+        ms, addr = struct.unpack_from("<II", rec, 2)
+        fmt = elf.cstring(addr)
+        if fmt is None:
+            text = "<formato 0x%08x no encontrado> %r" % (addr, [v for _, v in parse_args(rec, nargs)])
+        else:
+            text = format_record(fmt, parse_args(rec, nargs))
+        print("%10u %s %s" % (ms, LEVELS[level] if level < len(LEVELS) else "?", text))
+
+
+def main(argv):
+    force = "--force" in argv
+    argv = [a for a in argv if a != "--force"]
+    if len(argv) < 3:
+        sys.exit(__doc__)
+    elf = Elf(argv[1])
+    for path in argv[2:]:
+        decode_file(elf, path, force)
+
+
+if __name__ == "__main__":
+    main(sys.argv)
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Servidor de firmware para la actualización por descarga (pull).
+
+Uso:
+  ota_server.py manifest firmware.bin VERSION [DIR]
+  ota_server.py serve DIR [-p PUERTO] [--rate KBPS] [--drop-after BYTES]
+
+`manifest` copia la imagen a DIR (por defecto el directorio de la imagen) y
+escribe DIR/manifest.json:
+  {"version": "1.3.0", "size": 1234567, "sha256": "<hex>", "url": "firmware.bin"}
+
+`serve` sirve DIR por HTTP con soporte de peticiones Range (206 Partial
+Content), que es lo que usa el dispositivo para descargar por bloques. Para
+probar la reanudación:
+  --rate KBPS        limita la velocidad de cada respuesta
+  --drop-after N     corta la conexión tras enviar N bytes de una respuesta
+Apunte `ota_manifest_url` (config.cpp) a http://<host>:<puerto>/manifest.json.
+"""
+
+import hashlib
+import http.server
+import json
+import os
+import re
+import shutil
+import sys
+import time
+
+RANGE_RE = re.compile(r"bytes=(\d+)-(\d*)$")
+
+
+def write_manifest(image, version, out_dir):
+    os.makedirs(out_dir, exist_ok=True)
+    name = os.path.basename(image)
+    dest = os.path.join(out_dir, name)
+    if os.path.abspath(dest) != os.path.abspath(image):
+        shutil.copyfile(image, dest)
+    with open(dest, "rb") as f:
+        data = f.read()
+    manifest = {
+        "version": version,
+        "size": len(data),
+        "sha256": hashlib.sha256(data).hexdigest(),
+        "url": name,
+    }
+    with open(os.path.join(out_dir, "manifest.json"), "w") as f:
+        json.dump(manifest, f)
+    print("manifest.json: %s %d bytes sha256=%s" % (version, len(data), manifest["sha256"]))
+
+
+class RangeHandler(http.server.SimpleHTTPRequestHandler):
+    rate_kbps = 0
+    drop_after = 0
+
+    def send_head(self):
+        path = self.translate_path(self.path)
+        if os.path.isdir(path) or not os.path.exists(path):
+            return super().send_head()
+        size = os.path.getsize(path)
+        first, last = 0, size - 1
+        m = RANGE_RE.match(self.headers.get("Range", ""))
+        if m:
+            first = int(m.group(1))
+            if m.group(2):
+                last = min(int(m.group(2)), size - 1)
+            if first > last:
+                self.send_error(416, "Range Not Satisfiable")
+                return None
+            self.send_response(206)
+            self.send_header("Content-Range", "bytes %d-%d/%d" % (first, last, size))
+        else:
+            self.send_response(200)
+        self.send_header("Content-Type", self.guess_type(path))
+        self.send_header("Content-Length", str(last - first + 1))
+        self.send_header("Accept-Ranges", "bytes")
+        self.end_headers()
+        f = open(path, "rb")
+        f.seek(first)
+        self.remaining = last - first + 1
+        return f
+
+    def copyfile(self, source, outputfile):
+        sent = 0
+        block = 1024
+        while self.remaining > 0:
+            data = source.read(min(block, self.remaining))
+            if not data:
+                break
+            if self.drop_after and sent + len(data) > self.drop_after:
+                outputfile.write(data[: self.drop_after - sent])
+                self.log_message("conexion cortada tras %d bytes", self.drop_after)
+                self.close_connection = True
+                return
+            outputfile.write(data)
+            sent += len(data)
+            self.remaining -= len(data)
+            if self.rate_kbps:
+                time.sleep(len(data) / (self.rate_kbps * 1024.0))
+
+
+def serve(directory, args):
+    port = 8080
+    while args:
+        if args[0] == "-p":
+            port = int(args[1])
+        elif args[0] == "--rate":
+            RangeHandler.rate_kbps = float(args[1])
+        elif args[0] == "--drop-after":
+            RangeHandler.drop_after = int(args[1])
+        args = args[2:]
+    os.chdir(directory)
+    server = http.server.ThreadingHTTPServer(("", port), RangeHandler)
+    print("Sirviendo %s en el puerto %d" % (os.getcwd(), port))
+    server.serve_forever()
+
+
+def main(argv):
+    if len(argv) >= 4 and argv[1] == "manifest":
+        image = argv[2]
+        write_manifest(image, argv[3], argv[4] if len(argv) > 4 else os.path.dirname(image) or ".")
+        return 0
+    if len(argv) >= 3 and argv[1] == "serve":
+        serve(argv[2], argv[3:])
+        return 0
+    print(__doc__)
+    return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,238 @@
+#include "ts_codec.h"
+#include <string.h>
+
+#define TS_SAMPLE_MAX_BITS  (36 + TS_SERIES * 44)   // Peor caso: '1111'+32 y '11'+5+5+32 por serie
+
+static ts_block_header_t* ts_header(uint8_t* block)
+{
+  return (ts_block_header_t*)block;
+}
+
+// CRC32 (polinomio 0xEDB88320) con tabla de nibbles
+static uint32_t ts_crc32(const uint8_t* data, size_t len)
+{
+  static const uint32_t table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+// --- Escritura / lectura de bits (MSB primero) ---
+static void ts_put_bits(ts_encoder_t* e, uint32_t value, uint8_t bits)
+{
+  uint8_t* payload = e->block + sizeof(ts_block_header_t);
+  while (bits > 0) {
+    uint32_t byte = e->bit_pos >> 3;
+    uint8_t free_bits = 8 - (e->bit_pos & 7);
+    uint8_t n = bits < free_bits ? bits : free_bits;
+    uint8_t chunk = (uint8_t)((value >> (bits - n)) & ((1u << n) - 1));
+    payload[byte] |= (uint8_t)(chunk << (free_bits - n));
+    e->bit_pos += n;
+    bits -= n;
+  }
+}
+
+typedef struct {
+  const uint8_t* data;
+  uint32_t bit_pos;
+  uint32_t bit_len;
+} ts_reader_t;
+
+static bool ts_get_bits(ts_reader_t* r, uint8_t bits, uint32_t* out)
+{
+  if (r->bit_pos + bits > r->bit_len) return false;
+  uint32_t v = 0;
+  while (bits > 0) {
+    uint8_t avail = 8 - (r->bit_pos & 7);
+    uint8_t n = bits < avail ? bits : avail;
+    uint8_t byte = r->data[r->bit_pos >> 3];
+    v = (v << n) | ((byte >> (avail - n)) & ((1u << n) - 1));
+    r->bit_pos += n;
+    bits -= n;
+  }
+  *out = v;
+  return true;
+}
+
+static uint8_t ts_clz(uint32_t x) { return x ? (uint8_t)__builtin_clz(x) : 32; }
+static uint8_t ts_ctz(uint32_t x) { return x ? (uint8_t)__builtin_ctz(x) : 32; }
+
+void ts_encoder_reset(ts_encoder_t* e)
+{
+  memset(e, 0, sizeof(*e));
+  ts_header(e->block)->magic = TS_BLOCK_MAGIC;
+}
+
+uint16_t ts_encoder_count(const ts_encoder_t* e)
+{
+  return ((const ts_block_header_t*)e->block)->count;
+}
+
+static void ts_put_dod(ts_encoder_t* e, int32_t dod)
+{
+  if (dod == 0) {
+    ts_put_bits(e, 0, 1);
+  } else if (dod >= -63 && dod <= 64) {
+    ts_put_bits(e, 0x2, 2);
+    ts_put_bits(e, (uint32_t)(dod + 63), 7);
+  } else if (dod >= -255 && dod <= 256) {
+    ts_put_bits(e, 0x6, 3);
+    ts_put_bits(e, (uint32_t)(dod + 255), 9);
+  } else if (dod >= -2047 && dod <= 2048) {
+    ts_put_bits(e, 0xE, 4);
+    ts_put_bits(e, (uint32_t)(dod + 2047), 12);
+  } else {
+    ts_put_bits(e, 0xF, 4);
+    ts_put_bits(e, (uint32_t)dod, 32);
+  }
+}
+
+static void ts_put_value(ts_encoder_t* e, int s, int32_t v)
+{
+  uint32_t x = (uint32_t)v ^ (uint32_t)e->prev_v[s];
+  e->prev_v[s] = v;
+  if (x == 0) {
+    ts_put_bits(e, 0, 1);
+    return;
+  }
+  uint8_t lead = ts_clz(x);
+  uint8_t trail = ts_ctz(x);
+  if (lead > 31) lead = 31;
+  // Reutilizar la ventana anterior si los bits significativos caben en ella
+  if (e->len[s] > 0 && lead >= e->lead[s] && trail >= 32 - e->lead[s] - e->len[s]) {
+    uint8_t prev_trail = 32 - e->lead[s] - e->len[s];
+    ts_put_bits(e, 0x2, 2);
+    ts_put_bits(e, x >> prev_trail, e->len[s]);
+    return;
+  }
+  uint8_t len = 32 - lead - trail;
+  ts_put_bits(e, 0x3, 2);
+  ts_put_bits(e, lead, 5);
+  ts_put_bits(e, len - 1, 5);
+  ts_put_bits(e, x >> trail, len);
+  e->lead[s] = lead;
+  e->len[s] = len;
+}
+
+bool ts_encoder_append(ts_encoder_t* e, const ts_sample_t* s)
+{
+  ts_block_header_t* h = ts_header(e->block);
+  if (h->count > 0 && s->t < e->prev_t) return false;
+  if (e->bit_pos + TS_SAMPLE_MAX_BITS > TS_BLOCK_PAYLOAD * 8) return false;
+
+  if (h->count == 0) {
+    // Primera muestra: tiempo en el encabezado y valores completos
+    h->t_min = s->t;
+    for (int i = 0; i < TS_SERIES; i++) {
+      ts_put_bits(e, (uint32_t)s->v[i], 32);
+      e->prev_v[i] = s->v[i];
+    }
+  } else {
+    // Aritmética módulo 2^32: un salto de reloj enorme no desborda el int32
+    int32_t delta = (int32_t)(s->t - e->prev_t);
+    ts_put_dod(e, (int32_t)((uint32_t)delta - (uint32_t)e->prev_delta));
+    e->prev_delta = delta;
+    for (int i = 0; i < TS_SERIES; i++) ts_put_value(e, i, s->v[i]);
+  }
+  e->prev_t = s->t;
+  h->t_max = s->t;
+  h->count++;
+  h->data_len = (uint16_t)((e->bit_pos + 7) >> 3);
+  return true;
+}
+
+void ts_encoder_seal(ts_encoder_t* e)
+{
+  ts_block_header_t* h = ts_header(e->block);
+  h->crc = ts_crc32(e->block + sizeof(ts_block_header_t), h->data_len);
+}
+
+bool ts_block_valid(const uint8_t* block)
+{
+  const ts_block_header_t* h = (const ts_block_header_t*)block;
+  if (h->magic != TS_BLOCK_MAGIC || h->data_len > TS_BLOCK_PAYLOAD || h->count == 0) return false;
+  return ts_crc32(block + sizeof(ts_block_header_t), h->data_len) == h->crc;
+}
+
+static bool ts_get_dod(ts_reader_t* r, int32_t* dod)
+{
+  uint32_t bit, v;
+  uint8_t prefix = 0;
+  // Cantidad de unos antes del primer cero (máximo 4)
+  while (prefix < 4) {
+    if (!ts_get_bits(r, 1, &bit)) return false;
+    if (!bit) break;
+    prefix++;
+  }
+  switch (prefix) {
+    case 0: *dod = 0; return true;
+    case 1: if (!ts_get_bits(r, 7, &v)) return false; *dod = (int32_t)v - 63; return true;
+    case 2: if (!ts_get_bits(r, 9, &v)) return false; *dod = (int32_t)v - 255; return true;
+    case 3: if (!ts_get_bits(r, 12, &v)) return false; *dod = (int32_t)v - 2047; return true;
+    default: if (!ts_get_bits(r, 32, &v)) return false; *dod = (int32_t)v; return true;
+  }
+}
+
+// Decodifica un bloque (sellado o abierto) sin validar el CRC
+static bool ts_decode_payload(const uint8_t* block, ts_sample_fn fn, void* ctx)
+{
+  const ts_block_header_t* h = (const ts_block_header_t*)block;
+  if (h->magic != TS_BLOCK_MAGIC || h->data_len > TS_BLOCK_PAYLOAD) return false;
+  ts_reader_t r = { block + sizeof(ts_block_header_t), 0, (uint32_t)h->data_len * 8 };
+  ts_sample_t s;
+  int32_t delta = 0;
+  uint8_t lead[TS_SERIES] = { 0 }, len[TS_SERIES] = { 0 };
+  uint32_t v, ctrl;
+
+  for (uint16_t n = 0; n < h->count; n++) {
+    if (n == 0) {
+      s.t = h->t_min;
+      for (int i = 0; i < TS_SERIES; i++) {
+        if (!ts_get_bits(&r, 32, &v)) return false;
+        s.v[i] = (int32_t)v;
+      }
+    } else {
+      int32_t dod;
+      if (!ts_get_dod(&r, &dod)) return false;
+      delta = (int32_t)((uint32_t)delta + (uint32_t)dod);
+      s.t += (uint32_t)delta;
+      for (int i = 0; i < TS_SERIES; i++) {
+        if (!ts_get_bits(&r, 1, &ctrl)) return false;
+        if (!ctrl) continue;
+        if (!ts_get_bits(&r, 1, &ctrl)) return false;
+        if (ctrl) {
+          uint32_t l, m;
+          if (!ts_get_bits(&r, 5, &l) || !ts_get_bits(&r, 5, &m)) return false;
+          // Ventana fuera de los 32 bits: el bloque está corrupto
+          if (l + m + 1 > 32) return false;
+          lead[i] = (uint8_t)l;
+          len[i] = (uint8_t)(m + 1);
+        } else if (len[i] == 0) {
+          return false;
+        }
+        if (!ts_get_bits(&r, len[i], &v)) return false;
+        s.v[i] = (int32_t)((uint32_t)s.v[i] ^ (v << (32 - lead[i] - len[i])));
+      }
+    }
+    if (!fn(&s, ctx)) return true;
+  }
+  return true;
+}
+
+bool ts_block_decode(const uint8_t* block, ts_sample_fn fn, void* ctx)
+{
+  if (!ts_block_valid(block)) return false;
+  return ts_decode_payload(block, fn, ctx);
+}
+
+bool ts_encoder_decode(const ts_encoder_t* e, ts_sample_fn fn, void* ctx)
+{
+  return ts_decode_payload(e->block, fn, ctx);
+}
@@ -0,0 +1,72 @@
+#ifndef TS_CODEC_H
+#define TS_CODEC_H
+
+// Codec de series de tiempo estilo Gorilla para las lecturas del sensor.
+// Cada bloque de TS_BLOCK_SIZE bytes guarda un encabezado (rango de tiempo,
+// cantidad de muestras, CRC32) y un flujo de bits con:
+//   - marcas de tiempo: delta-of-delta con prefijos de longitud variable
+//     ('0' = mismo intervalo, '10' + 7 bits, '110' + 9, '1110' + 12, '1111' + 32);
+//   - valores en punto fijo (int32): XOR con el valor anterior ('0' = igual,
+//     '10' = bits significativos dentro de la ventana anterior, '11' + 5 bits
+//     de ceros iniciales + 5 bits de longitud-1 + bits significativos).
+// No depende de Arduino; el tamaño del bloque es múltiplo de la página de flash.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TS_BLOCK_SIZE       512         // Dos páginas de 256 bytes
+#define TS_SERIES           3           // temperatura x10, humedad x10, batería (mV)
+#define TS_BLOCK_MAGIC      0x3153544DUL    // "MTS1"
+#define TS_VALUE_NONE       INT32_MIN   // Lectura inválida (p. ej. error del DHT)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t t_min;
+  uint32_t t_max;
+  uint16_t count;
+  uint16_t data_len;            // Bytes usados del flujo de bits
+  uint32_t crc;                 // CRC32 del flujo de bits
+} ts_block_header_t;
+
+#define TS_BLOCK_PAYLOAD    (TS_BLOCK_SIZE - sizeof(ts_block_header_t))
+
+typedef struct {
+  uint32_t t;
+  int32_t v[TS_SERIES];
+} ts_sample_t;
+
+// Estado del codificador del bloque abierto. Es POD: puede vivir en memoria RTC.
+typedef struct {
+  uint8_t block[TS_BLOCK_SIZE]; // Encabezado + flujo de bits
+  uint32_t bit_pos;
+  uint32_t prev_t;
+  int32_t prev_delta;
+  int32_t prev_v[TS_SERIES];
+  uint8_t lead[TS_SERIES];      // Ventana del último XOR por serie
+  uint8_t len[TS_SERIES];
+} ts_encoder_t;
+
+typedef bool (*ts_sample_fn)(const ts_sample_t* s, void* ctx);
+
+void ts_encoder_reset(ts_encoder_t* e);
+
+// Agrega una muestra. Retorna false si el bloque está lleno (sellar y reiniciar)
+// o si t es anterior a la última muestra.
+bool ts_encoder_append(ts_encoder_t* e, const ts_sample_t* s);
+
+uint16_t ts_encoder_count(const ts_encoder_t* e);
+
+// Completa el encabezado (CRC incluido); e->block queda listo para escribirse
+void ts_encoder_seal(ts_encoder_t* e);
+
+// Valida magic y CRC de un bloque sellado
+bool ts_block_valid(const uint8_t* block);
+
+// Decodifica todas las muestras de un bloque. fn puede retornar false para cortar.
+// Retorna false si el bloque es inválido.
+bool ts_block_decode(const uint8_t* block, ts_sample_fn fn, void* ctx);
+
+// Decodifica el bloque abierto (sin CRC todavía)
+bool ts_encoder_decode(const ts_encoder_t* e, ts_sample_fn fn, void* ctx);
+
+#endif
@@ -0,0 +1,173 @@
+#include "ts_store.h"
+#include "moe_log.h"
+#include <LittleFS.h>
+#include "freertos/semphr.h"
+
+#define TS_DIR              "/ts"
+#define TS_FILE             "/ts/data.bin"
+#define TS_OLD_FILE         "/ts/data.old"
+#define TS_RTC_MAGIC        0x54534D52UL        // "RMST"
+#define TS_MIN_EPOCH        1600000000UL
+#define TS_APPEND_WAIT_MS   50                  // Si hay una consulta en curso, se omite la muestra
+
+typedef struct {
+  uint32_t magic;
+  ts_encoder_t enc;
+  uint32_t samples;
+  uint32_t blocks;
+  uint32_t sealed_samples;
+} ts_rtc_t;
+
+// Bloque abierto y contadores: persisten en deep sleep
+RTC_DATA_ATTR static ts_rtc_t ts_rtc;
+
+static SemaphoreHandle_t ts_mutex = NULL;
+static bool ts_fs_ok = false;
+
+void ts_store_begin()
+{
+  if (ts_mutex) return;
+  ts_mutex = xSemaphoreCreateMutex();
+  if (ts_rtc.magic != TS_RTC_MAGIC) {
+    memset(&ts_rtc, 0, sizeof(ts_rtc));
+    ts_rtc.magic = TS_RTC_MAGIC;
+    ts_encoder_reset(&ts_rtc.enc);
+  }
+  ts_fs_ok = LittleFS.begin();
+  if (ts_fs_ok && !LittleFS.exists(TS_DIR)) LittleFS.mkdir(TS_DIR);
+}
+
+static int32_t ts_fixed(float v, float scale)
+{
+  return isnan(v) ? TS_VALUE_NONE : (int32_t)lroundf(v * scale);
+}
+
+// Escribe el bloque sellado al final del archivo y rota si excede el tamaño
+static void ts_store_write_block()
+{
+  ts_encoder_seal(&ts_rtc.enc);
+  if (!ts_fs_ok) return;
+  File f = LittleFS.open(TS_FILE, "a");
+  if (!f) return;
+  bool ok = f.write(ts_rtc.enc.block, TS_BLOCK_SIZE) == TS_BLOCK_SIZE;
+  size_t size = f.size();
+  f.close();
+  if (!ok) {
+    MLOGE("[TSDB] ERROR escribiendo bloque");
+    return;
+  }
+  ts_rtc.blocks++;
+  ts_rtc.sealed_samples += ts_encoder_count(&ts_rtc.enc);
+  if (size >= TS_MAX_FILE_BYTES) {
+    LittleFS.remove(TS_OLD_FILE);
+    LittleFS.rename(TS_FILE, TS_OLD_FILE);
+    MLOGI("[TSDB] Archivo rotado");
+  }
+}
+
+void ts_store_append(time_t t, float temp_c, float humidity_pct, int battery_mv)
+{
+  if (!ts_mutex || t < (time_t)TS_MIN_EPOCH) return;
+  if (ts_encoder_count(&ts_rtc.enc) > 0 && (uint32_t)t < ts_rtc.enc.prev_t + TS_MIN_INTERVAL_S) return;
+  if (xSemaphoreTake(ts_mutex, pdMS_TO_TICKS(TS_APPEND_WAIT_MS)) != pdTRUE) return;
+
+  ts_sample_t s;
+  s.t = (uint32_t)t;
+  s.v[0] = ts_fixed(temp_c, 10);
+  s.v[1] = ts_fixed(humidity_pct, 10);
+  s.v[2] = battery_mv > 0 ? battery_mv : TS_VALUE_NONE;
+
+  if (!ts_encoder_append(&ts_rtc.enc, &s) && ts_encoder_count(&ts_rtc.enc) > 0) {
+    // Bloque lleno: sellar, escribir y empezar uno nuevo con esta muestra
+    ts_store_write_block();
+    ts_encoder_reset(&ts_rtc.enc);
+    ts_encoder_append(&ts_rtc.enc, &s);
+  }
+  ts_rtc.samples++;
+  xSemaphoreGive(ts_mutex);
+}
+
+typedef struct {
+  uint32_t from;
+  uint32_t to;
+  ts_sample_fn fn;
+  void* ctx;
+  size_t emitted;
+  bool stop;
+} ts_scan_t;
+
+static bool ts_scan_filter(const ts_sample_t* s, void* ctx)
+{
+  ts_scan_t* sc = (ts_scan_t*)ctx;
+  if (s->t > sc->to) return false;
+  if (s->t < sc->from) return true;
+  sc->emitted++;
+  if (!sc->fn(s, sc->ctx)) {
+    sc->stop = true;
+    return false;
+  }
+  return true;
+}
+
+static void ts_scan_file(const char* path, ts_scan_t* sc, uint8_t* block)
+{
+  if (!LittleFS.exists(path)) return;
+  File f = LittleFS.open(path, "r");
+  if (!f) return;
+  ts_block_header_t h;
+  size_t pos = 0;
+  while (!sc->stop && f.read((uint8_t*)&h, sizeof(h)) == sizeof(h))
+  {
+    // Sólo se lee el bloque completo si su rango de tiempo se solapa con la consulta
+    if (h.magic == TS_BLOCK_MAGIC && h.t_max >= sc->from && h.t_min <= sc->to) {
+      memcpy(block, &h, sizeof(h));
+      if (f.read(block + sizeof(h), TS_BLOCK_PAYLOAD) != TS_BLOCK_PAYLOAD) break;
+      ts_block_decode(block, ts_scan_filter, sc);
+    }
+    if (h.magic == TS_BLOCK_MAGIC && h.t_min > sc->to) break;
+    pos += TS_BLOCK_SIZE;
+    f.seek(pos);
+  }
+  f.close();
+}
+
+size_t ts_store_scan(uint32_t from, uint32_t to, ts_sample_fn fn, void* ctx)
+{
+  if (!ts_mutex || from > to) return 0;
+  ts_scan_t sc = { from, to, fn, ctx, 0, false };
+  uint8_t* block = (uint8_t*)malloc(TS_BLOCK_SIZE);
+  if (!block) return 0;
+
+  // El mutex evita una rotación durante el recorrido; las muestras que lleguen
+  // mientras tanto se omiten (ver TS_APPEND_WAIT_MS)
+  xSemaphoreTake(ts_mutex, portMAX_DELAY);
+  if (ts_fs_ok) {
+    ts_scan_file(TS_OLD_FILE, &sc, block);
+    ts_scan_file(TS_FILE, &sc, block);
+  }
+  if (!sc.stop && ts_encoder_count(&ts_rtc.enc) > 0) ts_encoder_decode(&ts_rtc.enc, ts_scan_filter, &sc);
+  xSemaphoreGive(ts_mutex);
+
+  free(block);
+  return sc.emitted;
+}
+
+static uint32_t ts_file_size(const char* path)
+{
+  if (!LittleFS.exists(path)) return 0;
+  File f = LittleFS.open(path, "r");
+  if (!f) return 0;
+  uint32_t size = f.size();
+  f.close();
+  return size;
+}
+
+void ts_store_get_stats(ts_store_stats_t* out)
+{
+  out->samples = ts_rtc.samples;
+  out->blocks = ts_rtc.blocks;
+  out->sealed_samples = ts_rtc.sealed_samples;
+  out->open_count = ts_encoder_count(&ts_rtc.enc);
+  out->flash_bytes = 0;
+  if (ts_fs_ok) out->flash_bytes = ts_file_size(TS_OLD_FILE) + ts_file_size(TS_FILE);
+}
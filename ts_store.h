@@ -0,0 +1,36 @@
+#ifndef TS_STORE_H
+#define TS_STORE_H
+
+#include <Arduino.h>
+#include "ts_codec.h"
+
+// Almacenamiento de largo plazo de las lecturas (temperatura, humedad, batería)
+// con el codec de ts_codec. Los bloques sellados se agregan al final de
+// /ts/data.bin (sólo append, de a TS_BLOCK_SIZE bytes); al superar
+// TS_MAX_FILE_BYTES el archivo rota a /ts/data.old. El bloque abierto vive en
+// memoria RTC: un despertar no escribe flash hasta que el bloque se llena.
+
+#define TS_MAX_FILE_BYTES   (256UL * 1024UL)    // ~2 años a 10 min entre los dos archivos
+#define TS_MIN_INTERVAL_S   60                  // En modo continuo se guarda a lo sumo 1 muestra/min
+
+typedef struct {
+  uint32_t samples;             // Muestras agregadas (desde el último arranque en frío)
+  uint32_t blocks;              // Bloques sellados y escritos
+  uint32_t sealed_samples;      // Muestras dentro de esos bloques
+  uint32_t flash_bytes;         // Tamaño de los archivos de datos
+  uint16_t open_count;          // Muestras en el bloque abierto
+} ts_store_stats_t;
+
+void ts_store_begin();
+
+// Agrega una lectura (NAN = sin dato). Ignora lecturas sin hora válida o más
+// próximas que TS_MIN_INTERVAL_S a la anterior.
+void ts_store_append(time_t t, float temp_c, float humidity_pct, int battery_mv);
+
+// Recorre las muestras en [from, to] en orden. Los bloques fuera de rango se
+// saltan leyendo sólo su encabezado. fn puede retornar false para cortar.
+size_t ts_store_scan(uint32_t from, uint32_t to, ts_sample_fn fn, void* ctx);
+
+void ts_store_get_stats(ts_store_stats_t* out);
+
+#endif
@@ -0,0 +1,134 @@
+#include "wake_stats.h"
+#include "moe_log.h"
+#include "esp_timer.h"
+
+typedef struct {
+  wake_bucket_t b[WAKE_PROFILE_COUNT][WAKE_KIND_COUNT];
+  uint16_t since_decay;
+} wake_stats_rtc_t;
+
+// Persistente en deep sleep (se pone a cero en el arranque en frío)
+RTC_DATA_ATTR static wake_stats_rtc_t wake_rtc;
+
+// Despertar en curso (tiempos en µs desde el arranque, esp_timer)
+static bool wake_active = false;
+static uint8_t wake_kind;
+static uint8_t wake_profile;
+static int64_t wifi_since = -1;
+static int64_t oled_since = -1;
+static int64_t wifi_us = 0;
+static int64_t oled_us = 0;
+
+static void wake_decay()
+{
+  for (int p = 0; p < WAKE_PROFILE_COUNT; p++) {
+    for (int k = 0; k < WAKE_KIND_COUNT; k++) {
+      wake_bucket_t &b = wake_rtc.b[p][k];
+      b.wakes >>= 1;
+      b.awake_ms >>= 1;
+      b.wifi_ms >>= 1;
+      b.oled_ms >>= 1;
+      b.charge_uah >>= 1;
+    }
+  }
+  wake_rtc.since_decay = 0;
+}
+
+void wake_stats_begin(esp_sleep_wakeup_cause_t cause, bool headless)
+{
+  switch (cause) {
+    case ESP_SLEEP_WAKEUP_TIMER: wake_kind = WAKE_KIND_TIMER; break;
+    case ESP_SLEEP_WAKEUP_EXT0:  wake_kind = WAKE_KIND_DOOR; break;
+    case ESP_SLEEP_WAKEUP_EXT1:  wake_kind = WAKE_KIND_BUTTON; break;
+    default: wake_active = false; return;
+  }
+  wake_profile = headless ? WAKE_PROFILE_HEADLESS : WAKE_PROFILE_DISPLAY;
+  wake_active = true;
+}
+
+// Acumula el intervalo abierto (si lo hay) y lo cierra o abre según on
+static void wake_track(bool on, int64_t* since, int64_t* total)
+{
+  int64_t now = esp_timer_get_time();
+  if (*since >= 0) *total += now - *since;
+  *since = on ? now : -1;
+}
+
+void wake_stats_wifi(bool on)
+{
+  wake_track(on, &wifi_since, &wifi_us);
+}
+
+void wake_stats_oled(bool on)
+{
+  wake_track(on, &oled_since, &oled_us);
+}
+
+void wake_stats_end()
+{
+  wake_stats_wifi(false);
+  wake_stats_oled(false);
+  if (!wake_active) return;
+  wake_active = false;
+
+  uint32_t awake = (uint32_t)(esp_timer_get_time() / 1000);
+  uint32_t wifi = (uint32_t)(wifi_us / 1000);
+  uint32_t oled = (uint32_t)(oled_us / 1000);
+  // mA·ms -> µAh: / 3600
+  uint64_t mams = (uint64_t)awake * WAKE_I_BASE_MA + (uint64_t)wifi * WAKE_I_WIFI_MA + (uint64_t)oled * WAKE_I_OLED_MA;
+  uint32_t uah = (uint32_t)((mams + 1800) / 3600);
+
+  if (wake_rtc.since_decay >= WAKE_STATS_DECAY_EVERY) wake_decay();
+  wake_bucket_t &b = wake_rtc.b[wake_profile][wake_kind];
+  b.wakes++;
+  b.awake_ms += awake;
+  b.wifi_ms += wifi;
+  b.oled_ms += oled;
+  b.charge_uah += uah;
+  wake_rtc.since_decay++;
+
+  static const char* const kinds[WAKE_KIND_COUNT] = { "timer", "puerta", "boton" };
+  MLOGI("[WAKE] %s %s: despierto %u ms, WiFi %u ms, pantalla %u ms, ~%u uAh",
+        kinds[wake_kind], wake_profile == WAKE_PROFILE_HEADLESS ? "sin pantalla" : "con pantalla",
+        (unsigned)awake, (unsigned)wifi, (unsigned)oled, (unsigned)uah);
+  int32_t saving;
+  if (wake_stats_saving_ms((wake_kind_t)wake_kind, &saving)) {
+    MLOGI("[WAKE] %s: sin pantalla %d ms menos por despertar (medias de %u y %u despertares)", kinds[wake_kind], (int)saving,
+          wake_rtc.b[WAKE_PROFILE_HEADLESS][wake_kind].wakes, wake_rtc.b[WAKE_PROFILE_DISPLAY][wake_kind].wakes);
+  }
+}
+
+void wake_stats_get(wake_profile_t profile, wake_kind_t kind, wake_bucket_t* out)
+{
+  *out = wake_rtc.b[profile][kind];
+}
+
+bool wake_stats_saving_ms(wake_kind_t kind, int32_t* out)
+{
+  const wake_bucket_t &h = wake_rtc.b[WAKE_PROFILE_HEADLESS][kind];
+  const wake_bucket_t &d = wake_rtc.b[WAKE_PROFILE_DISPLAY][kind];
+  if (!h.wakes || !d.wakes) return false;
+  *out = (int32_t)(d.awake_ms / d.wakes) - (int32_t)(h.awake_ms / h.wakes);
+  return true;
+}
+
+void wake_stats_summary(JsonObject out)
+{
+  static const char* const names[WAKE_PROFILE_COUNT] = { "headless", "display" };
+  for (int p = 0; p < WAKE_PROFILE_COUNT; p++) {
+    JsonArray arr = out.createNestedArray(names[p]);
+    for (int k = 0; k < WAKE_KIND_COUNT; k++) {
+      const wake_bucket_t &b = wake_rtc.b[p][k];
+      JsonArray row = arr.createNestedArray();
+      row.add(b.wakes);
+      row.add(b.wakes ? b.awake_ms / b.wakes : 0);
+      row.add(b.wakes ? b.charge_uah / b.wakes : 0);
+    }
+  }
+  JsonArray save = out.createNestedArray("save_ms");
+  for (int k = 0; k < WAKE_KIND_COUNT; k++) {
+    int32_t saving;
+    if (wake_stats_saving_ms((wake_kind_t)k, &saving)) save.add(saving);
+    else save.add(nullptr);
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef WAKE_STATS_H
+#define WAKE_STATS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_sleep.h>
+
+// Perfilador de despertares del modo normal. Mide cuánto tiempo está despierto
+// el equipo en cada despertar (desde el arranque de la aplicación hasta
+// esp_deep_sleep_start), cuánto de ese tiempo tuvo WiFi y pantalla (Vext)
+// encendidos, y estima la carga consumida con corrientes de referencia. Los
+// acumulados viven en memoria RTC separados por perfil (sin pantalla / con
+// pantalla) y por causa, para comparar ambos perfiles con la misma mezcla de
+// despertares. Se reducen a la mitad cada WAKE_STATS_DECAY_EVERY despertares.
+
+// Corrientes de referencia (mA) para la estimación
+#define WAKE_I_BASE_MA          40      // CPU activa con WiFi apagado
+#define WAKE_I_WIFI_MA          60      // Adicional con WiFi encendido
+#define WAKE_I_OLED_MA          10      // Adicional con la pantalla encendida
+
+#define WAKE_STATS_DECAY_EVERY  64
+
+typedef enum {
+  WAKE_KIND_TIMER = 0,
+  WAKE_KIND_DOOR,               // EXT0 (sensor de puerta)
+  WAKE_KIND_BUTTON,             // EXT1 (botón PRG)
+  WAKE_KIND_COUNT
+} wake_kind_t;
+
+typedef enum {
+  WAKE_PROFILE_HEADLESS = 0,
+  WAKE_PROFILE_DISPLAY,
+  WAKE_PROFILE_COUNT
+} wake_profile_t;
+
+typedef struct {
+  uint16_t wakes;
+  uint32_t awake_ms;            // Sumas (se dividen por wakes para el promedio)
+  uint32_t wifi_ms;
+  uint32_t oled_ms;
+  uint32_t charge_uah;
+} wake_bucket_t;
+
+// Inicio del despertar. Sólo se mide si es un despertar de deep sleep
+// (timer, EXT0 o EXT1); en arranque en frío no se acumula nada.
+void wake_stats_begin(esp_sleep_wakeup_cause_t cause, bool headless);
+
+// Cambios de WiFi y de Vext durante el despertar
+void wake_stats_wifi(bool on);
+void wake_stats_oled(bool on);
+
+// Cierra el despertar justo antes de esp_deep_sleep_start y lo acumula
+void wake_stats_end();
+
+void wake_stats_get(wake_profile_t profile, wake_kind_t kind, wake_bucket_t* out);
+
+// Diferencia medida del tiempo despierto medio con pantalla menos sin pantalla
+// para una causa. false si falta alguno de los dos perfiles.
+bool wake_stats_saving_ms(wake_kind_t kind, int32_t* out);
+
+// Añade al payload los promedios por perfil y causa y el ahorro medido:
+//   "wake":{"headless":[[n,ms,uAh],..],"display":[[n,ms,uAh],..],"save_ms":[..]}
+// (timer, puerta, botón; save_ms es null si falta alguno de los perfiles)
+void wake_stats_summary(JsonObject out);
+
+#endif
@@ -0,0 +1,167 @@
+#include "wifi_link.h"
+#include "moe_log.h"
+#include <WiFi.h>
+#include "esp_wifi.h"
+
+typedef struct {
+  link_state_t state;
+  link_stats_t stats;
+} wifi_link_rtc_t;
+
+// Persistente en deep sleep (se pone a cero en el arranque en frío)
+RTC_DATA_ATTR static wifi_link_rtc_t link_rtc;
+RTC_DATA_ATTR static bool link_rtc_ready = false;
+
+static link_settings_t link_applied;
+static uint8_t link_phase_now = LINK_PHASE_IDLE;
+static uint8_t link_tier_used = LINK_TIER_UNKNOWN;
+static bool link_hold = false;
+static bool link_11b_off = false;       // Estado del driver desde que se encendió
+static portMUX_TYPE link_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void wifi_link_ready()
+{
+  if (link_rtc_ready) return;
+  memset(&link_rtc, 0, sizeof(link_rtc));
+  link_state_init(&link_rtc.state);
+  link_rtc_ready = true;
+}
+
+static wifi_ps_type_t wifi_link_ps_type(uint8_t ps)
+{
+  switch (ps) {
+    case LINK_PS_MIN: return WIFI_PS_MIN_MODEM;
+    case LINK_PS_MAX: return WIFI_PS_MAX_MODEM;
+    default: return WIFI_PS_NONE;
+  }
+}
+
+void wifi_link_phase(link_phase_t phase)
+{
+  wifi_link_ready();
+  wifi_mode_t mode = WiFi.getMode();
+  if (mode == WIFI_MODE_NULL) return;
+  taskENTER_CRITICAL(&link_mux);
+  uint8_t prev = link_rtc.state.tier;
+  uint8_t tier = link_tier(&link_rtc.state);
+  taskEXIT_CRITICAL(&link_mux);
+  link_settings_t s;
+  link_settings(MOE_LINK_POLICY, tier, phase, &s);
+
+  // Las tasas 11b se fijan al arrancar la interfaz: sólo antes de asociar y sin AP
+  if (phase == LINK_PHASE_ASSOC && s.no_11b != link_11b_off && mode == WIFI_MODE_STA &&
+      WiFi.status() != WL_CONNECTED) {
+    esp_wifi_stop();
+    if (esp_wifi_config_11b_rate(WIFI_IF_STA, s.no_11b) == ESP_OK) link_11b_off = s.no_11b;
+    esp_wifi_start();
+    link_applied.tx_qdbm = 0;
+  }
+  s.no_11b = link_11b_off;
+  if (s.tx_qdbm && s.tx_qdbm != link_applied.tx_qdbm) esp_wifi_set_max_tx_power((int8_t)s.tx_qdbm);
+  else if (!s.tx_qdbm) s.tx_qdbm = link_applied.tx_qdbm;
+  // El AP no admite ahorro: el portal retiene la radio despierta
+  if (link_hold) s.ps = LINK_PS_NONE;
+  WiFi.setSleep(wifi_link_ps_type(s.ps));
+
+  link_applied = s;
+  link_phase_now = phase;
+  link_tier_used = tier;
+  if (tier != prev) {
+    MLOGI("[LINK] Nivel %u -> %u (RSSI %d dBm, fallos %u): tx %u/4 dBm, ahorro %u, sin 11b %d",
+          prev, tier, link_rtc.state.rssi, link_rtc.state.fail_score, s.tx_qdbm, s.ps, s.no_11b ? 1 : 0);
+  }
+}
+
+void wifi_link_hold_awake(bool hold)
+{
+  link_hold = hold;
+  if (hold) {
+    WiFi.setSleep(WIFI_PS_NONE);
+    link_applied.ps = LINK_PS_NONE;
+  } else {
+    wifi_link_phase(LINK_PHASE_IDLE);
+  }
+}
+
+void wifi_link_update()
+{
+  if (WiFi.status() != WL_CONNECTED) return;
+  wifi_link_ready();
+  taskENTER_CRITICAL(&link_mux);
+  link_observe_rssi(&link_rtc.state, (int8_t)WiFi.RSSI());
+  uint8_t prev = link_rtc.state.tier;
+  // link_tier se vuelve a evaluar en wifi_link_phase; aquí sólo se mira si cambia
+  link_state_t probe = link_rtc.state;
+  bool changed = link_tier(&probe) != prev;
+  taskEXIT_CRITICAL(&link_mux);
+  if (changed && link_phase_now == LINK_PHASE_IDLE) wifi_link_phase(LINK_PHASE_IDLE);
+}
+
+static void wifi_link_result(link_phase_t phase, bool ok, uint32_t ms)
+{
+  wifi_link_ready();
+  int8_t rssi = ok && WiFi.status() == WL_CONNECTED ? (int8_t)WiFi.RSSI() : 0;
+  taskENTER_CRITICAL(&link_mux);
+  if (rssi) link_observe_rssi(&link_rtc.state, rssi);
+  link_observe_result(&link_rtc.state, ok);
+  link_stats_record(&link_rtc.stats, phase, link_tier_used, ok, ms);
+  taskEXIT_CRITICAL(&link_mux);
+}
+
+void wifi_link_assoc_result(bool ok, uint32_t ms)
+{
+  wifi_link_result(LINK_PHASE_ASSOC, ok, ms);
+}
+
+void wifi_link_send_result(bool ok, uint32_t ms)
+{
+  wifi_link_result(LINK_PHASE_SEND, ok, ms);
+}
+
+void wifi_link_radio_off()
+{
+  link_11b_off = false;
+  memset(&link_applied, 0, sizeof(link_applied));
+}
+
+void wifi_link_get(wifi_link_info_t* out)
+{
+  wifi_link_ready();
+  out->policy = MOE_LINK_POLICY;
+  out->phase = link_phase_now;
+  out->applied = link_applied;
+  out->hold = link_hold;
+  taskENTER_CRITICAL(&link_mux);
+  out->state = link_rtc.state;
+  out->stats = link_rtc.stats;
+  taskEXIT_CRITICAL(&link_mux);
+}
+
+void wifi_link_summary(JsonObject out)
+{
+  wifi_link_info_t l;
+  wifi_link_get(&l);
+  out["pol"] = l.policy;
+  out["tier"] = l.state.tier;
+  out["rssi"] = l.state.rssi;
+  out["fail"] = l.state.fail_score;
+  out["tx"] = l.applied.tx_qdbm;
+  out["ps"] = l.applied.ps;
+  out["b11"] = l.applied.no_11b ? 0 : 1;
+  JsonArray sn = out.createNestedArray("sn");
+  JsonArray sf = out.createNestedArray("sf");
+  JsonArray sms = out.createNestedArray("sms");
+  JsonArray an = out.createNestedArray("an");
+  JsonArray af = out.createNestedArray("af");
+  JsonArray ams = out.createNestedArray("ams");
+  for (uint8_t t = 0; t < LINK_TIER_COUNT; t++) {
+    const link_count_t &s = l.stats.send[t];
+    const link_count_t &a = l.stats.assoc[t];
+    sn.add(s.n);
+    sf.add(s.fail);
+    sms.add(s.n ? s.ms / s.n : 0);
+    an.add(a.n);
+    af.add(a.fail);
+    ams.add(a.n ? a.ms / a.n : 0);
+  }
+}
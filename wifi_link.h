@@ -0,0 +1,55 @@
+#ifndef WIFI_LINK_H
+#define WIFI_LINK_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "link_policy.h"
+
+// Aplica link_policy a la radio en cada fase: potencia máxima de
+// transmisión, modo de ahorro y tasas 802.11b (éstas sólo antes de asociar
+// y sin AP: requieren reiniciar la interfaz). El estado del enlace y los
+// resultados por nivel viven en RTC, así el despertar siguiente asocia con
+// lo aprendido. Con -DMOE_LINK_POLICY=0 se usa la política fija anterior
+// (potencia del driver, MAX_MODEM) para compararlas: el payload de
+// telemetría y /metrics informan cuál corre.
+
+#ifndef MOE_LINK_POLICY
+#define MOE_LINK_POLICY         LINK_POLICY_ADAPTIVE
+#endif
+
+typedef struct {
+  uint8_t policy;
+  uint8_t phase;                // Última fase aplicada
+  link_state_t state;
+  link_settings_t applied;      // ps ya incluye la retención (hold)
+  bool hold;
+  link_stats_t stats;
+} wifi_link_info_t;
+
+// Ajustes de la fase según el nivel actual del enlace
+void wifi_link_phase(link_phase_t phase);
+
+// Sin ahorro mientras hold (AP del portal, recepción de firmware). Al soltar
+// se vuelve a la fase de reposo.
+void wifi_link_hold_awake(bool hold);
+
+// Con el enlace arriba: mide el RSSI y, si cambió el nivel estando en
+// reposo, vuelve a aplicar la fase. Llamar periódicamente en modo continuo.
+void wifi_link_update();
+
+// Resultado de un intento de asociación o de un envío (cuenta en el nivel
+// con que se hizo)
+void wifi_link_assoc_result(bool ok, uint32_t ms);
+void wifi_link_send_result(bool ok, uint32_t ms);
+
+// El driver WiFi se apagó: lo aplicado ya no rige
+void wifi_link_radio_off();
+
+void wifi_link_get(wifi_link_info_t* out);
+
+// Resumen para el payload:
+//   "link":{"pol":..,"tier":..,"rssi":..,"fail":..,"tx":..,"ps":..,"b11":..,
+//           "sn":[por nivel],"sf":[..],"sms":[media ms],"an":[..],"af":[..],"ams":[..]}
+void wifi_link_summary(JsonObject out);
+
+#endif
@@ -0,0 +1,80 @@
+#include "wifi_rank.h"
+#include <string.h>
+
+void wifi_rank_init(wifi_net_stats_t* s)
+{
+  memset(s, 0, sizeof(*s));
+  s->score = WIFI_RANK_SCORE_INIT;
+}
+
+void wifi_rank_record(wifi_net_stats_t* s, bool ok, uint32_t latency_ms, const uint8_t* bssid, uint8_t channel)
+{
+  if (s->attempts < UINT16_MAX) s->attempts++;
+  if (!ok) {
+    s->score -= s->score >> WIFI_RANK_EWMA_SHIFT;
+    memset(s->bssid, 0, sizeof(s->bssid));
+    s->channel = 0;
+    return;
+  }
+  if (s->successes < UINT16_MAX) s->successes++;
+  s->score += (255 - s->score + (1 << WIFI_RANK_EWMA_SHIFT) - 1) >> WIFI_RANK_EWMA_SHIFT;
+  if (latency_ms > UINT16_MAX) latency_ms = UINT16_MAX;
+  if (latency_ms == 0) latency_ms = 1;
+  if (s->latency_ms == 0) {
+    s->latency_ms = (uint16_t)latency_ms;
+  } else {
+    int32_t d = (int32_t)latency_ms - (int32_t)s->latency_ms;
+    s->latency_ms = (uint16_t)((int32_t)s->latency_ms + d / (1 << WIFI_RANK_EWMA_SHIFT));
+  }
+  if (bssid) memcpy(s->bssid, bssid, sizeof(s->bssid));
+  else memset(s->bssid, 0, sizeof(s->bssid));
+  s->channel = bssid ? channel : 0;
+}
+
+int32_t wifi_rank_value(const wifi_net_stats_t* s, const wifi_scan_hit_t* hit)
+{
+  // Tasa de éxito: hasta 1020 puntos
+  int32_t v = (int32_t)s->score * 4;
+  // Señal: de -100 a -30 dBm, hasta 420 (20 dB valen unos 30 puntos de tasa)
+  if (hit) {
+    int32_t r = hit->rssi + 100;
+    if (r < 0) r = 0;
+    if (r > 70) r = 70;
+    v += r * 6;
+  }
+  // Latencia: 1 punto cada 32 ms (8 s restan 250)
+  v -= s->latency_ms / 32;
+  return v;
+}
+
+uint8_t wifi_rank_order(const wifi_net_stats_t* stats, const wifi_scan_hit_t* hits, uint8_t n,
+                        uint32_t tried, uint8_t* order)
+{
+  int32_t value[32];
+  uint8_t count = 0;
+  if (n > 32) n = 32;
+  for (uint8_t i = 0; i < n; i++) {
+    if (tried & (1UL << i)) continue;
+    if (hits && hits[i].rssi == 0) continue;
+    int32_t v = wifi_rank_value(&stats[i], hits ? &hits[i] : NULL);
+    // Inserción estable: a igual valor queda primero el índice menor
+    uint8_t k = count;
+    while (k > 0 && value[k - 1] < v) {
+      value[k] = value[k - 1];
+      order[k] = order[k - 1];
+      k--;
+    }
+    value[k] = v;
+    order[k] = i;
+    count++;
+  }
+  return count;
+}
+
+uint32_t wifi_rank_timeout_ms(const wifi_net_stats_t* s, uint32_t max_ms)
+{
+  if (s->latency_ms == 0) return max_ms;
+  uint32_t t = (uint32_t)s->latency_ms * WIFI_RANK_TIMEOUT_MULT;
+  if (t < WIFI_RANK_TIMEOUT_MIN_MS) t = WIFI_RANK_TIMEOUT_MIN_MS;
+  return t < max_ms ? t : max_ms;
+}
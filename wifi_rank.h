@@ -0,0 +1,53 @@
+#ifndef WIFI_RANK_H
+#define WIFI_RANK_H
+
+// Orden de intento entre las redes guardadas. Cada red lleva una tasa de
+// éxito reciente (EWMA en 0..255), la latencia hasta obtener IP (EWMA) y la
+// pista BSSID/canal de la última conexión buena, que permite asociarse sin
+// barrer todos los canales. El valor de una red combina tasa, latencia y,
+// si hay un escaneo a mano, la señal con que se la vio; las redes ausentes
+// de ese escaneo no son candidatas. A igual valor gana el índice menor (la
+// red guardada más recientemente). No depende de Arduino.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WIFI_RANK_SCORE_INIT        160     // Red nueva: por delante de una que viene fallando
+#define WIFI_RANK_EWMA_SHIFT        2       // Peso 1/4 de cada intento
+#define WIFI_RANK_TIMEOUT_MULT      3       // Plazo de un intento: 3x la latencia habitual
+#define WIFI_RANK_TIMEOUT_MIN_MS    1500
+
+typedef struct {
+  uint8_t bssid[6];
+  uint8_t channel;              // 0 = sin pista (asociación con barrido completo)
+  uint8_t score;                // Éxito reciente (255 = siempre conectó)
+  uint16_t latency_ms;          // Hasta obtener IP; 0 = nunca conectó
+  uint16_t attempts;            // Totales (saturan)
+  uint16_t successes;
+} wifi_net_stats_t;
+
+typedef struct {
+  uint8_t bssid[6];             // El de mejor señal de ese SSID
+  uint8_t channel;
+  int8_t rssi;                  // 0 = no apareció
+} wifi_scan_hit_t;
+
+void wifi_rank_init(wifi_net_stats_t* s);
+
+// Resultado de un intento. Con éxito se guarda la pista (bssid puede ser
+// NULL); un fallo la borra, así el próximo intento barre los canales.
+void wifi_rank_record(wifi_net_stats_t* s, bool ok, uint32_t latency_ms, const uint8_t* bssid, uint8_t channel);
+
+// hit = lo visto en el escaneo (NULL = sin escaneo)
+int32_t wifi_rank_value(const wifi_net_stats_t* s, const wifi_scan_hit_t* hit);
+
+// Deja en order los índices candidatos de mejor a peor y retorna cuántos
+// son. hits tiene n entradas (NULL = sin escaneo: todas son candidatas). Se
+// omiten las redes con su bit en tried.
+uint8_t wifi_rank_order(const wifi_net_stats_t* stats, const wifi_scan_hit_t* hits, uint8_t n,
+                        uint32_t tried, uint8_t* order);
+
+// Plazo para un intento, nunca mayor que max_ms. Sin latencia conocida, max_ms.
+uint32_t wifi_rank_timeout_ms(const wifi_net_stats_t* s, uint32_t max_ms);
+
+#endif
@@ -0,0 +1,264 @@
+#include "wifi_store.h"
+#include "moe_log.h"
+#include <Preferences.h>
+#include "esp_rom_crc.h"
+#include "freertos/semphr.h"
+
+#define WIFI_STORE_RTC_MAGIC    0x3146574DUL    // "MWF1"
+#define WIFI_STORE_VERSION      1
+
+// Formato del blob moe_wifi/nets
+typedef struct {
+  uint8_t version;
+  uint8_t count;
+  wifi_net_t nets[WIFI_STORE_MAX];
+} wifi_store_blob_t;
+
+typedef struct {
+  uint32_t magic;
+  uint8_t unsaved;                // Fuera del CRC: intentos aún no escritos en NVS
+  bool scan_valid;                // Fuera del CRC: el escaneo se renueva seguido
+  wifi_scan_hit_t scan[WIFI_STORE_MAX];
+  wifi_store_blob_t b;
+  uint32_t crc;                   // CRC32 de b
+} wifi_store_rtc_t;
+
+// Espejo persistente en deep sleep (en arranque en frío queda con magic = 0)
+RTC_DATA_ATTR static wifi_store_rtc_t ws_rtc;
+
+static portMUX_TYPE ws_mux = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t ws_write_mutex = NULL;
+static bool ws_ready = false;
+
+static uint32_t wifi_store_crc()
+{
+  return esp_rom_crc32_le(0, (const uint8_t*)&ws_rtc.b, sizeof(ws_rtc.b));
+}
+
+static bool wifi_store_rtc_valid()
+{
+  return ws_rtc.magic == WIFI_STORE_RTC_MAGIC && ws_rtc.b.version == WIFI_STORE_VERSION &&
+         ws_rtc.b.count <= WIFI_STORE_MAX && ws_rtc.crc == wifi_store_crc();
+}
+
+// Escribe la lista en NVS y replica la primera red en las claves históricas
+static bool wifi_store_write()
+{
+  xSemaphoreTake(ws_write_mutex, portMAX_DELAY);
+  wifi_store_blob_t b;
+  taskENTER_CRITICAL(&ws_mux);
+  b = ws_rtc.b;
+  ws_rtc.unsaved = 0;
+  taskEXIT_CRITICAL(&ws_mux);
+
+  Preferences prefs;
+  bool ok = prefs.begin("moe_wifi", false) && prefs.putBytes("nets", &b, sizeof(b)) == sizeof(b);
+  prefs.end();
+  if (b.count) config_set_wifi(b.nets[0].ssid, b.nets[0].pass);
+  else config_set_wifi(NULL, NULL);
+  ok = config_store_flush() && ok;
+  xSemaphoreGive(ws_write_mutex);
+  if (!ok) MLOGE("[WIFI] ERROR escribiendo la lista de redes en NVS");
+  return ok;
+}
+
+static void wifi_store_load_nvs()
+{
+  memset(&ws_rtc, 0, sizeof(ws_rtc));
+  Preferences prefs;
+  prefs.begin("moe_wifi", true);
+  size_t len = prefs.getBytes("nets", &ws_rtc.b, sizeof(ws_rtc.b));
+  prefs.end();
+  bool loaded = len == sizeof(ws_rtc.b) && ws_rtc.b.version == WIFI_STORE_VERSION && ws_rtc.b.count <= WIFI_STORE_MAX;
+  if (!loaded) memset(&ws_rtc.b, 0, sizeof(ws_rtc.b));
+  ws_rtc.b.version = WIFI_STORE_VERSION;
+  ws_rtc.crc = wifi_store_crc();
+  ws_rtc.magic = WIFI_STORE_RTC_MAGIC;
+  if (loaded) return;
+
+  // Primera vez con esta versión: importar la red única que ya estaba guardada
+  config_values_t cfg;
+  config_store_get(&cfg);
+  if (cfg.wifi_ssid[0] == 0) return;
+  wifi_net_t &n = ws_rtc.b.nets[0];
+  strlcpy(n.ssid, cfg.wifi_ssid, sizeof(n.ssid));
+  strlcpy(n.pass, cfg.wifi_pass, sizeof(n.pass));
+  wifi_rank_init(&n.stats);
+  ws_rtc.b.count = 1;
+  ws_rtc.crc = wifi_store_crc();
+  MLOGI("[WIFI] Red guardada importada a la lista: %s", n.ssid);
+  wifi_store_write();
+}
+
+void wifi_store_begin()
+{
+  if (ws_ready) return;
+  ws_write_mutex = xSemaphoreCreateMutex();
+  bool cached = wifi_store_rtc_valid();
+  if (!cached) wifi_store_load_nvs();
+  ws_ready = true;
+  MLOGI("[WIFI] %u redes guardadas (%s)", ws_rtc.b.count, cached ? "espejo RTC" : "NVS");
+}
+
+static inline void wifi_store_ensure_ready()
+{
+  if (!ws_ready) wifi_store_begin();
+}
+
+uint8_t wifi_store_count()
+{
+  wifi_store_ensure_ready();
+  return ws_rtc.b.count;
+}
+
+bool wifi_store_get(uint8_t i, wifi_net_t* out)
+{
+  wifi_store_ensure_ready();
+  bool ok = false;
+  taskENTER_CRITICAL(&ws_mux);
+  if (i < ws_rtc.b.count) {
+    *out = ws_rtc.b.nets[i];
+    ok = true;
+  }
+  taskEXIT_CRITICAL(&ws_mux);
+  return ok;
+}
+
+// Se llama dentro de la sección crítica
+static int wifi_store_find_locked(const char* ssid)
+{
+  for (uint8_t i = 0; i < ws_rtc.b.count; i++) {
+    if (strcmp(ws_rtc.b.nets[i].ssid, ssid) == 0) return i;
+  }
+  return -1;
+}
+
+int wifi_store_find(const char* ssid)
+{
+  wifi_store_ensure_ready();
+  taskENTER_CRITICAL(&ws_mux);
+  int i = wifi_store_find_locked(ssid);
+  taskEXIT_CRITICAL(&ws_mux);
+  return i;
+}
+
+bool wifi_store_add(const char* ssid, const char* pass)
+{
+  if (!ssid || !ssid[0] || strlen(ssid) > CONFIG_SSID_MAX) return false;
+  if (!pass) pass = "";
+  wifi_store_ensure_ready();
+
+  taskENTER_CRITICAL(&ws_mux);
+  wifi_store_blob_t &b = ws_rtc.b;
+  int i = wifi_store_find_locked(ssid);
+  wifi_net_t n;
+  if (i >= 0) {
+    n = b.nets[i];
+    if (strcmp(n.pass, pass) != 0) wifi_rank_init(&n.stats);
+  } else {
+    if (b.count < WIFI_STORE_MAX) {
+      i = b.count++;
+    } else {
+      // Lista llena: sale la de peor valor
+      i = 0;
+      for (uint8_t k = 1; k < b.count; k++) {
+        if (wifi_rank_value(&b.nets[k].stats, NULL) < wifi_rank_value(&b.nets[i].stats, NULL)) i = k;
+      }
+    }
+    memset(&n, 0, sizeof(n));
+    strlcpy(n.ssid, ssid, sizeof(n.ssid));
+    wifi_rank_init(&n.stats);
+  }
+  strlcpy(n.pass, pass, sizeof(n.pass));
+  // Primera de la lista: gana los empates del orden de intento
+  memmove(&b.nets[1], &b.nets[0], i * sizeof(wifi_net_t));
+  b.nets[0] = n;
+  ws_rtc.scan_valid = false;
+  ws_rtc.crc = wifi_store_crc();
+  taskEXIT_CRITICAL(&ws_mux);
+
+  MLOGI("[WIFI] Red guardada: %s (%u en la lista)", ssid, b.count);
+  return wifi_store_write();
+}
+
+bool wifi_store_remove(const char* ssid)
+{
+  wifi_store_ensure_ready();
+  taskENTER_CRITICAL(&ws_mux);
+  wifi_store_blob_t &b = ws_rtc.b;
+  int i = wifi_store_find_locked(ssid);
+  if (i >= 0) {
+    memmove(&b.nets[i], &b.nets[i + 1], (b.count - i - 1) * sizeof(wifi_net_t));
+    b.count--;
+    memset(&b.nets[b.count], 0, sizeof(wifi_net_t));
+    ws_rtc.scan_valid = false;
+    ws_rtc.crc = wifi_store_crc();
+  }
+  taskEXIT_CRITICAL(&ws_mux);
+  if (i < 0) return false;
+  MLOGI("[WIFI] Red quitada: %s", ssid);
+  wifi_store_write();
+  return true;
+}
+
+void wifi_store_clear()
+{
+  wifi_store_ensure_ready();
+  taskENTER_CRITICAL(&ws_mux);
+  memset(ws_rtc.b.nets, 0, sizeof(ws_rtc.b.nets));
+  ws_rtc.b.count = 0;
+  ws_rtc.scan_valid = false;
+  ws_rtc.crc = wifi_store_crc();
+  taskEXIT_CRITICAL(&ws_mux);
+  wifi_store_write();
+}
+
+void wifi_store_record(uint8_t i, bool ok, uint32_t latency_ms, const uint8_t* bssid, uint8_t channel)
+{
+  wifi_store_ensure_ready();
+  bool write = false;
+  taskENTER_CRITICAL(&ws_mux);
+  if (i < ws_rtc.b.count) {
+    wifi_rank_record(&ws_rtc.b.nets[i].stats, ok, latency_ms, bssid, channel);
+    ws_rtc.crc = wifi_store_crc();
+    write = ++ws_rtc.unsaved >= WIFI_STORE_FLUSH_EVERY;
+  }
+  taskEXIT_CRITICAL(&ws_mux);
+  if (write) wifi_store_write();
+}
+
+uint8_t wifi_store_stats(wifi_net_stats_t* out)
+{
+  wifi_store_ensure_ready();
+  taskENTER_CRITICAL(&ws_mux);
+  uint8_t n = ws_rtc.b.count;
+  for (uint8_t i = 0; i < n; i++) out[i] = ws_rtc.b.nets[i].stats;
+  taskEXIT_CRITICAL(&ws_mux);
+  return n;
+}
+
+bool wifi_store_scan_get(wifi_scan_hit_t* hits)
+{
+  wifi_store_ensure_ready();
+  taskENTER_CRITICAL(&ws_mux);
+  bool valid = ws_rtc.scan_valid;
+  if (valid) memcpy(hits, ws_rtc.scan, sizeof(ws_rtc.scan));
+  taskEXIT_CRITICAL(&ws_mux);
+  return valid;
+}
+
+void wifi_store_scan_set(const wifi_scan_hit_t* hits)
+{
+  wifi_store_ensure_ready();
+  taskENTER_CRITICAL(&ws_mux);
+  memcpy(ws_rtc.scan, hits, sizeof(ws_rtc.scan));
+  ws_rtc.scan_valid = true;
+  taskEXIT_CRITICAL(&ws_mux);
+}
+
+void wifi_store_scan_invalidate()
+{
+  taskENTER_CRITICAL(&ws_mux);
+  ws_rtc.scan_valid = false;
+  taskEXIT_CRITICAL(&ws_mux);
+}
@@ -0,0 +1,61 @@
+#ifndef WIFI_STORE_H
+#define WIFI_STORE_H
+
+#include <Arduino.h>
+#include "config_store.h"
+#include "wifi_rank.h"
+
+// Redes WiFi guardadas (hasta WIFI_STORE_MAX), cada una con sus
+// estadísticas de wifi_rank. La lista vive en NVS (moe_wifi/nets, un blob) y
+// se refleja en memoria RTC con CRC, igual que config_store: los despertares
+// no abren NVS. Las estadísticas se actualizan en RTC en cada intento y se
+// escriben en NVS cada WIFI_STORE_FLUSH_EVERY intentos o cuando cambia la
+// lista. La primera red de la lista se replica en moe_wifi/ssid y pass, así
+// una versión anterior del firmware sigue conectando.
+// También guarda en RTC el último escaneo pasivo, resumido por red guardada
+// (wifi_scan_hit_t): vale hasta que cambia la lista o se invalida.
+
+#define WIFI_STORE_MAX              5
+#define WIFI_STORE_FLUSH_EVERY      16      // Intentos registrados entre escrituras a NVS
+
+typedef struct {
+  char ssid[CONFIG_SSID_MAX + 1];
+  char pass[CONFIG_PASS_MAX + 1];
+  wifi_net_stats_t stats;
+} wifi_net_t;
+
+// Valida el espejo RTC o carga de NVS. La primera vez importa la red única
+// de versiones anteriores (moe_wifi/ssid).
+void wifi_store_begin();
+
+uint8_t wifi_store_count();
+
+// Copia de la red i (con su contraseña). false si no existe.
+bool wifi_store_get(uint8_t i, wifi_net_t* out);
+
+// Índice de la red con ese SSID o -1
+int wifi_store_find(const char* ssid);
+
+// Agrega la red o actualiza su contraseña, y la deja primera en la lista. Con
+// la lista llena reemplaza a la de peor valor. Una contraseña distinta
+// reinicia las estadísticas. Escribe en NVS.
+bool wifi_store_add(const char* ssid, const char* pass);
+
+// Quita la red. Escribe en NVS. false si no existía.
+bool wifi_store_remove(const char* ssid);
+
+// Borra todas las redes
+void wifi_store_clear();
+
+// Resultado de un intento de conexión con la red i (ver wifi_rank_record)
+void wifi_store_record(uint8_t i, bool ok, uint32_t latency_ms, const uint8_t* bssid, uint8_t channel);
+
+// Estadísticas de todas las redes en el orden de la lista; retorna cuántas
+uint8_t wifi_store_stats(wifi_net_stats_t* out);
+
+// Último escaneo pasivo (WIFI_STORE_MAX entradas). false si no hay uno válido.
+bool wifi_store_scan_get(wifi_scan_hit_t* hits);
+void wifi_store_scan_set(const wifi_scan_hit_t* hits);
+void wifi_store_scan_invalidate();
+
+#endif
@@ -1,20 +1,155 @@
 #include "wifi_utils.h"
+#include "moe_log.h"
 #include "config.h"
 #include "display_utils.h"
 #include "ota_utils.h"
+#include "net_stats.h"
 #include "esp_wifi.h"
-#include <Preferences.h>
-#include <WebServer.h>
-#include "images.h"
-#include <DNSServer.h>
-#include <DNSServer.h>
+#include "config_store.h"
+#include "wake_stats.h"
+#include "ap_portal.h"
+#include "wifi_store.h"
+#include "wifi_link.h"
+
+// Escaneo pasivo: escucha beacons (sin probe requests) algo más de un intervalo por canal
+#define WIFI_SCAN_DWELL_MS      110
+#define WIFI_SCAN_COST_MS       1600    // 13 canales; no se escanea si no queda este margen
+
+// WiFi.begin sin conectar (sólo carga SSID y clave) para fijar el listen
+// interval antes de la asociación: el AP lo recibe en la solicitud de
+// asociación y retiene para la estación el tráfico entre escuchas. Con
+// canal y BSSID la asociación va directo a ese AP, sin barrer los canales.
+void wifi_begin_sta(const char* ssid, const char* pass, int32_t channel, const uint8_t* bssid)
+{
+  WiFi.begin(ssid, pass, channel, bssid, false);
+  wifi_config_t conf;
+  if (esp_wifi_get_config(WIFI_IF_STA, &conf) == ESP_OK) {
+    conf.sta.listen_interval = config_get_listen_interval();
+    esp_wifi_set_config(WIFI_IF_STA, &conf);
+  }
+  esp_wifi_connect();
+}
+
+// Pista de asociación para la red i: la del escaneo guardado o la de su última conexión
+static void wifi_begin_net(const wifi_net_t* net, const wifi_scan_hit_t* hit)
+{
+  const wifi_net_stats_t* s = &net->stats;
+  if (hit && hit->rssi != 0) wifi_begin_sta(net->ssid, net->pass, hit->channel, hit->bssid);
+  else if (s->channel) wifi_begin_sta(net->ssid, net->pass, s->channel, s->bssid);
+  else wifi_begin_sta(net->ssid, net->pass);
+}
+
+bool wifi_begin_stored()
+{
+  wifi_net_stats_t stats[WIFI_STORE_MAX];
+  wifi_scan_hit_t hits[WIFI_STORE_MAX];
+  uint8_t order[WIFI_STORE_MAX];
+  uint8_t n = wifi_store_stats(stats);
+  bool have_scan = wifi_store_scan_get(hits);
+  // Sin candidatas según el escaneo: igual se intenta la mejor por historial
+  if (wifi_rank_order(stats, have_scan ? hits : NULL, n, 0, order) == 0) {
+    have_scan = false;
+    if (wifi_rank_order(stats, NULL, n, 0, order) == 0) return false;
+  }
+  wifi_net_t net;
+  if (!wifi_store_get(order[0], &net)) return false;
+  wifi_begin_net(&net, have_scan ? &hits[order[0]] : NULL);
+  return true;
+}
 
-// Namespace de NVS para credenciales
-static const char* PREF_NS = "moe_wifi";
+// Escaneo pasivo resumido por red guardada (la de mejor señal de cada SSID)
+static void wifi_scan_saved()
+{
+  wifi_scan_hit_t hits[WIFI_STORE_MAX];
+  memset(hits, 0, sizeof(hits));
+  int n = WiFi.scanNetworks(false, false, true, WIFI_SCAN_DWELL_MS);
+  for (int i = 0; i < n; i++) {
+    const wifi_ap_record_t* ap = (const wifi_ap_record_t*)WiFi.getScanInfoByIndex(i);
+    if (!ap) continue;
+    int k = wifi_store_find((const char*)ap->ssid);
+    if (k < 0 || (hits[k].rssi != 0 && hits[k].rssi >= ap->rssi)) continue;
+    memcpy(hits[k].bssid, ap->bssid, sizeof(hits[k].bssid));
+    hits[k].channel = ap->primary;
+    hits[k].rssi = ap->rssi != 0 ? ap->rssi : -1;
+  }
+  WiFi.scanDelete();
+  wifi_store_scan_set(hits);
+  MLOGI("[WIFI] Escaneo pasivo: %d redes visibles", n);
+}
+
+// Intenta las redes guardadas de mejor a peor dentro de budget_ms en total.
+// Cada intento dura a lo sumo unas veces la latencia habitual de esa red.
+// Sin escaneo guardado se ordena por historial; si la elegida falla (o el
+// escaneo guardado no muestra ninguna) se hace un escaneo pasivo, una vez,
+// y se sigue con lo que muestre. Las que no aparecen se intentan al final.
+static bool wifi_connect_ranked(uint32_t budget_ms)
+{
+  wifi_net_stats_t stats[WIFI_STORE_MAX];
+  wifi_scan_hit_t hits[WIFI_STORE_MAX];
+  uint8_t order[WIFI_STORE_MAX];
+  uint32_t tried = 0;
+  bool scanned = false;
+  bool blind = false;
+  unsigned long start = millis();
+
+  for (;;) {
+    uint32_t elapsed = millis() - start;
+    if (elapsed >= budget_ms) break;
+    uint32_t left = budget_ms - elapsed;
+    uint8_t n = wifi_store_stats(stats);
+    bool have_scan = !blind && wifi_store_scan_get(hits);
+    uint8_t c = wifi_rank_order(stats, have_scan ? hits : NULL, n, tried, order);
+    if (c == 0) {
+      if (!have_scan) break;
+      // El escaneo guardado no muestra ninguna: escanear otra vez si hay
+      // margen y, si tampoco, probar a ciegas (una red oculta no aparece)
+      if (!scanned && left >= WIFI_SCAN_COST_MS + WIFI_RANK_TIMEOUT_MIN_MS) {
+        wifi_scan_saved();
+        scanned = true;
+      } else {
+        blind = true;
+      }
+      continue;
+    }
+
+    uint8_t i = order[0];
+    wifi_net_t net;
+    if (!wifi_store_get(i, &net)) break;
+    uint32_t timeout = wifi_rank_timeout_ms(&stats[i], left);
+    display_oled_message_3_line("Conectando a", "la red Wi-Fi", net.ssid);
+    unsigned long t0 = millis();
+    wifi_link_phase(LINK_PHASE_ASSOC);
+    wifi_begin_net(&net, have_scan ? &hits[i] : NULL);
+    while (WiFi.status() != WL_CONNECTED && millis() - t0 < timeout) delay(50);
+    uint32_t took = millis() - t0;
+    wifi_link_assoc_result(WiFi.status() == WL_CONNECTED, took);
+
+    if (WiFi.status() == WL_CONNECTED) {
+      wifi_store_record(i, true, took, WiFi.BSSID(), (uint8_t)WiFi.channel());
+      MLOGI("[WIFI] Conectado a %s en %u ms (canal %d, %d dBm)", net.ssid, (unsigned)took, (int)WiFi.channel(), (int)WiFi.RSSI());
+      return true;
+    }
+    wifi_store_record(i, false, took, NULL, 0);
+    tried |= 1UL << i;
+    MLOGW("[WIFI] Sin conexión a %s tras %u ms", net.ssid, (unsigned)took);
+    WiFi.disconnect(false);
+    // El panorama cambió: el escaneo guardado ya no sirve
+    if (have_scan && !scanned) wifi_store_scan_invalidate();
+    // Quedan otras redes: ver cuáles están al alcance antes de seguir
+    bool others = tried != (1UL << n) - 1;
+    if (!scanned && others && millis() - start + WIFI_SCAN_COST_MS + WIFI_RANK_TIMEOUT_MIN_MS <= budget_ms) {
+      wifi_scan_saved();
+      scanned = true;
+    }
+  }
+  return false;
+}
 
-// Portal de configuración: nombre y password del AP
-static const char* CONFIG_AP_SSID_PREFIX = "MOE_Telemetry_";
-static const char* CONFIG_AP_PASS = ""; // abierto por defecto
+void wifi_power_save(bool enabled)
+{
+  // El modo de ahorro lo elige wifi_link según el enlace; aquí sólo se retiene
+  wifi_link_hold_awake(!enabled);
+}
 
 //  Función que permite configurar y realizar la conexión a la red Wi-Fi
 void set_wifi_connection() 
@@ -22,367 +157,48 @@ void set_wifi_connection()
   // Use the non-blocking try_connect_wifi_no_ap which will only start AP if explicitly needed
   if (try_connect_wifi_no_ap()) return;
 
-  // Intentar cargar credenciales guardadas en Preferences
+  // Sin redes guardadas (o con force_ap): abrir el portal de configuración,
+  // que queda atendiendo en segundo plano
   String stored_ssid, stored_pass;
   if (!load_wifi_credentials(stored_ssid, stored_pass)) {
-    // No hay credenciales guardadas: iniciar portal de configuración
-    Serial.println("[WIFI] No se encontraron credenciales: iniciando AP de configuración...");
-    start_config_ap();
-    // start_config_ap() reinicia el dispositivo o guarda credenciales
-    return;
-  }
-
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(stored_ssid.c_str(), stored_pass.c_str());
-
-  unsigned long startAttemptTime = millis();
-  const unsigned long timeout = WIFI_TIMEOUT_MS;
-
-  display_oled_message_3_line(
-    "Conectando a",
-    "la red Wi-Fi",
-    stored_ssid
-  );
-
-  while (WiFi.status() != WL_CONNECTED && (millis() - startAttemptTime) < timeout)
-  {
-    delay(100);
-  }
-
-  // Configurar WiFi en modo de bajo consumo
-  esp_wifi_set_ps(WIFI_PS_MAX_MODEM); // Máximo ahorro energético en WiFi
-  // esp_wifi_set_ps(WIFI_PS_MIN_MODEM); // Mínimo ahorro energético en WiFi
-
-  if (WiFi.status() == WL_CONNECTED) 
-  {
-    display_oled_message_3_line(
-      "Conexión", 
-      "Wi-Fi", 
-      "establecida"
-    );
-    delay(500);
-  } 
-  else 
-  {
-    display_oled_message_3_line(
-      "Error en", 
-      "la conexión", 
-      "Wi-Fi"
-    );
-    delay(500);
+    MLOGI("[WIFI] No se encontraron credenciales: iniciando AP de configuración...");
+    ap_portal_start();
   }
 }
 
-// Cargar credenciales desde Preferences. Retorna true si existen y no están vacías.
-// Cargar credenciales desde Preferences. Retorna true si existen y no están vacías.
+// Cargar credenciales desde la configuración cacheada. Retorna true si existen y no están vacías.
 // Además soporta la bandera "force_ap" que puede establecer OTA para forzar
 // entrar en modo AP en el siguiente reinicio (por ejemplo después de un flash).
 bool load_wifi_credentials(String &out_ssid, String &out_password)
 {
-  Preferences prefs;
-  prefs.begin(PREF_NS, true); // read-only para leer ssid/pass y flag
-  String s = prefs.getString("ssid", "");
-  String p = prefs.getString("pass", "");
-  bool force_ap = prefs.getBool("force_ap", false);
-  prefs.end();
-
-  if (force_ap) {
-    // Clear flag and force AP by returning false
-    Preferences prefs2;
-    prefs2.begin(PREF_NS, false);
-    prefs2.remove("force_ap");
-    prefs2.end();
-    Serial.println("[WIFI] force_ap flag detected -> starting AP and clearing flag");
+  if (config_get_force_ap()) {
+    // Clear flag and force AP by returning false (se escribe ya: no debe repetirse tras un corte)
+    config_set_force_ap(false);
+    config_store_flush();
+    MLOGI("[WIFI] force_ap flag detected -> starting AP and clearing flag");
     return false;
   }
 
-  if (s.length() == 0) return false;
-  out_ssid = s;
-  out_password = p;
+  // La primera de la lista: la guardada más recientemente
+  wifi_net_t net;
+  if (!wifi_store_get(0, &net)) return false;
+  out_ssid = net.ssid;
+  out_password = net.pass;
   return true;
 }
 
-// Guardar credenciales en NVS
+// Agrega la red a la lista (o actualiza su contraseña) como preferida
 void save_wifi_credentials(const char* ssid, const char* password)
 {
-  Preferences prefs;
-  prefs.begin(PREF_NS, false);
-  prefs.putString("ssid", String(ssid));
-  prefs.putString("pass", String(password));
   // Ensure we don't keep force_ap after saving credentials
-  prefs.remove("force_ap");
-  prefs.end();
+  config_set_force_ap(false);
+  wifi_store_add(ssid, password);
 }
 
-// Borrar credenciales (factory reset WiFi)
+// Borrar todas las redes (factory reset WiFi)
 void erase_wifi_credentials()
 {
-  Preferences prefs;
-  prefs.begin(PREF_NS, false);
-  prefs.remove("ssid");
-  prefs.remove("pass");
-  prefs.end();
-}
-
-// Portal de configuración simple usando WebServer. Bloqueante: espera POST /save o /factory_reset.
-void start_config_ap()
-{
-  Serial.println("[WIFI] Config AP: escaneando redes cercanas...");
-
-  // Cambiar a modo STA temporal para escanear
-  WiFi.mode(WIFI_STA);
-  WiFi.disconnect();
-  delay(200);
-
-  int n = WiFi.scanNetworks();
-  String networksJson = "[";
-  if (n > 0) {
-    for (int i = 0; i < n; ++i) {
-      String ss = WiFi.SSID(i);
-      int rssi = WiFi.RSSI(i);
-      bool open = (WiFi.encryptionType(i) == WIFI_AUTH_OPEN);
-      // Escape double quotes in SSID
-      ss.replace("\"", "\\\"");
-      networksJson += "{\"ssid\":\"" + ss + "\",\"rssi\":" + String(rssi) + ",\"open\":" + String(open ? 1 : 0) + "}";
-      if (i < n - 1) networksJson += ",";
-    }
-  }
-  networksJson += "]";
-
-  Serial.println("[WIFI] Scan completo. Redes encontradas: " + String(n));
-
-  // Iniciar AP para portal de configuración
-  // Stop OTA server if running to avoid port conflicts so AP portal on :80 is reachable
-  if (is_ota_active()) {
-    Serial.println("[WIFI] Deteniendo servidor OTA antes de iniciar AP para evitar conflicto de puertos...");
-    stop_ota_background();
-    delay(200);
-  }
-  WiFi.mode(WIFI_AP);
-  // Build AP SSID: prefix + last 4 hex digits of MAC
-  String mac = WiFi.macAddress();
-  mac.replace(":", "");
-  String last4 = mac;
-  if (last4.length() >= 4) last4 = last4.substring(last4.length() - 4);
-  String apSSID = String(CONFIG_AP_SSID_PREFIX) + last4;
-  bool apStarted = WiFi.softAP(apSSID.c_str(), CONFIG_AP_PASS);
-  if (!apStarted) {
-    Serial.println("[WIFI] ERROR: no se pudo iniciar AP");
-    return;
-  }
-
-  IPAddress apIP = WiFi.softAPIP();
-  Serial.print("[WIFI] AP iniciado. SSID: "); Serial.println(apSSID);
-  Serial.print("[WIFI] IP AP: "); Serial.println(apIP.toString());
-  // Mostrar únicamente SSID, IP y MAC en pantalla durante modo AP
-  String macAddr = WiFi.macAddress();
-  // Use specialized AP display for better readability
-  display_oled_ap_info(apSSID, apIP.toString(), macAddr);
-
-  // Iniciar servidor DNS para captive portal: redirigir todas las consultas al AP IP
-  static DNSServer dnsServer;
-  const byte DNS_PORT = 53;
-  // Responder a cualquier dominio con la IP del AP
-  dnsServer.start(DNS_PORT, "*", apIP);
-
-  WebServer apServer(80);
-
-  // Serve logo as binary PNG to avoid embedding large base64 into HTML
-  apServer.on("/logo.png", HTTP_GET, [&]() {
-    const char* b64 = get_image_base64("logo");
-    if (!b64 || b64[0] == '\0') {
-      Serial.println("[WIFI] /logo.png: no logo data");
-      apServer.send(404, "text/plain", "no logo"); return; }
-    size_t b64len = strlen(b64);
-    Serial.printf("[WIFI] /logo.png: b64len=%u\n", (unsigned)b64len);
-    size_t maxBin = (b64len / 4) * 3 + 16;
-    uint8_t* buf = (uint8_t*)malloc(maxBin);
-    if (!buf) { apServer.send(500, "text/plain", "OOM"); return; }
-    // simple base64 decode
-    const char* b64chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    unsigned char dtable[256]; memset(dtable, 0x80, 256);
-    for (int i = 0; i < 64; ++i) dtable[(unsigned char)b64chars[i]] = i;
-    dtable['='] = 0;
-    size_t out_len = 0; unsigned int val = 0; int valb = -8;
-    for (size_t i = 0; i < b64len; ++i) {
-      unsigned char c = b64[i]; if (dtable[c] & 0x80) continue;
-      val = (val << 6) + dtable[c]; valb += 6;
-      if (valb >= 0) { buf[out_len++] = (unsigned char)((val >> valb) & 0xFF); valb -= 8; }
-    }
-    Serial.printf("[WIFI] /logo.png: decoded=%u bytes\n", (unsigned)out_len);
-    if (out_len >= 8) {
-      Serial.print("[WIFI] /logo.png: header=");
-      for (int i = 0; i < 8; ++i) {
-        if (buf[i] < 16) Serial.print('0');
-        Serial.print(buf[i], HEX);
-        Serial.print(' ');
-      }
-      Serial.println();
-    }
-    WiFiClient client = apServer.client();
-    String hdr = "HTTP/1.1 200 OK\r\n";
-    hdr += "Content-Type: image/png\r\n";
-    hdr += "Content-Length: "; hdr += String((int)out_len); hdr += "\r\n";
-    hdr += "Connection: close\r\n\r\n";
-    client.print(hdr);
-    size_t wrote = client.write(buf, out_len);
-    Serial.printf("[WIFI] /logo.png: wrote=%u bytes to client\n", (unsigned)wrote);
-    client.flush();
-    free(buf);
-  });
-
-  // Endpoint que devuelve redes escaneadas como JSON
-  apServer.on("/scan", HTTP_GET, [&]() {
-    apServer.send(200, "application/json", networksJson);
-  });
-
-  // Página principal (UI estilo OTA)
-  apServer.on("/", HTTP_GET, [&]() {
-    String page = R"rawliteral(
-<!DOCTYPE html>
-<html lang="es">
-<head>
-  <meta charset="utf-8">
-  <meta name="viewport" content="width=device-width,initial-scale=1">
-  <title>MOE Telemetry - Configuración WiFi</title>
-  <style>
-    :root{--bg:rgb(0,0,0);--card-bg:rgb(20,20,20);--accent:rgb(0,140,226);--accent-dark:#007bb5;--info-bg:rgba(0,140,226,0.04);--muted:#6c757d;--text:#ffffff;--update-green:#28a745;--reset-red:#dc3545}
-    body{font-family:-apple-system,BlinkMacSystemFont,'Segoe UI',Roboto,Helvetica,Arial;background:var(--bg);color:var(--text);min-height:100vh;display:flex;align-items:center;justify-content:center;padding:20px}
-    .container{background:var(--card-bg);border-radius:12px;max-width:640px;width:100%;box-shadow:0 20px 60px rgba(0,0,0,.7);overflow:hidden;border:1px solid rgba(255,255,255,0.03);position:relative}
-    .header{background:linear-gradient(135deg,#222222 0%,#4a4a4a 100%);color:var(--text);padding:30px;text-align:center}
-    .header h1{font-size:24px;margin:0;color:var(--accent)}
-    #logo{height:64px;display:block;margin:6px auto;background:rgba(255,255,255,0.02);padding:6px;border-radius:8px}
-    .content{padding:28px}
-    label{display:block;margin-top:12px;color:rgba(255,255,255,0.8);font-weight:600}
-    select,input{width:100%;padding:12px;margin-top:6px;border-radius:8px;border:1px solid rgba(255,255,255,0.06);background:transparent;color:var(--text)}
-    select{background:rgb(30,30,30)}
-    .row{display:flex;gap:12px}
-    .row .col{flex:1}
-    .buttons{display:flex;gap:10px;margin-top:18px}
-    button{flex:1;padding:12px;border-radius:10px;border:none;font-weight:700;cursor:pointer}
-    .primary{background:linear-gradient(90deg,var(--accent) 0%,var(--accent-dark) 100%);color:#fff}
-    .danger{background:linear-gradient(90deg,var(--muted) 0%,#5a636b 100%);color:#fff}
-    .status{margin-top:14px;padding:12px;border-radius:8px;background:rgba(0,0,0,0.06);color:var(--text);border-left:4px solid var(--accent)}
-    .signature{position:absolute;left:0;right:0;bottom:6px;text-align:center;font-size:10px;color:#fff;opacity:0.04;pointer-events:none;user-select:none}
-  </style>
-</head>
-<body>
-  <div class="container">
-    <div class="header">
-      <h1>Configuración WiFi</h1>
-      <div class="version"><img id="logo" src="__LOGO__" alt="MOE" style="display:block;margin:0 auto;"></div>
-      <div class="signature">juan camilo yepes</div>
-    </div>
-    <div class="content">
-      <label for="ssidSelect">Seleccionar red disponible</label>
-      <select id="ssidSelect"><option value="">-- redes cercanas --</option></select>
-
-      <label for="ssidInput">SSID (puedes escribir o seleccionar)</label>
-      <input id="ssidInput" placeholder="Nombre de la red">
-
-      <label for="passInput">Contraseña</label>
-      <input id="passInput" type="password" placeholder="Contraseña WiFi (si aplica)">
-
-      <div class="buttons">
-        <button id="saveBtn" class="primary">Guardar y Conectar</button>
-        <button id="resetBtn" class="danger">Restablecer de fábrica</button>
-      </div>
-
-      <div id="status" class="status" style="display:none">Estado...</div>
-    </div>
-  </div>
-
-  <script>
-    const ssidSelect = document.getElementById('ssidSelect');
-    const ssidInput = document.getElementById('ssidInput');
-    const passInput = document.getElementById('passInput');
-    const saveBtn = document.getElementById('saveBtn');
-    const resetBtn = document.getElementById('resetBtn');
-    const statusDiv = document.getElementById('status');
-
-    function showStatus(msg, ok=true){ statusDiv.style.display='block'; statusDiv.textContent = msg; statusDiv.style.background = ok ? 'rgba(0,140,226,0.12)' : 'rgba(220,40,40,0.12)'; statusDiv.style.color = '#ffffff'; }
-
-    // Cargar redes desde /scan
-    fetch('/scan').then(r=>r.json()).then(list=>{
-      list.sort((a,b)=>b.rssi-a.rssi);
-      list.forEach(n=>{
-        const opt = document.createElement('option');
-        opt.value = n.ssid;
-        opt.textContent = `${n.ssid} (${n.rssi}dBm)`;
-        ssidSelect.appendChild(opt);
-      });
-    }).catch(()=>{ /* ignore */ });
-
-    ssidSelect.addEventListener('change', ()=>{ if (ssidSelect.value) ssidInput.value = ssidSelect.value; });
-
-    saveBtn.addEventListener('click', ()=>{
-      const ss = ssidInput.value.trim();
-      const pw = passInput.value;
-      if (!ss){ showStatus('SSID vacío', false); return; }
-      showStatus('Guardando credenciales...');
-      const form = new FormData(); form.append('ssid', ss); form.append('pass', pw);
-      fetch('/save', { method:'POST', body: form }).then(r=>r.text()).then(t=>{
-        showStatus('Guardado. Reiniciando...', true);
-        setTimeout(()=>location.reload(),3000);
-      }).catch(e=>{ showStatus('Error al guardar', false); });
-    });
-
-    resetBtn.addEventListener('click', ()=>{
-      if (!confirm('¿Borrar credenciales y reiniciar el dispositivo?')) return;
-      fetch('/factory_reset', { method:'POST' }).then(r=>r.text()).then(t=>{ showStatus('Restableciendo...'); setTimeout(()=>location.reload(),3000); }).catch(()=>{ showStatus('Error al resetear', false); });
-    });
-  </script>
-</body>
-</html>
-)rawliteral";
-
-    // Inyectar la IP del AP en la página para que también se muestre en el navegador
-    page.replace("MOE Telemetry", "MOE Telemetry - " + apIP.toString());
-    // Reemplazar placeholder de logo y añadir IP al título
-    String pageStr = page;
-    // Embed the logo as a data: URI so it renders even when the client is connected to the AP
-    pageStr.replace("__LOGO__", String("data:image/png;base64,") + String(get_image_base64("logo")));
-    pageStr.replace("MOE Telemetry", String("MOE Telemetry - ") + apIP.toString());
-    apServer.send(200, "text/html", pageStr);
-  });
-
-  // Captive portal behavior: servir una página simple para cualquier request
-  // Esto ayuda a clientes que no siguen 302/Location o usan HTTPS para comprobaciones.
-  apServer.onNotFound([&]() {
-    String fallback = "<html><head><meta http-equiv=\"refresh\" content=\"0;url=http://" + apIP.toString() + "\"></head><body>Red de configuracion MOE - <a href=\"http://" + apIP.toString() + "\">Abrir configuracion</a></body></html>";
-    apServer.send(200, "text/html", fallback);
-  });
-
-  // Save handler
-  apServer.on("/save", HTTP_POST, [&]() {
-    String ss = apServer.arg("ssid");
-    String pw = apServer.arg("pass");
-    if (ss.length() == 0) {
-      apServer.send(400, "text/plain", "SSID vacío");
-      return;
-    }
-    save_wifi_credentials(ss.c_str(), pw.c_str());
-    apServer.send(200, "text/plain", "Guardado");
-    delay(200);
-    ESP.restart();
-  });
-
-  // Factory reset handler
-  apServer.on("/factory_reset", HTTP_POST, [&]() {
-    erase_wifi_credentials();
-    apServer.send(200, "text/plain", "Borrado");
-    delay(200);
-    ESP.restart();
-  });
-
-  apServer.begin();
-  Serial.println("[WIFI] Portal de configuración activo en "+apIP.toString());
-
-  while (true) {
-    dnsServer.processNextRequest();
-    apServer.handleClient();
-    delay(10);
-  }
+  wifi_store_clear();
 }
 
 //  Función que permite establecer la hora y fecha actual en que ocurre el evento
@@ -403,7 +219,8 @@ time_t get_time_NTP()
       display_oled_message_3_line(
         "Error al", 
         "sincronizar con", 
-        "NTP"
+        "NTP",
+        500
       );
       return 0;
     }
@@ -433,46 +250,42 @@ void disconnect_wifi()
   WiFi.mode(WIFI_OFF);                                                  //  Se garantiza que no se quede en modo STA o AP
   esp_wifi_stop();                                                      //  Se apaga el driver
   esp_wifi_deinit();                                                    //  Se deshabilita completamente el módulo WiFi
+  wifi_link_radio_off();
+  wake_stats_wifi(false);
 }
 
 // Try to connect using stored credentials but DO NOT launch AP if none are present.
 // Returns true if connected, false otherwise.
 bool try_connect_wifi_no_ap()
 {
-  String stored_ssid, stored_pass;
-  if (!load_wifi_credentials(stored_ssid, stored_pass)) {
-    Serial.println("[WIFI] try_connect_wifi_no_ap: no credentials stored");
+  // El portal está probando otras credenciales: no pisar su asociación
+  if (ap_portal_owns_sta()) return WiFi.status() == WL_CONNECTED;
+  // force_ap lo atiende set_wifi_connection (abre el portal)
+  if (wifi_store_count() == 0 || config_get_force_ap()) {
+    MLOGI("[WIFI] try_connect_wifi_no_ap: no credentials stored");
     return false;
   }
 
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(stored_ssid.c_str(), stored_pass.c_str());
+  // Con el portal abierto el AP sigue arriba junto a la estación
+  WiFi.mode(ap_portal_active() ? WIFI_AP_STA : WIFI_STA);
+  wake_stats_wifi(true);
 
+  // WIFI_TIMEOUT_MS es el presupuesto de todos los intentos juntos
   unsigned long startAttemptTime = millis();
-  const unsigned long timeout = WIFI_TIMEOUT_MS;
+  bool connected = wifi_connect_ranked(WIFI_TIMEOUT_MS);
+  net_stats_record_assoc(millis() - startAttemptTime, connected);
 
-  display_oled_message_3_line(
-    "Conectando a",
-    "la red Wi-Fi",
-    stored_ssid
-  );
+  // Configurar WiFi en modo de bajo consumo (según el nivel del enlace)
+  wifi_link_phase(LINK_PHASE_IDLE);
 
-  while (WiFi.status() != WL_CONNECTED && (millis() - startAttemptTime) < timeout)
-  {
-    delay(100);
-  }
-
-  // Configurar WiFi en modo de bajo consumo
-  esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
-
-  if (WiFi.status() == WL_CONNECTED)
+  if (connected)
   {
     display_oled_message_3_line(
       "Conexión",
       "Wi-Fi",
-      "establecida"
+      "establecida",
+      200
     );
-    delay(200);
     return true;
   }
   else
@@ -480,9 +293,9 @@ bool try_connect_wifi_no_ap()
     display_oled_message_3_line(
       "Error en",
       "la conexión",
-      "Wi-Fi"
+      "Wi-Fi",
+      200
     );
-    delay(200);
     return false;
   }
-}
\ No newline at end of file
+}
@@ -9,16 +9,23 @@
 void set_wifi_connection();
 
 // Attempt to connect to WiFi using stored credentials but DO NOT start AP if none.
+// Prueba las redes guardadas de mejor a peor (wifi_rank) con WIFI_TIMEOUT_MS
+// como presupuesto total.
 // Returns true if connected (WL_CONNECTED), false otherwise.
 bool try_connect_wifi_no_ap();
 
-// Configuración y persistencia de credenciales WiFi
+// Configuración y persistencia de credenciales WiFi. Las redes viven en la
+// lista de wifi_store; load devuelve la guardada más recientemente.
 bool load_wifi_credentials(String &out_ssid, String &out_password);
 void save_wifi_credentials(const char* ssid, const char* password);
 void erase_wifi_credentials();
 
-// Inicia un Access Point con portal de configuración (bloqueante hasta guardar o reiniciar)
-void start_config_ap();
+// Asocia la estación sin esperar, fijando antes el listen interval. Con
+// canal y BSSID se asocia directo a ese AP.
+void wifi_begin_sta(const char* ssid, const char* pass, int32_t channel = 0, const uint8_t* bssid = NULL);
+
+// wifi_begin_sta con la mejor red guardada según wifi_rank. false si no hay.
+bool wifi_begin_stored();
 
 // Funciones de sincronización de tiempo
 time_t get_time_NTP();
@@ -26,4 +33,11 @@ time_t get_time_NTP();
 // Funciones de desconexión para ahorro energético
 void disconnect_wifi();
 
+// Modem sleep: la radio se apaga entre beacons y despierta cada listen
+// interval beacons (config_store; debe ser múltiplo del DTIM del AP, los
+// broadcasts como ARP sólo se entregan en los beacons DTIM) o, con el enlace
+// débil, cada DTIM (wifi_link). false lo desactiva mientras se recibe
+// firmware o el portal tiene el AP arriba; true vuelve al modo de reposo.
+void wifi_power_save(bool enabled);
+
 #endif
\ No newline at end of file